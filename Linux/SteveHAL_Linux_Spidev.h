@@ -0,0 +1,657 @@
+/****************************************************************************
+SteveHAL_Linux_Spidev.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a Linux-specific Hardware Abstraction Layer for Steve,
+using the spidev driver for SPI and libgpiod for the !PD line.
+****************************************************************************/
+
+#ifndef _STEVEHAL_LINUX_SPIDEV_H
+#define _STEVEHAL_LINUX_SPIDEV_H
+
+#ifdef __linux__
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#include <gpiod.h>
+
+#include "SteveHAL.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// STEVE HAL FOR LINUX
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// This implements a Steve Hardware Abstraction Layer for Linux, using the
+// spidev driver (/dev/spidevB.C) and the libgpiod library (version 1.x).
+// It can be used on e.g. a Raspberry Pi, with the !CS line of the EVE
+// connected to one of the chip select pins of the SPI controller, and the
+// !PD line connected to a GPIO pin.
+//
+// Every ioctl call to the spidev driver is a round trip through the kernel
+// that takes much longer than clocking a byte out, so this HAL stores
+// everything that's sent between Select(true) and Select(false) in a
+// cache, and sends it with a single SPI_IOC_MESSAGE call when the chip is
+// de-selected. Read transactions send the header and receive the data in
+// one SPI_IOC_MESSAGE call with multiple segments.
+//
+// The spidev driver limits the total size of a message to its "bufsiz"
+// module parameter (4096 by default). The cache size should not be larger
+// than that. Transactions that don't fit in a single message are split
+// into multiple messages, and the !CS line is kept active between them.
+//
+// Link with -lgpiod.
+class SteveHAL_Linux_Spidev : public SteveHAL
+{
+public:
+  //-------------------------------------------------------------------------
+  // Default parameters
+  const static size_t DEFAULT_CACHE_SIZE = 4096;
+  const static size_t MIN_CACHE_SIZE = 64;
+
+  // Maximum SPI clock speed during early initialization
+  const static uint32_t MAX_SLOW_CLOCK = 11000000;
+
+  // Maximum number of segments in a message
+  const static unsigned MAX_SEGMENTS = 2;
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  const char       *_device;            // Name of the spidev device
+  uint32_t          _clockRate;         // Clock frequency to use
+  const char       *_gpioChip;          // Name of GPIO chip for !PD
+  unsigned          _pdLine;            // GPIO line offset for !PD
+
+  int               _fd;                // File descriptor for spidev
+  struct gpiod_chip *_chip;             // GPIO chip
+  struct gpiod_line *_line;             // GPIO line for !PD
+  uint32_t          _speed;             // Current SPI clock speed
+  bool              _slow;              // True if using slow clock
+
+  bool              _selected;          // True if EVE chip is selected
+  bool              _csActive;          // True if !CS kept active by driver
+  size_t            _cacheSize;         // Size of cache buffer
+  uint8_t          *_cache;             // Write cache buffer
+  size_t            _cacheIndex;        // Number of bytes in cache
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveHAL_Linux_Spidev(
+    const char *device = "/dev/spidev0.0", // Name of the spidev device
+    uint32_t clockrate = 16000000,      // Clock frequency to use
+    const char *gpiochip = "gpiochip0", // Name of GPIO chip for !PD
+    unsigned pdline = 25,               // GPIO line offset for !PD
+    size_t cachesize = DEFAULT_CACHE_SIZE) // Maximum bytes per message
+  {
+    _device = device;
+    _clockRate = clockrate;
+    _gpioChip = gpiochip;
+    _pdLine = pdline;
+
+    _fd = -1;
+    _chip = NULL;
+    _line = NULL;
+    _speed = clockrate;
+    _slow = true;
+
+    _selected = false;
+    _csActive = false;
+
+    if (cachesize < MIN_CACHE_SIZE)
+    {
+      cachesize = MIN_CACHE_SIZE;
+    }
+
+    _cacheSize = cachesize;
+    _cache = new uint8_t[_cacheSize];
+    _cacheIndex = 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveHAL_Linux_Spidev()
+  {
+    End();
+
+    delete[] _cache;
+  }
+
+private:
+  //-------------------------------------------------------------------------
+  // The cache buffer is owned by the instance, so it can't be copied
+  SteveHAL_Linux_Spidev(const SteveHAL_Linux_Spidev &) = delete;
+  SteveHAL_Linux_Spidev &operator=(const SteveHAL_Linux_Spidev &) = delete;
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the hardware
+  virtual bool Begin() override         // Returns true if successful
+  {
+    if (_fd >= 0)
+    {
+      return true;
+    }
+
+    bool result = false;
+
+    _fd = open(_device, O_RDWR);
+    if (_fd < 0)
+    {
+      perror(_device);
+      return false;
+    }
+
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+
+    if ((ioctl(_fd, SPI_IOC_WR_MODE, &mode) < 0)
+      || (ioctl(_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0)
+      || (ioctl(_fd, SPI_IOC_WR_MAX_SPEED_HZ, &_clockRate) < 0))
+    {
+      perror("spidev configuration failed");
+    }
+    else if (NULL == (_chip = gpiod_chip_open_by_name(_gpioChip)))
+    {
+      perror(_gpioChip);
+    }
+    else if (NULL == (_line = gpiod_chip_get_line(_chip, _pdLine)))
+    {
+      perror("gpiod_chip_get_line failed");
+    }
+    else if (gpiod_line_request_output(_line, "Steve", 0) < 0)
+    {
+      perror("gpiod_line_request_output failed");
+      _line = NULL;
+    }
+    else
+    {
+      result = true;
+    }
+
+    if (!result)
+    {
+      End();
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Shut down the hardware
+  virtual void End() override
+  {
+    if (_line)
+    {
+      gpiod_line_release(_line);
+      _line = NULL;
+    }
+
+    if (_chip)
+    {
+      gpiod_chip_close(_chip);
+      _chip = NULL;
+    }
+
+    if (_fd >= 0)
+    {
+      close(_fd);
+      _fd = -1;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the communication
+  //
+  // The clock speed is set for each transfer segment.
+  virtual void Init(
+    bool slow = false) override         // True=use slow speed for early init
+  {
+    _speed = _clockRate;
+    _slow = slow;
+
+    if (slow && (_speed > MAX_SLOW_CLOCK))
+    {
+      _speed = MAX_SLOW_CLOCK;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the fast clock
+  //
+  // The maximum speed of the device is raised if necessary; the new clock
+  // is used for the next transfer segment.
+  virtual bool SetClock(                // Returns true=success
+    uint32_t hz) override               // New fast clock in Hz
+  {
+    if ((_fd >= 0) && (hz > _clockRate)
+      && (ioctl(_fd, SPI_IOC_WR_MAX_SPEED_HZ, &hz) < 0))
+    {
+      perror("spidev speed change failed");
+      return false;
+    }
+
+    _clockRate = hz;
+
+    Init(_slow);
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the fast clock
+  virtual uint32_t GetClock() override  // Returns fast clock in Hz
+  {
+    return _clockRate;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Pause or resume communication
+  virtual void Pause(
+    bool pause) override                // True=pause, false=resume
+  {
+    (void)pause;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Turn the power on or off
+  virtual void Power(
+    bool enable) override               // True=on (!PD high) false=off/reset
+  {
+    gpiod_line_set_value(_line, enable ? 1 : 0);
+
+    _cacheIndex = 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize a transfer segment
+  void InitSegment(
+    struct spi_ioc_transfer &seg,       // Segment to initialize
+    const uint8_t *tx,                  // Data to send, NULL=send zeroes
+    uint8_t *rx,                        // Receive buffer, NULL=ignore
+    size_t len)                         // Number of bytes
+  {
+    memset(&seg, 0, sizeof(seg));
+    seg.tx_buf = (unsigned long)tx;
+    seg.rx_buf = (unsigned long)rx;
+    seg.len = (uint32_t)len;
+    seg.speed_hz = _speed;
+    seg.bits_per_word = 8;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a message to the driver
+  //
+  // The cs_change flag of the last segment tells the driver to keep the
+  // !CS line active after the message, so that the transaction can be
+  // continued with the next message.
+  void SendMessage(
+    struct spi_ioc_transfer *segs,      // Segments to send
+    unsigned num,                       // Number of segments
+    bool end)                           // True=end of transaction
+  {
+    segs[num - 1].cs_change = end ? 0 : 1;
+
+    if (ioctl(_fd, SPI_IOC_MESSAGE(num), segs) < 0)
+    {
+      perror("SPI_IOC_MESSAGE failed");
+      exit(-3);
+    }
+
+    _csActive = !end;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send write cache buffer
+  void SendCache(
+    bool end)                           // True=end of transaction
+  {
+    if (_cacheIndex || (end && _csActive))
+    {
+      struct spi_ioc_transfer seg;
+
+      InitSegment(seg, _cache, NULL, _cacheIndex);
+      SendMessage(&seg, 1, end);
+
+      _cacheIndex = 0;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Store data in cache
+  //
+  // The cache is sent when it's full and more data needs to be stored, so
+  // the cache is never empty when the transaction ends.
+  size_t WriteToCache(const void *buf, size_t size)
+  {
+    const uint8_t *block = (const uint8_t *)buf;
+    size_t remsize = size;
+
+    while (remsize)
+    {
+      if (_cacheIndex == _cacheSize)
+      {
+        SendCache(false);
+      }
+
+      size_t blocksize = remsize;
+
+      if (_cacheIndex + blocksize > _cacheSize)
+      {
+        blocksize = _cacheSize - _cacheIndex;
+      }
+
+      memcpy(&_cache[_cacheIndex], block, blocksize);
+      block += blocksize;
+      _cacheIndex += blocksize;
+      remsize -= blocksize;
+    }
+
+    return size;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive data into a buffer
+  //
+  // Any cached data is sent first, and the !CS line is kept active.
+  //
+  // If a header is given, it's sent in the same message as the first part
+  // of the data.
+  uint32_t ReceiveToBuffer(             // Returns number of bytes received
+    const uint8_t *header,              // Header to send first, NULL=none
+    uint32_t headerlen,                 // Number of header bytes
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len,                       // Number of bytes to receive
+    bool end)                           // True=end transaction when done
+  {
+    struct spi_ioc_transfer segs[MAX_SEGMENTS];
+    uint32_t result = 0;
+
+    if ((!len) && (!header))
+    {
+      return 0;
+    }
+
+    do
+    {
+      unsigned num = 0;
+      size_t chunk = len - result;
+
+      if (header)
+      {
+        InitSegment(segs[num++], header, NULL, headerlen);
+        chunk = (chunk + headerlen > _cacheSize) ? _cacheSize - headerlen : chunk;
+        header = NULL;
+      }
+      else if (chunk > _cacheSize)
+      {
+        chunk = _cacheSize;
+      }
+
+      if (chunk)
+      {
+        InitSegment(segs[num++], NULL, buffer + result, chunk);
+        result += (uint32_t)chunk;
+      }
+
+      SendMessage(segs, num, end && (result == len));
+    } while (result < len);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Select or de-select the chip
+  //
+  // The !CS line is controlled by the driver during messages, so this only
+  // starts or ends a transaction in the cache.
+  virtual bool Select(
+    bool enable) override               // True=select (!CS low) false=de-sel
+  {
+    bool result = (enable != _selected);
+
+    if (result)
+    {
+      if (enable)
+      {
+        _cacheIndex = 0;
+      }
+      else
+      {
+        SendCache(true);
+      }
+
+      _selected = enable;
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Transfer data to and from the EVE chip
+  virtual uint8_t Transfer(             // Returns received byte
+    uint8_t value) override             // Byte to send
+  {
+    struct spi_ioc_transfer seg;
+    uint8_t result;
+
+    SendCache(false);
+
+    InitSegment(seg, &value, &result, 1);
+    SendMessage(&seg, 1, !_selected);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send an 8-bit value
+  virtual void Send8(
+    uint8_t value) override             // Value to send
+  {
+    WriteToCache(&value, 1);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 16-bit value in little-endian format
+  virtual void Send16(
+    uint16_t value) override            // Value to send
+  {
+    uint8_t buf[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+
+    WriteToCache(buf, 2);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 24 bit value in BIG ENDIAN format
+  virtual void Send24BE(
+    uint32_t value) override            // Value to send (MSB ignored)
+  {
+    uint8_t buf[3] = { (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+
+    WriteToCache(buf, 3);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 32-bit value in little-endian format
+  virtual void Send32(
+    uint32_t value) override            // Value to send
+  {
+    uint8_t buf[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+
+    WriteToCache(buf, 4);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from a RAM buffer to the chip
+  virtual uint32_t SendBuffer(          // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len) override              // Number of bytes to send
+  {
+    return (uint32_t)WriteToCache(buffer, len);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a string with its nul-terminator and alignment bytes
+  //
+  // If the whole string fits, it's copied straight into the cache with one
+  // space check; otherwise WriteToCache sends the cache as needed.
+  virtual uint32_t SendStringPadded(    // Returns number of bytes sent
+    const char *s,                      // Characters to send, not NULL
+    uint16_t len,                       // Number of characters
+    uint16_t total) override            // Total including zero bytes
+  {
+    if (_cacheIndex + total <= _cacheSize)
+    {
+      memcpy(&_cache[_cacheIndex], s, len);
+      memset(&_cache[_cacheIndex + len], 0, (size_t)(total - len));
+      _cacheIndex += total;
+    }
+    else
+    {
+      const uint8_t zeroes[4] = { 0, 0, 0, 0 };
+
+      WriteToCache(s, len);
+      WriteToCache(zeroes, (size_t)(total - len));
+    }
+
+    return total;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive an 8-bit value
+  virtual uint8_t Receive8() override   // Returns incoming value
+  {
+    uint8_t result;
+
+    ReceiveBuffer(&result, 1);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a 16-bit value in little-endian format
+  virtual uint16_t Receive16() override // Returns incoming value
+  {
+    uint8_t buf[2];
+
+    ReceiveBuffer(buf, 2);
+
+    return (uint16_t)buf[0] | ((uint16_t)buf[1] << 8);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a 32-bit value in little-endian format
+  virtual uint32_t Receive32() override // Returns incoming value
+  {
+    uint8_t buf[4];
+
+    ReceiveBuffer(buf, 4);
+
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a buffer
+  virtual uint32_t ReceiveBuffer(       // Returns number of bytes received
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len) override              // Number of bytes to receive
+  {
+    SendCache(false);
+
+    return ReceiveToBuffer(NULL, 0, buffer, len, !_selected);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Perform a complete read transaction
+  //
+  // The header and the first part of the data are transferred in a single
+  // message.
+  virtual uint32_t ReadTransaction(     // Returns number of bytes received
+    const uint8_t *header,              // Header to send
+    uint32_t headerlen,                 // Number of header bytes to send
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len) override              // Number of bytes to receive
+  {
+    // Make sure the previous transaction has ended
+    Select(false);
+
+    return ReceiveToBuffer(header, headerlen, buffer, len, true);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for at least the requested time
+  virtual void Delay(
+    uint32_t ms) override               // Number of milliseconds to wait
+  {
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+
+    // Continue with the remaining time if interrupted by a signal
+    while ((nanosleep(&ts, &ts) < 0) && (errno == EINTR))
+    {
+      // Nothing
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  virtual uint32_t Micros() override    // Returns timestamp in us
+  {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000);
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
+#endif
@@ -0,0 +1,720 @@
+/****************************************************************************
+SteveHAL_Windows_FT4222.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a Windows-specific Hardware Abstraction Layer for Steve,
+using an FTDI FT4222H USB-to-QSPI bridge.
+****************************************************************************/
+
+#ifndef _STEVEHAL_WINDOWS_FT4222_H
+#define _STEVEHAL_WINDOWS_FT4222_H
+
+#ifdef _WIN32
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ftd2xx.h"
+#include "LibFT4222.h"
+#include "SteveHAL.h"
+
+#ifdef _WIN64
+#pragma comment(lib, "LibFT4222-64.lib")
+#else
+#pragma comment(lib, "LibFT4222.lib")
+#endif
+#pragma comment(lib, "ftd2xx.lib")
+
+/////////////////////////////////////////////////////////////////////////////
+// STEVE HAL FOR WINDOWS WITH FT4222H
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// This implements a Steve Hardware Abstraction Layer for Windows using the
+// LibFT4222 library from FTDI, for FT4222H modules such as the UMFT4222EV.
+//
+// The FT4222H must be in chip mode 0 (this is the default). In that mode,
+// the chip shows up as two interfaces: "FT4222 A" is the SPI master, and
+// "FT4222 B" is used for the GPIO pins. The !CS line of the EVE is
+// connected to SS0O, and the !PD line is connected to one of the GPIO pins
+// (GPIO0 by default). If more than one FT4222H is connected, the index
+// parameter of the constructor selects which one is used.
+//
+// The FT4222H supports single, dual and quad SPI, so Steve switches the
+// EVE and the HAL to quad SPI during initialization. The IO2 and IO3 lines
+// of the FT4222H must be connected to the EVE for that.
+//
+// The FT4222H library does a complete SPI transaction (from !CS going low
+// to !CS going high) for every call in multi-IO mode, so this HAL stores
+// everything that's sent between Select(true) and Select(false) in a cache
+// and sends it in one call. Transactions that don't fit in the cache are
+// split up into multiple transactions with new addresses.
+class SteveHAL_Windows_FT4222 : public SteveHAL
+{
+public:
+  //-------------------------------------------------------------------------
+  // Default parameters
+  //
+  // The FT4222H library can transfer up to 64 KB per call. The cache size
+  // minus the 3-byte address must be a multiple of 4, so that commands
+  // that are written to REG_CMDB_WRITE aren't split in the middle of a
+  // 32-bit value.
+  const static size_t DEFAULT_CACHE_SIZE = 65535;
+  const static size_t MIN_CACHE_SIZE = 7;
+
+  // Maximum SPI clock speed during early initialization
+  const static UINT32 MAX_SLOW_CLOCK = 11000000;
+
+  // Address of REG_CMDB_WRITE; when a transaction to this register is
+  // split, the address is not incremented.
+  const static DWORD REG_CMDB_WRITE_ADDRESS = 0x302578;
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  DWORD             _index;             // Index of FT4222H to use
+  UINT32            _clockRate;         // Clock frequency to use
+  GPIO_Port         _pdPort;            // GPIO pin used for !PD
+
+  FT_HANDLE         _spiHandle;         // Handle to the SPI interface
+  FT_HANDLE         _gpioHandle;        // Handle to the GPIO interface
+  bool              _spiInitialized;    // True if SPI master initialized
+  bool              _slow;              // True if using slow clock
+  FT4222_SPIMode    _ioLines;           // Current bus width
+  bool              _selected;          // True if EVE chip is selected
+
+  size_t            _cacheSize;         // Size of cache buffer
+  BYTE             *_cache;             // Write cache buffer
+  size_t            _cacheIndex;        // Number of bytes in cache
+  bool              _open;              // True=single-IO transaction open
+  DWORD             _txAddress;         // Address of current transaction
+  DWORD             _txOffset;          // Bytes sent in current transaction
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveHAL_Windows_FT4222(
+    DWORD index,                        // Index of FT4222H to use
+    UINT32 clockrate,                   // Clock frequency to use
+    GPIO_Port pdport = GPIO_PORT0,      // GPIO pin used for !PD
+    size_t cachesize = DEFAULT_CACHE_SIZE) // Write cache size in bytes
+  {
+    _index = index;
+    _clockRate = clockrate;
+    _pdPort = pdport;
+
+    _spiHandle = 0;
+    _gpioHandle = 0;
+    _spiInitialized = false;
+    _slow = true;
+    _ioLines = SPI_IO_SINGLE;
+    _selected = false;
+
+    if (cachesize > DEFAULT_CACHE_SIZE)
+    {
+      cachesize = DEFAULT_CACHE_SIZE;
+    }
+    if (cachesize < MIN_CACHE_SIZE)
+    {
+      cachesize = MIN_CACHE_SIZE;
+    }
+
+    // Round down to a multiple of 4 plus the address
+    _cacheSize = ((cachesize - 3) & ~(size_t)3) + 3;
+    _cache = new BYTE[_cacheSize];
+    _cacheIndex = 0;
+    _open = false;
+    _txAddress = 0;
+    _txOffset = 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveHAL_Windows_FT4222()
+  {
+    End();
+
+    delete[] _cache;
+  }
+
+private:
+  //-------------------------------------------------------------------------
+  // The cache buffer is owned by the instance, so it can't be copied
+  SteveHAL_Windows_FT4222(const SteveHAL_Windows_FT4222 &) = delete;
+  SteveHAL_Windows_FT4222 &operator=(const SteveHAL_Windows_FT4222 &) = delete;
+
+protected:
+  //-------------------------------------------------------------------------
+  // Find the system clock and divider for the requested SPI clock
+  //
+  // The highest frequency that's not higher than the requested frequency
+  // is used.
+  static void FindClock(
+    UINT32 rate,                        // Requested SPI clock
+    FT4222_ClockRate &sysclk,           // Output system clock
+    FT4222_SPIClock &divider)           // Output divider
+  {
+    static const struct
+    {
+      FT4222_ClockRate clk;
+      UINT32 hz;
+    } clocks[] =
+    {
+      { SYS_CLK_80, 80000000 },
+      { SYS_CLK_60, 60000000 },
+      { SYS_CLK_48, 48000000 },
+      { SYS_CLK_24, 24000000 },
+    };
+
+    UINT32 best = 0;
+
+    sysclk = SYS_CLK_24;
+    divider = CLK_DIV_512;
+
+    for (size_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++)
+    {
+      for (int d = CLK_DIV_2; d <= CLK_DIV_512; d++)
+      {
+        UINT32 hz = clocks[c].hz >> d;
+
+        if ((hz <= rate) && (hz > best))
+        {
+          best = hz;
+          sysclk = clocks[c].clk;
+          divider = (FT4222_SPIClock)d;
+        }
+      }
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the hardware
+  //
+  // This opens the SPI interface of the requested FT4222H and the GPIO
+  // interface that belongs to it. The interfaces of the same chip have
+  // consecutive location IDs.
+  virtual bool Begin() override         // Returns true if successful
+  {
+    if (_spiHandle)
+    {
+      return true;
+    }
+
+    bool result = false;
+    DWORD num = 0;
+
+    if ((FT_OK != FT_CreateDeviceInfoList(&num)) || (!num))
+    {
+      fprintf(stderr, "No FTDI devices found\n");
+      return false;
+    }
+
+    FT_DEVICE_LIST_INFO_NODE *list = new FT_DEVICE_LIST_INFO_NODE[num];
+    DWORD spiLocation = 0;
+    DWORD found = 0;
+
+    if (FT_OK == FT_GetDeviceInfoList(list, &num))
+    {
+      for (DWORD u = 0; u < num; u++)
+      {
+        printf("Device %u: %s LocId %X\n", u, list[u].Description, list[u].LocId);
+
+        if (!strcmp(list[u].Description, "FT4222 A"))
+        {
+          if (found++ == _index)
+          {
+            spiLocation = list[u].LocId;
+          }
+        }
+      }
+    }
+
+    delete[] list;
+
+    if (!spiLocation)
+    {
+      fprintf(stderr, "Not enough FT4222 devices found (wanted >%u got %u)\n", _index, found);
+      return false;
+    }
+
+    if (FT_OK != FT_OpenEx((PVOID)(ULONG_PTR)spiLocation, FT_OPEN_BY_LOCATION, &_spiHandle))
+    {
+      fprintf(stderr, "FT4222 %u failed to open SPI interface\n", _index);
+      _spiHandle = 0;
+    }
+    else if (FT_OK != FT_OpenEx((PVOID)(ULONG_PTR)(spiLocation + 1), FT_OPEN_BY_LOCATION, &_gpioHandle))
+    {
+      fprintf(stderr, "FT4222 %u failed to open GPIO interface\n", _index);
+      _gpioHandle = 0;
+    }
+    else
+    {
+      // GPIO2 and GPIO3 are used for suspend out and wakeup by default
+      FT4222_SetSuspendOut(_gpioHandle, FALSE);
+      FT4222_SetWakeUpInterrupt(_gpioHandle, FALSE);
+
+      GPIO_Dir dirs[4] = { GPIO_INPUT, GPIO_INPUT, GPIO_INPUT, GPIO_INPUT };
+      dirs[_pdPort] = GPIO_OUTPUT;
+
+      if (FT4222_OK != FT4222_GPIO_Init(_gpioHandle, dirs))
+      {
+        fprintf(stderr, "FT4222 %u failed to initialize GPIO\n", _index);
+      }
+      else
+      {
+        result = true;
+      }
+    }
+
+    if (!result)
+    {
+      End();
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Shut down the hardware
+  virtual void End() override
+  {
+    if (_gpioHandle)
+    {
+      FT4222_UnInitialize(_gpioHandle);
+      FT_Close(_gpioHandle);
+      _gpioHandle = 0;
+    }
+
+    if (_spiHandle)
+    {
+      FT4222_UnInitialize(_spiHandle);
+      FT_Close(_spiHandle);
+      _spiHandle = 0;
+    }
+
+    _spiInitialized = false;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the communication
+  virtual void Init(
+    bool slow = false) override         // True=use slow speed for early init
+  {
+    UINT32 rate = _clockRate;
+    FT4222_ClockRate sysclk;
+    FT4222_SPIClock divider;
+
+    if (slow && (rate > MAX_SLOW_CLOCK))
+    {
+      rate = MAX_SLOW_CLOCK;
+    }
+
+    FindClock(rate, sysclk, divider);
+
+    if ((FT4222_OK != FT4222_SetClock(_spiHandle, sysclk))
+      || (FT4222_OK != FT4222_SPIMaster_Init(_spiHandle, _ioLines, divider, CLK_IDLE_LOW, CLK_LEADING, 0x01)))
+    {
+      fprintf(stderr, "FT4222 %u failed to initialize SPI\n", _index);
+      exit(-3);
+    }
+
+    FT4222_SPI_SetDrivingStrength(_spiHandle, DS_8MA, DS_8MA, DS_8MA);
+
+    _spiInitialized = true;
+    _slow = slow;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the fast clock
+  //
+  // If the fast clock is in use, the SPI master is initialized again with
+  // the new clock. The actual clock is the highest one that the FT4222
+  // can generate without going over the requested clock (see FindClock).
+  virtual bool SetClock(                // Returns true=success
+    uint32_t hz) override               // New fast clock in Hz
+  {
+    _clockRate = hz;
+
+    if ((_spiInitialized) && (!_slow))
+    {
+      Init(false);
+    }
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the fast clock
+  virtual uint32_t GetClock() override  // Returns fast clock in Hz
+  {
+    return _clockRate;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the supported bus widths
+  virtual uint8_t GetBusWidths() override // Returns combination of BUSWIDTHs
+  {
+    return BUSWIDTH_SINGLE | BUSWIDTH_DUAL | BUSWIDTH_QUAD;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the bus width
+  //
+  // The values of the BUSWIDTH enum match the FT4222_SPIMode values.
+  virtual bool SetBusWidth(             // Returns true=success
+    BUSWIDTH width) override            // New bus width
+  {
+    _ioLines = (FT4222_SPIMode)width;
+
+    // If the SPI master isn't initialized yet, Init will use the width
+    if (_spiInitialized)
+    {
+      if (FT4222_OK != FT4222_SPIMaster_SetLines(_spiHandle, _ioLines))
+      {
+        fprintf(stderr, "FT4222 %u failed to set bus width %u\n", _index, width);
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Pause or resume communication
+  virtual void Pause(
+    bool pause) override                // True=pause, false=resume
+  {
+    // Nothing
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Turn the power on or off
+  virtual void Power(
+    bool enable) override               // True=on (!PD high) false=off/reset
+  {
+    FT4222_GPIO_Write(_gpioHandle, _pdPort, enable ? TRUE : FALSE);
+
+    _cacheIndex = 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send write cache buffer
+  //
+  // In single-IO mode, the transaction is kept open if it's not the end of
+  // the transaction. In multi-IO mode, every call is a complete
+  // transaction, so if this is not the end, the cache is re-initialized
+  // with the address of the next byte (or the same address for
+  // REG_CMDB_WRITE).
+  void SendCache(
+    bool end)                           // True=end of transaction
+  {
+    if (!_cacheIndex)
+    {
+      return;
+    }
+
+    uint16 sizeTransferred;
+    uint32 sizeOfRead;
+    size_t sent = _cacheIndex;
+
+    if (_ioLines == SPI_IO_SINGLE)
+    {
+      FT4222_SPIMaster_SingleWrite(_spiHandle, _cache, (uint16)_cacheIndex, &sizeTransferred, end ? TRUE : FALSE);
+
+      _open = !end;
+      _cacheIndex = 0;
+    }
+    else
+    {
+      FT4222_SPIMaster_MultiReadWrite(_spiHandle, NULL, _cache, 0, (uint16)_cacheIndex, 0, &sizeOfRead);
+
+      _cacheIndex = 0;
+
+      if (!end)
+      {
+        // Every part of the transaction starts with the address
+        _txOffset += (DWORD)(sent - 3);
+
+        DWORD address = _txAddress;
+        if ((address & 0x3FFFFF) != REG_CMDB_WRITE_ADDRESS)
+        {
+          address += _txOffset;
+        }
+
+        _cache[_cacheIndex++] = (BYTE)(address >> 16);
+        _cache[_cacheIndex++] = (BYTE)(address >> 8);
+        _cache[_cacheIndex++] = (BYTE)(address);
+      }
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Store data in cache
+  //
+  // The cache is sent when it's full and more data needs to be stored, so
+  // the cache is never empty when the transaction ends.
+  size_t WriteToCache(LPCVOID buf, size_t size)
+  {
+    const UCHAR *block = (const UCHAR *)buf;
+    size_t remsize = size;
+
+    while (remsize)
+    {
+      if (_cacheIndex == _cacheSize)
+      {
+        SendCache(false);
+      }
+
+      size_t blocksize = remsize;
+
+      if (_cacheIndex + blocksize > _cacheSize)
+      {
+        blocksize = _cacheSize - _cacheIndex;
+      }
+
+      memcpy(&_cache[_cacheIndex], block, blocksize);
+      block += blocksize;
+      _cacheIndex += blocksize;
+      remsize -= blocksize;
+
+      // Remember the address of a write transaction so it can be split
+      if ((!_txOffset) && (_cacheIndex >= 3) && (_cacheIndex - blocksize < 3))
+      {
+        _txAddress = ((DWORD)_cache[0] << 16) | ((DWORD)_cache[1] << 8) | (DWORD)_cache[2];
+      }
+    }
+
+    return size;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Select or de-select the chip
+  //
+  // The !CS line is controlled by the FT4222H library during transfers, so
+  // this only starts or ends a transaction in the cache.
+  virtual bool Select(
+    bool enable) override               // True=select (!CS low) false=de-sel
+  {
+    bool result = (enable != _selected);
+
+    if (result)
+    {
+      if (enable)
+      {
+        _cacheIndex = 0;
+        _txAddress = 0;
+        _txOffset = 0;
+      }
+      else
+      {
+        SendCache(true);
+      }
+
+      _selected = enable;
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Transfer data to and from the EVE chip
+  virtual uint8_t Transfer(             // Returns received byte
+    uint8_t value) override             // Byte to send
+  {
+    fprintf(stderr, "BUG: You shouldn't get here");
+    exit(-3);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send an 8-bit value
+  virtual void Send8(
+    uint8_t value) override             // Value to send
+  {
+    WriteToCache(&value, 1);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 16-bit value in little-endian format
+  virtual void Send16(
+    uint16_t value) override            // Value to send
+  {
+    // NOTE: Little-endian system assumed.
+    WriteToCache(&value, 2);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 24 bit value in BIG ENDIAN format
+  virtual void Send24BE(
+    uint32_t value) override            // Value to send (MSB ignored)
+  {
+    UINT32 buf = ((value >> 16) & 0xFF) | (value & 0x00FF00) | ((value & 0xFF) << 16);
+
+    WriteToCache(&buf, 3);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 32-bit value in little-endian format
+  virtual void Send32(
+    uint32_t value) override            // Value to send
+  {
+    // NOTE: Little-endian system assumed.
+    WriteToCache(&value, 4);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from a RAM buffer to the chip
+  virtual uint32_t SendBuffer(          // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len) override              // Number of bytes to send
+  {
+    return (uint32_t)WriteToCache(buffer, len);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a string with its nul-terminator and alignment bytes
+  //
+  // If the whole string fits, it's copied straight into the cache with one
+  // space check. The transaction header must already be in the cache, so
+  // WriteToCache has remembered the transaction address.
+  virtual uint32_t SendStringPadded(    // Returns number of bytes sent
+    const char *s,                      // Characters to send, not NULL
+    uint16_t len,                       // Number of characters
+    uint16_t total) override            // Total including zero bytes
+  {
+    if ((_cacheIndex >= 3) && (_cacheIndex + total <= _cacheSize))
+    {
+      memcpy(&_cache[_cacheIndex], s, len);
+      memset(&_cache[_cacheIndex + len], 0, (size_t)(total - len));
+      _cacheIndex += total;
+    }
+    else
+    {
+      const uint8_t zeroes[4] = { 0, 0, 0, 0 };
+
+      WriteToCache(s, len);
+      WriteToCache(zeroes, (size_t)(total - len));
+    }
+
+    return total;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Perform a complete read transaction
+  //
+  // Reads of more than 64 KB are split into multiple transactions.
+  //
+  // NOTE: This is the only way to read data from the EVE with this HAL;
+  // the Receive functions are not supported.
+  virtual uint32_t ReadTransaction(     // Returns number of bytes received
+    const uint8_t *header,              // Header to send
+    uint32_t headerlen,                 // Number of header bytes to send
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len) override              // Number of bytes to receive
+  {
+    // Make sure the previous transaction has ended
+    Select(false);
+
+    BYTE hdr[8];
+    DWORD address = ((DWORD)header[0] << 16) | ((DWORD)header[1] << 8) | (DWORD)header[2];
+    uint32_t result = 0;
+
+    if (headerlen > sizeof(hdr))
+    {
+      headerlen = sizeof(hdr);
+    }
+
+    memcpy(hdr, header, headerlen);
+
+    while (result < len)
+    {
+      uint16 chunk = (len - result > 0xFFFF) ? 0xFFFF : (uint16)(len - result);
+      uint16 sizeTransferred;
+      uint32 sizeOfRead;
+      FT4222_STATUS status;
+
+      hdr[0] = (BYTE)((address + result) >> 16);
+      hdr[1] = (BYTE)((address + result) >> 8);
+      hdr[2] = (BYTE)(address + result);
+
+      if (_ioLines == SPI_IO_SINGLE)
+      {
+        status = FT4222_SPIMaster_SingleWrite(_spiHandle, hdr, (uint16)headerlen, &sizeTransferred, FALSE);
+
+        if (FT4222_OK == status)
+        {
+          status = FT4222_SPIMaster_SingleRead(_spiHandle, buffer + result, chunk, &sizeTransferred, TRUE);
+        }
+      }
+      else
+      {
+        status = FT4222_SPIMaster_MultiReadWrite(_spiHandle, buffer + result, hdr, 0, (uint16)headerlen, chunk, &sizeOfRead);
+      }
+
+      if (FT4222_OK != status)
+      {
+        fprintf(stderr, "FT4222 read failed status %u\n", status);
+        exit(-3);
+      }
+
+      result += chunk;
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for at least the requested time
+  virtual void Delay(
+    uint32_t ms) override               // Number of milliseconds to wait
+  {
+    Sleep(ms);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  virtual uint32_t Micros() override    // Returns timestamp in us
+  {
+    LARGE_INTEGER count;
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+
+    return TicksToMicros((uint64_t)count.QuadPart, (uint64_t)frequency.QuadPart);
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
+#endif
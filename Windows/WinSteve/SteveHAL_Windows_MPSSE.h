@@ -22,6 +22,7 @@ This file declares a Windows-specific Hardware Abstraction Layer for Steve.
 #include "SteveHAL.h"
 
 #pragma comment(lib, "libmpsse.lib")
+#pragma comment(lib, "ftd2xx.lib")
 
 /////////////////////////////////////////////////////////////////////////////
 // STEVE HAL FOR WINDOWS
@@ -73,35 +74,160 @@ This file declares a Windows-specific Hardware Abstraction Layer for Steve.
 // any reason. See the LICENSE file.
 class SteveHAL_Windows_MPSSE : public SteveHAL
 {
+public:
+  //-------------------------------------------------------------------------
+  // Default parameters
+  //
+  // Every SPI_Write call costs at least one USB transaction, so the write
+  // cache should be big enough to hold an entire RAM_CMD fill (4 KB plus
+  // the address), so that a frame goes out in a single USB bulk transfer.
+  // The USB transfer sizes must be multiples of 64 bytes, and the maximum
+  // that the driver supports is 64 KB. The latency timer is the time in
+  // milliseconds that the FTDI chip waits before sending an incomplete
+  // packet to the host, which delays every read.
+  const static size_t DEFAULT_CACHE_SIZE = 8192;
+  const static size_t MAX_CACHE_SIZE = 65536;
+  const static DWORD DEFAULT_USB_TRANSFER_SIZE = 65536;
+  const static UCHAR DEFAULT_LATENCY = 2;
+
+  // Maximum SPI clock speed during early initialization
+  const static UINT32 MAX_SLOW_CLOCK = 8000000;
+
+  // With more than one cache buffer, the buffers are sent by a worker
+  // thread, so the application can fill the next buffer while the USB
+  // transfer of the previous one is in progress. Only reads, pin changes
+  // and Wait have to wait for the worker thread to finish.
+  const static size_t DEFAULT_CACHE_BUFFERS = 1;
+  const static size_t MAX_CACHE_BUFFERS = 8;
+
+  // The !INT line (Purple) is connected to ADBUS5 (GPIOL1). The MPSSE
+  // command to read the low byte of the pins, and the command to send the
+  // result back immediately.
+  const static UCHAR INT_PIN_MASK = 0x20;
+  const static UCHAR MPSSE_CMD_GET_DATA_BITS_LOWBYTE = 0x81;
+  const static UCHAR MPSSE_CMD_SEND_IMMEDIATE = 0x87;
+
 protected:
   //-------------------------------------------------------------------------
   // Data
   DWORD             _channel;           // MPSSE channel to use
   UINT32            _clockRate;         // Clock frequency to use
+  DWORD             _usbInSize;         // USB IN transfer size
+  DWORD             _usbOutSize;        // USB OUT transfer size
+  UCHAR             _latency;           // Latency timer in ms
 
   FT_HANDLE         _ftHandle;          // Handle to the channel
   bool              _selected;          // True if EVE chip is selected
+  bool              _csPending;         // True if !CS not activated yet
+  bool              _slow;              // True if using slow clock
 
-  const static size_t _cacheSize = 128; // Size of cache buffer
-  BYTE              _cache[_cacheSize]; // Write cache buffer
+  size_t            _cacheSize;         // Size of cache buffer
+  BYTE             *_cache;             // Write cache buffer being filled
   size_t            _cacheIndex;        // Number of bytes in cache
 
+  //-------------------------------------------------------------------------
+  // Cache buffer waiting for the worker thread
+  struct Pending
+  {
+    BYTE           *_buffer;            // Buffer to send
+    DWORD           _length;            // Number of bytes to send
+    DWORD           _options;           // Transfer options for SPI_Write
+  };
+
+  size_t            _bufferCount;       // Number of cache buffers
+  BYTE             *_buffers[MAX_CACHE_BUFFERS]; // Cache buffers
+  size_t            _fill;              // Index of buffer being filled
+  Pending           _pending[MAX_CACHE_BUFFERS]; // Queue for worker
+  size_t            _queueHead;         // Index of oldest queue entry
+  size_t            _queueCount;        // Number of queue entries
+
+  HANDLE            _thread;            // Worker thread, NULL=synchronous
+  bool              _stop;              // True=worker should exit
+  CRITICAL_SECTION  _lock;              // Protects the queue
+  CONDITION_VARIABLE _work;             // Signaled when buffer queued
+  CONDITION_VARIABLE _done;             // Signaled when buffer sent
+
 public:
   //-------------------------------------------------------------------------
   // Constructor
   SteveHAL_Windows_MPSSE(
     DWORD channel,                      // MPSSE channel to use
-    UINT32 clockrate)                   // Clock frequency to use
+    UINT32 clockrate,                   // Clock frequency to use
+    size_t cachesize = DEFAULT_CACHE_SIZE, // Write cache size in bytes
+    DWORD usbinsize = DEFAULT_USB_TRANSFER_SIZE, // USB IN transfer size
+    DWORD usboutsize = DEFAULT_USB_TRANSFER_SIZE, // USB OUT transfer size
+    UCHAR latency = DEFAULT_LATENCY,    // Latency timer in ms (1..255)
+    size_t buffers = DEFAULT_CACHE_BUFFERS) // Number of cache buffers
   {
     _channel = channel;
     _clockRate = clockrate;
+    _usbInSize = usbinsize;
+    _usbOutSize = usboutsize;
+    _latency = latency;
 
     _ftHandle = 0;
     _selected = true;
+    _csPending = false;
+    _slow = true;
+
+    if (cachesize < 1)
+    {
+      cachesize = 1;
+    }
+    if (cachesize > MAX_CACHE_SIZE)
+    {
+      cachesize = MAX_CACHE_SIZE;
+    }
 
+    if (buffers < 1)
+    {
+      buffers = 1;
+    }
+    if (buffers > MAX_CACHE_BUFFERS)
+    {
+      buffers = MAX_CACHE_BUFFERS;
+    }
+
+    _cacheSize = cachesize;
+    _bufferCount = buffers;
+    for (size_t u = 0; u < _bufferCount; u++)
+    {
+      _buffers[u] = new BYTE[_cacheSize];
+    }
+    _fill = 0;
+    _cache = _buffers[_fill];
     _cacheIndex = 0;
+
+    _queueHead = 0;
+    _queueCount = 0;
+    _thread = NULL;
+    _stop = false;
+    InitializeCriticalSection(&_lock);
+    InitializeConditionVariable(&_work);
+    InitializeConditionVariable(&_done);
   }
 
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveHAL_Windows_MPSSE()
+  {
+    StopWorker();
+
+    for (size_t u = 0; u < _bufferCount; u++)
+    {
+      delete[] _buffers[u];
+    }
+
+    DeleteCriticalSection(&_lock);
+  }
+
+private:
+  //-------------------------------------------------------------------------
+  // The cache buffers are owned by the instance, so it can't be copied
+  SteveHAL_Windows_MPSSE(const SteveHAL_Windows_MPSSE &) = delete;
+  SteveHAL_Windows_MPSSE &operator=(const SteveHAL_Windows_MPSSE &) = delete;
+
 protected:
   //-------------------------------------------------------------------------
   // Initialize the hardware
@@ -138,7 +264,7 @@ protected:
         }
         else
         {
-          result = true;
+          result = StartWorker();
         }
       }
       else
@@ -152,41 +278,203 @@ protected:
 
 protected:
   //-------------------------------------------------------------------------
-  // Initialize the communication
-  virtual void Init(
-    bool slow = false) override         // True=use slow speed for early init
+  // Shut down the hardware
+  virtual void End() override
   {
-    FT_STATUS status;
+    // Send whatever is still queued
+    StopWorker();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Worker thread that sends queued cache buffers
+  static DWORD WINAPI WorkerProc(
+    LPVOID param)                       // HAL instance
+  {
+    SteveHAL_Windows_MPSSE *hal = (SteveHAL_Windows_MPSSE *)param;
+
+    EnterCriticalSection(&hal->_lock);
 
-    if (slow)
+    for (;;)
     {
-      UINT32 rate = _clockRate;
-      if (slow && (rate > 8000000))
+      while ((!hal->_queueCount) && (!hal->_stop))
+      {
+        SleepConditionVariableCS(&hal->_work, &hal->_lock, INFINITE);
+      }
+
+      // Only exit when the queue is empty
+      if (!hal->_queueCount)
       {
-        rate = 8000000;
+        break;
       }
 
-      ChannelConfig channelConf = { 0 };
-      channelConf.ClockRate = rate;
-      channelConf.LatencyTimer = 10;
-      channelConf.configOptions = SPI_CONFIG_OPTION_MODE0 | SPI_CONFIG_OPTION_CS_DBUS3 | SPI_CONFIG_OPTION_CS_ACTIVELOW;
+      // The buffer stays in the queue until it's sent, so it doesn't get
+      // reused in the mean time
+      Pending &p = hal->_pending[hal->_queueHead];
+
+      LeaveCriticalSection(&hal->_lock);
+
+      DWORD sizeTransferred;
 
-      status = SPI_InitChannel(_ftHandle, &channelConf);
-      if (status != FT_OK)
+      SPI_Write(hal->_ftHandle, p._buffer, p._length, &sizeTransferred, p._options);
+
+      EnterCriticalSection(&hal->_lock);
+
+      hal->_queueHead = (hal->_queueHead + 1) % hal->_bufferCount;
+      hal->_queueCount--;
+
+      WakeAllConditionVariable(&hal->_done);
+    }
+
+    LeaveCriticalSection(&hal->_lock);
+
+    return 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Start the worker thread if there's more than one cache buffer
+  bool                                  // Returns true=success
+  StartWorker()
+  {
+    if ((_bufferCount > 1) && (!_thread))
+    {
+      _stop = false;
+
+      _thread = CreateThread(NULL, 0, WorkerProc, this, 0, NULL);
+      if (!_thread)
       {
-        fprintf(stderr, "Channel %u failed to initialize SPI status %u\n", _channel, status);
-        exit(-3);
+        fprintf(stderr, "Channel %u failed to create worker thread\n", _channel);
+        return false;
       }
+    }
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Stop the worker thread after it sends all queued buffers
+  void StopWorker()
+  {
+    if (_thread)
+    {
+      EnterCriticalSection(&_lock);
+      _stop = true;
+      WakeConditionVariable(&_work);
+      LeaveCriticalSection(&_lock);
+
+      WaitForSingleObject(_thread, INFINITE);
+      CloseHandle(_thread);
+      _thread = NULL;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Check if the worker thread has buffers to send
+  virtual bool IsBusy() override        // Returns true=transfer in progress
+  {
+    bool result = false;
+
+    if (_thread)
+    {
+      EnterCriticalSection(&_lock);
+      result = (_queueCount != 0);
+      LeaveCriticalSection(&_lock);
+    }
 
-/*
-      status = FT_SetUSBParameters(_ftHandle, 64, 64);
-      if (status != FT_OK)
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait until the worker thread has sent all queued buffers
+  //
+  // This must be called before anything else accesses the channel, so that
+  // everything happens in the right order.
+  virtual void Wait() override
+  {
+    if (_thread)
+    {
+      EnterCriticalSection(&_lock);
+
+      while (_queueCount)
       {
-        fprintf(stderr, "Channel %u failed to setup USB parameters %u\n", _channel, status);
-        exit(-3);
+        SleepConditionVariableCS(&_done, &_lock, INFINITE);
       }
-*/
+
+      LeaveCriticalSection(&_lock);
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the communication
+  //
+  // The channel is initialized again for each speed change, so the fast
+  // clock is actually used after early initialization.
+  virtual void Init(
+    bool slow = false) override         // True=use slow speed for early init
+  {
+    FT_STATUS status;
+
+    // The worker thread must be done with the channel
+    Wait();
+
+    UINT32 rate = _clockRate;
+    if (slow && (rate > MAX_SLOW_CLOCK))
+    {
+      rate = MAX_SLOW_CLOCK;
+    }
+
+    ChannelConfig channelConf = { 0 };
+    channelConf.ClockRate = rate;
+    channelConf.LatencyTimer = _latency;
+    channelConf.configOptions = SPI_CONFIG_OPTION_MODE0 | SPI_CONFIG_OPTION_CS_DBUS3 | SPI_CONFIG_OPTION_CS_ACTIVELOW;
+
+    status = SPI_InitChannel(_ftHandle, &channelConf);
+    if (status != FT_OK)
+    {
+      fprintf(stderr, "Channel %u failed to initialize SPI status %u\n", _channel, status);
+      exit(-3);
     }
+
+    status = FT_SetUSBParameters(_ftHandle, _usbInSize, _usbOutSize);
+    if (status != FT_OK)
+    {
+      fprintf(stderr, "Channel %u failed to setup USB parameters %u\n", _channel, status);
+      exit(-3);
+    }
+
+    _slow = slow;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the fast clock
+  //
+  // If the fast clock is in use, the channel is initialized again with the
+  // new clock.
+  virtual bool SetClock(                // Returns true=success
+    uint32_t hz) override               // New fast clock in Hz
+  {
+    _clockRate = hz;
+
+    if ((_ftHandle) && (!_slow))
+    {
+      Init(false);
+    }
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the fast clock
+  virtual uint32_t GetClock() override  // Returns fast clock in Hz
+  {
+    return _clockRate;
   }
 
 protected:
@@ -204,6 +492,10 @@ protected:
   virtual void Power(
     bool enable) override               // True=on (!PD high) false=off/reset
   {
+    // Discard the cache; whatever was queued is sent first
+    Wait();
+    _cacheIndex = 0;
+
     // Temporarily change the CS output to DBUS7 (Blue)
     SPI_ChangeCS(_ftHandle, SPI_CONFIG_OPTION_MODE0 | SPI_CONFIG_OPTION_CS_DBUS7 | SPI_CONFIG_OPTION_CS_ACTIVELOW);
 
@@ -212,23 +504,108 @@ protected:
 
     // Change CS back to pin DBUS3 (Orange)
     SPI_ChangeCS(_ftHandle, SPI_CONFIG_OPTION_MODE0 | SPI_CONFIG_OPTION_CS_DBUS3 | SPI_CONFIG_OPTION_CS_ACTIVELOW);
+  }
 
-    _cacheIndex = 0;
+protected:
+  //-------------------------------------------------------------------------
+  // Activate the !CS line if it was postponed
+  //
+  // Select(true) doesn't change the !CS line immediately; the line is
+  // activated by the first transfer, as part of the same USB transaction.
+  // This is only needed if there's no transfer to attach it to.
+  void ActivateCS()
+  {
+    if (_csPending)
+    {
+      Wait();
+      SPI_ToggleCS(_ftHandle, TRUE);
+
+      _csPending = false;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Put the write cache buffer in the queue for the worker thread, and
+  // switch to the next buffer
+  //
+  // If the next buffer is still queued, this waits until it's sent.
+  void QueueCache(
+    DWORD options)                      // Transfer options for SPI_Write
+  {
+    EnterCriticalSection(&_lock);
+
+    Pending &p = _pending[(_queueHead + _queueCount) % _bufferCount];
+
+    p._buffer = _cache;
+    p._length = (DWORD)_cacheIndex;
+    p._options = options;
+    _queueCount++;
+
+    WakeConditionVariable(&_work);
+
+    while (_queueCount == _bufferCount)
+    {
+      SleepConditionVariableCS(&_done, &_lock, INFINITE);
+    }
+
+    LeaveCriticalSection(&_lock);
+
+    _fill = (_fill + 1) % _bufferCount;
+    _cache = _buffers[_fill];
   }
 
 protected:
   //-------------------------------------------------------------------------
   // Send write cache buffer
-  void SendCache()
+  //
+  // If the !CS line activation is still pending, it's done as part of the
+  // write. If requested, the !CS line is de-activated at the end of the
+  // write.
+  //
+  // If there's a worker thread, the buffer is queued instead of sent, and
+  // this only waits if all buffers are in use.
+  void SendCache(
+    bool deselect = false)              // True=de-activate !CS at the end
   {
     if (_cacheIndex)
     {
       DWORD sizeTransferred;
+      DWORD options = SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES;
+
+      if (_csPending)
+      {
+        options |= SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE;
+        _csPending = false;
+      }
+
+      if (deselect)
+      {
+        options |= SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE;
+      }
 
-      SPI_Write(_ftHandle, _cache, _cacheIndex, &sizeTransferred, 0);
+      if (_thread)
+      {
+        QueueCache(options);
+      }
+      else
+      {
+        SPI_Write(_ftHandle, _cache, (DWORD)_cacheIndex, &sizeTransferred, options);
+      }
 
       _cacheIndex = 0;
     }
+    else if (deselect)
+    {
+      // Nothing to send; if the !CS line was never activated, leave it
+      if (!_csPending)
+      {
+        Wait();
+        SPI_ToggleCS(_ftHandle, FALSE);
+      }
+
+      _csPending = false;
+    }
   }
 
 protected:
@@ -277,12 +654,16 @@ protected:
 
     if (result)
     {
-      if (!enable)
+      if (enable)
       {
-        SendCache();
+        // Postpone activating the !CS line until the first transfer
+        _csPending = true;
+      }
+      else
+      {
+        // Send the cached data and de-activate the !CS line, all in one
+        SendCache(true);
       }
-
-      SPI_ToggleCS(_ftHandle, !!enable);
 
       _selected = enable;
     }
@@ -290,6 +671,18 @@ protected:
     return result;
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Send the cached data and get ready to read from the chip
+  //
+  // Reads have to wait until all queued buffers are sent.
+  void BeginRead()
+  {
+    SendCache();
+    Wait();
+    ActivateCS();
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Transfer data to and from the EVE chip
@@ -352,6 +745,35 @@ protected:
     return WriteToCache(buffer, len);
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Send a string with its nul-terminator and alignment bytes
+  //
+  // If the whole string fits, it's copied straight into the cache with one
+  // space check. The cache must not end up full here, because WriteToCache
+  // sends it as soon as it fills up.
+  virtual uint32_t SendStringPadded(    // Returns number of bytes sent
+    const char *s,                      // Characters to send, not NULL
+    uint16_t len,                       // Number of characters
+    uint16_t total) override            // Total including zero bytes
+  {
+    if (_cacheIndex + total < _cacheSize)
+    {
+      memcpy(&_cache[_cacheIndex], s, len);
+      memset(&_cache[_cacheIndex + len], 0, (size_t)(total - len));
+      _cacheIndex += total;
+    }
+    else
+    {
+      const uint8_t zeroes[4] = { 0, 0, 0, 0 };
+
+      WriteToCache(s, len);
+      WriteToCache(zeroes, (size_t)(total - len));
+    }
+
+    return total;
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Receive an 8-bit value
@@ -360,10 +782,7 @@ protected:
     uint8_t result;
     DWORD sizeTransferred;
 
-    if (_cacheIndex)
-    {
-      SendCache();
-    }
+    BeginRead();
 
     // NOTE: Little-endian system assumed.
     if (FT_OK != SPI_Read(_ftHandle, &result, 1, &sizeTransferred, 0))
@@ -385,10 +804,7 @@ protected:
     uint16_t result;
     DWORD sizeTransferred;
 
-    if (_cacheIndex)
-    {
-      SendCache();
-    }
+    BeginRead();
 
     // NOTE: Little-endian system assumed.
     if (FT_OK != SPI_Read(_ftHandle, (uint8_t *)&result, 2, &sizeTransferred, 0))
@@ -410,10 +826,7 @@ protected:
     uint32_t result;
     DWORD sizeTransferred;
 
-    if (_cacheIndex)
-    {
-      SendCache();
-    }
+    BeginRead();
 
     // NOTE: Little-endian system assumed.
     if (FT_OK != SPI_Read(_ftHandle, (uint8_t *)&result, 4, &sizeTransferred, 0))
@@ -434,10 +847,7 @@ protected:
   {
     DWORD sizeTransferred;
 
-    if (_cacheIndex)
-    {
-      SendCache();
-    }
+    BeginRead();
 
     if (FT_OK != SPI_Read(_ftHandle, buffer, len, &sizeTransferred, 0))
     {
@@ -448,6 +858,94 @@ protected:
     return sizeTransferred;
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Perform a complete read transaction
+  //
+  // The header is sent and the data is received with a single full-duplex
+  // transfer, which also activates and de-activates the !CS line. So a
+  // register read costs one USB round trip instead of several.
+  virtual uint32_t ReadTransaction(     // Returns number of bytes received
+    const uint8_t *header,              // Header to send
+    uint32_t headerlen,                 // Number of header bytes to send
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len) override              // Number of bytes to receive
+  {
+    // Make sure the previous transaction has ended
+    Select(false);
+    Wait();
+
+    // Build the outgoing data: the header followed by zeroes. The header
+    // bytes are received too, so the incoming data goes to a temporary
+    // buffer. Register reads fit in a buffer on the stack.
+    DWORD total = headerlen + len;
+    BYTE stackbuf[2 * 16];
+    BYTE *out = (total <= sizeof(stackbuf) / 2) ? stackbuf : new BYTE[2 * total];
+    BYTE *in = out + total;
+    DWORD sizeTransferred = 0;
+
+    memcpy(out, header, headerlen);
+    memset(out + headerlen, 0, len);
+
+    if (FT_OK != SPI_ReadWrite(_ftHandle, in, out, total, &sizeTransferred,
+      SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES | SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE | SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE))
+    {
+      fprintf(stderr, "SPI_ReadWrite failed");
+      exit(-3);
+    }
+
+    memcpy(buffer, in + headerlen, len);
+
+    if (out != stackbuf)
+    {
+      delete[] out;
+    }
+
+    return len;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for the !INT line to become active
+  //
+  // The libMPSSE library doesn't provide a way to read the pins of the
+  // low byte, so this sends an MPSSE command directly to the channel. The
+  // pin is polled once per millisecond, which doesn't use the SPI bus.
+  virtual bool WaitForInterrupt(        // Returns true=!INT active or unknown
+    uint32_t timeout_ms) override       // Maximum time to wait (ms)
+  {
+    DWORD start = GetTickCount();
+
+    Wait();
+
+    for (;;)
+    {
+      UCHAR cmd[2] = { MPSSE_CMD_GET_DATA_BITS_LOWBYTE, MPSSE_CMD_SEND_IMMEDIATE };
+      UCHAR value;
+      DWORD num;
+
+      if ((FT_OK != FT_Write(_ftHandle, cmd, sizeof(cmd), &num))
+        || (FT_OK != FT_Read(_ftHandle, &value, 1, &num))
+        || (num != 1))
+      {
+        // Can't tell; the caller will check the registers
+        return true;
+      }
+
+      if (!(value & INT_PIN_MASK))
+      {
+        return true;
+      }
+
+      if (GetTickCount() - start >= timeout_ms)
+      {
+        return false;
+      }
+
+      Sleep(1);
+    }
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Wait for at least the requested time
@@ -456,6 +954,20 @@ protected:
   {
     Sleep(ms);
   }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  virtual uint32_t Micros() override    // Returns timestamp in us
+  {
+    LARGE_INTEGER count;
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+
+    return TicksToMicros((uint64_t)count.QuadPart, (uint64_t)frequency.QuadPart);
+  }
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,167 @@
+/****************************************************************************
+SteveMultiDisplay_Windows.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a Windows-specific multiple display scheduler that uses
+one thread per display.
+****************************************************************************/
+
+#ifndef _STEVEMULTIDISPLAY_WINDOWS_H
+#define _STEVEMULTIDISPLAY_WINDOWS_H
+
+#ifdef _WIN32
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include <windows.h>
+
+#include "SteveMultiDisplay.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MULTIPLE DISPLAY SCHEDULER FOR WINDOWS
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Scheduler for multiple displays with one thread per display
+//
+// This works the same as SteveMultiDisplay, but Start creates a thread for
+// each display, which builds and submits frames for that display only, and
+// waits for it when it's busy. This is useful when each display is on
+// a separate channel (e.g. a separate FTDI device), so that the USB
+// round trips of one channel don't hold up the others.
+//
+// The frame functions are called from the threads, so they must not share
+// data with each other or with the main thread without synchronization.
+template<const uint8_t count> class SteveMultiDisplay_Windows : public SteveMultiDisplayTable<count>
+{
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  HANDLE            _threads[count];    // Thread handles, NULL=none
+  volatile LONG     _stop;              // Nonzero=threads should stop
+
+  //-------------------------------------------------------------------------
+  // Parameters for a thread
+  struct ThreadInfo
+  {
+    SteveMultiDisplay_Windows *_owner;  // Scheduler
+    uint8_t         _index;             // Index of the display
+  };
+
+  ThreadInfo        _info[count];       // Parameters for threads
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveMultiDisplay_Windows()
+    : SteveMultiDisplayTable<count>()
+    , _stop(0)
+  {
+    for (uint8_t u = 0; u < count; u++)
+    {
+      _threads[u] = NULL;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveMultiDisplay_Windows()
+  {
+    Stop();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Thread function
+  static DWORD WINAPI ThreadProc(
+    LPVOID param)                       // ThreadInfo
+  {
+    ThreadInfo *info = (ThreadInfo *)param;
+    SteveMultiDisplay_Windows *owner = info->_owner;
+    SteveMultiDisplay::Panel &p = owner->_panels[info->_index];
+
+    while (!InterlockedCompareExchange(&owner->_stop, 0, 0))
+    {
+      p._eve->BeginFrame(true);
+      p._func(*p._eve, p._context);
+      p._eve->SubmitFrame();
+
+      // The main thread reads the count while this thread updates it
+      InterlockedIncrement((volatile LONG *)&p._frames);
+    }
+
+    return 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start a thread for each display
+  //
+  // The displays should already be initialized with Begin.
+  bool                                  // Returns true=success
+  Start()
+  {
+    Stop();
+
+    _stop = 0;
+
+    for (uint8_t u = 0; u < this->_count; u++)
+    {
+      _info[u]._owner = this;
+      _info[u]._index = u;
+
+      _threads[u] = CreateThread(NULL, 0, ThreadProc, &_info[u], 0, NULL);
+
+      if (!_threads[u])
+      {
+        DBG_STAT("Could not create thread for display %u\n", u);
+        Stop();
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Stop all threads
+  //
+  // Each thread finishes the frame that it's working on.
+  void Stop()
+  {
+    InterlockedExchange(&_stop, 1);
+
+    for (uint8_t u = 0; u < count; u++)
+    {
+      if (_threads[u])
+      {
+        WaitForSingleObject(_threads[u], INFINITE);
+        CloseHandle(_threads[u]);
+        _threads[u] = NULL;
+      }
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Sleep when no display could accept a frame
+  //
+  // This is used by Run, when the displays are driven from one thread.
+  virtual void Idle() override
+  {
+    Sleep(1);
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
+
+#endif
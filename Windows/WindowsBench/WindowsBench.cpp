@@ -0,0 +1,88 @@
+/****************************************************************************
+* WindowsBench.cpp
+* (C) Jac Goudsmit
+* MIT License.
+****************************************************************************/
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <Windows.h>
+
+#include "Steve.h"
+#include "SteveHAL_Windows_MPSSE.h"
+#include "SteveHAL_Windows_FT4222.h"
+#include "SteveBench.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// KNOWN DISPLAY TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// These include files each declare a display type and an instance that can
+// be used for all displays of that type. The sizes of the benchmark
+// screens follow the profile.
+#include "SteveDisplay_CFA800480.h"
+#include "SteveDisplay_CFA480128.h"
+
+//---------------------------------------------------------------------------
+// Hardware abstraction layer for Windows
+//
+// Define USE_FT4222 to use an FT4222H module (which supports quad SPI)
+// instead of an MPSSE cable. Change the clock frequency or the HAL
+// parameters to compare the results.
+//#define USE_FT4222
+#ifdef USE_FT4222
+SteveHAL_Windows_FT4222 Hal_Channel0(0, 30000000);
+#else
+SteveHAL_Windows_MPSSE Hal_Channel0(0, 8000000);
+#endif
+
+//---------------------------------------------------------------------------
+// Display
+Steve d(CFA480128_DisplayProfile, Hal_Channel0);
+
+//---------------------------------------------------------------------------
+// Print a benchmark result
+void Report(const SteveBench::Result &result, void *context)
+{
+  printf("%-16s %6u iterations %9u us %8u/s",
+    result._name, result._iterations, result._elapsed_us,
+    SteveBench::PerSecond(result._iterations, result._elapsed_us));
+
+  if (result._bytes)
+  {
+    printf(" %7.3f MB/s", (double)result._bytes / (double)result._elapsed_us);
+  }
+
+  if (result._commands)
+  {
+    printf(" %9u commands/s", SteveBench::PerSecond(result._commands, result._elapsed_us));
+  }
+
+  printf(" p50 %u us p99 %u us\n", result._p50_us, result._p99_us);
+}
+
+//---------------------------------------------------------------------------
+// Main program
+int main(int argc, char **argv)
+{
+  if (!d.Begin())
+  {
+    fprintf(stderr, "Begin failed\n");
+    exit(-1);
+  }
+
+  // The number of iterations can be given on the command line
+  uint16_t iterations = (argc > 1) ? (uint16_t)atoi(argv[1]) : 100;
+
+  SteveBench bench(d, Report, NULL, iterations ? iterations : 100);
+
+  bench.Run();
+
+  d.End();
+
+  return 0;
+}
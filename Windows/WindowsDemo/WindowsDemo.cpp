@@ -13,6 +13,7 @@
 
 #include "Steve.h"
 #include "SteveHAL_Windows_MPSSE.h"
+#include "SteveHAL_Windows_FT4222.h"
 
 #include "BounceDemo.h"
 
@@ -33,8 +34,18 @@
 // Hardware abstraction layer for Windows
 //
 // If using multiple displays, you will need to create multiple
-// HAL instances.
+// HAL instances. SteveMultiDisplay (or SteveMultiDisplay_Windows, which
+// uses a thread per display) can drive them without waiting for each
+// display in turn.
+//
+// Define USE_FT4222 to use an FT4222H module (which supports quad SPI)
+// instead of an MPSSE cable.
+//#define USE_FT4222
+#ifdef USE_FT4222
+SteveHAL_Windows_FT4222 Hal_Channel0(0, 30000000);
+#else
 SteveHAL_Windows_MPSSE Hal_Channel0(0, 8000000);
+#endif
 
 //---------------------------------------------------------------------------
 // Display
@@ -62,11 +73,10 @@ int main(int argc, char **argv)
 
   for (;;)
   {
-    // Wait for the next frame
-    d.CmdWaitComplete();
-
-    // Start the command list
-    d.cmd_DLSTART();
+    // Start the command list for the next frame. This only waits if the
+    // co-processor is still busy with the previous frames, so the next
+    // frame is built while the current one is rendered.
+    d.BeginFrame();
 
     // Clear the screen (and clear the current color, stencil and tag)
     d.CmdClear(0, 0, 0);
@@ -78,7 +88,7 @@ int main(int argc, char **argv)
     bounceDemo.Cycle();
 
     // Instruct graphics processor to show the list
-    d.CmdDlFinish();
+    d.SubmitFrame();
   }
 
   // Unreachable code
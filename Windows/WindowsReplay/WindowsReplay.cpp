@@ -0,0 +1,168 @@
+/****************************************************************************
+* WindowsReplay.cpp
+* (C) Jac Goudsmit
+* MIT License.
+****************************************************************************/
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <Windows.h>
+
+#include "Steve.h"
+#include "SteveHAL_Windows_MPSSE.h"
+#include "SteveHAL_Windows_FT4222.h"
+#include "SteveHAL_Null.h"
+#include "SteveHAL_Recorder.h"
+#include "SteveReplay.h"
+#include "SteveBench.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// KNOWN DISPLAY TYPES
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// These include files each declare a display type and an instance that can
+// be used for all displays of that type. Use the same profile as the
+// application that made the recording.
+#include "SteveDisplay_CFA800480.h"
+#include "SteveDisplay_CFA480128.h"
+
+//---------------------------------------------------------------------------
+// Hardware abstraction layer for Windows
+//
+// Define USE_FT4222 to use an FT4222H module (which supports quad SPI)
+// instead of an MPSSE cable.
+//#define USE_FT4222
+#ifdef USE_FT4222
+SteveHAL_Windows_FT4222 Hal_Channel0(0, 30000000);
+#else
+SteveHAL_Windows_MPSSE Hal_Channel0(0, 8000000);
+#endif
+
+//---------------------------------------------------------------------------
+// Display
+Steve d(CFA480128_DisplayProfile, Hal_Channel0);
+
+//---------------------------------------------------------------------------
+// Write recorded data to a file
+void WriteFile(const uint8_t *data, uint32_t len, void *context)
+{
+  fwrite(data, 1, len, (FILE *)context);
+}
+
+//---------------------------------------------------------------------------
+// Ignore benchmark results while capturing
+void IgnoreResult(const SteveBench::Result &result, void *context)
+{
+  (void)result;
+  (void)context;
+}
+
+//---------------------------------------------------------------------------
+// Record the benchmark scenarios without hardware
+//
+// This makes a recording that can be used to try the replay.
+int Capture(const char *filename)
+{
+  FILE *f = fopen(filename, "wb");
+  if (!f)
+  {
+    fprintf(stderr, "Can't create %s\n", filename);
+    return -1;
+  }
+
+  SteveHAL_Null hal;
+  SteveHAL_Recorder recorder(hal, WriteFile, f);
+  Steve eve(CFA480128_DisplayProfile, recorder);
+
+  if (eve.Begin())
+  {
+    SteveBench bench(eve, IgnoreResult, NULL, 20);
+
+    bench.Run();
+  }
+
+  eve.End();
+  fclose(f);
+
+  return 0;
+}
+
+//---------------------------------------------------------------------------
+// Main program
+//
+// Usage:
+//   WindowsReplay <file> [<repeat>]  Replay a recording on the display
+//   WindowsReplay -c <file>          Record benchmarks without hardware
+int main(int argc, char **argv)
+{
+  if ((argc > 2) && (!strcmp(argv[1], "-c")))
+  {
+    return Capture(argv[2]);
+  }
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s <file> [<repeat>] | -c <file>\n", argv[0]);
+    exit(-1);
+  }
+
+  // Read the recording into memory so the file doesn't slow it down
+  FILE *f = fopen(argv[1], "rb");
+  if (!f)
+  {
+    fprintf(stderr, "Can't open %s\n", argv[1]);
+    exit(-1);
+  }
+
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t *data = (uint8_t *)malloc(len);
+  if ((!data) || (fread(data, 1, len, f) != (size_t)len))
+  {
+    fprintf(stderr, "Can't read %s\n", argv[1]);
+    exit(-1);
+  }
+
+  fclose(f);
+
+  if (!d.Begin())
+  {
+    fprintf(stderr, "Begin failed\n");
+    exit(-1);
+  }
+
+  int repeat = (argc > 2) ? atoi(argv[2]) : 1;
+
+  SteveReplay replay(Hal_Channel0);
+
+  for (int i = 0; i < repeat; i++)
+  {
+    if (!replay.Play(data, (uint32_t)len))
+    {
+      fprintf(stderr, "Replay failed\n");
+      break;
+    }
+
+    const SteveReplay::Result &r = replay.GetResult();
+
+    printf("Recorded %9u us (%u ms delays), replayed %9u us (%.1f%%)\n",
+      r._recorded_us, r._delay_ms, r._replay_us,
+      r._recorded_us ? 100.0 * r._replay_us / r._recorded_us : 0.0);
+    printf("%u transactions, %u bursts, %u reads, %u polls skipped, %.3f MB/s\n",
+      r._transactions, r._bursts, r._reads, r._skipped,
+      r._replay_us ? (double)r._bytes / (double)r._replay_us : 0.0);
+  }
+
+  d.End();
+  free(data);
+
+  return 0;
+}
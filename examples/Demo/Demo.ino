@@ -63,11 +63,10 @@ void setup()
 // Main program
 void loop()
 {
-  // Wait for the next frame
-  d.CmdWaitComplete();
-
-  // Start the command list
-  d.cmd_DLSTART();
+  // Start the command list for the next frame. This only waits if the
+  // co-processor is still busy with the previous frames, so the next
+  // frame is built while the current one is rendered.
+  d.BeginFrame();
 
   // Clear the screen (and clear the current color, stencil and tag)
   d.CmdClear(0, 0, 0);
@@ -79,5 +78,5 @@ void loop()
   bounceDemo.Cycle();
 
   // Instruct graphics processor to show the list
-  d.CmdDlFinish();
+  d.SubmitFrame();
 }
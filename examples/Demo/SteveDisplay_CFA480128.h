@@ -6,8 +6,9 @@
 //---------------------------------------------------------------------------
 // Display profile for the CrystalFontz CFA480128Ex-039Tx display
 //
-// This single instance can be used for any number of displays.
-SteveDisplay CFA480128_DisplayProfile(
+// This single instance can be used for any number of displays. It's a
+// constant, so the compiler can keep it in read-only memory.
+STEVE_CONSTEXPR SteveDisplay CFA480128_DisplayProfile(
   480, 24, 11, 6, 521,  // Horizontal width,  front porch, sync width, back porch, padding
   128, 4, 1, 3, 1,      // Vertical   height, front porch, sync lines, back porch, padding
   7);                   // Pixel clock is 60 MHz / 7 = ~8.57 MHz
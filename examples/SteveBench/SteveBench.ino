@@ -0,0 +1,97 @@
+/****************************************************************************
+* SteveBench.ino
+* (C) Jac Goudsmit
+* MIT License.
+****************************************************************************/
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include <Steve.h>
+#include <SteveHAL_Arduino.h>
+#include <SteveBench.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// DISPLAY TYPE
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Display profile for the CrystalFontz CFA480128Ex-039Tx display
+//
+// The sizes of the benchmark screens follow the profile. To benchmark
+// another display, replace this with a profile from the Demo example.
+STEVE_CONSTEXPR SteveDisplay CFA480128_DisplayProfile(
+  480, 24, 11, 6, 521,  // Horizontal width,  front porch, sync width, back porch, padding
+  128, 4, 1, 3, 1,      // Vertical   height, front porch, sync lines, back porch, padding
+  7);                   // Pixel clock is 60 MHz / 7 = ~8.57 MHz
+
+//---------------------------------------------------------------------------
+// Hardware abstraction layer for Arduino
+//
+// Change the clock frequency to compare the results.
+SteveHAL_Arduino Hal_SPI_9_8(SPI, 8000000, 9, 8);
+
+//---------------------------------------------------------------------------
+// Display
+Steve d(CFA480128_DisplayProfile, Hal_SPI_9_8);
+
+//---------------------------------------------------------------------------
+// Print a benchmark result
+void Report(const SteveBench::Result &result, void *context)
+{
+  Serial.print(result._name);
+  Serial.print(F(": "));
+  Serial.print(result._iterations);
+  Serial.print(F(" iterations in "));
+  Serial.print(result._elapsed_us);
+  Serial.print(F(" us, "));
+  Serial.print(SteveBench::PerSecond(result._iterations, result._elapsed_us));
+  Serial.print(F("/s"));
+
+  if (result._bytes)
+  {
+    Serial.print(F(", "));
+    Serial.print(SteveBench::PerSecond(result._bytes, result._elapsed_us));
+    Serial.print(F(" bytes/s"));
+  }
+
+  if (result._commands)
+  {
+    Serial.print(F(", "));
+    Serial.print(SteveBench::PerSecond(result._commands, result._elapsed_us));
+    Serial.print(F(" commands/s"));
+  }
+
+  Serial.print(F(", p50 "));
+  Serial.print(result._p50_us);
+  Serial.print(F(" us, p99 "));
+  Serial.print(result._p99_us);
+  Serial.println(F(" us"));
+}
+
+//---------------------------------------------------------------------------
+// Benchmarks
+SteveBench bench(d, Report);
+
+//---------------------------------------------------------------------------
+// Initialization
+void setup()
+{
+  Serial.begin(115200);
+  SPI.begin();
+
+  if (!d.Begin())
+  {
+    Serial.println(F("Begin failed"));
+  }
+}
+
+//---------------------------------------------------------------------------
+// Main program
+void loop()
+{
+  bench.Run();
+
+  Serial.println();
+}
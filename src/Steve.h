@@ -133,6 +133,53 @@ different. Because of this, the FT800 and FT801 aren't supported for now.
 #define DBG_STAT(...)
 #endif
 
+// Transport statistics (see GetStats) are collected unless STEVE_STATS is
+// defined as 0. STEVE_STAT is used to update a counter; it compiles to
+// nothing if the statistics are disabled.
+#ifndef STEVE_STATS
+#define STEVE_STATS 1
+#endif
+#if STEVE_STATS
+#define STEVE_STAT(x) (x)
+#else
+#define STEVE_STAT(x)
+#endif
+
+// Draw text that's formatted by the co-processor (see
+// Steve::CmdTextFormat), after checking at compile time that the number
+// of arguments matches the format string. The format must be a string
+// literal, and there must be at least one argument.
+#define STEVE_TEXT_FORMAT(eve, x, y, font, options, format, ...) \
+  do \
+  { \
+    static_assert(Steve::FormatArgCount(format) == sizeof(Steve::FormatArgs(__VA_ARGS__)) - 1, \
+      "Number of arguments doesn't match format string"); \
+    (eve).CmdTextFormat(x, y, font, options, format, __VA_ARGS__); \
+  } while (0)
+
+// Groups of co-processor commands can be left out by defining these
+// macros as 0, to save program memory on small microcontrollers where
+// the compiler doesn't discard unused functions (e.g. in debug builds).
+// This only removes cmd_ functions that are meant for the application;
+// commands that Steve uses itself are always available.
+// * STEVE_CMD_EVE4: commands that only work on EVE4 (BT817/BT818)
+// * STEVE_CMD_FLASH: external flash commands (needed by SteveFlashAssets)
+// * STEVE_CMD_ANIM: animation commands
+// * STEVE_CMD_WIDGETS: widgets such as buttons, gauges and sliders, and
+//   their colors and gradients
+#ifndef STEVE_CMD_EVE4
+#define STEVE_CMD_EVE4 1
+#endif
+#ifndef STEVE_CMD_FLASH
+#define STEVE_CMD_FLASH 1
+#endif
+#ifndef STEVE_CMD_ANIM
+#define STEVE_CMD_ANIM 1
+#endif
+#ifndef STEVE_CMD_WIDGETS
+#define STEVE_CMD_WIDGETS 1
+#endif
+
 // Define _countof. This macro definition is usually in stdlib.h.
 #ifndef _countof
 #define _countof(array) (sizeof(array) / sizeof(array[0]))
@@ -142,7 +189,32 @@ different. Because of this, the FT800 and FT801 aren't supported for now.
 // STATIC TYPESAFE EVE CHIP CONTROL CLASS
 /////////////////////////////////////////////////////////////////////////////
 
-class Steve
+//---------------------------------------------------------------------------
+// EVE chip control class template
+//
+// The template parameter is the type of the HAL. Normally this is
+// SteveHAL, and the Steve type (see below) is used: all calls to the HAL
+// go through the virtual functions, so one Steve class works with any HAL.
+//
+// On small microcontrollers, the virtual function calls for each byte can
+// take more time than the SPI transfers themselves. To avoid this, use a
+// HAL class that's wrapped in SteveHAL_Final as template parameter, e.g.:
+//
+//   SteveHAL_Final<SteveHAL_Arduino> hal(...);
+//   SteveT<SteveHAL_Final<SteveHAL_Arduino> > eve(profile, hal);
+//
+// Because nothing can be derived from the final HAL class, the compiler
+// can call its functions directly and inline them.
+//
+// Restriction: such an instance is a different type than Steve, and the
+// helper classes are not templates; they all take a Steve reference. This
+// means SteveAnimations, SteveBackground, SteveBench, SteveBitmapLoader,
+// SteveCmdQueue, SteveFlashAssets, SteveFontCache, SteveMultiDisplay,
+// SteveProfiler, SteveRamG, SteveScene, SteveTouch and SteveVideoPlayer
+// can only be used with Steve, not with a SteveT of a final HAL. Also,
+// the enums and constants (e.g. OPT_CENTER) are members of each SteveT
+// type, so code for a final HAL must name them through its own type.
+template<class HAL> class SteveT
 {
   //=========================================================================
   // CONSTANT DATA
@@ -184,6 +256,77 @@ public:
   // command
   const static uint16_t READ_INDEX_ERROR = 0x0FFF;
 
+  // Polling parameters for waiting for the co-processor: the number of
+  // polls that are done without a delay, and the maximum delay in
+  // milliseconds between polls after that. See CmdPollWait.
+  const static uint8_t  CMD_POLL_SPIN = 4;
+  const static uint8_t  CMD_POLL_MAX_DELAY = 8;
+
+  // Start-up timing: the minimum time in milliseconds that !PD is held low
+  // for a reset, the minimum time in milliseconds between !PD going high
+  // and the first host command, and the maximum number of polls (1 ms
+  // apart) while waiting for the chip to boot.
+  const static uint8_t  BOOT_PD_LOW_MS = 5;
+  const static uint8_t  BOOT_PD_HIGH_MS = 20;
+  const static uint8_t  BOOT_POLL_TRIES = 250;
+
+  // Maximum time in milliseconds to wait for the !INT line before the
+  // registers are checked again, when interrupts are used.
+  const static uint8_t  INT_WAIT_TIMEOUT_MS = 10;
+
+  // Maximum number of frames that can be submitted to the co-processor
+  // before BeginFrame waits for the oldest one. See BeginFrame.
+  const static uint8_t  FRAMES_IN_FLIGHT = 2;
+
+  // Streaming decompression: the number of bytes after which the
+  // co-processor is told to start on the data that was sent so far, and
+  // the size of the host buffer for data that comes from a reader
+  // function. See InflateStream.
+  const static uint16_t INFLATE_KICK_SIZE = RAM_CMD_SIZE / 4;
+  const static uint16_t INFLATE_READ_SIZE = 64;
+
+  // Register snapshots: the maximum number of bytes in one read, and the
+  // maximum number of unused bytes between two registers that are read
+  // in the same transaction. See RegReadSnapshot.
+  const static uint8_t  SNAPSHOT_WINDOW = 64;
+  const static uint8_t  SNAPSHOT_GAP = 32;
+
+  // Index in the command list cache that means "no list". See
+  // CmdSetRestoreList.
+  const static uint8_t  INVALID_LIST = 0xFF;
+
+  // Deferred command outputs (see CmdDefer) that are at most this many
+  // bytes apart in RAM_CMD are read in the same transaction, and the
+  // value that CmdDefer returns when there's no more space.
+  const static uint8_t  OUTPUT_WINDOW = 64;
+  const static uint8_t  INVALID_OUTPUT = 0xFF;
+
+  // Maximum length of a format string for CmdTextFormat, including the
+  // nul terminator. Longer strings are truncated.
+  const static uint16_t FORMAT_MAXLEN = 256;
+
+  // Direct display lists: the number of times DLBurstBegin checks if the
+  // previous list was swapped, and the delay between checks in ms.
+  const static uint8_t  DLSWAP_TRIES = 100;
+  const static uint8_t  DLSWAP_DELAY = 1;
+
+  // SPI clock calibration (see CalibrateClock): the size of the test
+  // pattern in RAM_G, the number of tests per clock, and the number of
+  // times the co-processor is polled (1 ms apart) before a test fails.
+  const static uint16_t CLOCKTEST_SIZE = 4096;
+  const static uint8_t  CLOCKTEST_PASSES = 3;
+  const static uint8_t  CLOCKTEST_TRIES = 100;
+
+  // Verified uploads (see UploadVerified): the number of chunks whose
+  // CRCs are checked together, and the default number of times a chunk
+  // is sent before giving up.
+  const static uint8_t  UPLOAD_CHUNKS = 8;
+  const static uint8_t  UPLOAD_TRIES = 3;
+
+  // Frame deduplication (see CmdSetFrameDedup): the number of ranges of
+  // commands per frame that can be left out of the comparison.
+  const static uint8_t  DEDUP_EXCLUDES = 4;
+
   //=========================================================================
   // HELPER CLASS REPRESENTING AN ADDRESS IN A MEMORY AREA WITH WRAPPING
   //=========================================================================
@@ -285,1363 +428,5108 @@ public:
   typedef Index<RAM_DL_SIZE> DLIndex;
 
   //=========================================================================
-  // STATIC HELPER FUNCTIONS
+  // HELPER CLASSES FOR STAGING CO-PROCESSOR COMMANDS IN HOST MEMORY
   //=========================================================================
 
 public:
   //-------------------------------------------------------------------------
-  // Convert RGB values to an RGB24 value
-  static uint32_t toRGB(                // Returns 24-bit RGB value
-      uint8_t r,                        // Red
-      uint8_t g,                        // Green
-      uint8_t b)                        // Blue
+  // Base class for a command staging buffer
+  //
+  // When a staging buffer is in use (see CmdSetStaging), co-processor
+  // commands are stored in host memory instead of being sent to the EVE
+  // one value at a time. The buffer is sent to RAM_CMD in one burst when
+  // the commands are executed, or when the buffer is full.
+  //
+  // Use the CmdStagingBuffer template below to declare a buffer; this
+  // class only exists so that Steve can refer to buffers of any size.
+  class CmdStaging
   {
-    return (uint32_t)r << 16 | (uint32_t)g << 8 | (uint32_t)b;
-  }
+    friend class SteveT;
+
+  protected:
+    uint8_t    *const _buffer;        // Storage
+    const uint16_t    _size;          // Size of storage in bytes
+    uint16_t          _length;        // Number of bytes used
+
+  protected:
+    //-----------------------------------------------------------------------
+    // Constructor
+    CmdStaging(
+      uint8_t *buffer,                // Storage
+      uint16_t size)                  // Size of storage in bytes
+      : _buffer(buffer)
+      , _size(size)
+      , _length(0)
+    {
+      // Nothing
+    }
+  };
+
+public:
+  //-------------------------------------------------------------------------
+  // Command staging buffer of a given size
+  //
+  // The size should be a multiple of 4, and can't be bigger than
+  // RAM_CMD_SIZE: offsets in the buffer are calculated with the 12-bit
+  // command index arithmetic (see FrameIsDuplicate). Small systems can use
+  // a small buffer (e.g. 256 bytes); it gets sent whenever it's full.
+  template<const uint16_t size> class CmdStagingBuffer : public CmdStaging
+  {
+    static_assert(size <= RAM_CMD_SIZE, "Staging buffer is bigger than RAM_CMD");
+
+  private:
+    uint8_t           _storage[size]; // Storage
+
+  public:
+    //-----------------------------------------------------------------------
+    // Constructor
+    CmdStagingBuffer()
+      : CmdStaging(_storage, size)
+    {
+      // Nothing
+    }
+  };
 
   //=========================================================================
-  // ENUM TYPES
+  // HELPER CLASSES FOR CACHING COMMAND LISTS IN RAM_G
   //=========================================================================
 
 public:
   //-------------------------------------------------------------------------
-  // Host commands and memory read/write operations
+  // Entry in a command list cache
+  struct ListCacheEntry
+  {
+    uint32_t          _address;       // Address in RAM_G
+    uint32_t          _size;          // Allocated size in bytes
+    uint32_t          _length;        // Used size in bytes
+    bool              _valid;         // True=list was recorded
+    bool              _snippet;       // True=display list snippet
+  };
+
+public:
+  //-------------------------------------------------------------------------
+  // Base class for a command list cache
   //
-  // Host commands and memory read/write operations are almost the same,
-  // even though they are presented in the datasheets as distinct operations.
+  // EVE4 chips can record co-processor commands into a command list in
+  // RAM_G, which can then be executed with a single CMD_CALLLIST (see
+  // RecordList and CallList). Older chips can store the display list
+  // commands that a sequence of co-processor commands produced, and append
+  // them to later display lists with CMD_APPEND (see RecordSnippet and
+  // AppendSnippet). The cache keeps track of the lists and snippets, and
+  // allocates space for them in an area of RAM_G that's reserved for it.
   //
-  // Only the lower 24 bits are significant. The "ACTIVE" command is
-  // partially identical to a "read memory location 0" operation but
-  // doesn't require a dummy byte.
-  enum HOSTCMD // 24 bits
+  // Use the ListCacheTable template to declare a cache for a given number
+  // of lists.
+  class ListCache
   {
-    // [DS2 p15][DS3 p15][DS4 p14]
-    HOSTCMD_ACTIVE                      = 0x000000,     // Switch from Standby/Sleep/PWRDOWN to Active. Same as "read 0"
-    HOSTCMD_READ                        = 0x000000,     // Read data. Add address, send dummy byte before reading.
-    HOSTCMD_STANDBY                     = 0x410000,     // Put core in standby mode. Use ACTIVE to wake up again.
-    HOSTCMD_SLEEP                       = 0x420000,     // Put core in sleep mode. Use ACTIVE to wake up again.
-    HOSTCMD_PWRDOWN                     = 0x430000,     // Put core in power down mode. Use ACTIVE to wake up again.
-    HOSTCMD_CLKEXT                      = 0x440000,     // Select PLL input from external xtal osc or external clock.
-    HOSTCMD_CLKINT                      = 0x480000,     // Select PLL input from internal osc (default).
-    HOSTCMD_PD_ROMS                     = 0x490000,     // (EVE2 only) Select power down to individual ROMs.
-    HOSTCMD_PWRDOWN1                    = 0x500000,     // Same as 0x430000.
-    HOSTCMD_CLKSEL                      = 0x610000,     // Select system clock freq.
-    HOSTCMD_CLKSEL1                     = 0x620000,     // Same as 0x610000.
-    HOSTCMD_RST_PULSE                   = 0x680000,     // Send reset pulse to core.
-    HOSTCMD_PINDRIVE                    = 0x700000,     // Set drive strength for various pins.
-    HOSTCMD_PIN_PD_STATE                = 0x710000,     // Set pin state during power down.
-    HOSTCMD_WRITE                       = 0x800000,     // Write data. Add address, send bytes.
+    friend class SteveT;
+
+  protected:
+    ListCacheEntry *const _entries;   // Storage
+    const uint8_t     _count;         // Number of entries
+    uint32_t          _base;          // First address in RAM_G
+    uint32_t          _end;           // Address after the area in RAM_G
+    uint32_t          _next;          // Next address to allocate
+
+  protected:
+    //-----------------------------------------------------------------------
+    // Constructor
+    ListCache(
+      ListCacheEntry *entries,        // Storage
+      uint8_t count)                  // Number of entries
+      : _entries(entries)
+      , _count(count)
+      , _base(0)
+      , _end(0)
+      , _next(0)
+    {
+      // Nothing
+    }
   };
 
-  //-----------------------------------------------------------------------
-  // Register addresses
-  enum REG // 22 bits
+public:
+  //-------------------------------------------------------------------------
+  // Command list cache with a given number of entries
+  template<const uint8_t count> class ListCacheTable : public ListCache
   {
-    // [DS2 p41][DS3 p42][DS3 p41]
-    //
-    // These are mostly in numerical order except where register groups
-    // were split between different address areas. There is some overlap,
-    // especially between the resistive and capacitive touch engines.
+  private:
+    ListCacheEntry    _storage[count]; // Storage
 
-    // General configuration / status
-    REG_ID                              = 0x302000,     // [PG2 p87][PG34 p49]  (ro8)   Identification; always 0x7C
-    REG_FRAMES                          = 0x302004,     // [PG2 p87][PG34 p49]  (ro32)  Frame counter
-    REG_CLOCK                           = 0x302008,     // [PG2 p87][PG34 p49]  (ro32)  Clock cycle counter
-    REG_FREQUENCY                       = 0x30200C,     // [PG2 p86][PG34 p49]  (rw28)  Clock frequency as known by the chip
-    REG_RENDERMODE                      = 0x302010,     //                      (rw1)   Single line rendering enable (not in [PG*])
-    REG_SNAPY                           = 0x302014,     //                      (rw11)  Single line scanline selection (not in [PG*])
-    REG_SNAPSHOT                        = 0x302018,     //                      (rw1)   Single line render mode trigger (not in [PG*])
-    REG_SNAPFORMAT                      = 0x30201C,     //                      (rw6)   Pixel format for scanline readout (not in [PG*])
-    REG_CPURESET                        = 0x302020,     // [PG2 p81][PG34 p46]  (rw3)   Audio/Touch/Graphics reset control
-    REG_TAP_CRC                         = 0x302024,     //                      (ro32)  Live video tap CRC (not in [PG*])
-    REG_TAP_MASK                        = 0x302028,     //                      (rw32)  Live video tap mask (not in [PG*])
+  public:
+    //-----------------------------------------------------------------------
+    // Constructor
+    ListCacheTable()
+      : ListCache(_storage, count)
+    {
+      // Nothing
+    }
+  };
 
-    // LCD panel configuration
-    REG_HCYCLE                          = 0x30202C,     // [PG2 p34][PG34 p32]  (rw12)  Horizontal total cycle count
-    REG_HOFFSET                         = 0x302030,     // [PG2 p34][PG34 p31]  (rw12)  Horizontal display start offset
-    REG_HSIZE                           = 0x302034,     // [PG2 p33][PG34 p31]  (rw12)  Horizontal display size
-    REG_HSYNC0                          = 0x302038,     // [PG2 p32][PG34 p31]  (rw12)  Horizontal sync fall offset
-    REG_HSYNC1                          = 0x30203C,     // [PG2 p32][PG34 p31]  (rw12)  Horizontal sync rise offset
-    REG_VCYCLE                          = 0x302040,     // [PG2 p31][PG34 p31]  (rw12)  Vertical total cycle count
-    REG_VOFFSET                         = 0x302044,     // [PG2 p31][PG34 p31]  (rw12)  Vertical display start offset
-    REG_VSIZE                           = 0x302048,     // [PG2 p31][PG34 p31]  (rw12)  Vertical display line count
-    REG_VSYNC0                          = 0x30204C,     // [PG2 p30][PG34 p30]  (rw10)  Vertical sync fall offset
-    REG_VSYNC1                          = 0x302050,     // [PG2 p30][PG34 p30]  (rw10)  Vertical sync rise offset
-    REG_DLSWAP                          = 0x302054,     // [PG2 p35][PG34 p30]  (rw2)   Display List swap control
-    REG_ROTATE                          = 0x302058,     // [PG2 p29][PG34 p30]  (rw3)   Screen rotation
-    REG_OUTBITS                         = 0x30205C,     // [PG2 p29][PG34 p29]  (rw9)   Output bits resolution
-    REG_DITHER                          = 0x302060,     // [PG2 p28][PG34 p29]  (rw1)   Output dither enable
-    REG_SWIZZLE                         = 0x302064,     // [PG2 p28][PG34 p29]  (rw4)   Output RGB bit order control
-    REG_CSPREAD                         = 0x302068,     // [PG2 p27][PG34 p29]  (rw1)   Output clock spreading enable
-    REG_PCLK_POL                        = 0x30206C,     // [PG2 p27][PG34 p29]  (rw1)   Pixel clock polarity
-    REG_PCLK                            = 0x302070,     // [PG2 p26][PG34 p29]  (rw8)   Pixel clock divider
+  //=========================================================================
+  // HELPER STRUCT FOR TRANSPORT STATISTICS
+  //=========================================================================
 
-    // Touch control
-    REG_TAG_X                           = 0x302074,     // [PG2 p36][PG34 p28]  (rw11)  Tag query X coordinate
-    REG_TAG_Y                           = 0x302078,     // [PG2 p36][PG34 p28]  (rw11)  Tag query Y coordinate
-    REG_TAG                             = 0x30207C,     // [PG2 p35][PG34 p28]  (ro8)   Tag query result
+public:
+  //-------------------------------------------------------------------------
+  // Counters for the traffic on the bus
+  //
+  // These are updated by Steve, so they count what Steve asks the HAL to
+  // do; the HAL may combine transfers (e.g. in a write cache). The byte
+  // counts include the headers of the transactions.
+  struct Stats
+  {
+    uint32_t          _transactions;    // Transactions (incl. reads)
+    uint32_t          _cs_toggles;      // Changes of the !CS line
+    uint32_t          _bytes_sent;      // Bytes sent to the EVE
+    uint32_t          _bytes_received;  // Bytes received from the EVE
+    uint32_t          _reg_reads;       // Register reads (RegRead8/16/32)
+    uint32_t          _poll_iterations; // Polls while waiting for the
+                                        //   co-processor (CmdPollWait)
+    uint32_t          _wrap_splits;     // Writes that were split at the
+                                        //   end of RAM_CMD
+    uint32_t          _frames;          // Frames finished (CmdDlFinish)
+    uint32_t          _frame_bytes;     // Bytes sent for the last frame
+    uint32_t          _max_frame_bytes; // Most bytes sent for a frame
+    uint32_t          _upload_retries;  // Chunks sent again because the
+                                        //   CRC didn't match (see
+                                        //   UploadVerified)
+  };
 
-    // Audio
-    REG_VOL_PB                          = 0x302080,     // [PG2 p38][PG34 p32]  (rw8)   Volume for playback
-    REG_VOL_SOUND                       = 0x302084,     // [PG2 p38][PG34 p32]  (rw8)   Volume for synthesizer sound
-    REG_SOUND                           = 0x302088,     // [PG2 p37][PG34 p32]  (rw16)  Sound effect select
-    REG_PLAY                            = 0x30208C,     // [PG2 p37][PG34 p32]  (rw1)   Start effect playback
+  //=========================================================================
+  // HELPER CLASSES FOR REGISTER SNAPSHOTS
+  //=========================================================================
 
-    // GPIO
-    REG_GPIO_DIR                        = 0x302090,     // [PG2 p84][PG34 p47]  (rw8)   Legacy GPIO direction
-    REG_GPIO                            = 0x302094,     // [PG2 p84][PG34 p48]  (rw8)   Legacy GPIO read/write
-    REG_GPIOX_DIR                       = 0x302098,     // [PG2 p85][PG34 p48]  (rw16)  Extended GPIO direction
-    REG_GPIOX                           = 0x30209C,     // [PG2 p86][PG34 p48]  (rw16)  Extended GPIO read/write
+public:
+  //-------------------------------------------------------------------------
+  // Base class for a set of registers that are read together
+  //
+  // Registers are added by address, and RegReadSnapshot reads all of them
+  // with as few transactions as possible: registers that are close
+  // together are read as one window, including the unused bytes between
+  // them. REG_INT_FLAGS is never read unless it was added, because reading
+  // it clears the flags.
+  //
+  // All registers are read as 32 bit values. Use the RegSnapshotTable
+  // template below to declare a snapshot.
+  class RegSnapshot
+  {
+    friend class SteveT;
 
-    //// 0x3020A0-0x3020A4 Reserved
+  protected:
+    uint32_t   *const _addresses;     // Addresses in ascending order
+    uint32_t   *const _values;        // Values from last read
+    const uint8_t     _max;           // Maximum number of registers
+    uint8_t           _count;         // Number of registers
+    uint8_t           _windows;       // Transactions of last read
 
-    // Interrupt control
-    REG_INT_FLAGS                       = 0x3020A8,     // [PG2 p83][PG34 p47]  (ro8)   Interrupt flags, clear by read
-    REG_INT_EN                          = 0x3020AC,     // [PG2 p83][PG34 p47]  (rw1)   Global interrupt enable
-    REG_INT_MASK                        = 0x3020B0,     // [PG2 p82][PG34 p47]  (rw8)   Interrupt mask
+  protected:
+    //-----------------------------------------------------------------------
+    // Constructor
+    RegSnapshot(
+      uint32_t *addresses,            // Storage for addresses
+      uint32_t *values,               // Storage for values
+      uint8_t max)                    // Maximum number of registers
+      : _addresses(addresses)
+      , _values(values)
+      , _max(max)
+      , _count(0)
+      , _windows(0)
+    {
+      // Nothing
+    }
 
-    // Audio playback
-    REG_PLAYBACK_START                  = 0x3020B4,     // [PG2 p42][PG34 p34]  (rw20)  Audio playback RAM start address
-    REG_PLAYBACK_LENGTH                 = 0x3020B8,     // [PG2 p42][PG34 p34]  (rw20)  Audio playback sample length
-    REG_PLAYBACK_READPTR                = 0x3020BC,     // [PG2 p41][PG34 p33]  (ro20)  Audio playback current read ptr
-    REG_PLAYBACK_FREQ                   = 0x3020C0,     // [PG2 p41][PG34 p33]  (rw16)  Audio playback sample frequency
-    REG_PLAYBACK_FORMAT                 = 0x3020C4,     // [PG2 p40][PG34 p33]  (rw2)   Audio playback format
-    REG_PLAYBACK_LOOP                   = 0x3020C8,     // [PG2 p39][PG34 p33]  (rw1)   Audio playback loop enable
-    REG_PLAYBACK_PLAY                   = 0x3020CC,     // [PG2 p39][PG34 p33]  (rw1)   Start audio playback
-    REG_PLAYBACK_PAUSE                  = 0x3025EC,     //          [PG34 p34]  (rw1)   Audio playback pause (EVE3/EVE4)
+  protected:
+    //-----------------------------------------------------------------------
+    // Find a register
+    uint8_t                           // Returns index or _count=not found
+    Find(
+      uint32_t address) const         // Address of the register
+    {
+      uint8_t u;
 
-    // Backlight control
-    REG_PWM_HZ                          = 0x3020D0,     // [PG2 p82][PG34 p47]  (rw14)  Backlight PWM frequency
-    REG_PWM_DUTY                        = 0x3020D4,     // [PG2 p81][PG34 p47]  (rw8)   Backlight PWM duty cycle
+      for (u = 0; (u < _count) && (_addresses[u] != address); u++)
+      {
+        // Nothing
+      }
 
-    // Display list macro commands
-    REG_MACRO_0                         = 0x3020D8,     //          [PG34 p46]  (rw32)  Display list macro command 0 (not in [PG2])
-    REG_MACRO_1                         = 0x3020DC,     //          [PG34 p46]  (rw32)  Display list macro command 1 (not in [PG2])
+      return u;
+    }
 
-    //// 0x3020E0-0x3020F4 Reserved
+  public:
+    //-----------------------------------------------------------------------
+    // Add a register
+    bool                              // Returns false=no more space
+    Add(
+      uint32_t address)               // Address of the register
+    {
+      if (Find(address) < _count)
+      {
+        return true;
+      }
 
-    // Co-processor registers
-    REG_CMD_READ                        = 0x3020F8,     // [PG2 p76][PG34 p45]  (rw12)  Command buffer read pointer
-    REG_CMD_WRITE                       = 0x3020FC,     // [PG2 p75][PG34 p45]  (ro12)  Command buffer write pointer
-    REG_CMD_DL                          = 0x302100,     // [PG2 p75][PG34 p45]  (rw13)  Command display list offset
-    REG_CMDB_SPACE                      = 0x302574,     // [PG2 p76][PG34 p46]  (rw12)  Command DL (bulk) space available
-    REG_CMDB_WRITE                      = 0x302578,     // [PG2 p77][PG34 p46]  (wo32)  Command DL (bulk) write
+      if (_count >= _max)
+      {
+        DBG_STAT("Snapshot full, %lX not added\n", address);
+        return false;
+      }
 
-    // Resistive touch engine (FT810/FT812/BT816/BT818)
-    REG_TOUCH_MODE                      = 0x302104,     // [PG2 p58][PG34 p40]  (rw2)   Touch screen sample mode
-    REG_TOUCH_ADC_MODE                  = 0x302108,     // [PG2 p58][PG34 p39]  (rw1)   Touch screen ADC mode
-    REG_TOUCH_CHARGE                    = 0x30210C,     // [PG2 p57][PG34 p39]  (rw16)  Touch charge time *6 clocks
-    REG_TOUCH_SETTLE                    = 0x302110,     // [PG2 p57][PG34 p39]  (rw4)   Touch settle time *6 clocks
-    REG_TOUCH_OVERSAMPLE                = 0x302114,     // [PG2 p56][PG34 p39]  (rw4)   Touch oversample factor
-    REG_TOUCH_RZTHRESH                  = 0x302118,     // [PG2 p56][PG34 p39]  (rw16)  Touch resistance threshold
-    REG_TOUCH_RAW_XY                    = 0x30211C,     // [PG2 p55][PG34 p38]  (ro32)  (compatibility) Touch screen raw data
-    REG_TOUCH_RZ                        = 0x302120,     // [PG2 p55][PG34 p38]  (ro16)  (compatibility) Touch screen resistance
-    REG_TOUCH_SCREEN_XY                 = 0x302124,     // [PG2 p53][PG34 p37]  (ro32)  (compatibility) Touch screen coordinates
-    REG_TOUCH_TAG_XY                    = 0x302128,     // [PG2 p52][PG34 p37]  (ro32)  Touch Tag 0 lookup
-    REG_TOUCH_TAG                       = 0x30212C,     // [PG2 p51][PG34 p37]  (ro8)   Touch Tag 0 result
-    REG_TOUCH_TRANSFORM_A               = 0x302150,     // [PG2 p49][PG34 p36]  (rw32)  Touch screen transform coefficient A
-    REG_TOUCH_TRANSFORM_B               = 0x302154,     // [PG2 p48][PG34 p36]  (rw32)  Touch screen transform coefficient B
-    REG_TOUCH_TRANSFORM_C               = 0x302158,     // [PG2 p47][PG34 p36]  (rw32)  Touch screen transform coefficient C
-    REG_TOUCH_TRANSFORM_D               = 0x30215C,     // [PG2 p46][PG34 p36]  (rw32)  Touch screen transform coefficient D
-    REG_TOUCH_TRANSFORM_E               = 0x302160,     // [PG2 p45][PG34 p36]  (rw32)  Touch screen transform coefficient E
-    REG_TOUCH_TRANSFORM_F               = 0x302164,     // [PG2 p44][PG34 p35]  (rw32)  Touch screen transform coefficient F
-    REG_TOUCH_CONFIG                    = 0x302168,     // [PG2 p43][PG34 p35]  (rw16)  Touch configuration
-    REG_TOUCH_DIRECT_XY                 = 0x30218C,     // [PG2 p54][PG34 p38]  (ro32)  (compatibility) Touch screen direct conversions
-    REG_TOUCH_DIRECT_Z1Z2               = 0x302190,     // [PG2 p54][PG34 p38]  (ro32)  (compatibility) Touch screen direct conversions
+      // Keep the addresses sorted
+      uint8_t u = _count++;
 
-    // Capacitive touch engine (FT811/FT813/BT815/BT817)
-    REG_CTOUCH_MODE                     = 0x302104,     // [PG2 p54][PG34 p41]  (rw2)   Touch screen sample mode
-    REG_CTOUCH_EXTEND                   = 0x302108,     // [PG2 p61][PG34 p41]  (rw1)   Touch screen mode (extended or compatibility)
-    REG_CTOUCH_EXTENDED                 = 0x302108,     // [PG2 p61][PG34 p41]  (rw1)   Touch screen mode (extended or compatibility) (Alias)
-    REG_CTOUCH_RAW_XY                   = 0x30211C,     // [PG2 p64][PG34 p42]  (ro32)  (compatibility) Touch screen raw data
-    REG_CTOUCH_TOUCH1_XY                = 0x30211C,     // [PG2 p62][PG34 p41]  (ro32)  (extended)      Screen data for touch 1
-    REG_CTOUCH_TOUCH4_Y                 = 0x302120,     // [PG2 p64][PG34 p42]  (ro16)  (extended)      Screen Y data for touch 4
-    REG_CTOUCH_TOUCH_XY                 = 0x302124,     // [PG2 p61][PG34 p41]  (ro32)  (compatibility) Screen data for single touch
-    REG_CTOUCH_TOUCH0_XY                = 0x302124,     // [PG2 p61][PG34 p41]  (ro32)  (extended)      Screen data for touch 0
-    REG_CTOUCH_TAG_XY                   = 0x302128,     // [PG2 p70][PG34 p44]  (ro32)  Touch Tag 0 lookup
-    REG_CTOUCH_TAG                      = 0x30212C,     // [PG2 p65][PG34 p42]  (ro8)   Touch Tag 0 result
-    REG_CTOUCH_TAG1_XY                  = 0x302130,     // [PG2 p71][PG34 p44]  (ro32)  Touch Tag 1 lookup
-    REG_CTOUCH_TAG1                     = 0x302134,     // [PG2 p66][PG34 p43]  (ro8)   Touch Tag 1 result
-    REG_CTOUCH_TAG2_XY                  = 0x302138,     // [PG2 p72][PG34 p44]  (ro32)  Touch Tag 2 lookup
-    REG_CTOUCH_TAG2                     = 0x30213C,     // [PG2 p67][PG34 p43]  (ro8)   Touch Tag 2 result
-    REG_CTOUCH_TAG3_XY                  = 0x302140,     // [PG2 p73][PG34 p44]  (ro32)  Touch Tag 3 lookup
-    REG_CTOUCH_TAG3                     = 0x302144,     // [PG2 p68][PG34 p43]  (ro8)   Touch Tag 3 result
-    REG_CTOUCH_TAG4_XY                  = 0x302148,     // [PG2 p74][PG34 p44]  (ro32)  Touch Tag 4 lookup
-    REG_CTOUCH_TAG4                     = 0x30214C,     // [PG2 p69][PG34 p43]  (ro8)   Touch Tag 4 result
-    REG_CTOUCH_TRANSFORM_A              = 0x302150,     // [PG2 p49][PG34 p36]  (rw32)  Touch screen transform coefficient A (Alias)
-    REG_CTOUCH_TRANSFORM_B              = 0x302154,     // [PG2 p48][PG34 p36]  (rw32)  Touch screen transform coefficient B (Alias)
-    REG_CTOUCH_TRANSFORM_C              = 0x302158,     // [PG2 p47][PG34 p36]  (rw32)  Touch screen transform coefficient C (Alias)
-    REG_CTOUCH_TRANSFORM_D              = 0x30215C,     // [PG2 p46][PG34 p36]  (rw32)  Touch screen transform coefficient D (Alias)
-    REG_CTOUCH_TRANSFORM_E              = 0x302160,     // [PG2 p45][PG34 p36]  (rw32)  Touch screen transform coefficient E (Alias)
-    REG_CTOUCH_TRANSFORM_F              = 0x302164,     // [PG2 p44][PG34 p35]  (rw32)  Touch screen transform coefficient F (Alias)
-    REG_CTOUCH_CONFIG                   = 0x302168,     // [PG2 p43][PG34 p35]  (rw16)  Touch configuration (Alias)
-    REG_CTOUCH_TOUCH4_X                 = 0x30216C,     // [PG2 p63][PG34 p42]  (ro16)  (extended)      Screen X data for touch 4
-    REG_CTOUCH_TOUCH2_XY                = 0x30218C,     // [PG2 p62][PG34 p41]  (ro32)  (extended)      Screen data for touch 2
-    REG_CTOUCH_TOUCH3_XY                = 0x302190,     // [PG2 p63][PG34 p42]  (ro32)  (extended)      Screen data for touch 3
+      while ((u > 0) && (_addresses[u - 1] > address))
+      {
+        _addresses[u] = _addresses[u - 1];
+        _values[u] = _values[u - 1];
+        u--;
+      }
 
-    // Touch host mode (not documented in [PG34])
-    REG_EHOST_TOUCH_X                   = 0x30210C,     //                      (rw16)  (touch host)    Touch X value updated by host (EVE3/EVE4))
-    REG_EHOST_TOUCH_ID                  = 0x302114,     //                      (rw4)   (touch host)    Touch ID 0-4 (EVE3/EVE4)
-    REG_EHOST_TOUCH_ACK                 = 0x302170,     //                      (rw4)   (touch host)    Acknowledgment (EVE3/EVE4)
+      _addresses[u] = address;
+      _values[u] = 0;
 
-    // Internal control
-    REG_BIST_EN                         = 0x302174,     //                      (rw1)   BIST memory mapping enable (not in [PG*])
-    REG_TRIM                            = 0x302180,     // [PG2 p88]            (rw8)   Internal relaxation clock trimming (not on EVE4?)
-    REG_ANA_COMP                        = 0x302184,     //                      (rw8)   Analog control register (not in [PG*])
-    REG_SPI_WIDTH                       = 0x302188,     // [PG2 p88][PG34 p50]  (rw3)   QSPI bus width setting
+      return true;
+    }
 
-    //// 0x30902194 - 0x302560 Reserved
+  public:
+    //-----------------------------------------------------------------------
+    // Remove all registers
+    void Clear()
+    {
+      _count = 0;
+      _windows = 0;
+    }
 
-    // Date stamp
-    REG_DATESTAMP                       = 0x302564,     //                      (ro128) 16 bytes of date stamp (not in [PG*])
+  public:
+    //-----------------------------------------------------------------------
+    // Get the number of transactions of the last read
+    uint8_t                           // Returns number of transactions
+    Windows() const
+    {
+      return _windows;
+    }
 
-    // EVE3/EVE4 features
-    REG_ADAPTIVE_FRAMERATE              = 0x30257C,     //          [PG34 p50]  (rw1)   Reduce frame rate during complex drawing (EVE3/EVE4)
+  public:
+    //-----------------------------------------------------------------------
+    // Check if a register is in the snapshot
+    bool                              // Returns true=register was added
+    Has(
+      uint32_t address) const         // Address of the register
+    {
+      return Find(address) < _count;
+    }
 
-    // Flash registers
-    REG_FLASH_STATUS                    = 0x3025F0,     //          [PG34 p34]  (rw2)   Flash status (EVE3/EVE4)
-    REG_FLASH_STATE                     = 0x3025F0,     //          [PG34 p34]  (rw2)   Flash status (EVE3/EVE4) (Alias)
-    REG_FLASH_SIZE                      = 0x309024,     //          [PG34 p34]  (ro32)  Detected flash capacity in MB (EVE3/EVE4) (not in [DS3])
+  public:
+    //-----------------------------------------------------------------------
+    // Get the value of a register from the last read
+    uint32_t                          // Returns value, 0=not in snapshot
+    Get32(
+      uint32_t address) const         // Address of the register
+    {
+      uint8_t u = Find(address);
 
-    // EVE4 features
-    REG_UNDERRUN                        = 0x30260C,     //          [PG34 p50]  (ro32)  Line underrun counter (EVE4)
-    REG_AH_CYCLE_MAX                    = 0x302610,     //          [PG34 p50]  (rw12)  Adaptive hsync: max total PCLK cycles (EVE4)
-    REG_PCLK_FREQ                       = 0x302614,     //          [PG34 p51]  (rw16)  Fractional PCLK (EVE4)
-    REG_PCLK_2X                         = 0x302618,     //          [PG34 p51]  (rw1)   2 pixels per PCLK cycle (EVE4)
-    REG_ANIM_ACTIVE                     = 0x30902C,     //          [PG34 p53]  (ro32)  Bitmask of currently playing animations (EVE4)
-    REG_PLAY_CONTROL                    = 0x30914E,     //          [PG34 p53]  (rw8)   Video playback control (EVE4)
+      return (u < _count) ? _values[u] : 0;
+    }
 
-    // Special Registers (documented in Programmer's Guides but not in
-    // any data sheets except [DS4]).
-    REG_TRACKER                         = 0x309000,     // [PG2 p77][PG34 p51]  (rw32)  Tracker register 0
-    REG_TRACKER_1                       = 0x309004,     // [PG2 p78][PG34 p51]  (rw32)  Tracker register 1
-    REG_TRACKER_2                       = 0x309008,     // [PG2 p78][PG34 p52]  (rw32)  Tracker register 2
-    REG_TRACKER_3                       = 0x30900C,     // [PG2 p79][PG34 p52]  (rw32)  Tracker register 3
-    REG_TRACKER_4                       = 0x309010,     // [PG2 p79][PG34 p52]  (rw32)  Tracker register 4
-    REG_MEDIAFIFO_READ                  = 0x309014,     // [PG2 p80][PG34 p52]  (ro32)  Media FIFO read offset
-    REG_MEDIAFIFO_WRITE                 = 0x309018,     // [PG2 p80][PG34 p52]  (rw32)  Media FIFO write offset
+    uint16_t                          // Returns value, 0=not in snapshot
+    Get16(
+      uint32_t address) const         // Address of the register
+    {
+      return (uint16_t)Get32(address);
+    }
 
-    // Undocumented constants found in other code
-    //REG_BUSYBITS                      = 0x3020E8,     // Undocumented
-    //REG_ROMSUB_SEL                    = 0x3020F0,     // Undocumented
-    //REG_ANALOG                        = 0x30216C,     // Undocumented
-    //REG_PATCHED_TOUCH_FAULT           = 0x30216C,     // Undocumented
-    //REG_PATCHED_ANALOG                = 0x302170,     // Undocumented
-    //REG_TOUCH_FAULT                   = 0x302170,     // Undocumented
-    //REG_CRC                           = 0x302178,     // Undocumented
-    //REG_SPI_EARLY_TX                  = 0x30217C,     // Undocumented
+    uint8_t                           // Returns value, 0=not in snapshot
+    Get8(
+      uint32_t address) const         // Address of the register
+    {
+      return (uint8_t)Get32(address);
+    }
 
-    REG_COPRO_PATCH_PTR                 = 0x307162,     //          [PG34 p53]  (ro16)  Co-processor patch pointer
+  public:
+    //-----------------------------------------------------------------------
+    // Decoded fields of frequently used registers
+    //
+    // The registers must be added to the snapshot.
+    bool                              // Returns true=screen is touched
+    Touched() const                   // (REG_TOUCH_SCREEN_XY)
+    {
+      return Has(REG_TOUCH_SCREEN_XY) && (Get32(REG_TOUCH_SCREEN_XY) != 0x80008000UL);
+    }
 
-    REG_CHIP_ID                         = 0x0C0000,     // [PG2 p11][PG34 p16]  (rw32)  Chip identifier in RAM_G [DS2 p46][DS3 p47][DS4 p45]
+    int16_t                           // Returns X coordinate
+    TouchX() const                    // (REG_TOUCH_SCREEN_XY)
+    {
+      return (int16_t)(Get32(REG_TOUCH_SCREEN_XY) >> 16);
+    }
+
+    int16_t                           // Returns Y coordinate
+    TouchY() const                    // (REG_TOUCH_SCREEN_XY)
+    {
+      return (int16_t)Get32(REG_TOUCH_SCREEN_XY);
+    }
+
+    uint16_t                          // Returns raw X value
+    RawX() const                      // (REG_TOUCH_RAW_XY)
+    {
+      return (uint16_t)(Get32(REG_TOUCH_RAW_XY) >> 16);
+    }
+
+    uint16_t                          // Returns raw Y value
+    RawY() const                      // (REG_TOUCH_RAW_XY)
+    {
+      return (uint16_t)Get32(REG_TOUCH_RAW_XY);
+    }
+
+    uint8_t                           // Returns touched tag, 0=none
+    Tag() const                       // (REG_TOUCH_TAG)
+    {
+      return Get8(REG_TOUCH_TAG);
+    }
+
+    uint32_t                          // Returns frame counter
+    Frames() const                    // (REG_FRAMES)
+    {
+      return Get32(REG_FRAMES);
+    }
+
+    uint16_t                          // Returns co-processor read index
+    CmdRead() const                   // (REG_CMD_READ)
+    {
+      return Get16(REG_CMD_READ) & 0xFFF;
+    }
+
+    uint16_t                          // Returns flags; INT values
+    IntFlags() const                  // (REG_INT_FLAGS)
+    {
+      return Get16(REG_INT_FLAGS);
+    }
   };
 
+public:
   //-------------------------------------------------------------------------
-  // Display list commands and co-processor commands
-  enum ENC_CMD
+  // Register snapshot with a given maximum number of registers
+  template<const uint8_t count> class RegSnapshotTable : public RegSnapshot
   {
-    // Display List commands
-    ENC_CMD_DISPLAY                     = 0x00000000,   // [PG2 p127][PG34 p80] End the display list
-    ENC_CMD_BITMAP_SOURCE               = 0x01000000,   // [PG2 p106][PG34 p65] Specify the address of bitmap data
-    ENC_CMD_CLEAR_COLOR_RGB             = 0x02000000,   // [PG2 p121][PG34 p76] Specify clear values for RGB
-    ENC_CMD_CLEAR_COLOR                 = 0x02000000,   // [PG2 p121][PG34 p76] Specify clear values for RGB (Alias for use with 24 bit RGB value)
-    ENC_CMD_TAG                         = 0x03000000,   // [PG2 p143][PG34 p90] Attach tag value for following graphics objects drawn on screen
-    ENC_CMD_COLOR_RGB                   = 0x04000000,   // [PG2 p126][PG34 p79] Set the current color RGB
-    ENC_CMD_COLOR                       = 0x04000000,   // [PG2 p126][PG34 p79] Set the current color RGB (Alias for use with 24-bit RGB value)
-    ENC_CMD_BITMAP_HANDLE               = 0x05000000,   // [PG2 p96] [PG34 p58] Specify the bitmap handle
-    ENC_CMD_CELL                        = 0x06000000,   // [PG2 p117][PG34 p74] Specify the bitmap cell number for the VERTEX2 command
-    ENC_CMD_BITMAP_LAYOUT               = 0x07000000,   // [PG2 p97] [PG34 p59] Specify source bitmap memory format and layout
-    ENC_CMD_BITMAP_SIZE                 = 0x08000000,   // [PG2 p103][PG34 p63] Specify the screen drawing of bitmaps
-    ENC_CMD_ALPHA_FUNC                  = 0x09000000,   // [PG2 p92] [PG34 p56] Specify the Alpha test function
-    ENC_CMD_STENCIL_FUNC                = 0x0A000000,   // [PG2 p139][PG34 p88] Set function and reference value for stencil testing
-    ENC_CMD_BLEND_FUNC                  = 0x0B000000,   // [PG2 p114][PG34 p72] Specify pixel arithmetic
-    ENC_CMD_STENCIL_OP                  = 0x0C000000,   // [PG2 p141][PG34 p89] Set stencil test actions
-    ENC_CMD_POINT_SIZE                  = 0x0D000000,   // [PG2 p133][PG34 p83] Specify the radius of points
-    ENC_CMD_LINE_WIDTH                  = 0x0E000000,   // [PG2 p130][PG34 p81] Specify the width of lines to be drawn
-    ENC_CMD_CLEAR_COLOR_A               = 0x0F000000,   // [PG2 p120][PG34 p75] Specify clear value for the alpha channel
-    ENC_CMD_COLOR_A                     = 0x10000000,   // [PG2 p124][PG34 p77] Set the current color alpha
-    ENC_CMD_CLEAR_STENCIL               = 0x11000000,   // [PG2 p122][PG34 p77] Specify clear value for the stencil buffer
-    ENC_CMD_CLEAR_TAG                   = 0x12000000,   // [PG2 p123][PG34 p77] Specify clear value for the tag buffer
-    ENC_CMD_STENCIL_MASK                = 0x13000000,   // [PG2 p140][PG34 p88] Control the writing of individual bits in stencil planes
-    ENC_CMD_TAG_MASK                    = 0x14000000,   // [PG2 p144][PG34 p90] Control the writing of the tag buffer
-    ENC_CMD_BITMAP_TRANSFORM_A          = 0x15000000,   // [PG2 p108][PG34 p68] Specify the A coefficient of the bitmap transform matrix
-    ENC_CMD_BITMAP_TRANSFORM_B          = 0x16000000,   // [PG2 p109][PG34 p69] Specify the B coefficient of the bitmap transform matrix
-    ENC_CMD_BITMAP_TRANSFORM_C          = 0x17000000,   // [PG2 p110][PG34 p69] Specify the C coefficient of the bitmap transform matrix
-    ENC_CMD_BITMAP_TRANSFORM_D          = 0x18000000,   // [PG2 p111][PG34 p70] Specify the D coefficient of the bitmap transform matrix
-    ENC_CMD_BITMAP_TRANSFORM_E          = 0x19000000,   // [PG2 p112][PG34 p70] Specify the D coefficient of the bitmap transform matrix
-    ENC_CMD_BITMAP_TRANSFORM_F          = 0x1A000000,   // [PG2 p113][PG34 p71] Specify the D coefficient of the bitmap transform matrix
-    ENC_CMD_SCISSOR_XY                  = 0x1B000000,   // [PG2 p138][PG34 p87] Specify the top left corner of the scissor clip rectangle
-    ENC_CMD_SCISSOR_SIZE                = 0x1C000000,   // [PG2 p137][PG34 p86] Specify the size of the scissor clip rectangle
-    ENC_CMD_CALL                        = 0x1D000000,   // [PG2 p116][PG34 p73] Execute a sequence at another location in the DL
-    ENC_CMD_JUMP                        = 0x1E000000,   // [PG2 p129][PG34 p81] Execute commands at another location in the display list
-    ENC_CMD_BEGIN                       = 0x1F000000,   // [PG2 p94] [PG34 p56] Begin drawing graphics primitive
-    ENC_CMD_COLOR_MASK                  = 0x20000000,   // [PG2 p125][PG34 p78] Enable or disable writing of color components
-    ENC_CMD_END                         = 0x21000000,   // [PG2 p128][PG34 p80] End drawing a graphics primitive
-    ENC_CMD_SAVE_CONTEXT                = 0x22000000,   // [PG2 p136][PG34 p85] Push the current graphics context on the context stack
-    ENC_CMD_RESTORE_CONTEXT             = 0x23000000,   // [PG2 p134][PG34 p84] Restore the current graphics context
-    ENC_CMD_RETURN                      = 0x24000000,   // [PG2 p135][PG34 p85] Return from a previous CALL command
-    ENC_CMD_MACRO                       = 0x25000000,   // [PG2 p131][PG34 p82] Execute a single command from a macro register
-    ENC_CMD_CLEAR                       = 0x26000000,   // [PG2 p118][PG34 p74] Clear buffers to preset values
-    ENC_CMD_VERTEX_FORMAT               = 0x27000000,   // [PG2 p147][PG34 p92] Set the precision of the VERTEX2F format
-    ENC_CMD_BITMAP_LAYOUT_H             = 0x28000000,   // [PG2 p103][PG34 p63] Specify 2 msb's of source bitmap memory format/layout
-    ENC_CMD_BITMAP_SIZE_H               = 0x29000000,   // [PG2 p105][PG34 p64] Specify 2 msb's of bitmap dimensions
-    ENC_CMD_PALETTE_SOURCE              = 0x2A000000,   // [PG2 p132][PG34 p83] Specify the base address of the palette
-    ENC_CMD_VERTEX_TRANSLATE_X          = 0x2B000000,   // [PG2 p148][PG34 p93] Specify the vertex transformations X translation component
-    ENC_CMD_VERTEX_TRANSLATE_Y          = 0x2C000000,   // [PG2 p149][PG34 p94] Specify the vertex transformations Y translation component
-    ENC_CMD_NOP                         = 0x2D000000,   // [PG2 p131][PG34 p82] No operation
-    ENC_CMD_BITMAP_EXT_FORMAT           = 0x2E000000,   //           [PG34 p57] Specify the extended format of the bitmap (EVE3/EVE4)
-    ENC_CMD_BITMAP_SWIZZLE              = 0x2F000000,   //           [PG34 p66] Set source for RGBA channels of a bitmap (EVE3/EVE4)
-    ENC_CMD_VERTEX2F                    = 0x40000000,   // [PG2 p145][PG34 p91] Start operations of graphics primitives at spec'd coordinates based on VERTEX_FORMAT ([PG*] encodes this as 1<<30)
-    ENC_CMD_VERTEX2II                   = 0x80000000,   // [PG2 p146][PG34 p92] Start operations of graphics primitives at spec'd coords in pixel precision ([PG*] encodes this as 2<<30)
+  private:
+    uint32_t          _storage[2][count]; // Addresses and values
 
-    // Co-processor commands
-    ENC_CMD_DLSTART                     = 0xFFFFFF00,   // [PG2 p162][PG34 p112]    Start new Display List
-    ENC_CMD_SWAP                        = 0xFFFFFF01,   // [PG2 p163][PG34 p114]    Swap current Display List
-    ENC_CMD_INTERRUPT                   = 0xFFFFFF02,   // [PG2 p164][PG34 p113]    Trigger interrupt CMDFLAG
-    //ENC_CMD_CRC                       = 0xFFFFFF03,   //                          (EVE1?)
-    //ENC_CMD_HAMMERAUX                 = 0xFFFFFF04,   //                          (EVE1?)
-    //ENC_CMD_MARCH                     = 0xFFFFFF05,   //                          (EVE1?)
-    //ENC_CMD_IDCT_DELETED              = 0xFFFFFF06,   //                          (EVE1?)
-    //ENC_CMD_EXECUTE                   = 0xFFFFFF07,   //                          (EVE1?)
-    //ENC_CMD_GETPOINT                  = 0xFFFFFF08,   //                          (EVE1?)
-    ENC_CMD_BGCOLOR                     = 0xFFFFFF09,   // [PG2 p184][PG34 p130]    Set background color
-    ENC_CMD_FGCOLOR                     = 0xFFFFFF0A,   // [PG2 p183][PG34 p129]    Set foreground color
-    ENC_CMD_GRADIENT                    = 0xFFFFFF0B,   // [PG2 p193][PG34 p134]    Draw a smooth color gradient
-    ENC_CMD_TEXT                        = 0xFFFFFF0C,   // [PG2 p213][PG34 p148]    Draw text string
-#ifdef ARDUINO
-    ENC_CMD_TEXTF                       = 0xFFFFFF0C,   // [PG2 p213][PG34 p148]    Draw text string (Alias for use with program memory string)
-#endif
-    ENC_CMD_BUTTON                      = 0xFFFFFF0D,   // [PG2 p176][PG34 p125]    Draw a button
-    ENC_CMD_KEYS                        = 0xFFFFFF0E,   // [PG2 p196][PG34 p137]    Draw a row of keys
-    ENC_CMD_PROGRESS                    = 0xFFFFFF0F,   // [PG2 p200][PG34 p140]    Draw a progress bar
-    ENC_CMD_SLIDER                      = 0xFFFFFF10,   // [PG2 p205][PG34 p143]    Draw a slider
-    ENC_CMD_SCROLLBAR                   = 0xFFFFFF11,   // [PG2 p203][PG34 p141]    Draw a scrollbar
-    ENC_CMD_TOGGLE                      = 0xFFFFFF12,   // [PG2 p210][PG34 p146]    Draw a toggle switch
-    ENC_CMD_GAUGE                       = 0xFFFFFF13,   // [PG2 p187][PG34 p131]    Draw a gauge
-    ENC_CMD_CLOCK                       = 0xFFFFFF14,   // [PG2 p179][PG34 p126]    Draw an analog clock
-    ENC_CMD_CALIBRATE                   = 0xFFFFFF15,   // [PG2 p227][PG34 p159]    Interactive touch screen calibration
-    ENC_CMD_SPINNER                     = 0xFFFFFF16,   // [PG2 p229][PG34 p161]    Show an animated spinner
-    ENC_CMD_STOP                        = 0xFFFFFF17,   // [PG2 p236][PG34 p164]    Stop SKETCH, SPINNER or SCREENSAVER
-    ENC_CMD_MEMCRC                      = 0xFFFFFF18,   // [PG2 p173][PG34 p123]    Compute CRC-32 of given RAM_G memory block
-    ENC_CMD_REGREAD                     = 0xFFFFFF19,   // [PG2 p166][PG34 p115]    Read a register value
-    ENC_CMD_MEMWRITE                    = 0xFFFFFF1A,   // [PG2 p167][PG34 p115]    Write memory or registers
-    ENC_CMD_MEMSET                      = 0xFFFFFF1B,   // [PG2 p175][PG34 p124]    Fill block of memory with byte value
-    ENC_CMD_MEMZERO                     = 0xFFFFFF1C,   // [PG2 p174][PG34 p123]    Fill block of memory with zeros
-    ENC_CMD_MEMCPY                      = 0xFFFFFF1D,   // [PG2 p176][PG34 p124]    Copy block of memory
-    ENC_CMD_APPEND                      = 0xFFFFFF1E,   // [PG2 p165][PG34 p114]    Append more commands from RAM_G
-    ENC_CMD_SNAPSHOT                    = 0xFFFFFF1F,   // [PG2 p245][PG34 p171]    Take a snapshot of the current screen
-    //ENC_CMD_TOUCH_TRANSFORM           = 0xFFFFFF20,   //                          (EVE1?)
-    ENC_CMD_BITMAP_TRANSFORM            = 0xFFFFFF21,   //           [PG34 p188]    Perform bitmap transformation based on 3 points
-    ENC_CMD_INFLATE                     = 0xFFFFFF22,   // [PG2 p168][PG34 p116]    Decompress data in RAM_G
-    ENC_CMD_GETPTR                      = 0xFFFFFF23,   // [PG2 p222][PG34 p153]    Returns first unallocated memory location
-    ENC_CMD_LOADIMAGE                   = 0xFFFFFF24,   // [PG2 p169][PG34 p117]    Load JPEG or PNG image into an EVE bitmap in RAM_G
-    ENC_CMD_GETPROPS                    = 0xFFFFFF25,   // [PG2 p223][PG34 p154]    Returns address and size of bitmap from LOADIMAGE
-    ENC_CMD_LOADIDENTITY                = 0xFFFFFF26,   // [PG2 p220][PG34 p152]    Set the current matrix to the identity matrix
-    ENC_CMD_TRANSLATE                   = 0xFFFFFF27,   // [PG2 p226][PG34 p158]    Apply a translation to the current matrix
-    ENC_CMD_SCALE                       = 0xFFFFFF28,   // [PG2 p223][PG34 p155]    Apply a scale to the current matrix
-    ENC_CMD_ROTATE                      = 0xFFFFFF29,   // [PG2 p225][PG34 p156]    Apply a rotation to the current matrix
-    ENC_CMD_SETMATRIX                   = 0xFFFFFF2A,   // [PG2 p220][PG34 p152]    Assign current matrix values to graphics engine
-    ENC_CMD_SETFONT                     = 0xFFFFFF2B,   // [PG2 p237][PG34 p165]    Register custom-designed font to co-processor
-    ENC_CMD_TRACK                       = 0xFFFFFF2C,   // [PG2 p240][PG34 p168]    Track touches for a graphic object
-    ENC_CMD_DIAL                        = 0xFFFFFF2D,   // [PG2 p207][PG34 p144]    Draw a rotary dial control
-    ENC_CMD_NUMBER                      = 0xFFFFFF2E,   // [PG2 p217][PG34 p151]    Draw a number
-    ENC_CMD_SCREENSAVER                 = 0xFFFFFF2F,   // [PG2 p233][PG34 p162]    Start an animated screen saver
-    ENC_CMD_SKETCH                      = 0xFFFFFF30,   // [PG2 p234][PG34 p163]    Let user sketch a drawing with the touch panel
-    ENC_CMD_LOGO                        = 0xFFFFFF31,   // [PG2 p249][PG34 p174]    Show FTDI or Bridgetek logo animation
-    ENC_CMD_COLDSTART                   = 0xFFFFFF32,   // [PG2 p163][PG34 p113]    Set the co-processor to the default reset states
-    ENC_CMD_GETMATRIX                   = 0xFFFFFF33,   // [PG2 p221][PG34 p153]    Retrieve the current graphics engine matrix
-    ENC_CMD_GRADCOLOR                   = 0xFFFFFF34,   // [PG2 p185][PG34 p130]    Set 3D button highlight color
-    ENC_CMD_CSKETCH                     = 0xFFFFFF35,   // [PG2 p249]               Let user sketch a drawing with resistive touch screen (deprecated)(EVE2)
-    ENC_CMD_SETROTATE                   = 0xFFFFFF36,   // [PG2 p228][PG34 p160]    Rotate the screen
-    ENC_CMD_SNAPSHOT2                   = 0xFFFFFF37,   // [PG2 p246][PG34 p171]    Take a snapshot of part of the screen
-    ENC_CMD_SETBASE                     = 0xFFFFFF38,   // [PG2 p216][PG34 p150]    Set the base for number output
-    ENC_CMD_MEDIAFIFO                   = 0xFFFFFF39,   // [PG2 p170][PG34 p120]    Set up a streaming media FIFO in RAM_G
-    ENC_CMD_PLAYVIDEO                   = 0xFFFFFF3A,   // [PG2 p171][PG34 p120]    Play back MJPEG-encoded video
-    ENC_CMD_SETFONT2                    = 0xFFFFFF3B,   // [PG2 p237][PG34 p165]    Set custom-designed font to co-processor with extended parameters
-    ENC_CMD_SETSCRATCH                  = 0xFFFFFF3C,   // [PG2 p239][PG34 p166]    Set scratch bitmap handle for widget use
-    //ENC_CMD_INT_RAMSHARED             = 0xFFFFFF3D,   //                          Unknown (not in [PG*])
-    //ENC_CMD_INT_SWLOADIMAGE           = 0xFFFFFF3E,   //                          Unknown (not in [PG*])
-    ENC_CMD_ROMFONT                     = 0xFFFFFF3F,   // [PG239 p2][PG34 p167]    Load a ROM font into a bitmap handle
-    ENC_CMD_VIDEOSTART                  = 0xFFFFFF40,   // [PG2 p172][PG34 p121]    Initialize video frame decoder
-    ENC_CMD_VIDEOFRAME                  = 0xFFFFFF41,   // [PG2 p172][PG34 p122]    Load next frame of video
-    ENC_CMD_SYNC                        = 0xFFFFFF42,   //           [PG34 p187]    Wait for the end of the video scan out (EVE3/EVE4)
-    ENC_CMD_SETBITMAP                   = 0xFFFFFF43,   // [PG2 p247][PG34 p173]    Generate Display List commands for a bitmap
-    ENC_CMD_FLASHERASE                  = 0xFFFFFF44,   //           [PG34 p174]    Erase flash storage (EVE3/EVE4)
-    ENC_CMD_FLASHWRITE                  = 0xFFFFFF45,   //           [PG34 p174]    Write data from host to flash storage (EVE3/EVE4)
-    ENC_CMD_FLASHREAD                   = 0xFFFFFF46,   //           [PG34 p176]    Read data from flash to RAM_G (EVE3/EVE4)
-    ENC_CMD_FLASHUPDATE                 = 0xFFFFFF47,   //           [PG34 p177]    Write given data from RAM_G to flash, erasing and skipping as needed (EVE3/EVE4)
-    ENC_CMD_FLASHDETACH                 = 0xFFFFFF48,   //           [PG34 p177]    Put flash storage SPI lines into hi-Z mode (EVE3/EVE4)
-    ENC_CMD_FLASHATTACH                 = 0xFFFFFF49,   //           [PG34 p178]    Reconnect to the flash storage via SPI (EVE3/EVE4)
-    ENC_CMD_FLASHFAST                   = 0xFFFFFF4A,   //           [PG34 p178]    Drive the flash storage in full-speed mode if possible (EVE3/EVE4)
-    ENC_CMD_FLASHSPIDESEL               = 0xFFFFFF4B,   //           [PG34 p179]    De-assert SPI CS for the flash storage device (EVE3/EVE4)
-    ENC_CMD_FLASHSPITX                  = 0xFFFFFF4C,   //           [PG34 p179]    Transmit data from host to flash storage SPI interface (EVE3/EVE4)
-    ENC_CMD_FLASHSPIRX                  = 0xFFFFFF4D,   //           [PG34 p179]    Receive data from flash storage SPI interface to RAM_G (EVE3/EVE4)
-    ENC_CMD_FLASHSOURCE                 = 0xFFFFFF4E,   //           [PG34 p181]    Specify source address for flash storage data (EVE3/EVE4)
-    ENC_CMD_CLEARCACHE                  = 0xFFFFFF4F,   //           [PG34 p180]    Clear graphics engine cache after changes in flash storage (EVE3/EVE4)
-    ENC_CMD_INFLATE2                    = 0xFFFFFF50,   //           [PG34 p117]    Decompress data in RAM_G with options (EVE3/EVE4)
-    ENC_CMD_ROTATEAROUND                = 0xFFFFFF51,   //           [PG34 p157]    Apply a rotation around a specified coordinate (EVE3/EVE4)
-    ENC_CMD_RESETFONTS                  = 0xFFFFFF52,   //           [PG34 p167]    Load bitmap handles 16-31 with their default fonts (EVE3/EVE4)
-    ENC_CMD_ANIMSTART                   = 0xFFFFFF53,   //           [PG34 p181]    Start an animation from flash storage (EVE3/EVE4)
-    ENC_CMD_ANIMSTOP                    = 0xFFFFFF54,   //           [PG34 p184]    Stop an animation or all animations (EVE3/EVE4)
-    ENC_CMD_ANIMXY                      = 0xFFFFFF55,   //           [PG34 p185]    Set the coordinates of an animation (EVE3/EVE4)
-    ENC_CMD_ANIMDRAW                    = 0xFFFFFF56,   //           [PG34 p185]    Draw one or more active animations (EVE3/EVE4)
-    ENC_CMD_GRADIENTA                   = 0xFFFFFF57,   //           [PG34 p136]    Draw smooth color gradient with transparency (EVE3/EVE4)
-    ENC_CMD_FILLWIDTH                   = 0xFFFFFF58,   //           [PG34 p147]    Set the pixel fill width for various commands (EVE3/EVE4)
-    EMC_CMD_APPENDF                     = 0xFFFFFF59,   //           [PG34 p176]    Append data from flash storage to Display List (EVE3/EVE4)
-    ENC_CMD_ANIMFRAME                   = 0xFFFFFF5A,   //           [PG34 p185]    Draw the specified frame of an animation (EVE3/EVE4)
-    //ENC_CMD_NOPCMD                    = 0xFFFFFF5B,   //                          No operation; renamed from "NOP" because of conflict with NOP DL command (Not in [PG*])
-    //ENC_CMD_SHA1                      = 0xFFFFFF5C,   //                          Calculate SHA1 hash? (Not in [PG*])
-    //ENC_CMD_HMAC                      = 0xFFFFFF5D,   //                          Calculate HMAC hash? (Not in [PG*])
-    //EMC_CMD_LAST                      = 0xFFFFFF5E,   //                          Unknown (Not in [PG*])
-    ENC_CMD_VIDEOSTARTF                 = 0xFFFFFF5F,   //           [PG34 p181]    Initialize video frame decoder from flash storage (EVE3/EVE4)
-    ENC_CMD_CALIBRATESUB                = 0xFFFFFF60,   //           [PG34 p159]    Execute touch screen calibration for a sub-window (EVE3/EVE4)
-    ENC_CMD_TESTCARD                    = 0xFFFFFF61,   //           [PG34 p189]    Load a Display List with a test card graphic (EVE4)
-    ENC_CMD_HSF                         = 0xFFFFFF62,   //           [PG34 p195]    Non-square pixel correction (EVE4)
-    ENC_CMD_APILEVEL                    = 0xFFFFFF63,   //           [PG34 p112]    Set the co-processor API level (EVE4)
-    ENC_CMD_GETIMAGE                    = 0xFFFFFF64,   //           [PG34 p194]    Get attributes of bitmap loaded previously (EVE4)
-    ENC_CMD_WAIT                        = 0xFFFFFF65,   //           [PG34 p190]    Wait for specified number of microseconds (EVE4)
-    ENC_CMD_RETURNCMD                   = 0xFFFFFF66,   //           [PG34 p192]    End execution of a command list; renamed from "RETURN" because of conflict with DL command) (EVE4)
-    ENC_CMD_CALLLIST                    = 0xFFFFFF67,   //           [PG34 p192]    Call a command list in RAM_G (EVE4)
-    ENC_CMD_NEWLIST                     = 0xFFFFFF68,   //           [PG34 p190]    Start a command list in RAM_G (EVE4)
-    ENC_CMD_ENDLIST                     = 0xFFFFFF69,   //           [PG34 p191]    Terminate command list in RAM_G (EVE4)
-    ENC_CMD_PCLKFREQ                    = 0xFFFFFF6A,   //           [PG34 p196]    Generate pixel clock as close as possible to the one requested (EVE4)
-    ENC_CMD_FONTCACHE                   = 0xFFFFFF6B,   //           [PG34 p193]    Enable font cache for extended flash-based fonts (EVE4)
-    ENC_CMD_FONTCACHEQUERY              = 0xFFFFFF6C,   //           [PG34 p194]    Query the capacity and utilization of the font cache (EVE4)
-    ENC_CMD_ANIMFRAMERAM                = 0xFFFFFF6D,   //           [PG34 p186]    Draw a specified frame of an animation from RAM_G (EVE4)
-    ENC_CMD_ANIMSTARTRAM                = 0xFFFFFF6E,   //           [PG34 p182]    Start an animation from RAM_G (EVE4)
-    ENC_CMD_RUNANIM                     = 0xFFFFFF6F,   //           [PG32 p183]    Wait until run-once animation is complete (EVE4)
-    ENC_CMD_FLASHPROGRAM                = 0xFFFFFF70,   //           [PG34 p175]    Write data from RAM_G to flash storage (EVE3/EVE4)
+  public:
+    //-----------------------------------------------------------------------
+    // Constructor
+    RegSnapshotTable()
+      : RegSnapshot(_storage[0], _storage[1], count)
+    {
+      // Nothing
+    }
+  };
+
+  //=========================================================================
+  // HELPER CLASSES FOR DEFERRED COMMAND OUTPUTS
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Base class for output values of co-processor commands
+  //
+  // Commands such as cmd_GETPROPS store their output in the command queue.
+  // Instead of waiting for each command and reading each value with
+  // CmdRead32, the Cmd index of an output can be handed to CmdDefer. The
+  // outputs are then read later by CmdResolve, e.g. once per frame, after
+  // the co-processor has executed the commands. Outputs that are close
+  // together in RAM_CMD are read in one transaction. For example:
+  //
+  //   Steve::CmdOutputTable<30> outputs;
+  //   Steve::CmdIndex w, h;
+  //   eve.cmd_GETPROPS(NULL, &w, &h);
+  //   uint8_t iw = eve.CmdDefer(outputs, w);
+  //   uint8_t ih = eve.CmdDefer(outputs, h);
+  //   ...
+  //   eve.CmdResolve(outputs);
+  //   if (outputs.IsReady(iw)) ... outputs.Get(iw) ...
+  //
+  // An output is lost if it's overwritten by later commands before it's
+  // resolved, i.e. when more than RAM_CMD_SIZE bytes of commands follow
+  // it, or if the command queue is reset (e.g. by CmdRecover).
+  //
+  // Use the CmdOutputTable template below to declare a set of outputs.
+  class CmdOutputs
+  {
+    friend class SteveT;
+
+  public:
+    //-----------------------------------------------------------------------
+    // State of an output
+    enum STATE
+    {
+      STATE_PENDING,                  // Not read yet
+      STATE_READY,                    // Value is available
+      STATE_LOST,                     // Overwritten before it was read
+    };
+
+  protected:
+    //-----------------------------------------------------------------------
+    // Output
+    struct Entry
+    {
+      uint32_t        _total;         // Location in the command stream
+      uint16_t        _offset;        // Location in RAM_CMD
+      uint32_t        _value;         // Value, if ready
+      uint8_t         _state;         // STATE value
+    };
+
+  protected:
+    Entry      *const _entries;       // Outputs, in command stream order
+    const uint8_t     _max;           // Maximum number of outputs
+    uint8_t           _count;         // Number of outputs
+    uint8_t           _pending;       // Number of outputs not resolved
+    uint8_t           _epoch;         // Command queue epoch of outputs
+    uint8_t           _windows;       // Transactions of last resolve
+
+  protected:
+    //-----------------------------------------------------------------------
+    // Constructor
+    CmdOutputs(
+      Entry *entries,                 // Storage for outputs
+      uint8_t max)                    // Maximum number of outputs
+      : _entries(entries)
+      , _max(max)
+      , _count(0)
+      , _pending(0)
+      , _epoch(0)
+      , _windows(0)
+    {
+      // Nothing
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Remove all outputs
+    void Clear()
+    {
+      _count = 0;
+      _pending = 0;
+      _windows = 0;
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Get the number of outputs
+    uint8_t                           // Returns number of outputs
+    Count() const
+    {
+      return _count;
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Get the number of outputs that weren't resolved yet
+    uint8_t                           // Returns number of outputs
+    Pending() const
+    {
+      return _pending;
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Get the number of transactions of the last resolve
+    uint8_t                           // Returns number of transactions
+    Windows() const
+    {
+      return _windows;
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Get the state of an output
+    STATE                             // Returns state; LOST=invalid id
+    State(
+      uint8_t id) const               // Output from CmdDefer
+    {
+      return (id < _count) ? (STATE)_entries[id]._state : STATE_LOST;
+    }
+
+    bool                              // Returns true=value available
+    IsReady(
+      uint8_t id) const               // Output from CmdDefer
+    {
+      return State(id) == STATE_READY;
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Get the value of an output
+    uint32_t                          // Returns value, 0=not ready
+    Get(
+      uint8_t id) const               // Output from CmdDefer
+    {
+      return IsReady(id) ? _entries[id]._value : 0;
+    }
+  };
+
+public:
+  //-------------------------------------------------------------------------
+  // Set of deferred command outputs with a given maximum number
+  template<const uint8_t count> class CmdOutputTable : public CmdOutputs
+  {
+  private:
+    typename CmdOutputs::Entry _storage[count]; // Outputs
+
+  public:
+    //-----------------------------------------------------------------------
+    // Constructor
+    CmdOutputTable()
+      : CmdOutputs(_storage, count)
+    {
+      // Nothing
+    }
+  };
+
+  //=========================================================================
+  // STATIC HELPER FUNCTIONS
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Convert RGB values to an RGB24 value
+  static uint32_t toRGB(                // Returns 24-bit RGB value
+      uint8_t r,                        // Red
+      uint8_t g,                        // Green
+      uint8_t b)                        // Blue
+  {
+    return (uint32_t)r << 16 | (uint32_t)g << 8 | (uint32_t)b;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Count the arguments that a format string for OPT_FORMAT needs
+  //
+  // Every conversion (%d, %i, %u, %o, %x, %X, %c, %s) takes one argument,
+  // and every '*' for a width or precision takes another one. "%%" takes
+  // none. This can be evaluated at compile time; see STEVE_TEXT_FORMAT.
+  static STEVE_CONSTEXPR uint8_t        // Returns number of arguments
+  FormatArgCount(
+    const char *format)                 // Format string
+  {
+    return (!format || !*format) ? 0
+      : (*format != '%') ? FormatArgCount(format + 1)
+      : (format[1] == '%') ? FormatArgCount(format + 2)
+      : FormatSpecArgCount(format + 1);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of arguments as the size of an array type
+  //
+  // This is only declared, to be used with sizeof in STEVE_TEXT_FORMAT.
+  template<typename... ARGS>
+  static char (&FormatArgs(             // Returns array of count + 1 chars
+    ARGS... args))[sizeof...(ARGS) + 1];
+
+protected:
+  //-------------------------------------------------------------------------
+  // Count the arguments of one conversion, after the '%'
+  static STEVE_CONSTEXPR uint8_t        // Returns number of arguments
+  FormatSpecArgCount(
+    const char *spec)                   // Flags, width etc. of conversion
+  {
+    return (!*spec) ? 0
+      : (*spec == '*') ? (uint8_t)(1 + FormatSpecArgCount(spec + 1))
+      : ((*spec == 'd') || (*spec == 'i') || (*spec == 'u') || (*spec == 'o')
+        || (*spec == 'x') || (*spec == 'X') || (*spec == 'c') || (*spec == 's'))
+        ? (uint8_t)(1 + FormatArgCount(spec + 1))
+      : FormatSpecArgCount(spec + 1);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Calculate a CRC-32 of a block of data
+  //
+  // This is the same CRC-32 that CMD_MEMCRC calculates (the one that's
+  // also used by zlib). To calculate the CRC of data that's split up,
+  // pass the result of each call to the next one.
+  static uint32_t                       // Returns CRC
+  Crc32(
+    const void *data,                   // Data
+    uint32_t len,                       // Number of bytes
+    uint32_t crc = 0)                   // Result of previous part
+  {
+    const static uint32_t table[16] =
+    {
+      0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+      0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+      0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+      0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+    };
+
+    const uint8_t *p = (const uint8_t *)data;
+
+    crc = ~crc;
+
+    while (len--)
+    {
+      crc ^= *p++;
+      crc = (crc >> 4) ^ table[crc & 0x0F];
+      crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return ~crc;
+  }
+
+  //=========================================================================
+  // ENUM TYPES
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Host commands and memory read/write operations
+  //
+  // Host commands and memory read/write operations are almost the same,
+  // even though they are presented in the datasheets as distinct operations.
+  //
+  // Only the lower 24 bits are significant. The "ACTIVE" command is
+  // partially identical to a "read memory location 0" operation but
+  // doesn't require a dummy byte.
+  enum HOSTCMD // 24 bits
+  {
+    // [DS2 p15][DS3 p15][DS4 p14]
+    HOSTCMD_ACTIVE                      = 0x000000,     // Switch from Standby/Sleep/PWRDOWN to Active. Same as "read 0"
+    HOSTCMD_READ                        = 0x000000,     // Read data. Add address, send dummy byte before reading.
+    HOSTCMD_STANDBY                     = 0x410000,     // Put core in standby mode. Use ACTIVE to wake up again.
+    HOSTCMD_SLEEP                       = 0x420000,     // Put core in sleep mode. Use ACTIVE to wake up again.
+    HOSTCMD_PWRDOWN                     = 0x430000,     // Put core in power down mode. Use ACTIVE to wake up again.
+    HOSTCMD_CLKEXT                      = 0x440000,     // Select PLL input from external xtal osc or external clock.
+    HOSTCMD_CLKINT                      = 0x480000,     // Select PLL input from internal osc (default).
+    HOSTCMD_PD_ROMS                     = 0x490000,     // (EVE2 only) Select power down to individual ROMs.
+    HOSTCMD_PWRDOWN1                    = 0x500000,     // Same as 0x430000.
+    HOSTCMD_CLKSEL                      = 0x610000,     // Select system clock freq.
+    HOSTCMD_CLKSEL1                     = 0x620000,     // Same as 0x610000.
+    HOSTCMD_RST_PULSE                   = 0x680000,     // Send reset pulse to core.
+    HOSTCMD_PINDRIVE                    = 0x700000,     // Set drive strength for various pins.
+    HOSTCMD_PIN_PD_STATE                = 0x710000,     // Set pin state during power down.
+    HOSTCMD_WRITE                       = 0x800000,     // Write data. Add address, send bytes.
   };
 
-  // Alpha test function for ALPHA_FUNC (ProgGuide 4.4 p.92)
-  // and STENCIL_FUNC (ProgGuide 4.42 p.139)
-  // See ProgGuide Table 5 p.92.
-  typedef enum
+  //-----------------------------------------------------------------------
+  // Register addresses
+  enum REG // 22 bits
+  {
+    // [DS2 p41][DS3 p42][DS3 p41]
+    //
+    // These are mostly in numerical order except where register groups
+    // were split between different address areas. There is some overlap,
+    // especially between the resistive and capacitive touch engines.
+
+    // General configuration / status
+    REG_ID                              = 0x302000,     // [PG2 p87][PG34 p49]  (ro8)   Identification; always 0x7C
+    REG_FRAMES                          = 0x302004,     // [PG2 p87][PG34 p49]  (ro32)  Frame counter
+    REG_CLOCK                           = 0x302008,     // [PG2 p87][PG34 p49]  (ro32)  Clock cycle counter
+    REG_FREQUENCY                       = 0x30200C,     // [PG2 p86][PG34 p49]  (rw28)  Clock frequency as known by the chip
+    REG_RENDERMODE                      = 0x302010,     //                      (rw1)   Single line rendering enable (not in [PG*])
+    REG_SNAPY                           = 0x302014,     //                      (rw11)  Single line scanline selection (not in [PG*])
+    REG_SNAPSHOT                        = 0x302018,     //                      (rw1)   Single line render mode trigger (not in [PG*])
+    REG_SNAPFORMAT                      = 0x30201C,     //                      (rw6)   Pixel format for scanline readout (not in [PG*])
+    REG_CPURESET                        = 0x302020,     // [PG2 p81][PG34 p46]  (rw3)   Audio/Touch/Graphics reset control
+    REG_TAP_CRC                         = 0x302024,     //                      (ro32)  Live video tap CRC (not in [PG*])
+    REG_TAP_MASK                        = 0x302028,     //                      (rw32)  Live video tap mask (not in [PG*])
+
+    // LCD panel configuration
+    REG_HCYCLE                          = 0x30202C,     // [PG2 p34][PG34 p32]  (rw12)  Horizontal total cycle count
+    REG_HOFFSET                         = 0x302030,     // [PG2 p34][PG34 p31]  (rw12)  Horizontal display start offset
+    REG_HSIZE                           = 0x302034,     // [PG2 p33][PG34 p31]  (rw12)  Horizontal display size
+    REG_HSYNC0                          = 0x302038,     // [PG2 p32][PG34 p31]  (rw12)  Horizontal sync fall offset
+    REG_HSYNC1                          = 0x30203C,     // [PG2 p32][PG34 p31]  (rw12)  Horizontal sync rise offset
+    REG_VCYCLE                          = 0x302040,     // [PG2 p31][PG34 p31]  (rw12)  Vertical total cycle count
+    REG_VOFFSET                         = 0x302044,     // [PG2 p31][PG34 p31]  (rw12)  Vertical display start offset
+    REG_VSIZE                           = 0x302048,     // [PG2 p31][PG34 p31]  (rw12)  Vertical display line count
+    REG_VSYNC0                          = 0x30204C,     // [PG2 p30][PG34 p30]  (rw10)  Vertical sync fall offset
+    REG_VSYNC1                          = 0x302050,     // [PG2 p30][PG34 p30]  (rw10)  Vertical sync rise offset
+    REG_DLSWAP                          = 0x302054,     // [PG2 p35][PG34 p30]  (rw2)   Display List swap control
+    REG_ROTATE                          = 0x302058,     // [PG2 p29][PG34 p30]  (rw3)   Screen rotation
+    REG_OUTBITS                         = 0x30205C,     // [PG2 p29][PG34 p29]  (rw9)   Output bits resolution
+    REG_DITHER                          = 0x302060,     // [PG2 p28][PG34 p29]  (rw1)   Output dither enable
+    REG_SWIZZLE                         = 0x302064,     // [PG2 p28][PG34 p29]  (rw4)   Output RGB bit order control
+    REG_CSPREAD                         = 0x302068,     // [PG2 p27][PG34 p29]  (rw1)   Output clock spreading enable
+    REG_PCLK_POL                        = 0x30206C,     // [PG2 p27][PG34 p29]  (rw1)   Pixel clock polarity
+    REG_PCLK                            = 0x302070,     // [PG2 p26][PG34 p29]  (rw8)   Pixel clock divider
+
+    // Touch control
+    REG_TAG_X                           = 0x302074,     // [PG2 p36][PG34 p28]  (rw11)  Tag query X coordinate
+    REG_TAG_Y                           = 0x302078,     // [PG2 p36][PG34 p28]  (rw11)  Tag query Y coordinate
+    REG_TAG                             = 0x30207C,     // [PG2 p35][PG34 p28]  (ro8)   Tag query result
+
+    // Audio
+    REG_VOL_PB                          = 0x302080,     // [PG2 p38][PG34 p32]  (rw8)   Volume for playback
+    REG_VOL_SOUND                       = 0x302084,     // [PG2 p38][PG34 p32]  (rw8)   Volume for synthesizer sound
+    REG_SOUND                           = 0x302088,     // [PG2 p37][PG34 p32]  (rw16)  Sound effect select
+    REG_PLAY                            = 0x30208C,     // [PG2 p37][PG34 p32]  (rw1)   Start effect playback
+
+    // GPIO
+    REG_GPIO_DIR                        = 0x302090,     // [PG2 p84][PG34 p47]  (rw8)   Legacy GPIO direction
+    REG_GPIO                            = 0x302094,     // [PG2 p84][PG34 p48]  (rw8)   Legacy GPIO read/write
+    REG_GPIOX_DIR                       = 0x302098,     // [PG2 p85][PG34 p48]  (rw16)  Extended GPIO direction
+    REG_GPIOX                           = 0x30209C,     // [PG2 p86][PG34 p48]  (rw16)  Extended GPIO read/write
+
+    //// 0x3020A0-0x3020A4 Reserved
+
+    // Interrupt control
+    REG_INT_FLAGS                       = 0x3020A8,     // [PG2 p83][PG34 p47]  (ro8)   Interrupt flags, clear by read
+    REG_INT_EN                          = 0x3020AC,     // [PG2 p83][PG34 p47]  (rw1)   Global interrupt enable
+    REG_INT_MASK                        = 0x3020B0,     // [PG2 p82][PG34 p47]  (rw8)   Interrupt mask
+
+    // Audio playback
+    REG_PLAYBACK_START                  = 0x3020B4,     // [PG2 p42][PG34 p34]  (rw20)  Audio playback RAM start address
+    REG_PLAYBACK_LENGTH                 = 0x3020B8,     // [PG2 p42][PG34 p34]  (rw20)  Audio playback sample length
+    REG_PLAYBACK_READPTR                = 0x3020BC,     // [PG2 p41][PG34 p33]  (ro20)  Audio playback current read ptr
+    REG_PLAYBACK_FREQ                   = 0x3020C0,     // [PG2 p41][PG34 p33]  (rw16)  Audio playback sample frequency
+    REG_PLAYBACK_FORMAT                 = 0x3020C4,     // [PG2 p40][PG34 p33]  (rw2)   Audio playback format
+    REG_PLAYBACK_LOOP                   = 0x3020C8,     // [PG2 p39][PG34 p33]  (rw1)   Audio playback loop enable
+    REG_PLAYBACK_PLAY                   = 0x3020CC,     // [PG2 p39][PG34 p33]  (rw1)   Start audio playback
+    REG_PLAYBACK_PAUSE                  = 0x3025EC,     //          [PG34 p34]  (rw1)   Audio playback pause (EVE3/EVE4)
+
+    // Backlight control
+    REG_PWM_HZ                          = 0x3020D0,     // [PG2 p82][PG34 p47]  (rw14)  Backlight PWM frequency
+    REG_PWM_DUTY                        = 0x3020D4,     // [PG2 p81][PG34 p47]  (rw8)   Backlight PWM duty cycle
+
+    // Display list macro commands
+    REG_MACRO_0                         = 0x3020D8,     //          [PG34 p46]  (rw32)  Display list macro command 0 (not in [PG2])
+    REG_MACRO_1                         = 0x3020DC,     //          [PG34 p46]  (rw32)  Display list macro command 1 (not in [PG2])
+
+    //// 0x3020E0-0x3020F4 Reserved
+
+    // Co-processor registers
+    REG_CMD_READ                        = 0x3020F8,     // [PG2 p76][PG34 p45]  (rw12)  Command buffer read pointer
+    REG_CMD_WRITE                       = 0x3020FC,     // [PG2 p75][PG34 p45]  (ro12)  Command buffer write pointer
+    REG_CMD_DL                          = 0x302100,     // [PG2 p75][PG34 p45]  (rw13)  Command display list offset
+    REG_CMDB_SPACE                      = 0x302574,     // [PG2 p76][PG34 p46]  (rw12)  Command DL (bulk) space available
+    REG_CMDB_WRITE                      = 0x302578,     // [PG2 p77][PG34 p46]  (wo32)  Command DL (bulk) write
+
+    // Resistive touch engine (FT810/FT812/BT816/BT818)
+    REG_TOUCH_MODE                      = 0x302104,     // [PG2 p58][PG34 p40]  (rw2)   Touch screen sample mode
+    REG_TOUCH_ADC_MODE                  = 0x302108,     // [PG2 p58][PG34 p39]  (rw1)   Touch screen ADC mode
+    REG_TOUCH_CHARGE                    = 0x30210C,     // [PG2 p57][PG34 p39]  (rw16)  Touch charge time *6 clocks
+    REG_TOUCH_SETTLE                    = 0x302110,     // [PG2 p57][PG34 p39]  (rw4)   Touch settle time *6 clocks
+    REG_TOUCH_OVERSAMPLE                = 0x302114,     // [PG2 p56][PG34 p39]  (rw4)   Touch oversample factor
+    REG_TOUCH_RZTHRESH                  = 0x302118,     // [PG2 p56][PG34 p39]  (rw16)  Touch resistance threshold
+    REG_TOUCH_RAW_XY                    = 0x30211C,     // [PG2 p55][PG34 p38]  (ro32)  (compatibility) Touch screen raw data
+    REG_TOUCH_RZ                        = 0x302120,     // [PG2 p55][PG34 p38]  (ro16)  (compatibility) Touch screen resistance
+    REG_TOUCH_SCREEN_XY                 = 0x302124,     // [PG2 p53][PG34 p37]  (ro32)  (compatibility) Touch screen coordinates
+    REG_TOUCH_TAG_XY                    = 0x302128,     // [PG2 p52][PG34 p37]  (ro32)  Touch Tag 0 lookup
+    REG_TOUCH_TAG                       = 0x30212C,     // [PG2 p51][PG34 p37]  (ro8)   Touch Tag 0 result
+    REG_TOUCH_TRANSFORM_A               = 0x302150,     // [PG2 p49][PG34 p36]  (rw32)  Touch screen transform coefficient A
+    REG_TOUCH_TRANSFORM_B               = 0x302154,     // [PG2 p48][PG34 p36]  (rw32)  Touch screen transform coefficient B
+    REG_TOUCH_TRANSFORM_C               = 0x302158,     // [PG2 p47][PG34 p36]  (rw32)  Touch screen transform coefficient C
+    REG_TOUCH_TRANSFORM_D               = 0x30215C,     // [PG2 p46][PG34 p36]  (rw32)  Touch screen transform coefficient D
+    REG_TOUCH_TRANSFORM_E               = 0x302160,     // [PG2 p45][PG34 p36]  (rw32)  Touch screen transform coefficient E
+    REG_TOUCH_TRANSFORM_F               = 0x302164,     // [PG2 p44][PG34 p35]  (rw32)  Touch screen transform coefficient F
+    REG_TOUCH_CONFIG                    = 0x302168,     // [PG2 p43][PG34 p35]  (rw16)  Touch configuration
+    REG_TOUCH_DIRECT_XY                 = 0x30218C,     // [PG2 p54][PG34 p38]  (ro32)  (compatibility) Touch screen direct conversions
+    REG_TOUCH_DIRECT_Z1Z2               = 0x302190,     // [PG2 p54][PG34 p38]  (ro32)  (compatibility) Touch screen direct conversions
+
+    // Capacitive touch engine (FT811/FT813/BT815/BT817)
+    REG_CTOUCH_MODE                     = 0x302104,     // [PG2 p54][PG34 p41]  (rw2)   Touch screen sample mode
+    REG_CTOUCH_EXTEND                   = 0x302108,     // [PG2 p61][PG34 p41]  (rw1)   Touch screen mode (extended or compatibility)
+    REG_CTOUCH_EXTENDED                 = 0x302108,     // [PG2 p61][PG34 p41]  (rw1)   Touch screen mode (extended or compatibility) (Alias)
+    REG_CTOUCH_RAW_XY                   = 0x30211C,     // [PG2 p64][PG34 p42]  (ro32)  (compatibility) Touch screen raw data
+    REG_CTOUCH_TOUCH1_XY                = 0x30211C,     // [PG2 p62][PG34 p41]  (ro32)  (extended)      Screen data for touch 1
+    REG_CTOUCH_TOUCH4_Y                 = 0x302120,     // [PG2 p64][PG34 p42]  (ro16)  (extended)      Screen Y data for touch 4
+    REG_CTOUCH_TOUCH_XY                 = 0x302124,     // [PG2 p61][PG34 p41]  (ro32)  (compatibility) Screen data for single touch
+    REG_CTOUCH_TOUCH0_XY                = 0x302124,     // [PG2 p61][PG34 p41]  (ro32)  (extended)      Screen data for touch 0
+    REG_CTOUCH_TAG_XY                   = 0x302128,     // [PG2 p70][PG34 p44]  (ro32)  Touch Tag 0 lookup
+    REG_CTOUCH_TAG                      = 0x30212C,     // [PG2 p65][PG34 p42]  (ro8)   Touch Tag 0 result
+    REG_CTOUCH_TAG1_XY                  = 0x302130,     // [PG2 p71][PG34 p44]  (ro32)  Touch Tag 1 lookup
+    REG_CTOUCH_TAG1                     = 0x302134,     // [PG2 p66][PG34 p43]  (ro8)   Touch Tag 1 result
+    REG_CTOUCH_TAG2_XY                  = 0x302138,     // [PG2 p72][PG34 p44]  (ro32)  Touch Tag 2 lookup
+    REG_CTOUCH_TAG2                     = 0x30213C,     // [PG2 p67][PG34 p43]  (ro8)   Touch Tag 2 result
+    REG_CTOUCH_TAG3_XY                  = 0x302140,     // [PG2 p73][PG34 p44]  (ro32)  Touch Tag 3 lookup
+    REG_CTOUCH_TAG3                     = 0x302144,     // [PG2 p68][PG34 p43]  (ro8)   Touch Tag 3 result
+    REG_CTOUCH_TAG4_XY                  = 0x302148,     // [PG2 p74][PG34 p44]  (ro32)  Touch Tag 4 lookup
+    REG_CTOUCH_TAG4                     = 0x30214C,     // [PG2 p69][PG34 p43]  (ro8)   Touch Tag 4 result
+    REG_CTOUCH_TRANSFORM_A              = 0x302150,     // [PG2 p49][PG34 p36]  (rw32)  Touch screen transform coefficient A (Alias)
+    REG_CTOUCH_TRANSFORM_B              = 0x302154,     // [PG2 p48][PG34 p36]  (rw32)  Touch screen transform coefficient B (Alias)
+    REG_CTOUCH_TRANSFORM_C              = 0x302158,     // [PG2 p47][PG34 p36]  (rw32)  Touch screen transform coefficient C (Alias)
+    REG_CTOUCH_TRANSFORM_D              = 0x30215C,     // [PG2 p46][PG34 p36]  (rw32)  Touch screen transform coefficient D (Alias)
+    REG_CTOUCH_TRANSFORM_E              = 0x302160,     // [PG2 p45][PG34 p36]  (rw32)  Touch screen transform coefficient E (Alias)
+    REG_CTOUCH_TRANSFORM_F              = 0x302164,     // [PG2 p44][PG34 p35]  (rw32)  Touch screen transform coefficient F (Alias)
+    REG_CTOUCH_CONFIG                   = 0x302168,     // [PG2 p43][PG34 p35]  (rw16)  Touch configuration (Alias)
+    REG_CTOUCH_TOUCH4_X                 = 0x30216C,     // [PG2 p63][PG34 p42]  (ro16)  (extended)      Screen X data for touch 4
+    REG_CTOUCH_TOUCH2_XY                = 0x30218C,     // [PG2 p62][PG34 p41]  (ro32)  (extended)      Screen data for touch 2
+    REG_CTOUCH_TOUCH3_XY                = 0x302190,     // [PG2 p63][PG34 p42]  (ro32)  (extended)      Screen data for touch 3
+
+    // Touch host mode (not documented in [PG34])
+    REG_EHOST_TOUCH_X                   = 0x30210C,     //                      (rw16)  (touch host)    Touch X value updated by host (EVE3/EVE4))
+    REG_EHOST_TOUCH_ID                  = 0x302114,     //                      (rw4)   (touch host)    Touch ID 0-4 (EVE3/EVE4)
+    REG_EHOST_TOUCH_ACK                 = 0x302170,     //                      (rw4)   (touch host)    Acknowledgment (EVE3/EVE4)
+
+    // Internal control
+    REG_BIST_EN                         = 0x302174,     //                      (rw1)   BIST memory mapping enable (not in [PG*])
+    REG_TRIM                            = 0x302180,     // [PG2 p88]            (rw8)   Internal relaxation clock trimming (not on EVE4?)
+    REG_ANA_COMP                        = 0x302184,     //                      (rw8)   Analog control register (not in [PG*])
+    REG_SPI_WIDTH                       = 0x302188,     // [PG2 p88][PG34 p50]  (rw3)   QSPI bus width setting
+
+    //// 0x30902194 - 0x302560 Reserved
+
+    // Date stamp
+    REG_DATESTAMP                       = 0x302564,     //                      (ro128) 16 bytes of date stamp (not in [PG*])
+
+    // EVE3/EVE4 features
+    REG_ADAPTIVE_FRAMERATE              = 0x30257C,     //          [PG34 p50]  (rw1)   Reduce frame rate during complex drawing (EVE3/EVE4)
+
+    // Flash registers
+    REG_FLASH_STATUS                    = 0x3025F0,     //          [PG34 p34]  (rw2)   Flash status (EVE3/EVE4)
+    REG_FLASH_STATE                     = 0x3025F0,     //          [PG34 p34]  (rw2)   Flash status (EVE3/EVE4) (Alias)
+    REG_FLASH_SIZE                      = 0x309024,     //          [PG34 p34]  (ro32)  Detected flash capacity in MB (EVE3/EVE4) (not in [DS3])
+
+    // EVE4 features
+    REG_UNDERRUN                        = 0x30260C,     //          [PG34 p50]  (ro32)  Line underrun counter (EVE4)
+    REG_AH_CYCLE_MAX                    = 0x302610,     //          [PG34 p50]  (rw12)  Adaptive hsync: max total PCLK cycles (EVE4)
+    REG_PCLK_FREQ                       = 0x302614,     //          [PG34 p51]  (rw16)  Fractional PCLK (EVE4)
+    REG_PCLK_2X                         = 0x302618,     //          [PG34 p51]  (rw1)   2 pixels per PCLK cycle (EVE4)
+    REG_ANIM_ACTIVE                     = 0x30902C,     //          [PG34 p53]  (ro32)  Bitmask of currently playing animations (EVE4)
+    REG_PLAY_CONTROL                    = 0x30914E,     //          [PG34 p53]  (rw8)   Video playback control (EVE4)
+
+    // Special Registers (documented in Programmer's Guides but not in
+    // any data sheets except [DS4]).
+    REG_TRACKER                         = 0x309000,     // [PG2 p77][PG34 p51]  (rw32)  Tracker register 0
+    REG_TRACKER_1                       = 0x309004,     // [PG2 p78][PG34 p51]  (rw32)  Tracker register 1
+    REG_TRACKER_2                       = 0x309008,     // [PG2 p78][PG34 p52]  (rw32)  Tracker register 2
+    REG_TRACKER_3                       = 0x30900C,     // [PG2 p79][PG34 p52]  (rw32)  Tracker register 3
+    REG_TRACKER_4                       = 0x309010,     // [PG2 p79][PG34 p52]  (rw32)  Tracker register 4
+    REG_MEDIAFIFO_READ                  = 0x309014,     // [PG2 p80][PG34 p52]  (ro32)  Media FIFO read offset
+    REG_MEDIAFIFO_WRITE                 = 0x309018,     // [PG2 p80][PG34 p52]  (rw32)  Media FIFO write offset
+
+    // Undocumented constants found in other code
+    //REG_BUSYBITS                      = 0x3020E8,     // Undocumented
+    //REG_ROMSUB_SEL                    = 0x3020F0,     // Undocumented
+    //REG_ANALOG                        = 0x30216C,     // Undocumented
+    //REG_PATCHED_TOUCH_FAULT           = 0x30216C,     // Undocumented
+    //REG_PATCHED_ANALOG                = 0x302170,     // Undocumented
+    //REG_TOUCH_FAULT                   = 0x302170,     // Undocumented
+    //REG_CRC                           = 0x302178,     // Undocumented
+    //REG_SPI_EARLY_TX                  = 0x30217C,     // Undocumented
+
+    REG_COPRO_PATCH_PTR                 = 0x307162,     //          [PG34 p53]  (ro16)  Co-processor patch pointer
+
+    REG_CHIP_ID                         = 0x0C0000,     // [PG2 p11][PG34 p16]  (rw32)  Chip identifier in RAM_G [DS2 p46][DS3 p47][DS4 p45]
+  };
+
+  //-------------------------------------------------------------------------
+  // Display list commands and co-processor commands
+  enum ENC_CMD
+  {
+    // Display List commands
+    ENC_CMD_DISPLAY                     = 0x00000000,   // [PG2 p127][PG34 p80] End the display list
+    ENC_CMD_BITMAP_SOURCE               = 0x01000000,   // [PG2 p106][PG34 p65] Specify the address of bitmap data
+    ENC_CMD_CLEAR_COLOR_RGB             = 0x02000000,   // [PG2 p121][PG34 p76] Specify clear values for RGB
+    ENC_CMD_CLEAR_COLOR                 = 0x02000000,   // [PG2 p121][PG34 p76] Specify clear values for RGB (Alias for use with 24 bit RGB value)
+    ENC_CMD_TAG                         = 0x03000000,   // [PG2 p143][PG34 p90] Attach tag value for following graphics objects drawn on screen
+    ENC_CMD_COLOR_RGB                   = 0x04000000,   // [PG2 p126][PG34 p79] Set the current color RGB
+    ENC_CMD_COLOR                       = 0x04000000,   // [PG2 p126][PG34 p79] Set the current color RGB (Alias for use with 24-bit RGB value)
+    ENC_CMD_BITMAP_HANDLE               = 0x05000000,   // [PG2 p96] [PG34 p58] Specify the bitmap handle
+    ENC_CMD_CELL                        = 0x06000000,   // [PG2 p117][PG34 p74] Specify the bitmap cell number for the VERTEX2 command
+    ENC_CMD_BITMAP_LAYOUT               = 0x07000000,   // [PG2 p97] [PG34 p59] Specify source bitmap memory format and layout
+    ENC_CMD_BITMAP_SIZE                 = 0x08000000,   // [PG2 p103][PG34 p63] Specify the screen drawing of bitmaps
+    ENC_CMD_ALPHA_FUNC                  = 0x09000000,   // [PG2 p92] [PG34 p56] Specify the Alpha test function
+    ENC_CMD_STENCIL_FUNC                = 0x0A000000,   // [PG2 p139][PG34 p88] Set function and reference value for stencil testing
+    ENC_CMD_BLEND_FUNC                  = 0x0B000000,   // [PG2 p114][PG34 p72] Specify pixel arithmetic
+    ENC_CMD_STENCIL_OP                  = 0x0C000000,   // [PG2 p141][PG34 p89] Set stencil test actions
+    ENC_CMD_POINT_SIZE                  = 0x0D000000,   // [PG2 p133][PG34 p83] Specify the radius of points
+    ENC_CMD_LINE_WIDTH                  = 0x0E000000,   // [PG2 p130][PG34 p81] Specify the width of lines to be drawn
+    ENC_CMD_CLEAR_COLOR_A               = 0x0F000000,   // [PG2 p120][PG34 p75] Specify clear value for the alpha channel
+    ENC_CMD_COLOR_A                     = 0x10000000,   // [PG2 p124][PG34 p77] Set the current color alpha
+    ENC_CMD_CLEAR_STENCIL               = 0x11000000,   // [PG2 p122][PG34 p77] Specify clear value for the stencil buffer
+    ENC_CMD_CLEAR_TAG                   = 0x12000000,   // [PG2 p123][PG34 p77] Specify clear value for the tag buffer
+    ENC_CMD_STENCIL_MASK                = 0x13000000,   // [PG2 p140][PG34 p88] Control the writing of individual bits in stencil planes
+    ENC_CMD_TAG_MASK                    = 0x14000000,   // [PG2 p144][PG34 p90] Control the writing of the tag buffer
+    ENC_CMD_BITMAP_TRANSFORM_A          = 0x15000000,   // [PG2 p108][PG34 p68] Specify the A coefficient of the bitmap transform matrix
+    ENC_CMD_BITMAP_TRANSFORM_B          = 0x16000000,   // [PG2 p109][PG34 p69] Specify the B coefficient of the bitmap transform matrix
+    ENC_CMD_BITMAP_TRANSFORM_C          = 0x17000000,   // [PG2 p110][PG34 p69] Specify the C coefficient of the bitmap transform matrix
+    ENC_CMD_BITMAP_TRANSFORM_D          = 0x18000000,   // [PG2 p111][PG34 p70] Specify the D coefficient of the bitmap transform matrix
+    ENC_CMD_BITMAP_TRANSFORM_E          = 0x19000000,   // [PG2 p112][PG34 p70] Specify the D coefficient of the bitmap transform matrix
+    ENC_CMD_BITMAP_TRANSFORM_F          = 0x1A000000,   // [PG2 p113][PG34 p71] Specify the D coefficient of the bitmap transform matrix
+    ENC_CMD_SCISSOR_XY                  = 0x1B000000,   // [PG2 p138][PG34 p87] Specify the top left corner of the scissor clip rectangle
+    ENC_CMD_SCISSOR_SIZE                = 0x1C000000,   // [PG2 p137][PG34 p86] Specify the size of the scissor clip rectangle
+    ENC_CMD_CALL                        = 0x1D000000,   // [PG2 p116][PG34 p73] Execute a sequence at another location in the DL
+    ENC_CMD_JUMP                        = 0x1E000000,   // [PG2 p129][PG34 p81] Execute commands at another location in the display list
+    ENC_CMD_BEGIN                       = 0x1F000000,   // [PG2 p94] [PG34 p56] Begin drawing graphics primitive
+    ENC_CMD_COLOR_MASK                  = 0x20000000,   // [PG2 p125][PG34 p78] Enable or disable writing of color components
+    ENC_CMD_END                         = 0x21000000,   // [PG2 p128][PG34 p80] End drawing a graphics primitive
+    ENC_CMD_SAVE_CONTEXT                = 0x22000000,   // [PG2 p136][PG34 p85] Push the current graphics context on the context stack
+    ENC_CMD_RESTORE_CONTEXT             = 0x23000000,   // [PG2 p134][PG34 p84] Restore the current graphics context
+    ENC_CMD_RETURN                      = 0x24000000,   // [PG2 p135][PG34 p85] Return from a previous CALL command
+    ENC_CMD_MACRO                       = 0x25000000,   // [PG2 p131][PG34 p82] Execute a single command from a macro register
+    ENC_CMD_CLEAR                       = 0x26000000,   // [PG2 p118][PG34 p74] Clear buffers to preset values
+    ENC_CMD_VERTEX_FORMAT               = 0x27000000,   // [PG2 p147][PG34 p92] Set the precision of the VERTEX2F format
+    ENC_CMD_BITMAP_LAYOUT_H             = 0x28000000,   // [PG2 p103][PG34 p63] Specify 2 msb's of source bitmap memory format/layout
+    ENC_CMD_BITMAP_SIZE_H               = 0x29000000,   // [PG2 p105][PG34 p64] Specify 2 msb's of bitmap dimensions
+    ENC_CMD_PALETTE_SOURCE              = 0x2A000000,   // [PG2 p132][PG34 p83] Specify the base address of the palette
+    ENC_CMD_VERTEX_TRANSLATE_X          = 0x2B000000,   // [PG2 p148][PG34 p93] Specify the vertex transformations X translation component
+    ENC_CMD_VERTEX_TRANSLATE_Y          = 0x2C000000,   // [PG2 p149][PG34 p94] Specify the vertex transformations Y translation component
+    ENC_CMD_NOP                         = 0x2D000000,   // [PG2 p131][PG34 p82] No operation
+    ENC_CMD_BITMAP_EXT_FORMAT           = 0x2E000000,   //           [PG34 p57] Specify the extended format of the bitmap (EVE3/EVE4)
+    ENC_CMD_BITMAP_SWIZZLE              = 0x2F000000,   //           [PG34 p66] Set source for RGBA channels of a bitmap (EVE3/EVE4)
+    ENC_CMD_VERTEX2F                    = 0x40000000,   // [PG2 p145][PG34 p91] Start operations of graphics primitives at spec'd coordinates based on VERTEX_FORMAT ([PG*] encodes this as 1<<30)
+    ENC_CMD_VERTEX2II                   = 0x80000000,   // [PG2 p146][PG34 p92] Start operations of graphics primitives at spec'd coords in pixel precision ([PG*] encodes this as 2<<30)
+
+    // Co-processor commands
+    ENC_CMD_DLSTART                     = 0xFFFFFF00,   // [PG2 p162][PG34 p112]    Start new Display List
+    ENC_CMD_SWAP                        = 0xFFFFFF01,   // [PG2 p163][PG34 p114]    Swap current Display List
+    ENC_CMD_INTERRUPT                   = 0xFFFFFF02,   // [PG2 p164][PG34 p113]    Trigger interrupt CMDFLAG
+    //ENC_CMD_CRC                       = 0xFFFFFF03,   //                          (EVE1?)
+    //ENC_CMD_HAMMERAUX                 = 0xFFFFFF04,   //                          (EVE1?)
+    //ENC_CMD_MARCH                     = 0xFFFFFF05,   //                          (EVE1?)
+    //ENC_CMD_IDCT_DELETED              = 0xFFFFFF06,   //                          (EVE1?)
+    //ENC_CMD_EXECUTE                   = 0xFFFFFF07,   //                          (EVE1?)
+    //ENC_CMD_GETPOINT                  = 0xFFFFFF08,   //                          (EVE1?)
+    ENC_CMD_BGCOLOR                     = 0xFFFFFF09,   // [PG2 p184][PG34 p130]    Set background color
+    ENC_CMD_FGCOLOR                     = 0xFFFFFF0A,   // [PG2 p183][PG34 p129]    Set foreground color
+    ENC_CMD_GRADIENT                    = 0xFFFFFF0B,   // [PG2 p193][PG34 p134]    Draw a smooth color gradient
+    ENC_CMD_TEXT                        = 0xFFFFFF0C,   // [PG2 p213][PG34 p148]    Draw text string
+#ifdef ARDUINO
+    ENC_CMD_TEXTF                       = 0xFFFFFF0C,   // [PG2 p213][PG34 p148]    Draw text string (Alias for use with program memory string)
+#endif
+    ENC_CMD_BUTTON                      = 0xFFFFFF0D,   // [PG2 p176][PG34 p125]    Draw a button
+    ENC_CMD_KEYS                        = 0xFFFFFF0E,   // [PG2 p196][PG34 p137]    Draw a row of keys
+    ENC_CMD_PROGRESS                    = 0xFFFFFF0F,   // [PG2 p200][PG34 p140]    Draw a progress bar
+    ENC_CMD_SLIDER                      = 0xFFFFFF10,   // [PG2 p205][PG34 p143]    Draw a slider
+    ENC_CMD_SCROLLBAR                   = 0xFFFFFF11,   // [PG2 p203][PG34 p141]    Draw a scrollbar
+    ENC_CMD_TOGGLE                      = 0xFFFFFF12,   // [PG2 p210][PG34 p146]    Draw a toggle switch
+    ENC_CMD_GAUGE                       = 0xFFFFFF13,   // [PG2 p187][PG34 p131]    Draw a gauge
+    ENC_CMD_CLOCK                       = 0xFFFFFF14,   // [PG2 p179][PG34 p126]    Draw an analog clock
+    ENC_CMD_CALIBRATE                   = 0xFFFFFF15,   // [PG2 p227][PG34 p159]    Interactive touch screen calibration
+    ENC_CMD_SPINNER                     = 0xFFFFFF16,   // [PG2 p229][PG34 p161]    Show an animated spinner
+    ENC_CMD_STOP                        = 0xFFFFFF17,   // [PG2 p236][PG34 p164]    Stop SKETCH, SPINNER or SCREENSAVER
+    ENC_CMD_MEMCRC                      = 0xFFFFFF18,   // [PG2 p173][PG34 p123]    Compute CRC-32 of given RAM_G memory block
+    ENC_CMD_REGREAD                     = 0xFFFFFF19,   // [PG2 p166][PG34 p115]    Read a register value
+    ENC_CMD_MEMWRITE                    = 0xFFFFFF1A,   // [PG2 p167][PG34 p115]    Write memory or registers
+    ENC_CMD_MEMSET                      = 0xFFFFFF1B,   // [PG2 p175][PG34 p124]    Fill block of memory with byte value
+    ENC_CMD_MEMZERO                     = 0xFFFFFF1C,   // [PG2 p174][PG34 p123]    Fill block of memory with zeros
+    ENC_CMD_MEMCPY                      = 0xFFFFFF1D,   // [PG2 p176][PG34 p124]    Copy block of memory
+    ENC_CMD_APPEND                      = 0xFFFFFF1E,   // [PG2 p165][PG34 p114]    Append more commands from RAM_G
+    ENC_CMD_SNAPSHOT                    = 0xFFFFFF1F,   // [PG2 p245][PG34 p171]    Take a snapshot of the current screen
+    //ENC_CMD_TOUCH_TRANSFORM           = 0xFFFFFF20,   //                          (EVE1?)
+    ENC_CMD_BITMAP_TRANSFORM            = 0xFFFFFF21,   //           [PG34 p188]    Perform bitmap transformation based on 3 points
+    ENC_CMD_INFLATE                     = 0xFFFFFF22,   // [PG2 p168][PG34 p116]    Decompress data in RAM_G
+    ENC_CMD_GETPTR                      = 0xFFFFFF23,   // [PG2 p222][PG34 p153]    Returns first unallocated memory location
+    ENC_CMD_LOADIMAGE                   = 0xFFFFFF24,   // [PG2 p169][PG34 p117]    Load JPEG or PNG image into an EVE bitmap in RAM_G
+    ENC_CMD_GETPROPS                    = 0xFFFFFF25,   // [PG2 p223][PG34 p154]    Returns address and size of bitmap from LOADIMAGE
+    ENC_CMD_LOADIDENTITY                = 0xFFFFFF26,   // [PG2 p220][PG34 p152]    Set the current matrix to the identity matrix
+    ENC_CMD_TRANSLATE                   = 0xFFFFFF27,   // [PG2 p226][PG34 p158]    Apply a translation to the current matrix
+    ENC_CMD_SCALE                       = 0xFFFFFF28,   // [PG2 p223][PG34 p155]    Apply a scale to the current matrix
+    ENC_CMD_ROTATE                      = 0xFFFFFF29,   // [PG2 p225][PG34 p156]    Apply a rotation to the current matrix
+    ENC_CMD_SETMATRIX                   = 0xFFFFFF2A,   // [PG2 p220][PG34 p152]    Assign current matrix values to graphics engine
+    ENC_CMD_SETFONT                     = 0xFFFFFF2B,   // [PG2 p237][PG34 p165]    Register custom-designed font to co-processor
+    ENC_CMD_TRACK                       = 0xFFFFFF2C,   // [PG2 p240][PG34 p168]    Track touches for a graphic object
+    ENC_CMD_DIAL                        = 0xFFFFFF2D,   // [PG2 p207][PG34 p144]    Draw a rotary dial control
+    ENC_CMD_NUMBER                      = 0xFFFFFF2E,   // [PG2 p217][PG34 p151]    Draw a number
+    ENC_CMD_SCREENSAVER                 = 0xFFFFFF2F,   // [PG2 p233][PG34 p162]    Start an animated screen saver
+    ENC_CMD_SKETCH                      = 0xFFFFFF30,   // [PG2 p234][PG34 p163]    Let user sketch a drawing with the touch panel
+    ENC_CMD_LOGO                        = 0xFFFFFF31,   // [PG2 p249][PG34 p174]    Show FTDI or Bridgetek logo animation
+    ENC_CMD_COLDSTART                   = 0xFFFFFF32,   // [PG2 p163][PG34 p113]    Set the co-processor to the default reset states
+    ENC_CMD_GETMATRIX                   = 0xFFFFFF33,   // [PG2 p221][PG34 p153]    Retrieve the current graphics engine matrix
+    ENC_CMD_GRADCOLOR                   = 0xFFFFFF34,   // [PG2 p185][PG34 p130]    Set 3D button highlight color
+    ENC_CMD_CSKETCH                     = 0xFFFFFF35,   // [PG2 p249]               Let user sketch a drawing with resistive touch screen (deprecated)(EVE2)
+    ENC_CMD_SETROTATE                   = 0xFFFFFF36,   // [PG2 p228][PG34 p160]    Rotate the screen
+    ENC_CMD_SNAPSHOT2                   = 0xFFFFFF37,   // [PG2 p246][PG34 p171]    Take a snapshot of part of the screen
+    ENC_CMD_SETBASE                     = 0xFFFFFF38,   // [PG2 p216][PG34 p150]    Set the base for number output
+    ENC_CMD_MEDIAFIFO                   = 0xFFFFFF39,   // [PG2 p170][PG34 p120]    Set up a streaming media FIFO in RAM_G
+    ENC_CMD_PLAYVIDEO                   = 0xFFFFFF3A,   // [PG2 p171][PG34 p120]    Play back MJPEG-encoded video
+    ENC_CMD_SETFONT2                    = 0xFFFFFF3B,   // [PG2 p237][PG34 p165]    Set custom-designed font to co-processor with extended parameters
+    ENC_CMD_SETSCRATCH                  = 0xFFFFFF3C,   // [PG2 p239][PG34 p166]    Set scratch bitmap handle for widget use
+    //ENC_CMD_INT_RAMSHARED             = 0xFFFFFF3D,   //                          Unknown (not in [PG*])
+    //ENC_CMD_INT_SWLOADIMAGE           = 0xFFFFFF3E,   //                          Unknown (not in [PG*])
+    ENC_CMD_ROMFONT                     = 0xFFFFFF3F,   // [PG239 p2][PG34 p167]    Load a ROM font into a bitmap handle
+    ENC_CMD_VIDEOSTART                  = 0xFFFFFF40,   // [PG2 p172][PG34 p121]    Initialize video frame decoder
+    ENC_CMD_VIDEOFRAME                  = 0xFFFFFF41,   // [PG2 p172][PG34 p122]    Load next frame of video
+    ENC_CMD_SYNC                        = 0xFFFFFF42,   //           [PG34 p187]    Wait for the end of the video scan out (EVE3/EVE4)
+    ENC_CMD_SETBITMAP                   = 0xFFFFFF43,   // [PG2 p247][PG34 p173]    Generate Display List commands for a bitmap
+    ENC_CMD_FLASHERASE                  = 0xFFFFFF44,   //           [PG34 p174]    Erase flash storage (EVE3/EVE4)
+    ENC_CMD_FLASHWRITE                  = 0xFFFFFF45,   //           [PG34 p174]    Write data from host to flash storage (EVE3/EVE4)
+    ENC_CMD_FLASHREAD                   = 0xFFFFFF46,   //           [PG34 p176]    Read data from flash to RAM_G (EVE3/EVE4)
+    ENC_CMD_FLASHUPDATE                 = 0xFFFFFF47,   //           [PG34 p177]    Write given data from RAM_G to flash, erasing and skipping as needed (EVE3/EVE4)
+    ENC_CMD_FLASHDETACH                 = 0xFFFFFF48,   //           [PG34 p177]    Put flash storage SPI lines into hi-Z mode (EVE3/EVE4)
+    ENC_CMD_FLASHATTACH                 = 0xFFFFFF49,   //           [PG34 p178]    Reconnect to the flash storage via SPI (EVE3/EVE4)
+    ENC_CMD_FLASHFAST                   = 0xFFFFFF4A,   //           [PG34 p178]    Drive the flash storage in full-speed mode if possible (EVE3/EVE4)
+    ENC_CMD_FLASHSPIDESEL               = 0xFFFFFF4B,   //           [PG34 p179]    De-assert SPI CS for the flash storage device (EVE3/EVE4)
+    ENC_CMD_FLASHSPITX                  = 0xFFFFFF4C,   //           [PG34 p179]    Transmit data from host to flash storage SPI interface (EVE3/EVE4)
+    ENC_CMD_FLASHSPIRX                  = 0xFFFFFF4D,   //           [PG34 p179]    Receive data from flash storage SPI interface to RAM_G (EVE3/EVE4)
+    ENC_CMD_FLASHSOURCE                 = 0xFFFFFF4E,   //           [PG34 p181]    Specify source address for flash storage data (EVE3/EVE4)
+    ENC_CMD_CLEARCACHE                  = 0xFFFFFF4F,   //           [PG34 p180]    Clear graphics engine cache after changes in flash storage (EVE3/EVE4)
+    ENC_CMD_INFLATE2                    = 0xFFFFFF50,   //           [PG34 p117]    Decompress data in RAM_G with options (EVE3/EVE4)
+    ENC_CMD_ROTATEAROUND                = 0xFFFFFF51,   //           [PG34 p157]    Apply a rotation around a specified coordinate (EVE3/EVE4)
+    ENC_CMD_RESETFONTS                  = 0xFFFFFF52,   //           [PG34 p167]    Load bitmap handles 16-31 with their default fonts (EVE3/EVE4)
+    ENC_CMD_ANIMSTART                   = 0xFFFFFF53,   //           [PG34 p181]    Start an animation from flash storage (EVE3/EVE4)
+    ENC_CMD_ANIMSTOP                    = 0xFFFFFF54,   //           [PG34 p184]    Stop an animation or all animations (EVE3/EVE4)
+    ENC_CMD_ANIMXY                      = 0xFFFFFF55,   //           [PG34 p185]    Set the coordinates of an animation (EVE3/EVE4)
+    ENC_CMD_ANIMDRAW                    = 0xFFFFFF56,   //           [PG34 p185]    Draw one or more active animations (EVE3/EVE4)
+    ENC_CMD_GRADIENTA                   = 0xFFFFFF57,   //           [PG34 p136]    Draw smooth color gradient with transparency (EVE3/EVE4)
+    ENC_CMD_FILLWIDTH                   = 0xFFFFFF58,   //           [PG34 p147]    Set the pixel fill width for various commands (EVE3/EVE4)
+    EMC_CMD_APPENDF                     = 0xFFFFFF59,   //           [PG34 p176]    Append data from flash storage to Display List (EVE3/EVE4)
+    ENC_CMD_ANIMFRAME                   = 0xFFFFFF5A,   //           [PG34 p185]    Draw the specified frame of an animation (EVE3/EVE4)
+    //ENC_CMD_NOPCMD                    = 0xFFFFFF5B,   //                          No operation; renamed from "NOP" because of conflict with NOP DL command (Not in [PG*])
+    //ENC_CMD_SHA1                      = 0xFFFFFF5C,   //                          Calculate SHA1 hash? (Not in [PG*])
+    //ENC_CMD_HMAC                      = 0xFFFFFF5D,   //                          Calculate HMAC hash? (Not in [PG*])
+    //EMC_CMD_LAST                      = 0xFFFFFF5E,   //                          Unknown (Not in [PG*])
+    ENC_CMD_VIDEOSTARTF                 = 0xFFFFFF5F,   //           [PG34 p181]    Initialize video frame decoder from flash storage (EVE3/EVE4)
+    ENC_CMD_CALIBRATESUB                = 0xFFFFFF60,   //           [PG34 p159]    Execute touch screen calibration for a sub-window (EVE3/EVE4)
+    ENC_CMD_TESTCARD                    = 0xFFFFFF61,   //           [PG34 p189]    Load a Display List with a test card graphic (EVE4)
+    ENC_CMD_HSF                         = 0xFFFFFF62,   //           [PG34 p195]    Non-square pixel correction (EVE4)
+    ENC_CMD_APILEVEL                    = 0xFFFFFF63,   //           [PG34 p112]    Set the co-processor API level (EVE4)
+    ENC_CMD_GETIMAGE                    = 0xFFFFFF64,   //           [PG34 p194]    Get attributes of bitmap loaded previously (EVE4)
+    ENC_CMD_WAIT                        = 0xFFFFFF65,   //           [PG34 p190]    Wait for specified number of microseconds (EVE4)
+    ENC_CMD_RETURNCMD                   = 0xFFFFFF66,   //           [PG34 p192]    End execution of a command list; renamed from "RETURN" because of conflict with DL command) (EVE4)
+    ENC_CMD_CALLLIST                    = 0xFFFFFF67,   //           [PG34 p192]    Call a command list in RAM_G (EVE4)
+    ENC_CMD_NEWLIST                     = 0xFFFFFF68,   //           [PG34 p190]    Start a command list in RAM_G (EVE4)
+    ENC_CMD_ENDLIST                     = 0xFFFFFF69,   //           [PG34 p191]    Terminate command list in RAM_G (EVE4)
+    ENC_CMD_PCLKFREQ                    = 0xFFFFFF6A,   //           [PG34 p196]    Generate pixel clock as close as possible to the one requested (EVE4)
+    ENC_CMD_FONTCACHE                   = 0xFFFFFF6B,   //           [PG34 p193]    Enable font cache for extended flash-based fonts (EVE4)
+    ENC_CMD_FONTCACHEQUERY              = 0xFFFFFF6C,   //           [PG34 p194]    Query the capacity and utilization of the font cache (EVE4)
+    ENC_CMD_ANIMFRAMERAM                = 0xFFFFFF6D,   //           [PG34 p186]    Draw a specified frame of an animation from RAM_G (EVE4)
+    ENC_CMD_ANIMSTARTRAM                = 0xFFFFFF6E,   //           [PG34 p182]    Start an animation from RAM_G (EVE4)
+    ENC_CMD_RUNANIM                     = 0xFFFFFF6F,   //           [PG32 p183]    Wait until run-once animation is complete (EVE4)
+    ENC_CMD_FLASHPROGRAM                = 0xFFFFFF70,   //           [PG34 p175]    Write data from RAM_G to flash storage (EVE3/EVE4)
+  };
+
+  // Alpha test function for ALPHA_FUNC (ProgGuide 4.4 p.92)
+  // and STENCIL_FUNC (ProgGuide 4.42 p.139)
+  // See ProgGuide Table 5 p.92.
+  typedef enum
+  {
+    FUNC_NEVER                          = 0,
+    FUNC_LESS                           = 1,
+    FUNC_LEQUAL                         = 2,
+    FUNC_GREATER                        = 3,
+    FUNC_GEQUAL                         = 4,
+    FUNC_EQUAL                          = 5,
+    FUNC_NOTEQUAL                       = 6,
+    FUNC_ALWAYS                         = 7,
+  }   FUNC;
+
+  // Graphics primitive operations for BEGIN (ProgGuide 4.5 Table 6 p.94)
+  typedef enum
+  {
+    BEGIN_BITMAPS                       = 1,
+    BEGIN_POINTS                        = 2,
+    BEGIN_LINES                         = 3,
+    BEGIN_LINE_STRIP                    = 4,
+    BEGIN_EDGE_STRIP_R                  = 5,
+    BEGIN_EDGE_STRIP_L                  = 6,
+    BEGIN_EDGE_STRIP_A                  = 7,
+    BEGIN_EDGE_STRIP_B                  = 8,
+    BEGIN_RECTS                         = 9,
+  }   BEGIN;
+
+  // Bitmap format for BITMAP_LAYOUT (ProgGuide 4.7 Table 7 p.97)
+  typedef enum
+  {
+    FORMAT_ARGB1555                     = 0,
+    FORMAT_L1                           = 1,
+    FORMAT_L4                           = 2,
+    FORMAT_L8                           = 3,
+    FORMAT_RGB332                       = 4,
+    FORMAT_ARGB2                        = 5,
+    FORMAT_ARGB4                        = 6,
+    FORMAT_RGB565                       = 7,
+    FORMAT_TEXT8X8                      = 9,
+    FORMAT_TEXTVGA                      = 10,
+    FORMAT_BARGRAPH                     = 11,
+    FORMAT_PALETTED565                  = 14,
+    FORMAT_PALETTED4444                 = 15,
+    FORMAT_PALETTED8                    = 16,
+    FORMAT_L2                           = 17,
+
+    FORMAT_ARGB8                        = 0x20,         // Used by SNAPSHOT2 only
+
+    COMPRESSED_RGBA_ASTC_4x4_KHR        = 37808,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_5x4_KHR        = 37809,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_5x5_KHR        = 37810,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_6x5_KHR        = 37811,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_6x6_KHR        = 37812,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_8x5_KHR        = 37813,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_8x6_KHR        = 37814,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_8x8_KHR        = 37815,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_10x5_KHR       = 37816,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_10x6_KHR       = 37817,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_10x8_KHR       = 37818,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_10x10_KHR      = 37819,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_12x10_KHR      = 37820,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    COMPRESSED_RGBA_ASTC_12x12_KHR      = 37821,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+
+  }   FORMAT;
+
+  // Bitmap filtering mode for BITMAP_SIZE (ProgGuide 4.9 p.103)
+  enum FILTER
+  {
+    FILTER_NEAREST                      = 0,
+    FILTER_BILINEAR                     = 1,
+  };
+
+  // Bitmap wrap mode for BITMAP_SIZE (ProgGuide 4.9 p.103)
+  enum WRAP
+  {
+    WRAP_BORDER                         = 0,
+    WRAP_REPEAT                         = 1,
+  };
+
+  // Blending factor for BLEND_FUNC (ProgGuide 4.18 Table 8 p.114)
+  enum BLEND
+  {
+    BLEND_ZERO                          = 0,
+    BLEND_ONE                           = 1,
+    BLEND_SRC_ALPHA                     = 2,
+    BLEND_DST_ALPHA                     = 3,
+    BLEND_ONE_MINUS_SRC_ALPHA           = 4,
+    BLEND_ONE_MINUS_DST_ALPHA           = 5,
+  };
+
+  // Stencil operations for STENCIL_OP (ProgGuide 4.44 Figure 10 p.141)
+  enum STENCIL
+  {
+    STENCIL_ZERO                        = 0,
+    STENCIL_KEEP                        = 1,
+    STENCIL_REPLACE                     = 2,
+    STENCIL_INCR                        = 3,
+    STENCIL_DECR                        = 4,
+    STENCIL_INVERT                      = 5,
+  };
+
+  // Options for co-processor commands (ProgGuide 5.8 p.158)
+  // NOTE: These are flags; they may be combined.
+  // Remarks show commands for which the options are valid
+  enum OPT {
+    OPT_NONE                            = 0x0000,
+    OPT_3D                              = 0x0000,       // BUTTON, CLOCK, KEYS, GAUGE, SLIDER, DIAL, TOGGLE, PROGRESS, SCROLLBAR
+    OPT_RGB565                          = 0x0000,       // LOADIMAGE
+    OPT_MONO                            = 0x0001,       // LOADIMAGE
+    OPT_NODL                            = 0x0002,       // LOADIMAGE
+    OPT_NOTEAR                          = 0x0004,       // PLAYVIDEO
+    OPT_FULLSCREEN                      = 0x0008,       // PLAYVIDEO
+    OPT_MEDIAFIFO                       = 0x0010,       // PLAYVIDEO
+    OPT_SOUND                           = 0x0020,       // PLAYVIDEO
+    OPT_FLAT                            = 0x0100,       // BUTTON, CLOCK, KEYS, GAUGE, SLIDER, DIAL, TOGGLE, PROGRESS, SCROLLBAR
+    OPT_SIGNED                          = 0x0100,       // NUMBER
+    OPT_CENTERX                         = 0x0200,       // KEYS, TEXT, NUMBER
+    OPT_CENTERY                         = 0x0400,       // KEYS, TEXT, NUMBER
+    OPT_CENTER                          = 0x0600,       // KEYS, TEXT, NUMBER
+    OPT_RIGHTX                          = 0x0800,       // KEYS, TEXT, NUMBER
+    OPT_NOBACK                          = 0x1000,       // CLOCK, GAUGE
+    OPT_FORMAT                          = 0x1000,       // TEXT, BUTTON, TOGGLE (EVE3/EVE4)
+    OPT_NOTICKS                         = 0x2000,       // CLOCK, GAUGE
+    OPT_FILL                            = 0x2000,       // TEXT, BUTTON (EVE3/EVE4)
+    OPT_NOHM                            = 0x4000,       // CLOCK
+    OPT_NOPOINTER                       = 0x4000,       // GAUGE
+    OPT_NOSECS                          = 0x8000,       // CLOCK
+    OPT_NOHANDS                         = 0xC000,       // CLOCK
+  }; // 16 bits
+
+  // Values for REG_DLSWAP (see ProgGuide p.30)
+  enum DLSWAP {
+    // Don't store this value; wait until the register is this value
+    // before storing another value.
+    DLSWAP_DONE                         = 0x0,
+
+    DLSWAP_LINE                         = 0x1,          // Start reading from current DL after current line
+    DLSWAP_FRAME                        = 0x2,          // Start reading from current DL after current frame
+  }; // 2 bits
+
+  // Values for REG_SPI_WIDTH [PG2 p88][PG34 p50]
+  enum SPIWIDTH {
+    SPIWIDTH_SINGLE                     = 0x0,          // Single SPI
+    SPIWIDTH_DUAL                       = 0x1,          // Dual SPI
+    SPIWIDTH_QUAD                       = 0x2,          // Quad SPI
+
+    SPIWIDTH_EXTRA_DUMMY                = 0x4,          // Flag: Two dummy bytes for reads
+  }; // 3 bits
+
+  // Values for REG_INT_EN and REG_INT_FLAGS (see Datasheet 4.1.6 p.20)
+  // NOTE: These are flags; they may be combined.
+  enum INT // 8 bits (EVE2/EVE3), 9 bits (EVE4)
+  {
+    // [DS2 p20][DS3 p19]
+    INT_SWAP                            = 0x001,        // DL swap occurred
+    INT_TOUCH                           = 0x002,        // Touch detected
+    INT_TAG                             = 0x004,        // Touch screen tag value changed
+    INT_SOUND                           = 0x008,        // Sound effect ended
+    INT_PLAYBACK                        = 0x010,        // Audio playback ended
+    INT_CMDEMPTY                        = 0x020,        // Command FIFO empty
+    INT_CMDFLAG                         = 0x040,        // Flag set by command
+    INT_CONVCOMPLETE                    = 0x080,        // Touch screen conversion complete
+    INT_UNDERRUN                        = 0x100,        // (EVE4 only) Graphics pipeline underrun
+
+    //INT_L8C                           = 0x0C,         // 
+    //INT_VGA                           = 0x0D,         // 
+    //INT_G8                            = 0x12,         // 
+  }; // 8 bits
+
+  // Values for REG_PLAYBACK_FORMAT (see ProgGuide p.40)
+  enum SAMPLES {
+    SAMPLES_LINEAR                      = 0x0,          // Linear audio samples
+    SAMPLES_ULAW                        = 0x1,          // uLaw audio samples
+    SAMPLES_ADPCM                       = 0x2,          // IMA ADPCM audio samples
+  }; // 2 bits
+
+  // Values for REG_TOUCH_MODE (see ProgGuide p.58)
+  enum TOUCHMODE {
+    TOUCHMODE_OFF                       = 0x0,          // Touch mode off
+    TOUCHMODE_ONESHOT                   = 0x1,          // Read one touch sample
+    TOUCHMODE_FRAME                     = 0x2,          // Read one touch sample each frame
+    TOUCHMODE_CONTINUOUS                = 0x3,          // Continuous touch mode up to 1000 Hz
+  }; // 2 bits
+
+  // Values for CMD_APILEVEL (EVE4 only)
+  enum APILEVEL
+  {
+    APILEVEL_BT815                      = 1,            // BT815 (EVE3) mode
+    APILEVEL_BT817_BT818                = 2,            // BT817/818 (EVE4) mode
+  };
+
+  // Values for CMD_ANIMSTART (EVE4 only)
+  //
+  // Not documented; found in EVE_defines.h from Bridgetek.
+  enum ANIM
+  {
+    ANIM_ONCE                           = 0,            // Play animation once
+    ANIM_LOOP                           = 1,            // Keep looping
+    ANIM_HOLD                           = 2,            // Hold
+  };
+
+  //-------------------------------------------------------------------------
+  // Power modes (see SetPowerMode)
+  enum POWERMODE
+  {
+    POWERMODE_ACTIVE,                                   // Running
+    POWERMODE_STANDBY,                                  // Clock stopped, PLL running
+    POWERMODE_SLEEP,                                    // Clock and PLL stopped
+  };
+
+  //-------------------------------------------------------------------------
+  // Progress of the initialization (see BeginStep)
+  enum BEGINSTEP
+  {
+    BEGINSTEP_PENDING,                                  // Call again later
+    BEGINSTEP_DONE,                                     // Display initialized
+    BEGINSTEP_FAILED,                                   // Initialization failed
+  };
+
+  //-------------------------------------------------------------------------
+  // Internal state of BeginStep
+  enum BOOT
+  {
+    BOOT_START,                                         // Reset the EVE
+    BOOT_POWER_ON,                                      // Power on after reset
+    BOOT_CLOCK,                                         // Start the clock
+    BOOT_WAIT_ID,                                       // Poll REG_ID
+    BOOT_WAIT_RESET,                                    // Poll REG_CPURESET
+    BOOT_DONE,                                          // Finished
+    BOOT_FAILED,                                        // Failed
+  };
+
+  //-------------------------------------------------------------------------
+  // Graphics state that's tracked by the shadow state (see
+  // CmdSetShadowState)
+  enum SHADOW
+  {
+    SHADOW_COLOR_RGB,                                   // COLOR_RGB
+    SHADOW_COLOR_A,                                     // COLOR_A
+    SHADOW_LINE_WIDTH,                                  // LINE_WIDTH
+    SHADOW_POINT_SIZE,                                  // POINT_SIZE
+    SHADOW_BEGIN,                                       // BEGIN
+    SHADOW_BITMAP_HANDLE,                               // BITMAP_HANDLE
+    SHADOW_CELL,                                        // CELL
+    SHADOW_VERTEX_FORMAT,                               // VERTEX_FORMAT
+    SHADOW_VERTEX_TRANSLATE_X,                          // VERTEX_TRANSLATE_X
+    SHADOW_VERTEX_TRANSLATE_Y,                          // VERTEX_TRANSLATE_Y
+
+    SHADOW_COUNT
+  };
+
+  // Value for unknown state in the shadow state
+  const static uint32_t SHADOW_UNKNOWN = 0xFFFFFFFFUL;
+
+  //=========================================================================
+  // DATA MEMBERS
+  //=========================================================================
+
+protected:
+  const SteveDisplay
+                   &_profile;           // Display init parameters
+  HAL              &_hal;               // Communication functions
+
+  // Cached constants
+  const uint16_t    _hcenter;           // Horizontal center in pixels
+  const uint16_t    _vcenter;           // Vertical center in pixels_
+
+  // State variables
+  SteveDisplay::CHIPID
+                    _chipid;            // Chip ID detected by Begin
+  SteveHAL::BUSWIDTH
+                    _bus_width;         // Current SPI bus width
+  uint8_t           _read_dummies;      // Number of dummy bytes for reads
+  SteveDisplay::CLKSEL
+                    _clksel;            // Current clock multiplier
+  POWERMODE         _power_mode;        // Current power mode
+  BOOT              _boot;              // State of BeginStep
+  uint8_t           _boot_tries;        // Number of polls in BeginStep
+  uint8_t           _boot_wait;         // Time to wait in ms, 0=none
+  uint32_t          _boot_time;         // Micros at start of wait
+  bool              _cmd_bulk;          // True=write cmds to REG_CMDB_WRITE
+  CmdIndex          _cmd_index;         // Graphics engine cmd write index
+                                        //   (offset from RAM_CMD)
+  uint16_t          _cmd_space;         // Known free space in cmd queue
+  uint16_t          _cmd_read;          // Last known REG_CMD_READ value
+                                        //   READ_INDEX_ERROR=unknown
+  DLIndex           _dl_index;          // Display list write index
+                                        //   (offset from RAM_DL)
+  bool              _cmd_stream;        // True=write transaction is open
+                                        //   at RAM_CMD + _cmd_index
+  bool              _dl_stream;         // True=write transaction is open
+                                        //   at RAM_DL + _dl_index
+  bool              _dl_burst;          // True=DLAdd streams or buffers
+  bool              _dl_swap_pending;   // True=REG_DLSWAP may be busy
+  uint32_t         *_dl_buffer;         // Host DL buffer, NULL=none
+  uint16_t          _dl_buffer_size;    // Size of host buffer in words
+  uint16_t          _dl_buffered;       // Number of words in host buffer
+  CmdStaging       *_staging;           // Staging buffer, NULL=none
+  CmdIndex          _staging_index;     // Cmd index of first staged byte
+  uint16_t          _int_mask;          // Enabled interrupts (INT values)
+  uint16_t          _int_flags;         // Interrupt flags read but not
+                                        //   handled yet
+  uint32_t          _cmd_sent_total;    // Total bytes sent to the queue
+  uint32_t          _cmd_done_total;    // Total bytes read by co-processor
+                                        //   (last known)
+  uint32_t          _frame_end[FRAMES_IN_FLIGHT];
+                                        // _cmd_sent_total after each
+                                        //   submitted frame, oldest first
+  uint8_t           _frames_pending;    // Number of frames in flight
+  uint8_t           _cmd_epoch;         // Incremented when queue is reset
+  ListCache        *_lists;             // Command list cache, NULL=none
+  uint8_t           _restore_list;      // List called by CmdRecover
+  uint32_t          _fifo_address;      // Media FIFO address in RAM_G
+  uint32_t          _fifo_size;         // Media FIFO size, 0=none
+  uint32_t          _fifo_write;        // Media FIFO write offset
+  bool              _shadow_enabled;    // True=drop redundant state cmds
+  uint32_t          _shadow[SHADOW_COUNT];
+                                        // Last state commands that were
+                                        //   sent, SHADOW_UNKNOWN=unknown
+  bool              _dedup_enabled;     // True=skip repeated frames
+  bool              _dedup_armed;       // True=DLSTART seen in staging
+  bool              _dedup_skipped;     // True=last frame was skipped
+  CmdIndex          _dedup_start;       // Cmd index of DLSTART
+  uint32_t          _dedup_hash;        // Hash of last submitted frame
+  CmdIndex          _dedup_exclude[DEDUP_EXCLUDES][2];
+                                        // Ranges not compared (start/end)
+  uint8_t           _dedup_excludes;    // Number of ranges not compared
+#if STEVE_STATS
+  Stats             _stats;             // Transport statistics
+  uint32_t          _stats_frame_start; // _bytes_sent at start of frame
+#endif
+
+  //=========================================================================
+  // CONSTRUCTOR
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveT(
+    const SteveDisplay &profile,        // Display profile
+    HAL &hal)                           // Hardware functions
+    : _profile(profile)
+    , _hal(hal)
+    , _hcenter(profile._hsize / 2)
+    , _vcenter(profile._vsize / 2)
+    , _chipid(SteveDisplay::CHIPID_ANY)
+    , _bus_width(SteveHAL::BUSWIDTH_SINGLE)
+    , _read_dummies(1)
+    , _clksel(profile._clksel)
+    , _power_mode(POWERMODE_ACTIVE)
+    , _boot(BOOT_START)
+    , _boot_tries(0)
+    , _boot_wait(0)
+    , _boot_time(0)
+    , _cmd_bulk(false)
+    , _cmd_index()
+    , _cmd_space(0)
+    , _cmd_read(READ_INDEX_ERROR)
+    , _dl_index()
+    , _cmd_stream(false)
+    , _dl_stream(false)
+    , _dl_burst(false)
+    , _dl_swap_pending(false)
+    , _dl_buffer(NULL)
+    , _dl_buffer_size(0)
+    , _dl_buffered(0)
+    , _staging(NULL)
+    , _staging_index()
+    , _int_mask(0)
+    , _int_flags(0)
+    , _cmd_sent_total(0)
+    , _cmd_done_total(0)
+    , _frames_pending(0)
+    , _cmd_epoch(0)
+    , _lists(NULL)
+    , _restore_list(INVALID_LIST)
+    , _fifo_address(0)
+    , _fifo_size(0)
+    , _fifo_write(0)
+    , _shadow_enabled(false)
+    , _dedup_enabled(false)
+    , _dedup_armed(false)
+    , _dedup_skipped(false)
+    , _dedup_start()
+    , _dedup_hash(0)
+    , _dedup_excludes(0)
+  {
+    ShadowReset();
+    ResetStats();
+  }
+
+  //=========================================================================
+  // CONST FUNCTIONS TO ACCESS DISPLAY PARAMETERS
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Get a pointer to the profile
+  const SteveDisplay *Profile() const
+  {
+    return &_profile;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the chip ID that was detected by Begin
+  //
+  // The chip ID can only be read from the chip right after it's reset, so
+  // this returns the value that was read during Begin.
+  SteveDisplay::CHIPID                  // Returns chip ID, ANY=unknown
+  ChipId() const
+  {
+    return _chipid;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get display width
+  uint16_t                              // Returns width in pixels
+  Width() const
+  {
+    return _profile._hsize;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get display height
+  uint16_t                              // Returns height in pixels
+  Height() const
+  {
+    return _profile._vsize;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get horizontal center
+  uint16_t                              // Returns horizontal center (pixels)
+  HCenter() const
+  {
+    return _hcenter;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get vertical center
+  uint16_t                              // Returns vertical center (pixels)
+  VCenter() const
+  {
+    return _vcenter;
+  }
+
+  //=========================================================================
+  // LOW-LEVEL INIT/EXIT
+  //=========================================================================
+
+protected:
+  //-------------------------------------------------------------------------
+  // Early initialization virtual function
+  //
+  // This gets called by Begin after starting the chip but before
+  // initializing the timing registers.
+  // Specific subclasses can use this to work around bugs.
+  virtual bool                          // Returns true=success false=failure
+  EarlyInit()
+  {
+    // EVE_Init_Goodix_GT911()
+    // EVE_Init_Pen_Up_Bug_Fix()
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Touch screen initialization
+  //
+  // This gets called by Begin to initialize the touch screen and
+  // work around bugs.
+  // The implementation here switches the touch functionality off. This
+  // can be used for projects that don't require touch, regardless of
+  // whether the EVE has touch screen support.
+  virtual bool                          // Returns true=success false=failure
+  TouchInit()
+  {
+    // Disable touch
+    RegWrite8(REG_TOUCH_MODE, 0);
+    // Eliminate any false touches
+    RegWrite16(REG_TOUCH_RZTHRESH, 0);
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Check if a value is one of the known chip IDs
+  static bool                           // Returns true=known chip
+  IsKnownChipId(
+    uint32_t chipid)                    // Value from REG_CHIP_ID
+  {
+    switch (chipid)
+    {
+    case SteveDisplay::CHIPID_FT810:
+    case SteveDisplay::CHIPID_FT811:
+    case SteveDisplay::CHIPID_FT812:
+    case SteveDisplay::CHIPID_FT813:
+    case SteveDisplay::CHIPID_BT815:
+    case SteveDisplay::CHIPID_BT816:
+    case SteveDisplay::CHIPID_BT817:
+    case SteveDisplay::CHIPID_BT818:
+      return true;
+
+    default:
+      return false;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Set up communication with a running EVE chip
+  //
+  // This is used by Begin and WarmBegin after the chip is running. It
+  // reads and checks the chip ID, switches to the widest SPI bus width,
+  // and synchronizes the command queue index with the EVE.
+  //
+  // The chip ID is in RAM_G, and it's only valid right after a reset; on a
+  // running display, the application may have overwritten it. So for a
+  // warm start, a value that isn't a known chip ID is ignored, and the ID
+  // from the profile is used instead. If the profile doesn't have one, the
+  // chip can't be identified and the function fails.
+  bool                                  // Returns true=success false=failure
+  StartCommunication(
+    bool warm = false)                  // True=chip was already running
+  {
+    // Read the chip ID and match it with the expected value
+    uint32_t chipid = RegRead32(REG_CHIP_ID);
+
+    if ((warm) && (!IsKnownChipId(chipid)))
+    {
+      if (_profile._chipid == SteveDisplay::CHIPID_ANY)
+      {
+        DBG_STAT("Chip ID %08lX unknown, can't identify the chip\n", chipid);
+        return false;
+      }
+
+      DBG_GEEK("Chip ID overwritten, using the profile\n");
+      chipid = _profile._chipid;
+    }
+
+    _chipid = (SteveDisplay::CHIPID)chipid;
+    if (_profile._chipid != SteveDisplay::CHIPID_ANY)
+    {
+      if (_profile._chipid != _chipid)
+      {
+        DBG_STAT("Chip ID mismatch: Wanted %08lX, got %08lX\n", _profile._chipid, _chipid);
+        return false;
+      }
+    }
+
+    // Switch to the widest SPI bus that the HAL supports
+    uint8_t widths = _hal.GetBusWidths();
+    if (widths & SteveHAL::BUSWIDTH_QUAD)
+    {
+      if (!SetBusWidth(SteveHAL::BUSWIDTH_QUAD))
+      {
+        return false;
+      }
+    }
+    else if (widths & SteveHAL::BUSWIDTH_DUAL)
+    {
+      if (!SetBusWidth(SteveHAL::BUSWIDTH_DUAL))
+      {
+        return false;
+      }
+    }
+
+    // Store the frequency in the register if requested
+    if (_profile._frequency)
+    {
+      RegWrite32(REG_FREQUENCY, _profile._frequency);
+    }
+
+    // Get the current write pointer from the EVE
+    CmdInitWriteIndex();
+
+    // Use the bulk command register on EVE3/EVE4 chips, so the chip keeps
+    // track of the write pointer and wraparound of RAM_CMD.
+    _cmd_bulk = (_chipid >= SteveDisplay::CHIPID_BT815);
+
+    return true;
+  }
+
+  //=========================================================================
+  // PUBLIC INIT/EXIT FUNCTIONS
+  //=========================================================================
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait before the next step of BeginStep
+  //
+  // If the HAL can't tell the time (Micros returns 0), the time can't be
+  // measured between calls, so the HAL waits here instead.
+  BEGINSTEP                             // Returns BEGINSTEP_PENDING
+  BootWait(
+    BOOT next,                          // State after waiting
+    uint8_t ms,                         // Time to wait in ms
+    uint32_t *pwakeup)                  // Output time to call again
+  {
+    _boot = next;
+    _boot_wait = ms;
+    _boot_time = _hal.Micros();
+
+    if (!_boot_time)
+    {
+      _hal.Delay(ms);
+      _boot_wait = 0;
+      ms = 0;
+    }
+
+    if (pwakeup)
+    {
+      *pwakeup = _boot_time + (uint32_t)ms * 1000;
+    }
+
+    return BEGINSTEP_PENDING;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Set up the registers after the EVE is running; last step of BeginStep
+  bool                                  // Returns true=success false=failure
+  BootSetup()
+  {
+    // Check the chip ID and set up the communication
+    if (!StartCommunication())
+    {
+      return false;
+    }
+
+    // The reset cleared RAM_G, so any recorded command lists are gone
+    InvalidateAllLists();
+    _fifo_size = 0;
+    InvalidateFrameHash();
+
+    // Execute bug workarounds for specific subclasses
+    if (!EarlyInit())
+    {
+      return false;
+    }
+
+    // Set PCLK to zero; don't clock the LCD until later
+    RegWrite8(REG_PCLK, 0);
+
+    // Turn off backlight
+    RegWrite8(REG_PWM_DUTY, 0);
+
+    // Initialize display parameters
+    // The timing registers and the output registers are contiguous, so
+    // they're written from the register image of the profile in a single
+    // burst (see SteveDisplay::RegisterImage).
+    //
+    // The output bits are encoded as 3 values in 3 groups of 3 bits.
+    // 0b0000_000R_RRGG_GBBB
+    //                   --- Number of bits used for Blue
+    //               ----    Number of bits used for Green
+    //           ----        Number of bits used for Red
+    //   --------            Reserved
+    // If set to 0 in the profile, the default of the chip is kept: 8 bits
+    // (FT812/FT813) or 6 bits (FT810/FT811). The chip was just reset, so
+    // the default is read back and written again as part of the burst.
+    static_assert(REG_HCYCLE + SteveDisplay::IMAGE_PCLK_POL * 4 == REG_PCLK_POL,
+      "Register image doesn't match the registers");
+
+    SteveDisplay::Image image = _profile.RegisterImage();
+
+    if (!_profile._outbits)
+    {
+      image._regs[SteveDisplay::IMAGE_OUTBITS] = RegRead16(REG_OUTBITS);
+    }
+
+    RegWriteBuffer32(REG_HCYCLE, SteveDisplay::IMAGE_COUNT, image._regs);
+    // Don't set PCLK yet - wait for just after the first display list
+
+    // Set 10 mA or 5 mA drive for PCLK, DISP, VSYNC, DE, RGB lines and
+    // back light PWM.
+    // REG_GPIOX is only read here, and written once together with the
+    // DISP bit below.
+    uint16_t gpiox = RegRead16(REG_GPIOX);
+    if (_profile._lcd10ma)
+    {
+      gpiox |= 0x1000;
+    }
+    else
+    {
+      gpiox &= ~0x1000;
+    }
+
+    // Change the driving strength for any pins that have an explicit
+    // setting.
+    if (_profile._pindrivetable)
+    {
+      const uint8_t *p;
+
+      for (p = _profile._pindrivetable; *p != 0xFF; p++)
+      {
+        HostCommand(HOSTCMD_PINDRIVE, *p);
+      }
+    }
+
+    // Touch screen initialization
+    if (!TouchInit())
+    {
+      return false;
+    }
+
+    // TODO: Audio off
+
+    // Write the initial display list directly to RAM_DL; the coprocessor
+    // may not be available this early.
+    // This just shows a black screen
+    _dl_index = 0;
+    _dl_burst = false;
+    dl_CLEAR_COLOR(0);
+    dl_CLEAR(1, 1, 1); // color, stencil, tag
+    dl_DISPLAY();
+
+    // Tell the EVE that it can swap display lists at the next available
+    // frame boundary.
+    // TODO: Make this a parameter for Begin()?
+    RegWrite32(REG_DLSWAP, DLSWAP_FRAME);
+    _dl_swap_pending = true;
+
+    // Enable the DISP line of the LCD.
+    // That output line is always controlled by the same register regardless
+    // of the LCD type.
+    RegWrite16(REG_GPIOX, gpiox | 0x8000);
+
+    // Now start clocking the data to the LCD panel
+    RegWrite8(REG_PCLK, _profile._pclk);
+
+    // Initialize backlight
+    // TODO: Make these into parameter for Begin()?
+    RegWrite16(REG_PWM_HZ, 300);
+    RegWrite8(REG_PWM_DUTY, 32);
+
+    // TODO: Calibrate touch screen if necessary
+
+    return true;
+  }
+
+
+public:
+  //-------------------------------------------------------------------------
+  // Initialize the display one step at a time
+  //
+  // This does the same as Begin, but instead of waiting for the EVE to
+  // power up and boot, it returns BEGINSTEP_PENDING with the time (in
+  // HostMicros) at which it should be called again. Calling it earlier
+  // is harmless; it returns right away. That way, a host can do other
+  // work while the EVE starts up, or start several displays at the same
+  // time (see SteveMultiDisplay::Begin).
+  //
+  // After it returns BEGINSTEP_DONE or BEGINSTEP_FAILED, it keeps
+  // returning the same result until the initialization is started again
+  // with BeginRestart (or with Begin or End).
+  //
+  // See ProgGuide 2.3 p.11
+  BEGINSTEP                             // Returns progress
+  BeginStep(
+    uint32_t *pwakeup = NULL)           // Output time to call again
+  {
+    if (_boot_wait)
+    {
+      uint32_t elapsed = _hal.Micros() - _boot_time;
+      uint32_t wait = (uint32_t)_boot_wait * 1000;
+
+      if (elapsed < wait)
+      {
+        if (pwakeup)
+        {
+          *pwakeup = _boot_time + wait;
+        }
+
+        return BEGINSTEP_PENDING;
+      }
+
+      _boot_wait = 0;
+    }
+
+    switch (_boot)
+    {
+    case BOOT_START:
+      // Wake up the EVE
+      DBG_GEEK("Begin\n");
+
+      if (!_hal.Begin())
+      {
+        break;
+      }
+
+      // Reset the EVE and hold it in reset for a little while
+      Pause(true);
+      _hal.Power(false);
+
+      return BootWait(BOOT_POWER_ON, BOOT_PD_LOW_MS, pwakeup);
+
+    case BOOT_POWER_ON:
+      // The reset puts the EVE back in single SPI mode, with interrupts
+      // disabled
+      _hal.SetBusWidth(SteveHAL::BUSWIDTH_SINGLE);
+      _bus_width = SteveHAL::BUSWIDTH_SINGLE;
+      _read_dummies = 1;
+      _int_mask = 0;
+      _int_flags = 0;
+
+      _hal.Power(true);                 // Power on
+
+      // Wait for the chip to wake up
+      return BootWait(BOOT_CLOCK, BOOT_PD_HIGH_MS, pwakeup);
+
+    case BOOT_CLOCK:
+      // Select the chip and initialize the SPI bus in slow mode until
+      // the EVE clock is initialized
+      _hal.Select(true);
+      _hal.Init(true);
+
+      // Select the internal or external clock, and select the PLL
+      // multiplier for an external clock as necessary.
+      if (_profile._clkext)
+      {
+        HostCommand(HOSTCMD_CLKEXT);
+      }
+      else
+      {
+        HostCommand(HOSTCMD_CLKINT);
+      }
+
+      HostCommand(HOSTCMD_CLKSEL, _profile._clksel);
+      _clksel = _profile._clksel;
+
+      // Activate the FT81X
+      HostCommand(HOSTCMD_ACTIVE, 0);
+      _power_mode = POWERMODE_ACTIVE;
+
+      _boot = BOOT_WAIT_ID;
+      _boot_tries = 0;
+
+      // Fall through
+
+    case BOOT_WAIT_ID:
+      // Repeatedly poll REG_ID with a 1 ms delay between retries, instead
+      // of waiting a fixed time for the chip to initialize.
+      // The register should return 0x7C when the processor is running.
+      // This is still done in slow mode, because the EVE clock may not be
+      // stable until REG_ID has the correct value.
+      if (RegRead8(REG_ID) != 0x7C)
+      {
+        if (++_boot_tries < BOOT_POLL_TRIES)
+        {
+          return BootWait(BOOT_WAIT_ID, 1, pwakeup);
+        }
+
+        DBG_STAT("Timeout waiting for ID of 0x7C.\n");
+        DBG_STAT("Is the device connected? Is the right EVE device selected?\n");
+        break;
+      }
+
+      // Re-init in fast mode
+      _hal.Init(false);
+
+      _boot = BOOT_WAIT_RESET;
+      _boot_tries = 0;
+
+      // Fall through
+
+    case BOOT_WAIT_RESET:
+      // Repeatedly poll REG_CPURESET until it returns 0 meaning the reset
+      // is complete
+      if (RegRead8(REG_CPURESET) != 0)
+      {
+        if (++_boot_tries < BOOT_POLL_TRIES)
+        {
+          return BootWait(BOOT_WAIT_RESET, 1, pwakeup);
+        }
+
+        DBG_STAT("Timeout waiting for EVE CPU reset.\n");
+        DBG_STAT("Is the device connected? Is the right EVE device selected?\n");
+        break;
+      }
+
+      if (!BootSetup())
+      {
+        break;
+      }
+
+      _boot = BOOT_DONE;
+
+      // Fall through
+
+    case BOOT_DONE:
+      return BEGINSTEP_DONE;
+
+    default:
+      break;
+    }
+
+    _boot = BOOT_FAILED;
+
+    return BEGINSTEP_FAILED;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start the initialization with BeginStep again
+  //
+  // This doesn't access the EVE; the next call to BeginStep resets it.
+  void BeginRestart()
+  {
+    _boot = BOOT_START;
+    _boot_wait = 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Initialize the display
+  //
+  // This runs BeginStep until it's done, and waits with the HAL in
+  // between.
+  bool                                  // Returns true=success false=failure
+  Begin()
+  {
+    BeginRestart();
+
+    for (;;)
+    {
+      switch (BeginStep())
+      {
+      case BEGINSTEP_PENDING:
+        if (_boot_wait)
+        {
+          _hal.Delay(_boot_wait);
+          _boot_wait = 0;
+        }
+        break;
+
+      case BEGINSTEP_DONE:
+        return true;
+
+      default:
+        return false;
+      }
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Reconnect to a display that's already running
+  //
+  // This can be used instead of Begin when the host reconnects to a
+  // display that was initialized before, e.g. after the host was asleep.
+  // If the EVE is running (REG_ID and REG_CPURESET are as expected, the
+  // pixel clock is set to the value from the profile and the co-processor
+  // isn't in a fault state), the power cycle and the initialization of the
+  // registers are skipped. Only the chip ID is checked and the command
+  // queue index and the display list index are synchronized, so the
+  // image on the display stays as it was.
+  //
+  // The chip ID register is in RAM_G, so the application may have
+  // overwritten it. If it doesn't hold a known chip ID, the ID from the
+  // profile is used. With CHIPID_ANY in the profile, the chip can't be
+  // identified in that case, so a full Begin is done; profiles for
+  // displays that are reconnected should have a chip ID.
+  //
+  // If the chip isn't running, it falls back to Begin. That also happens
+  // when the EVE is still in dual or quad SPI mode, because it can only
+  // be checked in single SPI mode.
+  bool                                  // Returns true=success false=failure
+  WarmBegin()
+  {
+    DBG_GEEK("WarmBegin\n");
+
+    if (!_hal.Begin())
+    {
+      return false;
+    }
+
+    EndTransaction();
+
+    // Start in single SPI mode in fast mode
+    _hal.SetBusWidth(SteveHAL::BUSWIDTH_SINGLE);
+    _bus_width = SteveHAL::BUSWIDTH_SINGLE;
+    _read_dummies = 1;
+    _hal.Init(false);
+
+    if ((RegRead8(REG_ID) != 0x7C)
+      || (RegRead8(REG_CPURESET) != 0)
+      || (RegRead8(REG_PCLK) != _profile._pclk)
+      || (RegRead16(REG_CMD_READ) == READ_INDEX_ERROR))
+    {
+      DBG_GEEK("EVE not running, doing a full restart\n");
+      return Begin();
+    }
+
+    if (!StartCommunication(true))
+    {
+      DBG_GEEK("Warm start failed, doing a full restart\n");
+      return Begin();
+    }
+
+    // The display list on the screen stays valid, but the next direct
+    // display list starts at the beginning of RAM_DL
+    _dl_index = 0;
+    _dl_burst = false;
+    _dl_buffered = 0;
+
+    // Interrupts stay enabled, so get the mask from the chip
+    _int_mask = RegRead8(REG_INT_EN) ? RegRead16(REG_INT_MASK) : 0;
+    _int_flags = 0;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Temporarily disconnect/reconnect from the EVE chip
+  void Pause(
+    bool pause)                         // True=pause, False=resume
+  {
+    _hal.Pause(pause);
+    if (pause)
+    {
+      EndTransaction();
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // End communication without ending the HAL
+  void InternalEnd()
+  {
+    Pause(true);
+    _hal.Power(false);                  // Reset
+    _hal.Delay(BOOT_PD_LOW_MS);         // Hold for a little while
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // End communication with the EVE chip
+  //
+  // After this, BeginStep starts the initialization again.
+  void End()
+  {
+    InternalEnd();
+    _hal.End();
+
+    BeginRestart();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Change the SPI bus width
+  //
+  // The EVE chip is switched to the new bus width first, using the old bus
+  // width. Then the HAL is switched. In quad mode, the EVE is configured
+  // to expect two dummy bytes for reads instead of one, to give the host
+  // enough time to turn the data lines around.
+  //
+  // Begin calls this to switch to the widest bus width that the HAL
+  // supports, so normally it's not necessary to call this.
+  bool                                  // Returns true=success
+  SetBusWidth(
+    SteveHAL::BUSWIDTH width)           // New bus width
+  {
+    uint8_t value;
+
+    if (!(_hal.GetBusWidths() & width))
+    {
+      DBG_STAT("Bus width %u not supported by HAL\n", width);
+      return false;
+    }
+
+    switch (width)
+    {
+    case SteveHAL::BUSWIDTH_DUAL:
+      value = SPIWIDTH_DUAL;
+      break;
+
+    case SteveHAL::BUSWIDTH_QUAD:
+      value = SPIWIDTH_QUAD | SPIWIDTH_EXTRA_DUMMY;
+      break;
+
+    default:
+      value = SPIWIDTH_SINGLE;
+    }
+
+    // The EVE switches when the transaction ends
+    RegWrite8(REG_SPI_WIDTH, value);
+    EndTransaction();
+
+    if (!_hal.SetBusWidth(width))
+    {
+      DBG_STAT("HAL failed to switch to bus width %u\n", width);
+      return false;
+    }
+
+    _bus_width = width;
+    _read_dummies = (value & SPIWIDTH_EXTRA_DUMMY) ? 2 : 1;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the system clock frequency for a clock multiplier
+  static uint32_t                       // Returns frequency in Hz
+  ClockFrequency(
+    SteveDisplay::CLKSEL clksel)        // Clock multiplier
+  {
+    if (clksel == SteveDisplay::CLKSEL_DEFAULT)
+    {
+      return 60000000UL;
+    }
+
+    return (uint32_t)(clksel & 0x3F) * 12000000UL;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wake the EVE up from standby or sleep mode
+  //
+  // Coming out of sleep mode takes longer, because the PLL has to start
+  // and lock first; the SPI bus is used in slow mode until REG_ID can be
+  // read again, the same way as in Begin.
+  bool                                  // Returns true=success
+  Wake()
+  {
+    bool slow = (_power_mode == POWERMODE_SLEEP);
+
+    if (slow)
+    {
+      _hal.Init(true);
+    }
+
+    HostCommand(HOSTCMD_ACTIVE, 0);
+    _power_mode = POWERMODE_ACTIVE;
+
+    bool result = (RegWait8(REG_ID, 0x7C, BOOT_POLL_TRIES, 1) != 0);
+
+    if (slow)
+    {
+      _hal.Init(false);
+    }
+
+    if (!result)
+    {
+      DBG_STAT("Timeout waiting for EVE to wake up\n");
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Change the power mode
+  //
+  // In standby mode, the system clock is stopped; in sleep mode, the PLL
+  // is also stopped, so it takes longer to wake up (about 20 ms instead of
+  // a few). In both modes, the display shows nothing, and RAM_G, the
+  // registers and the bitmap and font handles are kept, so that the
+  // display can continue where it left off after going back to
+  // POWERMODE_ACTIVE, without calling Begin.
+  //
+  // Before going to standby or sleep mode, this sends any queued commands
+  // and waits until the co-processor has executed them. While the EVE isn't active,
+  // nothing else should be sent to it: any memory read wakes it up.
+  // After waking up, the command queue index is synchronized with the
+  // EVE (see CmdInitWriteIndex).
+  bool                                  // Returns true=success
+  SetPowerMode(
+    POWERMODE mode)                     // New power mode
+  {
+    if (mode == _power_mode)
+    {
+      return true;
+    }
+
+    if (_power_mode != POWERMODE_ACTIVE)
+    {
+      if (!Wake())
+      {
+        return false;
+      }
+
+      CmdInitWriteIndex();
+    }
+
+    if (mode != POWERMODE_ACTIVE)
+    {
+      bool error;
+
+      CmdExecute(true, &error);
+
+      if (error)
+      {
+        DBG_STAT("Co-processor error, not changing power mode\n");
+        return false;
+      }
+
+      HostCommand((mode == POWERMODE_SLEEP) ? HOSTCMD_SLEEP : HOSTCMD_STANDBY);
+      EndTransaction();
+
+      _power_mode = mode;
+    }
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Change the system clock frequency
+  //
+  // A higher frequency makes the co-processor and the graphics engine
+  // faster; a lower frequency uses less power. The EVE can only change
+  // the multiplier of the PLL in sleep mode, so the display goes blank
+  // for a moment (about 20 ms), but RAM_G and the handles are kept, and
+  // no new initialization is needed.
+  //
+  // REG_FREQUENCY is updated, and the pixel clock divider in REG_PCLK is
+  // scaled to keep the pixel clock (and the timing of the panel) about
+  // the same, unless a divider is given. The divider must be chosen so
+  // that the panel accepts the resulting pixel clock. CLKSEL_X6 is only
+  // available on EVE3/EVE4.
+  bool                                  // Returns true=success
+  SetPerformanceMode(
+    SteveDisplay::CLKSEL clksel,        // New clock multiplier
+    uint8_t pclk = 0)                   // Pixel clock divider, 0=scale
+  {
+    if (clksel == _clksel)
+    {
+      if (pclk)
+      {
+        RegWrite8(REG_PCLK, pclk);
+      }
+
+      return true;
+    }
+
+    uint32_t oldfreq = ClockFrequency(_clksel);
+    uint32_t newfreq = ClockFrequency(clksel);
+
+    if (!pclk)
+    {
+      uint8_t oldpclk = RegRead8(REG_PCLK);
+
+      if (oldpclk)
+      {
+        uint32_t scaled = ((uint32_t)oldpclk * newfreq + oldfreq / 2) / oldfreq;
+
+        pclk = (uint8_t)((scaled < 1) ? 1 : (scaled > 255) ? 255 : scaled);
+      }
+    }
+
+    if (!SetPowerMode(POWERMODE_SLEEP))
+    {
+      return false;
+    }
+
+    DBG_GEEK("Changing clock from %lu to %lu Hz\n", oldfreq, newfreq);
+
+    HostCommand(HOSTCMD_CLKSEL, clksel);
+    EndTransaction();
+
+    _clksel = clksel;
+
+    if (!SetPowerMode(POWERMODE_ACTIVE))
+    {
+      return false;
+    }
+
+    RegWrite32(REG_FREQUENCY, newfreq);
+
+    if (pclk)
+    {
+      RegWrite8(REG_PCLK, pclk);
+    }
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the current power mode
+  POWERMODE                             // Returns power mode
+  PowerMode() const
+  {
+    return _power_mode;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the current clock multiplier
+  SteveDisplay::CLKSEL                  // Returns clock multiplier
+  PerformanceMode() const
+  {
+    return _clksel;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the current SPI bus width
+  SteveHAL::BUSWIDTH                    // Returns bus width
+  BusWidth() const
+  {
+    return _bus_width;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Change the SPI clock that's used after early initialization
+  //
+  // This can be called before Begin, e.g. with a clock that was found by
+  // CalibrateClock and stored by the application. Not all HALs support
+  // this.
+  bool                                  // Returns true=success
+  SetClock(
+    uint32_t hz)                        // New SPI clock in Hz
+  {
+    EndTransaction();
+
+    return _hal.SetClock(hz);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the SPI clock that's used after early initialization
+  uint32_t                              // Returns clock in Hz, 0=unknown
+  GetClock()
+  {
+    return _hal.GetClock();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write a test pattern to RAM_G and let the co-processor calculate its
+  // CRC
+  //
+  // The pattern is pseudo-random, so that the data lines toggle a lot.
+  // The co-processor is only polled a limited number of times, because
+  // garbled reads may never show that it's done.
+  bool                                  // Returns false=test failed
+  ClockTest(
+    uint32_t address22,                 // Address of the pattern in RAM_G
+    uint32_t seed,                      // Start value for pattern, not 0
+    uint32_t *pcrc)                     // Output CRC from co-processor
+  {
+    if (RegRead8(REG_ID) != 0x7C)
+    {
+      return false;
+    }
+
+    uint32_t buf[16];
+
+    for (uint16_t offset = 0; offset < CLOCKTEST_SIZE; offset += sizeof(buf))
+    {
+      for (uint8_t u = 0; u < 16; u++)
+      {
+        // Xorshift
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        buf[u] = seed;
+      }
+
+      RegWriteBuffer32(address22 + offset, 16, buf);
+    }
+
+    CmdIndex result;
+    bool error;
+
+    cmd_MEMCRC(address22, CLOCKTEST_SIZE, &result);
+    CmdExecute();
+
+    for (uint8_t u = 0; CmdIsBusy(&error); u++)
+    {
+      if (u >= CLOCKTEST_TRIES)
+      {
+        return false;
+      }
+
+      _hal.Delay(1);
+    }
+
+    if (error)
+    {
+      return false;
+    }
+
+    *pcrc = CmdRead32(result);
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Find the fastest SPI clock that works reliably
+  //
+  // This should be called right after Begin, before anything is stored in
+  // the given area of RAM_G (CLOCKTEST_SIZE bytes). The HAL must support
+  // SetClock and GetClock; the current clock is used as a reference and
+  // must work.
+  //
+  // The clock is stepped up from the current clock. At each step, a test
+  // pattern is written to RAM_G and CMD_MEMCRC calculates its CRC, which
+  // is compared to the CRC that was calculated at the reference clock.
+  // That only needs to read 4 bytes back instead of the entire pattern.
+  // The test alternates between two patterns so that a write that didn't
+  // arrive at all can't pass. Stepping stops at the first failure, and
+  // the chosen clock is the highest clock that passed, minus a margin.
+  //
+  // A failed test may have garbled commands or memory writes. If the
+  // co-processor doesn't finish afterwards, it's recovered with
+  // CmdRecover. Memory writes that went to the wrong address can't be
+  // detected; it's safest to call Begin again (the HAL keeps the new
+  // clock) if the result is lower than the maximum.
+  //
+  // The result can be stored by the application, and passed to SetClock
+  // at the next startup to skip the calibration.
+  uint32_t                              // Returns new clock in Hz, 0=error
+  CalibrateClock(
+    uint32_t address22,                 // Address of test area in RAM_G
+    uint32_t maxhz,                     // Highest clock to try
+    uint32_t stephz = 1000000UL,        // Clock increment
+    uint8_t marginsteps = 1)            // Number of steps to back off
+  {
+    const static uint32_t seeds[2] = { 0x12345678UL, 0x9E3779B9UL };
+
+    uint32_t reference = _hal.GetClock();
+    uint32_t crc[2];
+
+    if ((!reference) || (!stephz))
+    {
+      DBG_STAT("HAL can't report or change the SPI clock\n");
+      return 0;
+    }
+
+    for (uint8_t u = 0; u < 2; u++)
+    {
+      if (!ClockTest(address22, seeds[u], &crc[u]))
+      {
+        DBG_STAT("Clock test failed at reference clock %lu Hz\n", reference);
+        return 0;
+      }
+    }
+
+    uint32_t best = reference;
+    uint8_t test = 0;
+    bool failed = false;
+
+    for (uint32_t hz = reference + stephz; (!failed) && (hz <= maxhz); hz += stephz)
+    {
+      if (!SetClock(hz))
+      {
+        DBG_STAT("HAL can't change the SPI clock to %lu Hz\n", hz);
+        break;
+      }
+
+      for (uint8_t pass = 0; (!failed) && (pass < CLOCKTEST_PASSES); pass++)
+      {
+        uint32_t value;
+        uint8_t u = test++ & 1;
+
+        failed = (!ClockTest(address22, seeds[u], &value)) || (value != crc[u]);
+      }
+
+      if (!failed)
+      {
+        best = hz;
+      }
+
+      DBG_GEEK("Clock test at %lu Hz: %s\n", hz, failed ? "failed" : "passed");
+    }
+
+    uint32_t margin = (uint32_t)marginsteps * stephz;
+    uint32_t result = (best - reference >= margin) ? best - margin : reference;
+
+    // Back to a known good clock; if the co-processor got garbled commands,
+    // it's recovered.
+    SetClock(result);
+
+    if (failed)
+    {
+      bool error;
+      uint8_t u;
+
+      for (u = 0; (CmdIsBusy(&error)) && (u < CLOCKTEST_TRIES); u++)
+      {
+        _hal.Delay(1);
+      }
+
+      if ((error) || (u >= CLOCKTEST_TRIES))
+      {
+        CmdRecover();
+      }
+    }
+
+    uint32_t value;
+
+    if ((!ClockTest(address22, seeds[test & 1], &value)) || (value != crc[test & 1]))
+    {
+      DBG_STAT("Clock test failed at %lu Hz, back to %lu Hz\n", result, reference);
+
+      SetClock(reference);
+      result = reference;
+    }
+
+    DBG_STAT("SPI clock calibrated to %lu Hz\n", result);
+
+    return result;
+  }
+
+  //=========================================================================
+  // START AND END TRANSACTIONS
+  //=========================================================================
+
+protected:
+  //-------------------------------------------------------------------------
+  // Begin a transaction, i.e. a Host Command, or a Memory Read/Write
+  //
+  // In most cases, this shouldn't be called directly. Call the other
+  // functions below instead, to send a host command or read/write from/to
+  // memory.
+  void BeginTransaction(
+    uint32_t data24)                    // 24-bit value to send
+  {
+    DBG_TRAFFIC("*** Transaction %06lX\n", data24);
+
+    // Make sure the previous transaction has ended.
+    // Then start a new transaction by selecting the chip.
+    EndTransaction();
+
+    if (_hal.Select(true))
+    {
+      STEVE_STAT(_stats._cs_toggles++);
+    }
+
+    // Send the lower 3 bytes of the command in BIG ENDIAN order.
+    _hal.Send24BE(data24);
+
+    STEVE_STAT(_stats._transactions++);
+    STEVE_STAT(_stats._bytes_sent += 3);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // End a transaction by de-selecting the chip.
+  //
+  // This is usually not necessary: Beginning a new transaction will end
+  // the previous transaction.
+  //
+  // Ending a transaction also ends the command stream (see Cmd() below),
+  // so the next co-processor command will start a new transaction.
+  void EndTransaction()
+  {
+    _cmd_stream = false;
+    _dl_stream = false;
+
+    if (_hal.Select(false))
+    {
+      STEVE_STAT(_stats._cs_toggles++);
+    }
+  }
+
+protected:
+  //-----------------------------------------------------------------------
+  // Read or write data
+  //
+  // After calling this, subsequent transfers will copy data to/from
+  // consecutive memory locations.
+  void BeginMemoryTransaction(
+    uint32_t address22,                 // Address (22 bits, not checked)
+    bool write)                         // False = read, true = write
+  {
+    DBG_TRAFFIC("Address %lX %s\n", address22, write ? "WRITE" : "READ");
+
+    // The address is passed by or-ing it to the 24 bit command.
+    BeginTransaction((uint32_t)(write ? HOSTCMD_WRITE : HOSTCMD_READ) | address22);
+
+    // In read mode, a dummy byte must be sent to the EVE before
+    // receiving the data. In quad mode, Steve switches the EVE to use
+    // an extra dummy byte.
+    if (!write)
+    {
+      for (uint8_t u = 0; u < _read_dummies; u++)
+      {
+        _hal.Send8(0);
+      }
+
+      STEVE_STAT(_stats._bytes_sent += _read_dummies);
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Read memory in a single transaction
+  //
+  // The header with the address and the dummy bytes is passed to the HAL
+  // together with the destination buffer, so that HALs with a high latency
+  // per transfer can do the entire read in one round trip.
+  uint32_t                              // Returns number of bytes read
+  MemoryRead(
+    uint32_t address22,                 // Address (22 bits, not checked)
+    uint32_t length,                    // Number of bytes to read
+    uint8_t *destination)               // Destination buffer
+  {
+    DBG_TRAFFIC("Address %lX READ\n", address22);
+
+    uint32_t data24 = (uint32_t)HOSTCMD_READ | address22;
+    uint8_t header[5] = { (uint8_t)(data24 >> 16), (uint8_t)(data24 >> 8), (uint8_t)data24, 0, 0 };
+
+    // Make sure the previous transaction has ended.
+    EndTransaction();
+
+    // The read transaction selects and de-selects the chip
+    STEVE_STAT(_stats._transactions++);
+    STEVE_STAT(_stats._cs_toggles += 2);
+    STEVE_STAT(_stats._bytes_sent += 3 + (uint32_t)_read_dummies);
+    STEVE_STAT(_stats._bytes_received += length);
+
+    return _hal.ReadTransaction(header, 3 + (uint32_t)_read_dummies, destination, length);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a Host Command
+  void HostCommand(
+    HOSTCMD hostcmd,                    // Host command (not READ or WRITE)
+    uint8_t parameter = 0)              // Parameter, if any
+  {
+    // The parameter is passed as the second byte of the 24-bit host
+    // command value.
+    return BeginTransaction((uint32_t)hostcmd | (uint32_t)parameter << 8);
+  }
+
+  //=========================================================================
+  // MEMORY OPERATIONS
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Read a one-byte register from FT81X memory
+  //
+  // Referred to as "rd8" in the documentation
+  uint8_t                               // Returns data at given address
+  RegRead8(
+    uint32_t address22)                 // Address (22 bits; not checked)
+  {
+    uint8_t result;
+
+    // Read the value
+    MemoryRead(address22, 1, &result);
+    STEVE_STAT(_stats._reg_reads++);
+
+    DBG_TRAFFIC("Reg %lX = %X\n", address22, result);
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Read a 2-byte register from FT81X memory
+  //
+  // Referred to as "rd16" in the documentation
+  uint16_t                              // Returns data at given address
+  RegRead16(
+    uint32_t address22)                 // Address (22 bits; not checked)
+  {
+    uint16_t result;
+    uint8_t buf[2];
+
+    // Read the value; it's stored in little-endian format
+    MemoryRead(address22, sizeof(buf), buf);
+    STEVE_STAT(_stats._reg_reads++);
+    result = (uint16_t)(buf[0] | (buf[1] << 8));
+
+    DBG_TRAFFIC("Reg %lX = %X\n", address22, result);
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Read a 4-byte register from FT81X memory
+  //
+  // Referred to as "rd32" in the documentation
+  uint32_t                            // Returns data at given address
+  RegRead32(
+    uint32_t address22)               // Address (22 bits; not checked)
+  {
+    uint32_t result;
+    uint8_t buf[4];
+
+    // Read the value; it's stored in little-endian format
+    MemoryRead(address22, sizeof(buf), buf);
+    STEVE_STAT(_stats._reg_reads++);
+    result = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+
+    DBG_TRAFFIC("Reg %lX = %lX\n", address22, result);
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Repeat reading a register until it matches the given value
+  //
+  // The function returns 0 if the register didn't contain the expected
+  // value after the given number of retries. In other words, the result
+  // is successful if the function returns nonzero.
+  uint8_t                             // Returns num retries remaining
+  RegWait8(
+    uint32_t address22,               // Address (22 bits; not checked)
+    uint8_t value,                    // Expected value
+    uint8_t maxtries,                 // Maximum number of tries
+    uint32_t delay_between_tries)     // Delay between tries in ms
+  {
+    uint8_t result = maxtries;
+    uint8_t read_value = 0;
+
+    while (result)
+    {
+      read_value = RegRead8(address22);
+      --result;
+
+      if (read_value == value)
+      {
+        DBG_TRAFFIC("Match after %u read(s)\n", maxtries - result);
+        return result;
+      }
+
+      _hal.Delay(delay_between_tries);
+    }
+
+    DBG_GEEK("Timeout waiting for %lX to become %X, last read value was %X\n", address22, value, read_value);
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Read a block of memory
+  uint32_t                              // Returns next address to read from
+  RegReadBuffer(
+    uint32_t address22,                 // Address (22 bits; not checked)
+    uint32_t length,                    // Number of bytes to read
+    uint8_t *destination)               // Destination buffer
+  {
+    DBG_TRAFFIC("Reading %lX length %lX (%lu dec)\n", address22, length, length);
+
+    address22 += MemoryRead(address22, length, destination);
+
+    return address22;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Read all registers of a snapshot
+  //
+  // Registers that are at most SNAPSHOT_GAP bytes apart are read in one
+  // transaction of at most SNAPSHOT_WINDOW bytes, so if the registers are
+  // close together, the snapshot takes a single transaction instead of one
+  // per register.
+  //
+  // If REG_INT_FLAGS is in the snapshot, the flags are remembered as if
+  // IntReadFlags was called.
+  uint8_t                               // Returns number of transactions
+  RegReadSnapshot(
+    RegSnapshot &snapshot)              // Registers to read
+  {
+    uint8_t buf[SNAPSHOT_WINDOW];
+    uint8_t first = 0;
+
+    snapshot._windows = 0;
+
+    while (first < snapshot._count)
+    {
+      uint32_t start = snapshot._addresses[first];
+      uint8_t last = first;
+
+      // Extend the window as far as possible
+      while (last + 1 < snapshot._count)
+      {
+        uint32_t next = snapshot._addresses[last + 1];
+
+        if ((next + 4 - start > SNAPSHOT_WINDOW)
+          || (next > snapshot._addresses[last] + 4 + SNAPSHOT_GAP)
+          || ((next > REG_INT_FLAGS) && (snapshot._addresses[last] < REG_INT_FLAGS)))
+        {
+          break;
+        }
+
+        last++;
+      }
+
+      uint32_t length = snapshot._addresses[last] + 4 - start;
+
+      DBG_TRAFFIC("Snapshot window %lX length %lu\n", start, length);
+      MemoryRead(start, length, buf);
+      snapshot._windows++;
+
+      for (uint8_t u = first; u <= last; u++)
+      {
+        const uint8_t *p = buf + (snapshot._addresses[u] - start);
+
+        snapshot._values[u] = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+
+        if (snapshot._addresses[u] == REG_INT_FLAGS)
+        {
+          _int_flags |= (uint16_t)snapshot._values[u];
+        }
+      }
+
+      first = last + 1;
+    }
+
+    return snapshot._windows;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write an 8 bit register
+  //
+  // Referred to as "wr8" in the documentation
+  void RegWrite8(
+    uint32_t address22,                 // Address (22 bits; not checked)
+    uint8_t value)                      // Value to store
+  {
+    DBG_TRAFFIC("Writing %lX = %02X\n", address22, value);
+
+    BeginMemoryTransaction(address22, true);
+
+    _hal.Send8(value);
+    STEVE_STAT(_stats._bytes_sent += 1);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write a 16 bit register
+  //
+  // Referred to as "wr16" in the documentation
+  void RegWrite16(
+    uint32_t address22,                 // Address (22 bits; not checked)
+    uint16_t value)                     // Value to store
+  {
+    DBG_TRAFFIC("Writing %lX = %04X\n", address22, value);
+
+    BeginMemoryTransaction(address22, true);
+
+    _hal.Send16(value);
+    STEVE_STAT(_stats._bytes_sent += 2);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write a 32 bit register
+  //
+  // Referred to as "wr32" in the documentation
+  void RegWrite32(
+    uint32_t address22,             // Address (22 bits; not checked)
+    uint32_t value)                 // Value to store
+  {
+    DBG_TRAFFIC("Writing %lX = %08lX\n", address22, value);
+
+    BeginMemoryTransaction(address22, true);
+
+    _hal.Send32(value);
+    STEVE_STAT(_stats._bytes_sent += 4);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write a block of memory
+  //
+  // NOTE: It may be necessary to send alignment bytes if the length
+  // is not a multiple of 4.
+  uint32_t                            // Returns next address to write to
+  RegWriteBuffer(
+    uint32_t address22,               // Address (22 bits; not checked)
+    uint32_t length,                  // Number of bytes to write
+    const uint8_t *source)            // Source buffer
+  {
+    DBG_TRAFFIC("Writing %lX length %lX (%lu dec)\n", address22, length, length);
+
+    BeginMemoryTransaction(address22, true);
+
+    address22 += _hal.SendBuffer(source, length);
+    STEVE_STAT(_stats._bytes_sent += length);
+
+    return address22;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write a number of consecutive 32 bit registers
+  //
+  // This writes all the values in a single transaction, so the address is
+  // only sent once.
+  uint32_t                            // Returns next address to write to
+  RegWriteBuffer32(
+    uint32_t address22,               // Address (22 bits; not checked)
+    uint32_t count,                   // Number of registers to write
+    const uint32_t *values)           // Values to store
+  {
+    DBG_TRAFFIC("Writing %lX count %lu registers\n", address22, count);
+
+    BeginMemoryTransaction(address22, true);
+
+    _hal.SendWords(values, count);
+
+    STEVE_STAT(_stats._bytes_sent += count * 4);
+
+    return address22 + count * 4;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start writing a block of memory asynchronously
+  //
+  // This works the same as RegWriteBuffer, but if the HAL supports it, the
+  // function returns while the data is still being sent, e.g. by DMA.
+  // The source buffer must stay valid and unchanged until the transfer is
+  // done: until the callback is called, or until TransferIsBusy returns
+  // false. Any other access to the EVE waits until the transfer is done.
+  uint32_t                            // Returns next address to write to
+  RegWriteBufferAsync(
+    uint32_t address22,               // Address (22 bits; not checked)
+    uint32_t length,                  // Number of bytes to write
+    const uint8_t *source,            // Source buffer
+    SteveHAL::ASYNC_CALLBACK callback = NULL, // Callback, NULL=none
+    void *context = NULL)             // Context for callback
+  {
+    DBG_TRAFFIC("Writing %lX length %lX (%lu dec) async\n", address22, length, length);
+
+    BeginMemoryTransaction(address22, true);
+
+    _hal.SendBufferAsync(source, length, callback, context);
+    STEVE_STAT(_stats._bytes_sent += length);
+
+    return address22 + length;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check if an asynchronous transfer is still in progress
+  bool                                // Returns true=transfer in progress
+  TransferIsBusy()
+  {
+    return _hal.IsBusy();
+  }
+
+  //=========================================================================
+  // COMMAND LIST CACHE (EVE4)
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Use a command list cache, or stop using one
+  //
+  // The cache uses the given area of RAM_G to store command lists. The
+  // area must not be used for anything else while the cache is in use.
+  // All lists in the cache are invalidated.
+  //
+  // Use NULL to stop using a cache.
+  void CmdSetListCache(
+    ListCache *cache,                   // Cache, NULL=none
+    uint32_t address = 0,               // First address in RAM_G
+    uint32_t size = 0)                  // Size of the area in RAM_G
+  {
+    _lists = cache;
+
+    if (_lists)
+    {
+      _lists->_base = address;
+      _lists->_end = address + size;
+
+      InvalidateAllLists();
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Invalidate all lists in the cache
+  //
+  // This frees all the space in RAM_G that's used by the cache. Begin
+  // calls this because a reset clears RAM_G.
+  void InvalidateAllLists()
+  {
+    if (_lists)
+    {
+      for (uint8_t u = 0; u < _lists->_count; u++)
+      {
+        _lists->_entries[u]._address = 0;
+        _lists->_entries[u]._size = 0;
+        _lists->_entries[u]._length = 0;
+        _lists->_entries[u]._valid = false;
+        _lists->_entries[u]._snippet = false;
+      }
+
+      _lists->_next = _lists->_base;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Invalidate a list in the cache
+  //
+  // The list can't be called until it's recorded again. If it was the last
+  // list that was allocated, its space is freed. Otherwise, its space is
+  // reused when the list is recorded again and it fits.
+  void InvalidateList(
+    uint8_t id)                         // Index of the list in the cache
+  {
+    if ((_lists) && (id < _lists->_count))
+    {
+      ListCacheEntry &entry = _lists->_entries[id];
+
+      entry._valid = false;
+
+      if ((entry._size) && (entry._address + entry._size == _lists->_next))
+      {
+        _lists->_next = entry._address;
+        entry._size = 0;
+      }
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check if a list in the cache is valid
+  bool                                  // Returns true=list can be called
+  ListIsValid(
+    uint8_t id) const                   // Index of the list in the cache
+  {
+    return (_lists) && (id < _lists->_count) && (_lists->_entries[id]._valid);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Allocate space in the list cache
+  //
+  // The entry is invalidated. If it already has enough space, the space is
+  // reused; otherwise new space is allocated.
+  ListCacheEntry *                      // Returns entry, NULL=failure
+  ListAllocate(
+    uint8_t id,                         // Index of the entry in the cache
+    uint32_t maxsize)                   // Maximum size in bytes
+  {
+    if ((!_lists) || (id >= _lists->_count))
+    {
+      DBG_STAT("List %u not in cache\n", id);
+      return NULL;
+    }
+
+    ListCacheEntry &entry = _lists->_entries[id];
+
+    InvalidateList(id);
+
+    maxsize = (maxsize + 3) & ~3UL;
+
+    if ((!entry._size) || (maxsize > entry._size))
+    {
+      if (maxsize > _lists->_end - _lists->_next)
+      {
+        DBG_STAT("No space for list %u of %lu bytes\n", id, maxsize);
+        entry._size = 0;
+        return NULL;
+      }
+
+      entry._address = _lists->_next;
+      entry._size = maxsize;
+      _lists->_next += maxsize;
+    }
+
+    return &entry;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Mark an entry in the list cache valid after storing data in it
+  //
+  // If the entry is the last one that was allocated, the space that
+  // wasn't used is given back.
+  //
+  // If the data was bigger than the space, it overwrote the entries that
+  // follow it in RAM_G, so those are invalidated too.
+  bool                                  // Returns true=success
+  ListCommit(
+    uint8_t id,                         // Index of the entry in the cache
+    uint32_t length,                    // Used size in bytes
+    bool snippet)                       // True=display list snippet
+  {
+    ListCacheEntry &entry = _lists->_entries[id];
+
+    if (length > entry._size)
+    {
+      DBG_STAT("List %u too big: %lu bytes, maximum %lu\n", id, length, entry._size);
+
+      uint32_t start = entry._address + entry._size;
+      uint32_t end = entry._address + length;
+
+      for (uint8_t u = 0; u < _lists->_count; u++)
+      {
+        ListCacheEntry &other = _lists->_entries[u];
+
+        if ((u != id) && (other._size) && (other._address < end) && (other._address + other._size > start))
+        {
+          DBG_STAT("List %u overwritten\n", u);
+          other._valid = false;
+        }
+      }
+
+      InvalidateList(id);
+      return false;
+    }
+
+    if (entry._address + entry._size == _lists->_next)
+    {
+      entry._size = (length + 3) & ~3UL;
+      _lists->_next = entry._address + entry._size;
+    }
+
+    entry._length = length;
+    entry._snippet = snippet;
+    entry._valid = true;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Record a command list
+  //
+  // This calls the given function (e.g. a lambda) between CMD_NEWLIST and
+  // CMD_ENDLIST, so that the co-processor commands that it generates are
+  // stored in a command list in RAM_G instead of being executed. After
+  // that, CallList can be used to execute the list with a single command.
+  //
+  // The co-processor stores the commands themselves in the list, so the
+  // size of the list is the number of bytes that are sent (plus 4 for the
+  // CMD_RETURN that terminates the list). Because that's only known after
+  // the commands are sent, the caller must provide the maximum size that
+  // the list may use; if there isn't enough space in the cache area, the
+  // function returns false without sending anything. If the list turns
+  // out to be bigger than the maximum, RAM_G after the list is
+  // overwritten, so the list is invalidated and the function returns
+  // false.
+  //
+  // Commands that are queued before a re-recorded list are executed first,
+  // so it's not necessary to wait for the co-processor before re-recording
+  // a list that's called by a previous frame.
+  //
+  // Command lists are only supported by EVE4 (BT817/BT818) chips.
+  template<typename BUILDER>
+  bool                                  // Returns true=list recorded
+  RecordList(
+    uint8_t id,                         // Index of the list in the cache
+    uint32_t maxsize,                   // Maximum size in bytes
+    BUILDER builder)                    // Function that generates commands
+  {
+    if (_chipid < SteveDisplay::CHIPID_BT817)
+    {
+      DBG_STAT("Command lists not supported by this chip\n");
+      return false;
+    }
+
+    ListCacheEntry *entry = ListAllocate(id, maxsize);
+
+    if (!entry)
+    {
+      return false;
+    }
+
+    cmd_NEWLIST(entry->_address);
+
+    uint32_t start = CmdTotal();
+
+    builder();
+
+    uint32_t size = CmdTotal() - start + 4;
+
+    cmd_ENDLIST();
+
+    return ListCommit(id, size, false);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Record a display list snippet
+  //
+  // This calls the given function (e.g. a lambda) that generates
+  // co-processor commands, and lets the co-processor execute them as part
+  // of the current display list. The display list commands that the
+  // co-processor produced are then copied from RAM_DL to the cache with
+  // CMD_MEMCPY, so that AppendSnippet can add them to later display lists
+  // with CMD_APPEND, without executing the original commands again. This
+  // works on all chips, and is useful for widgets that take a lot of
+  // co-processor time, such as gauges, clocks and keys.
+  //
+  // This must be called between CMD_DLSTART and CMD_SWAP. The function
+  // waits for the co-processor twice (before and after the commands),
+  // because the REG_CMD_DL register is used to find out where the
+  // snippet starts and ends in the display list.
+  //
+  // The snippet contains display list commands only, so any graphics
+  // state that the commands depend on (e.g. the color or the vertex
+  // format) must be the same when the snippet is appended.
+  //
+  // If the snippet doesn't fit in the given maximum size, nothing is
+  // copied and the function returns false.
+  template<typename BUILDER>
+  bool                                  // Returns true=snippet recorded
+  RecordSnippet(
+    uint8_t id,                         // Index of the snippet in the cache
+    uint32_t maxsize,                   // Maximum size in bytes
+    BUILDER builder)                    // Function that generates commands
+  {
+    ListCacheEntry *entry = ListAllocate(id, maxsize);
+
+    if (!entry)
+    {
+      return false;
+    }
+
+    CmdExecute(true);
+    uint16_t start = RegRead16(REG_CMD_DL);
+
+    builder();
+
+    CmdExecute(true);
+    uint16_t end = RegRead16(REG_CMD_DL);
+
+    uint32_t length = (uint16_t)(end - start) % RAM_DL_SIZE;
+
+    if (length > entry->_size)
+    {
+      DBG_STAT("Snippet %u too big: %lu bytes, maximum %lu\n", id, length, entry->_size);
+      InvalidateList(id);
+      return false;
+    }
+
+    cmd_MEMCPY(entry->_address, RAM_DL + start, length);
+
+    return ListCommit(id, length, true);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Append a display list snippet that was recorded with RecordSnippet
+  //
+  // If the snippet isn't valid, nothing is sent and the function returns
+  // false, so the caller can generate the commands directly instead.
+  bool                                  // Returns true=snippet appended
+  AppendSnippet(
+    uint8_t id)                         // Index of the snippet in the cache
+  {
+    if ((!ListIsValid(id)) || (!_lists->_entries[id]._snippet))
+    {
+      return false;
+    }
+
+    cmd_APPEND(_lists->_entries[id]._address, _lists->_entries[id]._length);
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Call a command list that was recorded with RecordList
+  //
+  // If the list isn't valid, nothing is sent and the function returns
+  // false, so the caller can generate the commands directly instead.
+  bool                                  // Returns true=list called
+  CallList(
+    uint8_t id)                         // Index of the list in the cache
+  {
+    if ((!ListIsValid(id)) || (_lists->_entries[id]._snippet))
+    {
+      return false;
+    }
+
+    cmd_CALLLIST(_lists->_entries[id]._address);
+
+    return true;
+  }
+
+  //=========================================================================
+  // MEDIA FIFO
+  //=========================================================================
+  // The media FIFO is a ring buffer in RAM_G that CMD_LOADIMAGE and
+  // CMD_PLAYVIDEO can read from with OPT_MEDIAFIFO. The co-processor
+  // decodes the data while the host writes the next chunks, so the
+  // data doesn't have to go through the command queue, and its size
+  // isn't limited by the size of RAM_CMD or the free space in RAM_G.
+  //
+  // Typical use:
+  //   MediaFifoBegin(address, size);
+  //   MediaFifoLoadImage(dest, OPT_RGB565);
+  //   while (more data) MediaFifoWrite(chunk, chunklen);
+  //   CmdWaitComplete();
+
+public:
+  //-------------------------------------------------------------------------
+  // Set up a media FIFO
+  //
+  // The address and the size must be multiples of 4. The area in RAM_G
+  // must not be used for anything else while the FIFO is in use.
+  //
+  // CMD_MEDIAFIFO resets the read and write offsets, so this waits until
+  // the co-processor has executed it.
+  bool                                  // Returns true=success
+  MediaFifoBegin(
+    uint32_t address,                   // Address in RAM_G
+    uint32_t size)                      // Size in bytes
+  {
+    if ((address & 3) || (size & 3) || (size < 8) || (address + size > RAM_G_SIZE))
+    {
+      DBG_GEEK("Invalid media FIFO %lX size %lu\n", address, size);
+      return false;
+    }
+
+    bool error;
+
+    cmd_MEDIAFIFO(address, size);
+    CmdExecute(true, &error);
+
+    if (error)
+    {
+      return false;
+    }
+
+    _fifo_address = address;
+    _fifo_size = size;
+    _fifo_write = 0;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start loading an image from the media FIFO
+  //
+  // The command is sent and executed; the co-processor then waits for the
+  // image data to be written with MediaFifoWrite.
+  void MediaFifoLoadImage(
+    uint32_t ptr32,                     // Destination in RAM_G
+    OPT options)                        // Options for CMD_LOADIMAGE
+  {
+    cmd_LOADIMAGE(ptr32, (OPT)(options | OPT_MEDIAFIFO), 0, NULL);
+    CmdExecute();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start playing a video from the media FIFO
+  //
+  // The command is sent and executed; the co-processor then waits for the
+  // video data to be written with MediaFifoWrite.
+  void MediaFifoPlayVideo(
+    OPT options)                        // Options for CMD_PLAYVIDEO
+  {
+    cmd_PLAYVIDEO((OPT)(options | OPT_MEDIAFIFO));
+    CmdExecute();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the free space in the media FIFO
+  //
+  // The space is calculated from REG_MEDIAFIFO_READ. Four bytes are kept
+  // free, so that a full FIFO can be distinguished from an empty one.
+  uint32_t                              // Returns number of bytes free
+  MediaFifoSpace()
+  {
+    if (!_fifo_size)
+    {
+      return 0;
+    }
+
+    uint32_t readoffset = RegRead32(REG_MEDIAFIFO_READ);
+    uint32_t used = (_fifo_write + _fifo_size - readoffset) % _fifo_size;
+
+    return _fifo_size - 4 - used;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write data to the media FIFO
+  //
+  // The data is written at the write offset, wrapping around the end of
+  // the FIFO, and REG_MEDIAFIFO_WRITE is updated so the co-processor can
+  // read it.
+  //
+  // The data should be a multiple of 4 bytes, except for the last chunk
+  // of a file: that is padded with zeroes.
+  //
+  // If wait is true, the function keeps writing as space becomes
+  // available, until all data is written, or until the co-processor stops
+  // reading (e.g. because it reached the end of the image, or because of
+  // an error). Otherwise, only the data that fits in the current free
+  // space is written (in multiples of 4 bytes, unless all of it fits).
+  uint32_t                              // Returns number of bytes written
+  MediaFifoWrite(
+    const uint8_t *data,                // Data to write
+    uint32_t len,                       // Number of bytes
+    bool wait = true)                   // False=only write what fits now
+  {
+    uint32_t result = 0;
+    uint8_t attempt = 0;
+
+    while (len)
+    {
+      // The space is always a multiple of 4, so only the last chunk can
+      // need padding.
+      uint32_t space = MediaFifoSpace();
+
+      if (!space)
+      {
+        bool error;
+
+        if ((!wait) || (!CmdIsBusy(&error)))
+        {
+          break;
+        }
+
+        CmdPollWait(attempt);
+        continue;
+      }
+
+      uint32_t chunk = (len < space) ? len : space;
+
+      // Write up to the end of the FIFO, then wrap around
+      uint32_t first = _fifo_size - _fifo_write;
+
+      if (first > chunk)
+      {
+        first = chunk;
+      }
+
+      RegWriteBuffer(_fifo_address + _fifo_write, first, data);
+
+      if (chunk > first)
+      {
+        RegWriteBuffer(_fifo_address, chunk - first, data + first);
+      }
+
+      // Pad the last bytes to a whole word
+      uint32_t padding = (4 - (chunk & 3)) & 3;
+
+      for (uint32_t u = 0; u < padding; u++)
+      {
+        _hal.Send8(0);
+      }
+
+      STEVE_STAT(_stats._bytes_sent += padding);
+
+      _fifo_write = (_fifo_write + chunk + padding) % _fifo_size;
+      RegWrite32(REG_MEDIAFIFO_WRITE, _fifo_write);
+
+      data += chunk;
+      len -= chunk;
+      result += chunk;
+      attempt = 0;
+    }
+
+    return result;
+  }
+
+  //=========================================================================
+  // SHADOW GRAPHICS STATE
+  //=========================================================================
+  // The shadow state is a copy of part of the graphics context of the
+  // display list that's being built by the co-processor: the color, the
+  // alpha, the line width, the point size, the current primitive, the
+  // bitmap handle and cell, and the vertex format and translation. It's
+  // always kept up to date (CmdVertex uses it to pick the smallest vertex
+  // encoding), but only when it's enabled, state commands that wouldn't
+  // change anything are dropped by Cmd, which saves bytes on the bus and
+  // entries in the display list.
+  //
+  // CMD_DLSTART sets the state to the defaults that every display list
+  // starts with. The state becomes unknown when it can't be tracked: when
+  // a context is restored, when display list commands such as CALL or
+  // MACRO are used, and when any other co-processor command is sent,
+  // because many of those (e.g. widgets) generate display list commands
+  // of their own.
+  //
+  // Only commands that are sent through the cmd_ functions are tracked;
+  // the dl_ functions don't affect the shadow state.
+
+public:
+  //-------------------------------------------------------------------------
+  // Enable or disable the shadow state
+  void CmdSetShadowState(
+    bool enable)                        // True=drop redundant state cmds
   {
-    FUNC_NEVER                          = 0,
-    FUNC_LESS                           = 1,
-    FUNC_LEQUAL                         = 2,
-    FUNC_GREATER                        = 3,
-    FUNC_GEQUAL                         = 4,
-    FUNC_EQUAL                          = 5,
-    FUNC_NOTEQUAL                       = 6,
-    FUNC_ALWAYS                         = 7,
-  }   FUNC;
+    _shadow_enabled = enable;
 
-  // Graphics primitive operations for BEGIN (ProgGuide 4.5 Table 6 p.94)
-  typedef enum
+    ShadowReset();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Forget the shadow state
+  //
+  // Call this if the graphics state was changed in a way that Steve can't
+  // see, e.g. by a display list snippet that was appended.
+  void ShadowReset()
   {
-    BEGIN_BITMAPS                       = 1,
-    BEGIN_POINTS                        = 2,
-    BEGIN_LINES                         = 3,
-    BEGIN_LINE_STRIP                    = 4,
-    BEGIN_EDGE_STRIP_R                  = 5,
-    BEGIN_EDGE_STRIP_L                  = 6,
-    BEGIN_EDGE_STRIP_A                  = 7,
-    BEGIN_EDGE_STRIP_B                  = 8,
-    BEGIN_RECTS                         = 9,
-  }   BEGIN;
+    for (uint8_t u = 0; u < SHADOW_COUNT; u++)
+    {
+      _shadow[u] = SHADOW_UNKNOWN;
+    }
+  }
 
-  // Bitmap format for BITMAP_LAYOUT (ProgGuide 4.7 Table 7 p.97)
-  typedef enum
+protected:
+  //-------------------------------------------------------------------------
+  // Set the shadow state to the defaults at the start of a display list
+  void ShadowDefaults()
   {
-    FORMAT_ARGB1555                     = 0,
-    FORMAT_L1                           = 1,
-    FORMAT_L4                           = 2,
-    FORMAT_L8                           = 3,
-    FORMAT_RGB332                       = 4,
-    FORMAT_ARGB2                        = 5,
-    FORMAT_ARGB4                        = 6,
-    FORMAT_RGB565                       = 7,
-    FORMAT_TEXT8X8                      = 9,
-    FORMAT_TEXTVGA                      = 10,
-    FORMAT_BARGRAPH                     = 11,
-    FORMAT_PALETTED565                  = 14,
-    FORMAT_PALETTED4444                 = 15,
-    FORMAT_PALETTED8                    = 16,
-    FORMAT_L2                           = 17,
+    _shadow[SHADOW_COLOR_RGB]          = ENC_COLOR_RGB(255, 255, 255);
+    _shadow[SHADOW_COLOR_A]            = ENC_COLOR_A(255);
+    _shadow[SHADOW_LINE_WIDTH]         = ENC_LINE_WIDTH(16);
+    _shadow[SHADOW_POINT_SIZE]         = ENC_POINT_SIZE(16);
+    _shadow[SHADOW_BEGIN]              = SHADOW_UNKNOWN;
+    _shadow[SHADOW_BITMAP_HANDLE]      = ENC_BITMAP_HANDLE(0);
+    _shadow[SHADOW_CELL]               = ENC_CELL(0);
+    _shadow[SHADOW_VERTEX_FORMAT]      = ENC_VERTEX_FORMAT(4);
+    _shadow[SHADOW_VERTEX_TRANSLATE_X] = ENC_VERTEX_TRANSLATE_X(0);
+    _shadow[SHADOW_VERTEX_TRANSLATE_Y] = ENC_VERTEX_TRANSLATE_Y(0);
+  }
 
-    FORMAT_ARGB8                        = 0x20,         // Used by SNAPSHOT2 only
+protected:
+  //-------------------------------------------------------------------------
+  // Update the shadow state with a command
+  bool                                  // Returns false=command redundant
+  ShadowUpdate(
+    uint32_t command)                   // Command to check
+  {
+    SHADOW slot;
 
-    COMPRESSED_RGBA_ASTC_4x4_KHR        = 37808,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_5x4_KHR        = 37809,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_5x5_KHR        = 37810,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_6x5_KHR        = 37811,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_6x6_KHR        = 37812,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_8x5_KHR        = 37813,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_8x6_KHR        = 37814,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_8x8_KHR        = 37815,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_10x5_KHR       = 37816,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_10x6_KHR       = 37817,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_10x8_KHR       = 37818,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_10x10_KHR      = 37819,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_12x10_KHR      = 37820,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
-    COMPRESSED_RGBA_ASTC_12x12_KHR      = 37821,        // Used by BITMAP_EXT_FORMAT only (EVE3/EVE4)
+    if (command == ENC_CMD_DLSTART)
+    {
+      ShadowDefaults();
+      return true;
+    }
 
-  }   FORMAT;
+    switch (command & 0xFF000000UL)
+    {
+    case ENC_CMD_COLOR_RGB:       slot = SHADOW_COLOR_RGB;      break;
+    case ENC_CMD_COLOR_A:         slot = SHADOW_COLOR_A;        break;
+    case ENC_CMD_LINE_WIDTH:      slot = SHADOW_LINE_WIDTH;     break;
+    case ENC_CMD_POINT_SIZE:      slot = SHADOW_POINT_SIZE;     break;
+    case ENC_CMD_BEGIN:           slot = SHADOW_BEGIN;          break;
+    case ENC_CMD_BITMAP_HANDLE:   slot = SHADOW_BITMAP_HANDLE;  break;
+    case ENC_CMD_CELL:            slot = SHADOW_CELL;           break;
+    case ENC_CMD_VERTEX_FORMAT:   slot = SHADOW_VERTEX_FORMAT;  break;
+    case ENC_CMD_VERTEX_TRANSLATE_X: slot = SHADOW_VERTEX_TRANSLATE_X; break;
+    case ENC_CMD_VERTEX_TRANSLATE_Y: slot = SHADOW_VERTEX_TRANSLATE_Y; break;
+
+    case ENC_CMD_END:
+      _shadow[SHADOW_BEGIN] = SHADOW_UNKNOWN;
+      return true;
+
+    case ENC_CMD_CALL:
+    case ENC_CMD_JUMP:
+    case ENC_CMD_RETURN:
+    case ENC_CMD_MACRO:
+    case ENC_CMD_RESTORE_CONTEXT:
+    case 0xFF000000UL: // Co-processor commands
+      ShadowReset();
+      return true;
+
+    default:
+      return true;
+    }
 
-  // Bitmap filtering mode for BITMAP_SIZE (ProgGuide 4.9 p.103)
-  enum FILTER
+    if (_shadow[slot] == command)
+    {
+      return false;
+    }
+
+    _shadow[slot] = command;
+
+    return true;
+  }
+
+  //=========================================================================
+  // TRANSPORT STATISTICS
+  //=========================================================================
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the transport statistics
+  //
+  // If the statistics are compiled out (see STEVE_STATS), all counters are
+  // zero.
+  Stats                                 // Returns copy of the counters
+  GetStats() const
   {
-    FILTER_NEAREST                      = 0,
-    FILTER_BILINEAR                     = 1,
-  };
+#if STEVE_STATS
+    return _stats;
+#else
+    Stats result;
 
-  // Bitmap wrap mode for BITMAP_SIZE (ProgGuide 4.9 p.103)
-  enum WRAP
+    memset(&result, 0, sizeof(result));
+
+    return result;
+#endif
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  //
+  // This returns 0 if the HAL doesn't support it (see SteveHAL::Micros).
+  uint32_t                              // Returns timestamp in us
+  HostMicros()
   {
-    WRAP_BORDER                         = 0,
-    WRAP_REPEAT                         = 1,
-  };
+    return _hal.Micros();
+  }
 
-  // Blending factor for BLEND_FUNC (ProgGuide 4.18 Table 8 p.114)
-  enum BLEND
+public:
+  //-------------------------------------------------------------------------
+  // Wait for at least the requested time, using the HAL
+  void HostDelay(
+    uint32_t ms)                        // Number of milliseconds to wait
   {
-    BLEND_ZERO                          = 0,
-    BLEND_ONE                           = 1,
-    BLEND_SRC_ALPHA                     = 2,
-    BLEND_DST_ALPHA                     = 3,
-    BLEND_ONE_MINUS_SRC_ALPHA           = 4,
-    BLEND_ONE_MINUS_DST_ALPHA           = 5,
-  };
+    _hal.Delay(ms);
+  }
 
-  // Stencil operations for STENCIL_OP (ProgGuide 4.44 Figure 10 p.141)
-  enum STENCIL
+public:
+  //-------------------------------------------------------------------------
+  // Reset the transport statistics
+  void ResetStats()
   {
-    STENCIL_ZERO                        = 0,
-    STENCIL_KEEP                        = 1,
-    STENCIL_REPLACE                     = 2,
-    STENCIL_INCR                        = 3,
-    STENCIL_DECR                        = 4,
-    STENCIL_INVERT                      = 5,
-  };
+#if STEVE_STATS
+    memset(&_stats, 0, sizeof(_stats));
+    _stats_frame_start = 0;
+#endif
+  }
 
-  // Options for co-processor commands (ProgGuide 5.8 p.158)
-  // NOTE: These are flags; they may be combined.
-  // Remarks show commands for which the options are valid
-  enum OPT {
-    OPT_NONE                            = 0x0000,
-    OPT_3D                              = 0x0000,       // BUTTON, CLOCK, KEYS, GAUGE, SLIDER, DIAL, TOGGLE, PROGRESS, SCROLLBAR
-    OPT_RGB565                          = 0x0000,       // LOADIMAGE
-    OPT_MONO                            = 0x0001,       // LOADIMAGE
-    OPT_NODL                            = 0x0002,       // LOADIMAGE
-    OPT_NOTEAR                          = 0x0004,       // PLAYVIDEO
-    OPT_FULLSCREEN                      = 0x0008,       // PLAYVIDEO
-    OPT_MEDIAFIFO                       = 0x0010,       // PLAYVIDEO
-    OPT_SOUND                           = 0x0020,       // PLAYVIDEO
-    OPT_FLAT                            = 0x0100,       // BUTTON, CLOCK, KEYS, GAUGE, SLIDER, DIAL, TOGGLE, PROGRESS, SCROLLBAR
-    OPT_SIGNED                          = 0x0100,       // NUMBER
-    OPT_CENTERX                         = 0x0200,       // KEYS, TEXT, NUMBER
-    OPT_CENTERY                         = 0x0400,       // KEYS, TEXT, NUMBER
-    OPT_CENTER                          = 0x0600,       // KEYS, TEXT, NUMBER
-    OPT_RIGHTX                          = 0x0800,       // KEYS, TEXT, NUMBER
-    OPT_NOBACK                          = 0x1000,       // CLOCK, GAUGE
-    OPT_NOTICKS                         = 0x2000,       // CLOCK, GAUGE
-    OPT_NOHM                            = 0x4000,       // CLOCK
-    OPT_NOPOINTER                       = 0x4000,       // GAUGE
-    OPT_NOSECS                          = 0x8000,       // CLOCK
-    OPT_NOHANDS                         = 0xC000,       // CLOCK
-  }; // 16 bits
+  //=========================================================================
+  // INTERRUPTS
+  //=========================================================================
 
-  // Values for REG_DLSWAP (see ProgGuide p.30)
-  enum DLSWAP {
-    // Don't store this value; wait until the register is this value
-    // before storing another value.
-    DLSWAP_DONE                         = 0x0,
+public:
+  //-------------------------------------------------------------------------
+  // Enable or disable interrupts
+  //
+  // The mask is a combination of INT values. If it's nonzero, the !INT
+  // line of the EVE is activated when any of the corresponding flags is
+  // set, and it's released when the flags are read.
+  //
+  // If INT_CMDEMPTY is enabled, CmdWaitComplete waits for the !INT line by
+  // calling the WaitForInterrupt function of the HAL, instead of polling
+  // the co-processor with increasing delays. If the HAL has access to the
+  // !INT line, that frees the SPI bus, and the host can sleep in the mean
+  // time. INT_SWAP can be used with WaitInterrupt to wait for the end of
+  // a frame.
+  //
+  // Begin disables all interrupts.
+  //
+  // Normally, old flags are cleared. To change the mask while interrupts
+  // are in use, without losing flags that weren't handled yet, set the
+  // clear parameter to false.
+  void EnableInterrupts(
+    uint16_t mask,                      // Combination of INT values
+    bool clear = true)                  // False=keep old flags
+  {
+    RegWrite16(REG_INT_MASK, mask);
+    RegWrite8(REG_INT_EN, mask ? 1 : 0);
 
-    DLSWAP_LINE                         = 0x1,          // Start reading from current DL after current line
-    DLSWAP_FRAME                        = 0x2,          // Start reading from current DL after current frame
-  }; // 2 bits
+    _int_mask = mask;
 
-  // Values for REG_INT_EN and REG_INT_FLAGS (see Datasheet 4.1.6 p.20)
-  // NOTE: These are flags; they may be combined.
-  enum INT // 8 bits (EVE2/EVE3), 9 bits (EVE4)
+    if (clear)
+    {
+      // Clear any old flags
+      RegRead16(REG_INT_FLAGS);
+      _int_flags = 0;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the enabled interrupts
+  uint16_t                              // Returns mask of INT values
+  Interrupts()
   {
-    // [DS2 p20][DS3 p19]
-    INT_SWAP                            = 0x001,        // DL swap occurred
-    INT_TOUCH                           = 0x002,        // Touch detected
-    INT_TAG                             = 0x004,        // Touch screen tag value changed
-    INT_SOUND                           = 0x008,        // Sound effect ended
-    INT_PLAYBACK                        = 0x010,        // Audio playback ended
-    INT_CMDEMPTY                        = 0x020,        // Command FIFO empty
-    INT_CMDFLAG                         = 0x040,        // Flag set by command
-    INT_CONVCOMPLETE                    = 0x080,        // Touch screen conversion complete
-    INT_UNDERRUN                        = 0x100,        // (EVE4 only) Graphics pipeline underrun
+    return _int_mask;
+  }
 
-    //INT_L8C                           = 0x0C,         // 
-    //INT_VGA                           = 0x0D,         // 
-    //INT_G8                            = 0x12,         // 
-  }; // 8 bits
+public:
+  //-------------------------------------------------------------------------
+  // Check if an interrupt may be pending, without using the SPI bus
+  //
+  // If the HAL can see the !INT line, this can be used to avoid reading
+  // REG_INT_FLAGS when nothing happened. If the HAL can't see the line,
+  // this always returns true.
+  bool                                  // Returns true=!INT active or unknown
+  IntPending()
+  {
+    return _hal.WaitForInterrupt(0);
+  }
 
-  // Values for REG_PLAYBACK_FORMAT (see ProgGuide p.40)
-  enum SAMPLES {
-    SAMPLES_LINEAR                      = 0x0,          // Linear audio samples
-    SAMPLES_ULAW                        = 0x1,          // uLaw audio samples
-    SAMPLES_ADPCM                       = 0x2,          // IMA ADPCM audio samples
-  }; // 2 bits
+public:
+  //-------------------------------------------------------------------------
+  // Read the interrupt flags
+  //
+  // Reading REG_INT_FLAGS clears the flags in the EVE, so the flags are
+  // remembered until they're handled by WaitInterrupt or IntClearFlags.
+  uint16_t                              // Returns set flags; INT values
+  IntReadFlags()
+  {
+    _int_flags |= RegRead16(REG_INT_FLAGS);
 
-  // Values for REG_TOUCH_MODE (see ProgGuide p.58)
-  enum TOUCHMODE {
-    TOUCHMODE_OFF                       = 0x0,          // Touch mode off
-    TOUCHMODE_ONESHOT                   = 0x1,          // Read one touch sample
-    TOUCHMODE_FRAME                     = 0x2,          // Read one touch sample each frame
-    TOUCHMODE_CONTINUOUS                = 0x3,          // Continuous touch mode up to 1000 Hz
-  }; // 2 bits
+    return _int_flags;
+  }
 
-  // Values for CMD_APILEVEL (EVE4 only)
-  enum APILEVEL
+public:
+  //-------------------------------------------------------------------------
+  // Clear interrupt flags that were handled
+  void IntClearFlags(
+    uint16_t flags)                     // Flags to clear; INT values
   {
-    APILEVEL_BT815                      = 1,            // BT815 (EVE3) mode
-    APILEVEL_BT817_BT818                = 2,            // BT817/818 (EVE4) mode
-  };
+    _int_flags &= ~flags;
+  }
 
-  // Values for CMD_ANIMSTART (EVE4 only)
+public:
+  //-------------------------------------------------------------------------
+  // Wait for an interrupt
   //
-  // Not documented; found in EVE_defines.h from Bridgetek.
-  enum ANIM
+  // This waits until one of the given flags is set, or until the timeout
+  // expires. The flags that were found are cleared.
+  //
+  // The timeout is approximate: the HAL is called to wait for the !INT
+  // line for short periods, and when the line is activated by other
+  // interrupts (or if the HAL can't see the line), each wait is counted
+  // as one millisecond.
+  //
+  // The flags must be enabled with EnableInterrupts first.
+  uint16_t                              // Returns found flags, 0=timeout
+  WaitInterrupt(
+    uint16_t flags,                     // Flags to wait for; INT values
+    uint32_t timeout_ms)                // Maximum time to wait (ms)
   {
-    ANIM_ONCE                           = 0,            // Play animation once
-    ANIM_LOOP                           = 1,            // Keep looping
-    ANIM_HOLD                           = 2,            // Hold
-  };
+    uint16_t result = IntReadFlags() & flags;
 
-  //=========================================================================
-  // DATA MEMBERS
-  //=========================================================================
+    while ((!result) && (timeout_ms))
+    {
+      uint32_t slice = (timeout_ms < INT_WAIT_TIMEOUT_MS) ? timeout_ms : INT_WAIT_TIMEOUT_MS;
 
-protected:
-  const SteveDisplay
-                   &_profile;           // Display init parameters
-  SteveHAL         &_hal;               // Communication functions
+      if (_hal.WaitForInterrupt(slice))
+      {
+        result = IntReadFlags() & flags;
+        timeout_ms--;
+      }
+      else
+      {
+        timeout_ms -= slice;
+      }
+    }
 
-  // Cached constants
-  const uint16_t    _hcenter;           // Horizontal center in pixels
-  const uint16_t    _vcenter;           // Vertical center in pixels_
+    _int_flags &= ~result;
 
-  // State variables
-  CmdIndex          _cmd_index;         // Graphics engine cmd write index
-                                        //   (offset from RAM_CMD)
-  DLIndex           _dl_index;          // Display list write index
-                                        //   (offset from RAM_DL)
+    return result;
+  }
 
   //=========================================================================
-  // CONSTRUCTOR
+  // DISPLAY LIST FUNCTIONS
   //=========================================================================
+  // NOTE: The display list is used internally. It only supports
+  // the "simple" commands that are encoded with the ENC_* functions.
+  // In most cases it's easiest to use the co-processor, so this section
+  // is safe to ignore when you're trying to understand the EVE.
+  //
+  // See ProgGuide 5.4 p.154 about how to synchronize the display list
+  // with the co-processor command queue.
 
 public:
   //-------------------------------------------------------------------------
-  // Constructor
-  Steve(
-    const SteveDisplay &profile,        // Display profile
-    SteveHAL &hal)                      // Hardware functions
-    : _profile(profile)
-    , _hal(hal)
-    , _hcenter(profile._hsize / 2)
-    , _vcenter(profile._vsize / 2)
-    , _cmd_index()
-    , _dl_index()
+  // Reset the display list index
+  //
+  // NOTE: It shouldn't be necessary to get the display list index
+  // without storing a command first, so there is no function to get the
+  // current index without storing anything.
+  void DLResetIndex(
+    uint16_t index = 0)                 // New index
   {
-    // Nothing here
-  }
+    DBG_TRAFFIC("DL reset %u\n", index);
 
-  //=========================================================================
-  // CONST FUNCTIONS TO ACCESS DISPLAY PARAMETERS
-  //=========================================================================
+    _dl_index = index;
+  }
 
 public:
   //-------------------------------------------------------------------------
-  // Get a pointer to the profile
-  const SteveDisplay *Profile() const
+  // Store a 32 bit display list command
+  //
+  // The class keeps track of the current location and updates it to the
+  // next location. Normally it's not necessary to do anything with the
+  // return value.
+  //
+  // Normally each command is written in a separate transaction. Between
+  // DLBurstBegin and DLBurstEnd, the commands are collected in the host
+  // buffer (see DLSetBuffer), or if there is none, they're sent in a
+  // write transaction that stays open until something else is sent.
+  //
+  // Referred to as "dl" in the documentation.
+  DLIndex                               // Returns updated DL index
+  DLAdd(
+    uint32_t value)                     // Value to write
   {
-    return &_profile;
+    DBG_TRAFFIC("dl(%08lX)\n", value);
+
+    if (!_dl_burst)
+    {
+      RegWrite32(RAM_DL + _dl_index.index(), value);
+    }
+    else if (_dl_buffer)
+    {
+      if (_dl_buffered >= _dl_buffer_size)
+      {
+        DLFlush();
+      }
+
+      _dl_buffer[_dl_buffered++] = value;
+    }
+    else
+    {
+      if (!_dl_stream)
+      {
+        BeginMemoryTransaction(RAM_DL + _dl_index.index(), true);
+
+        _dl_stream = true;
+      }
+
+      _hal.Send32(value);
+      STEVE_STAT(_stats._bytes_sent += 4);
+    }
+
+    _dl_index += 4;
+
+    // The next write after wrapping around needs a new address
+    if (!_dl_index.index())
+    {
+      _dl_stream = false;
+    }
+
+    return _dl_index;
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Get display width
-  uint16_t                              // Returns width in pixels
-  Width() const
+  // Store a precompiled array of display list commands
+  //
+  // The commands are written in one transaction (two if the display list
+  // index wraps around). The array can be built with the ENC_ functions,
+  // which are constexpr, so it can be a constant table. If progmem is
+  // true, the array is in program memory (e.g. declared with PROGMEM on
+  // AVR), see SteveHAL::SendBufferProgmem.
+  //
+  // Arrays in RAM are sent with SteveHAL::SendWords. Arrays in program
+  // memory are sent as bytes, so they only work on little-endian hosts.
+  DLIndex                               // Returns updated DL index
+  DLSendStatic(
+    const uint32_t *words,              // Commands to store
+    uint32_t count,                     // Number of commands
+    bool progmem = false)               // True=array is in program memory
   {
-    return _profile._hsize;
+    DBG_TRAFFIC("dl static %lu words\n", count);
+
+    const uint8_t *data = (const uint8_t *)words;
+    uint32_t len = count * 4;
+
+    while (len)
+    {
+      uint32_t chunk = RAM_DL_SIZE - _dl_index.index();
+
+      if (chunk > len)
+      {
+        chunk = len;
+      }
+
+      BeginMemoryTransaction(RAM_DL + _dl_index.index(), true);
+
+      if (progmem)
+      {
+        _hal.SendBufferProgmem(data, chunk);
+      }
+      else
+      {
+        _hal.SendWords((const uint32_t *)data, chunk / 4);
+      }
+
+      STEVE_STAT(_stats._bytes_sent += chunk);
+
+      _dl_index += (int16_t)chunk;
+      data += chunk;
+      len -= chunk;
+    }
+
+    return _dl_index;
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Get display height
-  uint16_t                              // Returns height in pixels
-  Height() const
+  // Set a host buffer for direct display lists
+  //
+  // Between DLBurstBegin and DLBurstEnd, DLAdd stores the commands in the
+  // buffer, and the buffer is written to RAM_DL in one transaction when
+  // it's full and at the end. This keeps the bus free for other traffic
+  // while the list is being built. Without a buffer (NULL), the commands
+  // are streamed to RAM_DL as they're added.
+  //
+  // This must not be called between DLBurstBegin and DLBurstEnd.
+  void DLSetBuffer(
+    uint32_t *buffer,                   // Buffer, NULL=none
+    uint16_t count)                     // Size of buffer in words
   {
-    return _profile._vsize;
+    _dl_buffer = count ? buffer : NULL;
+    _dl_buffer_size = count;
+    _dl_buffered = 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write the host display list buffer to RAM_DL
+  void DLFlush()
+  {
+    uint16_t count = _dl_buffered;
+
+    if (count)
+    {
+      _dl_buffered = 0;
+
+      // The index is already past the buffered commands
+      _dl_index -= (int16_t)(count * 4);
+
+      DLSendStatic(_dl_buffer, count);
+    }
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Get horizontal center
-  uint16_t                              // Returns horizontal center (pixels)
-  HCenter() const
+  // Start a direct display list
+  //
+  // This starts a new display list at the beginning of RAM_DL, which is
+  // written without the co-processor (see DLAdd). It must not be used
+  // while the co-processor builds display lists.
+  //
+  // If the previous direct list may not have been swapped in yet, this
+  // waits for REG_DLSWAP to become DLSWAP_DONE first, because the EVE
+  // would otherwise show a partly overwritten list. If that doesn't
+  // happen in time, the list is not started.
+  bool                                  // Returns false=previous swap busy
+  DLBurstBegin()
   {
-    return _hcenter;
+    if (_dl_swap_pending)
+    {
+      if (!RegWait8(REG_DLSWAP, DLSWAP_DONE, DLSWAP_TRIES, DLSWAP_DELAY))
+      {
+        DBG_STAT("Display list swap didn't finish\n");
+        return false;
+      }
+
+      _dl_swap_pending = false;
+    }
+
+    _dl_index = 0;
+    _dl_buffered = 0;
+    _dl_burst = true;
+
+    return true;
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Get vertical center
-  uint16_t                              // Returns vertical center (pixels)
-  VCenter() const
+  // Finish a direct display list and swap it in
+  //
+  // In mode DLSWAP_LINE, the new list is used after the current line is
+  // done, so it appears with the lowest latency (possibly with tearing).
+  // In mode DLSWAP_FRAME, it's used at the start of the next frame. The
+  // function doesn't wait for the swap; the next DLBurstBegin does. The
+  // list should end with dl_DISPLAY.
+  void DLBurstEnd(
+    DLSWAP mode = DLSWAP_FRAME)         // When to swap
   {
-    return _vcenter;
+    DLFlush();
+
+    _dl_burst = false;
+
+    RegWrite32(REG_DLSWAP, mode);
+
+    _dl_swap_pending = true;
   }
 
   //=========================================================================
-  // LOW-LEVEL INIT/EXIT
+  // CO-PROCESSOR SUPPORT
   //=========================================================================
 
-protected:
+public:
   //-------------------------------------------------------------------------
-  // Early initialization virtual function
+  // Read a 32 bit value from the given Cmd index
   //
-  // This gets called by Begin after starting the chip but before
-  // initializing the timing registers.
-  // Specific subclasses can use this to work around bugs.
-  virtual bool                          // Returns true=success false=failure
-  EarlyInit()
+  // This can be used to retrieve a value that gets stored by the
+  // co-processor into the output parameters of a command.
+  uint32_t                              // Returns value
+  CmdRead32(
+    CmdIndex cmdindex)                  // Command index to read from
   {
-    // EVE_Init_Goodix_GT911()
-    // EVE_Init_Pen_Up_Bug_Fix()
-    return true;
+    return RegRead32(RAM_CMD + cmdindex.index());
   }
 
-protected:
+public:
   //-------------------------------------------------------------------------
-  // Touch screen initialization
+  // Defer reading a command output
   //
-  // This gets called by Begin to initialize the touch screen and
-  // work around bugs.
-  // The implementation here switches the touch functionality off. This
-  // can be used for projects that don't require touch, regardless of
-  // whether the EVE has touch screen support.
-  virtual bool                          // Returns true=success false=failure
-  TouchInit()
+  // Call this right after the command that stores the output, with the
+  // Cmd index that the command returned for it (see CmdOutputs). Outputs
+  // must be added in the order in which they're stored.
+  uint8_t                               // Returns id, INVALID_OUTPUT=full
+  CmdDefer(
+    CmdOutputs &outputs,                // Set of outputs
+    CmdIndex cmdindex)                  // Cmd index of output value
   {
-    // Disable touch
-    RegWrite8(REG_TOUCH_MODE, 0);
-    // Eliminate any false touches
-    RegWrite16(REG_TOUCH_RZTHRESH, 0);
+    if ((outputs._count) && (outputs._epoch != _cmd_epoch))
+    {
+      // The queue was reset; the old outputs are gone
+      CmdResolve(outputs);
+    }
 
-    return true;
-  }
+    if (outputs._count >= outputs._max)
+    {
+      DBG_STAT("Command outputs full\n");
+      return INVALID_OUTPUT;
+    }
 
-  //=========================================================================
-  // PUBLIC INIT/EXIT FUNCTIONS
-  //=========================================================================
+    typename CmdOutputs::Entry &e = outputs._entries[outputs._count];
+
+    // The location in the stream is based on the total so far, which
+    // includes the staged commands
+    e._total = CmdTotal() - (_cmd_index - (int16_t)cmdindex.index()).index();
+    e._offset = cmdindex.index();
+    e._value = 0;
+    e._state = CmdOutputs::STATE_PENDING;
+
+    outputs._epoch = _cmd_epoch;
+    outputs._pending++;
+
+    return outputs._count++;
+  }
 
 public:
   //-------------------------------------------------------------------------
-  // Initialize the display
+  // Read the deferred command outputs that the co-processor has stored
   //
-  // See ProgGuide 2.3 p.11
-  bool                                  // Returns true=success false=failure
-  Begin()
+  // This reads REG_CMD_READ once to find out how far the co-processor
+  // got (or waits until it's done, if requested), and then reads the
+  // outputs that are available, combining outputs that are close
+  // together into one transaction.
+  //
+  // Call this regularly, e.g. once per frame; outputs that are overwritten
+  // by more than RAM_CMD_SIZE bytes of later commands are lost.
+  uint8_t                               // Returns number of pending outputs
+  CmdResolve(
+    CmdOutputs &outputs,                // Set of outputs
+    bool wait = false)                  // True=execute and wait until done
   {
-    // Wake up the EVE
-    DBG_GEEK("Begin\n");
+    typename CmdOutputs::Entry *entries = outputs._entries;
+    bool error = false;
 
-    if (!_hal.Begin())
+    outputs._windows = 0;
+
+    if (!outputs._pending)
     {
-      return false;
+      return 0;
     }
 
-    InternalEnd();
-
-    _hal.Power(true);                   // Power on
-    _hal.Delay(21);                     // More holding
+    if (outputs._epoch == _cmd_epoch)
+    {
+      if (wait)
+      {
+        CmdExecute(true, &error);
+      }
+      else
+      {
+        CmdReadIndex(&error);
+      }
+    }
 
-    // Select the chip and initialize the SPI bus in slow mode until
-    // the EVE clock is initialized
-    _hal.Select(true);
-    _hal.Init(true);
+    uint8_t u = 0;
 
-    // Select the internal or external clock, and select the PLL
-    // multiplier for an external clock as necessary.
-    if (_profile._clkext)
+    while (u < outputs._count)
     {
-      HostCommand(HOSTCMD_CLKEXT);
+      typename CmdOutputs::Entry &e = entries[u];
+
+      if (e._state != CmdOutputs::STATE_PENDING)
+      {
+        u++;
+        continue;
+      }
+
+      if ((error) || (outputs._epoch != _cmd_epoch) || ((int32_t)(_cmd_sent_total - (e._total + RAM_CMD_SIZE)) > 0))
+      {
+        DBG_STAT("Command output lost\n");
+
+        e._state = CmdOutputs::STATE_LOST;
+        outputs._pending--;
+        u++;
+        continue;
+      }
+
+      if ((int32_t)(_cmd_done_total - (e._total + 4)) < 0)
+      {
+        // Not executed yet; neither are the outputs after this one
+        break;
+      }
+
+      // Collect the outputs that fit in the same window
+      uint32_t start = e._total;
+      uint8_t end = u + 1;
+
+      while ((end < outputs._count)
+        && (entries[end]._state == CmdOutputs::STATE_PENDING)
+        && ((int32_t)(_cmd_done_total - (entries[end]._total + 4)) >= 0)
+        && (entries[end]._total + 4 - start <= OUTPUT_WINDOW))
+      {
+        end++;
+      }
+
+      uint8_t buf[OUTPUT_WINDOW];
+      uint16_t len = (uint16_t)(entries[end - 1]._total + 4 - start);
+      // The stream total starts at 0 when the queue is synchronized,
+      // which isn't necessarily the start of RAM_CMD
+      uint16_t offset = entries[u]._offset;
+      uint16_t first = len;
+
+      if (offset + len > RAM_CMD_SIZE)
+      {
+        first = (uint16_t)(RAM_CMD_SIZE - offset);
+
+        RegReadBuffer(RAM_CMD, len - first, buf + first);
+      }
+
+      RegReadBuffer(RAM_CMD + offset, first, buf);
+
+      outputs._windows++;
+
+      for (; u < end; u++)
+      {
+        const uint8_t *p = buf + (entries[u]._total - start);
+
+        entries[u]._value = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        entries[u]._state = CmdOutputs::STATE_READY;
+        outputs._pending--;
+      }
     }
-    else
+
+    return outputs._pending;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write a block of data to RAM_G and verify it
+  //
+  // Instead of reading the data back, which takes as long as writing it,
+  // the co-processor calculates the CRC of each chunk with CMD_MEMCRC, and
+  // only the CRCs are read back (as deferred outputs, see CmdOutputs)
+  // to be compared to the CRC that the host calculated (see Crc32). The
+  // host calculates its CRC after sending each chunk, so with HALs that
+  // send in the background, the two overlap.
+  //
+  // A chunk whose CRC doesn't match is sent again, up to the given number
+  // of tries; the other chunks aren't. Smaller chunks make retries cheaper
+  // but take one command per chunk. If the chunk size is 0, the whole
+  // block is one chunk.
+  //
+  // This uses the co-processor, so it waits until the co-processor is
+  // done with the commands that were queued before, and it shouldn't be
+  // called while a frame is being built.
+  bool                                  // Returns false=verification failed
+  UploadVerified(
+    uint32_t address22,                 // Address in RAM_G
+    const uint8_t *data,                // Data to write
+    uint32_t len,                       // Number of bytes
+    uint32_t chunksize = 0,             // Bytes per CRC, 0=one CRC
+    uint8_t tries = UPLOAD_TRIES)       // Maximum sends per chunk
+  {
+    static_assert(UPLOAD_CHUNKS <= 8, "Chunks don't fit in the bitmask");
+
+    if ((!chunksize) || (chunksize > len))
     {
-      HostCommand(HOSTCMD_CLKINT);
+      chunksize = len;
     }
 
-    HostCommand(HOSTCMD_CLKSEL, _profile._clksel);
-
-    // Activate the FT81X and give it some time to initialize
-    HostCommand(HOSTCMD_ACTIVE, 0);
-    _hal.Delay(40);
+    // The queued commands may still use the memory that's overwritten
+    bool error;
 
-    // Re-init in fast mode
-    _hal.Init(false);
+    CmdExecute(true, &error);
 
-    // Repeatedly poll REG_ID with up to 250 maximum retries and a 1 ms
-    // delay between retries.
-    // The register should return 0x7C when the processor is running.
-    if (!RegWait8(REG_ID, 0x7C, 250, 1))
+    if (error)
     {
-      DBG_STAT("Timeout waiting for ID of 0x7C.\n");
-      DBG_STAT("Is the device connected? Is the right EVE device selected?\n");
+      DBG_STAT("Co-processor error, not uploading\n");
       return false;
     }
 
-    // Repeatedly poll REG_CPURESET until it returns 0 meaning the reset
-    // is complete
-    while (!RegWait8(REG_CPURESET, 0, 250, 1))
-    {
-      DBG_STAT("Timeout waiting for EVE CPU reset.\n");
-      DBG_STAT("Is the device connected? Is the right EVE device selected?\n");
-      // TODO: in at the top, out at the bottom
-      return false;
-    }
+    uint32_t offset = 0;
 
-    // Read the chip ID and match it with the expected value
-    if (_profile._chipid != SteveDisplay::CHIPID_ANY)
+    while (offset < len)
     {
-      uint32_t chip_id = RegRead32(REG_CHIP_ID);
-      if (_profile._chipid != (SteveDisplay::CHIPID)chip_id)
+      CmdOutputTable<UPLOAD_CHUNKS> outputs;
+      uint32_t crc[UPLOAD_CHUNKS];
+      uint8_t id[UPLOAD_CHUNKS];
+      uint8_t count = 0;
+
+      // Number of chunks in this group
+      while ((count < UPLOAD_CHUNKS) && (offset + count * chunksize < len))
       {
-        DBG_STAT("Chip ID mismatch: Wanted %08lX, got %08lX\n", _profile._chipid, chip_id);
-        // TODO: in at the top, out at the bottom
-        return false;
+        count++;
       }
-    }
 
-    // Store the frequency in the register if requested
-    if (_profile._frequency)
-    {
-      RegWrite32(REG_FREQUENCY, _profile._frequency);
-    }
+      uint8_t bad = (uint8_t)((1U << count) - 1);
 
-    // Get the current write pointer from the EVE
-    CmdInitWriteIndex();
+      for (uint8_t attempt = 0; bad; attempt++)
+      {
+        if (attempt >= tries)
+        {
+          DBG_STAT("Upload to %lX failed verification\n", address22 + offset);
+          return false;
+        }
+
+        outputs.Clear();
+
+        for (uint8_t u = 0; u < count; u++)
+        {
+          if (!(bad & (1U << u)))
+          {
+            id[u] = INVALID_OUTPUT;
+            continue;
+          }
+
+          uint32_t start = offset + u * chunksize;
+          uint32_t size = (len - start < chunksize) ? len - start : chunksize;
+          CmdIndex result;
+
+          if (attempt)
+          {
+            STEVE_STAT(_stats._upload_retries++);
+          }
+
+          RegWriteBuffer(address22 + start, size, data + start);
+          crc[u] = Crc32(data + start, size);
+
+          cmd_MEMCRC(address22 + start, size, &result);
+          id[u] = CmdDefer(outputs, result);
+        }
+
+        CmdResolve(outputs, true);
+
+        for (uint8_t u = 0; u < count; u++)
+        {
+          if ((id[u] != INVALID_OUTPUT) && (outputs.IsReady(id[u])) && (outputs.Get(id[u]) == crc[u]))
+          {
+            bad &= (uint8_t)~(1U << u);
+          }
+          else if (bad & (1U << u))
+          {
+            DBG_GEEK("CRC mismatch at %lX, sending again\n", address22 + offset + u * chunksize);
+          }
+        }
+      }
 
-    // Execute bug workarounds for specific subclasses
-    if (!EarlyInit())
-    {
-      // TODO: in at the top, out at the bottom
-      return false;
+      offset += count * chunksize;
     }
 
-    // Set PCLK to zero; don't clock the LCD until later
-    RegWrite8(REG_PCLK, 0);
+    return true;
+  }
 
-    // Turn off backlight
-    RegWrite8(REG_PWM_DUTY, 0);
+public:
+  //-------------------------------------------------------------------------
+  // Synchronize the local command write index
+  //
+  // The co-processor executes commands from, and updates the command
+  // read index, until it reaches the command write index. So when we
+  // want to start to write a sequence of commands for the co-processor,
+  // we should synchronize our own write index to the write index of the
+  // co-processor. When we're done writing commands, we will set the
+  // write index to the end of the list.
+  //
+  // This function basically cancels all commands that were already queued
+  // for the co-processor (if any), and restarts the building of the queue.
+  CmdIndex                              // Returns updated Cmd index
+  CmdInitWriteIndex()
+  {
+    DBG_TRAFFIC("Reading REG_CMD_WRITE\n");
 
-    // Initialize display parameters
-    RegWrite16(REG_HSIZE,   _profile._hsize);   // active display width
-    RegWrite16(REG_HCYCLE,  _profile._hcycle);  // total number of clocks per line, incl front/back porch
-    RegWrite16(REG_HOFFSET, _profile._hoffset); // start of active line
-    RegWrite16(REG_HSYNC0,  _profile._hsync0);  // start of horizontal sync pulse
-    RegWrite16(REG_HSYNC1,  _profile._hsync1);  // end of horizontal sync pulse
-    RegWrite16(REG_VSIZE,   _profile._vsize);   // active display height
-    RegWrite16(REG_VCYCLE,  _profile._vcycle);  // total number of lines per screen, incl pre/post
-    RegWrite16(REG_VOFFSET, _profile._voffset); // start of active screen
-    RegWrite16(REG_VSYNC0,  _profile._vsync0);  // start of vertical sync pulse
-    RegWrite16(REG_VSYNC1,  _profile._vsync1);  // end of vertical sync pulse
-    RegWrite8(REG_SWIZZLE,  _profile._swizzle); // FT800 output to LCD - pin order
-    RegWrite8(REG_PCLK_POL, _profile._pclkpol); // LCD data is clocked in on this PCLK edge
-    // Don't set PCLK yet - wait for just after the first display list
+    _cmd_index = CmdIndex(RegRead16(REG_CMD_WRITE));
 
-    // Set 10 mA or 5 mA drive for PCLK, DISP, VSYNC, DE, RGB lines and
-    // back light PWM.
-    if (_profile._lcd10ma)
-    {
-      RegWrite16(REG_GPIOX, RegRead16(REG_GPIOX) | 0x1000);
-    }
-    else
-    {
-      RegWrite16(REG_GPIOX, RegRead16(REG_GPIOX) & ~0x1000);
-    }
+    // Force a refresh of the free space and the read index
+    _cmd_space = 0;
+    _cmd_read = READ_INDEX_ERROR;
 
-    // Change the driving strength for any pins that have an explicit
-    // setting.
-    if (_profile._pindrivetable)
-    {
-      const uint8_t *p;
+    // Forget about any frames in flight and any deferred outputs
+    _cmd_sent_total = 0;
+    _cmd_done_total = 0;
+    _frames_pending = 0;
+    _cmd_epoch++;
 
-      for (p = _profile._pindrivetable; *p != 0xFF; p++)
-      {
-        HostCommand(HOSTCMD_PINDRIVE, *p);
-      }
+    // Discard any staged commands
+    if (_staging)
+    {
+      _staging->_length = 0;
+      _staging_index = _cmd_index;
     }
 
-    // Enable or disable RGB clock spreading for reduced noise
-    RegWrite8(REG_CSPREAD, _profile._cspread ? 1 : 0);
+    _dedup_armed = false;
 
-    // Enable or disable dithering
-    RegWrite8(REG_DITHER, _profile._dither ? 1 : 0);
+    return _cmd_index;
+  }
 
-    // Enable output bits on LCD outputs
-    // Encoded as 3 values in 3 groups of 3 bits.
-    // 0b0000_000R_RRGG_GBBB
-    //                   --- Number of bits used for Blue
-    //               ----    Number of bits used for Green
-    //           ----        Number of bits used for Red
-    //   --------            Reserved
-    // If set to 0 (default), the EVE uses 8 bits (FT812/FT813) or 6 bits
-    // (FT810/FT811).
-    if (_profile._outbits)
-    {
-      RegWrite16(REG_OUTBITS, _profile._outbits);
-    }
+protected:
+  //-------------------------------------------------------------------------
+  // Get the index up to where commands were sent to the EVE
+  //
+  // Commands that are still in the staging buffer haven't been sent to
+  // the EVE yet, so the co-processor can't get to them.
+  CmdIndex                              // Returns index after sent data
+  CmdSentIndex() const
+  {
+    return _staging ? _staging_index : _cmd_index;
+  }
 
-    // Touch screen initialization
-    if (!TouchInit())
-    {
-      // TODO: in at the top, out at the bottom
-      return false;
-    }
+protected:
+  //-------------------------------------------------------------------------
+  // Get the total number of bytes stored in the command queue so far
+  //
+  // This includes the commands that are still in the staging buffer.
+  uint32_t                              // Returns running total (wraps)
+  CmdTotal() const
+  {
+    return _cmd_sent_total + (_staging ? _staging->_length : 0);
+  }
 
-    // TODO: Audio off
+protected:
+  //-------------------------------------------------------------------------
+  // Read the co-processor read index
+  //
+  // The value is cached, and the estimate of the free space in the command
+  // queue is updated from it: the co-processor frees up space by reading
+  // from the queue.
+  uint16_t                              // Returns REG_CMD_READ value
+  CmdReadIndex(
+    bool *pError = NULL)                // Optional output true=error
+  {
+    uint16_t readindex = RegRead16(REG_CMD_READ);
 
-    // Write the initial display list directly to RAM_DL; the coprocessor
-    // may not be available this early.
-    // This just shows a black screen
-    _dl_index = 0;
-    dl_CLEAR_COLOR(0);
-    dl_CLEAR(1, 1, 1); // color, stencil, tag
-    dl_DISPLAY();
+    bool error = (readindex == READ_INDEX_ERROR);
 
-    // Tell the EVE that it can swap display lists at the next available
-    // frame boundary.
-    // TODO: Make this a parameter for Begin()?
-    RegWrite32(REG_DLSWAP, DLSWAP_FRAME);
+    if (pError)
+    {
+      *pError = error;
+    }
 
-    // Enable the DISP line of the LCD.
-    // That output line is always controlled by the same register regardless
-    // of the LCD type.
-    RegWrite16(REG_GPIOX, RegRead16(REG_GPIOX) | 0x8000);
+    _cmd_read = readindex;
 
-    // Now start clocking the data to the LCD panel
-    RegWrite8(REG_PCLK, _profile._pclk);
+    if (error)
+    {
+      _cmd_space = 0;
+    }
+    else
+    {
+      // Calculate the used space by subtracting the read index from
+      // the write index. This value is wrapped around the maximum value.
+      uint16_t used_space = (CmdSentIndex() - readindex).index();
 
-    // Initialize backlight
-    // TODO: Make these into parameter for Begin()?
-    RegWrite16(REG_PWM_HZ, 300);
-    RegWrite8(REG_PWM_DUTY, 32);
+      // Subtract the used space from the total space but reduce the
+      // total space by 4 to avoid wrapping the maximum value to zero.
+      _cmd_space = (RAM_CMD_SIZE - 4) - used_space;
 
-    // TODO: Calibrate touch screen if necessary
+      // Keep track of the co-processor's progress for the frame functions
+      _cmd_done_total = _cmd_sent_total - used_space;
+    }
 
-    return true;
+    return readindex;
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Temporarily disconnect/reconnect from the EVE chip
-  void Pause(
-    bool pause)                         // True=pause, False=resume
+  // Get amount of free space in the command queue
+  //
+  // The number is based on the location where the chip is reading
+  // (not writing). So this can be called repeatedly to check if there's
+  // enough space for a certain command, e.g. when sending large amounts
+  // of data such as a bitmap.
+  //
+  // See also App Note 240 p.21
+  //
+  // In bulk mode, the chip calculates the free space for us, unless the
+  // caller wants to know whether the co-processor encountered an error:
+  // then the read index is needed anyway, and the free space is calculated
+  // from it.
+  //
+  // The result is also kept as an estimate of the free space, so that it's
+  // usually not necessary to call this before sending commands.
+  uint16_t                              // Returns number of bytes free
+  CmdGetFreeCmdSpace(
+    bool *pError = NULL)                // Optional output true=error
   {
-    _hal.Pause(pause);
-    if (pause)
+    if ((_cmd_bulk) && (!pError))
+    {
+      _cmd_space = RegRead16(REG_CMDB_SPACE);
+
+      _cmd_done_total = _cmd_sent_total - ((RAM_CMD_SIZE - 4) - _cmd_space);
+    }
+    else
     {
-      _hal.Select(false);
+      CmdReadIndex(pError);
     }
+
+    DBG_TRAFFIC("Free command space is %u\n", _cmd_space);
+
+    return _cmd_space;
   }
 
 protected:
   //-------------------------------------------------------------------------
-  // End communication without ending the HAL
-  void InternalEnd()
+  // Virtual function that gets called while waiting for the co-processor
+  //
+  // This gets called when a command (or a chunk of data such as a bitmap)
+  // doesn't fit in the free space of the command queue, after the
+  // co-processor was told to start executing the commands that were
+  // already queued. It also gets called while waiting for the co-processor
+  // to finish (see CmdWaitComplete).
+  //
+  // The implementation here does nothing. Subclasses can override this to
+  // do something useful in the mean time, such as preparing the next chunk
+  // of data, servicing other hardware, or yielding to other threads.
+  virtual void CmdYield()
   {
-    Pause(true);
-    _hal.Delay(20);                     // Wait a few ms before waking it up
-    _hal.Power(false);                  // Reset
-    _hal.Delay(6);                      // Hold for a little while
+    // Nothing
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // End communication with the EVE chip
-  void End()
+  // Wait between polls of the co-processor
+  //
+  // The first few polls are done without delay, because the co-processor
+  // usually catches up quickly. After that, the delay is doubled after
+  // every poll, up to a maximum. That way, a slow operation (e.g. loading
+  // a large image) doesn't keep the bus (and on USB adapters, the USB
+  // connection) busy with polls that each cost a round trip.
+  //
+  // CmdYield is called before the delay.
+  void CmdPollWait(
+    uint8_t &attempt)                   // Number of polls so far, updated
   {
-    InternalEnd();
-    _hal.End();
-  }
+    STEVE_STAT(_stats._poll_iterations++);
 
-  //=========================================================================
-  // START AND END TRANSACTIONS
-  //=========================================================================
+    CmdYield();
+
+    if (attempt >= CMD_POLL_SPIN)
+    {
+      uint8_t shift = attempt - CMD_POLL_SPIN;
+      uint32_t delay = CMD_POLL_MAX_DELAY;
+
+      if ((shift < 8) && ((1UL << shift) < delay))
+      {
+        delay = 1UL << shift;
+      }
+
+      _hal.Delay(delay);
+    }
+
+    if (attempt < 0xFF)
+    {
+      attempt++;
+    }
+  }
 
 protected:
   //-------------------------------------------------------------------------
-  // Begin a transaction, i.e. a Host Command, or a Memory Read/Write
+  // Wait until there is enough free space in the command queue
   //
-  // In most cases, this shouldn't be called directly. Call the other
-  // functions below instead, to send a host command or read/write from/to
-  // memory.
-  void BeginTransaction(
-    uint32_t data24)                    // 24-bit value to send
+  // The free space is cached in _cmd_space, and is only retrieved from
+  // the EVE when the cached value shows that the requested number of bytes
+  // won't fit. In most cases, a complete frame fits in the command queue,
+  // so this only costs one register read per frame.
+  //
+  // If there isn't enough free space, the co-processor must be executing
+  // commands to make space. In bulk mode, it does that by itself. In
+  // non-bulk mode, REG_CMD_WRITE is updated to the last 32-bit boundary
+  // that was written, so the co-processor can start executing the queue
+  // even if we're in the middle of storing a command.
+  bool                                  // Returns false=co-processor error
+  CmdWaitSpace(
+    uint16_t required)                  // Number of bytes required
   {
-    DBG_TRAFFIC("*** Transaction %06lX\n", data24);
+    bool started = false;
+    uint8_t attempt = 0;
 
-    // Make sure the previous transaction has ended.
-    // Then start a new transaction by selecting the chip.
-    EndTransaction();
+    while (_cmd_space < required)
+    {
+      bool error;
 
-    _hal.Select(true);
+      CmdGetFreeCmdSpace(&error);
 
-    // Send the lower 3 bytes of the command in BIG ENDIAN order.
-    _hal.Send24BE(data24);
+      if (error)
+      {
+        DBG_STAT("Co-processor error while waiting for command space\n");
+
+        _cmd_space = 0;
+
+        return false;
+      }
+
+      if (_cmd_space < required)
+      {
+        if ((!started) && (!_cmd_bulk))
+        {
+          RegWrite16(REG_CMD_WRITE, _cmd_index.index() & ~3);
+
+          started = true;
+        }
+
+        CmdPollWait(attempt);
+      }
+    }
+
+    return true;
   }
 
 protected:
   //-------------------------------------------------------------------------
-  // End a transaction by de-selecting the chip.
+  // Make sure a write transaction to the current command location is open
   //
-  // This is usually not necessary: Beginning a new transaction will end
-  // the previous transaction.
-  void EndTransaction()
+  // Consecutive co-processor commands are stored in consecutive locations
+  // in RAM_CMD, so there is no need to end the write transaction after
+  // each command and start a new one for the next command. That would
+  // cost a !CS cycle and a 3-byte address for every command.
+  //
+  // Instead, the write transaction is kept open (the command stream) until
+  // some other transaction is needed (e.g. to read a register or to update
+  // REG_CMD_WRITE in CmdExecute), or until the end of RAM_CMD is reached.
+  //
+  // In bulk mode, the data is written to REG_CMDB_WRITE instead. The chip
+  // stores it at its own write pointer and wraps it around as needed.
+  void CmdStreamBegin()
   {
-    _hal.Select(false);
+    if ((!_cmd_stream) && (!_staging))
+    {
+      BeginMemoryTransaction(_cmd_bulk ? (uint32_t)REG_CMDB_WRITE : RAM_CMD + _cmd_index.index(), true);
+
+      _cmd_stream = true;
+    }
   }
 
 protected:
-  //-----------------------------------------------------------------------
-  // Read or write data
+  //-------------------------------------------------------------------------
+  // Update the command index after storing data into the command stream
   //
-  // After calling this, subsequent transfers will copy data to/from
-  // consecutive memory locations.
-  void BeginMemoryTransaction(
-    uint32_t address22,                 // Address (22 bits, not checked)
-    bool write)                         // False = read, true = write
+  // If the data reached the end of RAM_CMD, the transaction is ended:
+  // the next location is at the start of RAM_CMD so a new transaction
+  // with a new address is needed for the rest of the data.
+  //
+  // In bulk mode, the index is still updated (the chip updates its write
+  // index the same way), so that output parameters can be found.
+  void CmdStreamAdvance(
+    uint16_t num)                       // Number of bytes that were stored
   {
-    DBG_TRAFFIC("Address %lX %s\n", address22, write ? "WRITE" : "READ");
+    _cmd_index += (int16_t)num;
+    _cmd_space -= num;
+    _cmd_sent_total += num;
 
-    // The address is passed by or-ing it to the 24 bit command.
-    BeginTransaction((uint32_t)(write ? HOSTCMD_WRITE : HOSTCMD_READ) | address22);
+    STEVE_STAT(_stats._bytes_sent += num);
 
-    // In read mode, a dummy byte must be sent to the EVE before
-    // receiving the data.
-    if (!write)
+    if ((_cmd_stream) && (!_cmd_bulk) && (!_cmd_index.index()))
     {
-      _hal.Send8(0);
+      EndTransaction();
     }
   }
 
 protected:
   //-------------------------------------------------------------------------
-  // Send a Host Command
-  void HostCommand(
-    HOSTCMD hostcmd,                    // Host command (not READ or WRITE)
-    uint8_t parameter = 0)              // Parameter, if any
-  {
-    // The parameter is passed as the second byte of the 24-bit host
-    // command value.
-    return BeginTransaction((uint32_t)hostcmd | (uint32_t)parameter << 8);
-  }
-
-  //=========================================================================
-  // MEMORY OPERATIONS
-  //=========================================================================
-
-public:
-  //-------------------------------------------------------------------------
-  // Read a one-byte register from FT81X memory
+  // Store data into the command queue, with flow control
+  //
+  // The data is split into chunks that fit in the free space of the
+  // command queue, and (in non-bulk mode) at the end of RAM_CMD. When the
+  // free space runs out, this waits for the co-processor to make more
+  // space. So there is no limit to the amount of data that can be sent,
+  // e.g. with cmd_MEMWRITE or cmd_INFLATE.
+  //
+  // The function always uses up all the space that's known to be free
+  // before it waits, and then waits until there is space for a reasonably
+  // sized chunk, so that large amounts of data aren't sent in many small
+  // transactions.
+  //
+  // If a staging buffer is in use, the data is stored in the staging
+  // buffer instead; the flow control happens when it's flushed.
+  //
+  // If the caller guarantees that the data stays valid until the HAL is
+  // done with it, the HAL is allowed to send it asynchronously.
   //
-  // Referred to as "rd8" in the documentation
-  uint8_t                               // Returns data at given address
-  RegRead8(
-    uint32_t address22)                 // Address (22 bits; not checked)
+  // Data in program memory (see SteveHAL::SendBufferProgmem) can't be
+  // staged; the caller must make sure the staging buffer isn't in use.
+  //
+  // If the data is an array of 32 bit values in host byte order, it's
+  // sent with SteveHAL::SendWords, so it also works on big-endian hosts.
+  // The length must be a multiple of 4 and the command index must be
+  // aligned. Arrays in program memory are always sent as bytes.
+  void CmdWrite(
+    const uint8_t *data,                // Data to store
+    uint32_t len,                       // Number of bytes
+    bool async = false,                 // True=data stays valid until sent
+    bool progmem = false,               // True=data is in program memory
+    bool words = false)                 // True=data is 32 bit host values
   {
-    uint8_t result;
+    if (_staging)
+    {
+#if !STEVE_LITTLE_ENDIAN
+      if (words)
+      {
+        const uint32_t *w = (const uint32_t *)data;
 
-    // Send the 22-bit address and operation flag.
-    BeginMemoryTransaction(address22, false);
+        for (uint32_t u = 0; u < len / 4; u++)
+        {
+          uint8_t buf[4] = { (uint8_t)w[u], (uint8_t)(w[u] >> 8), (uint8_t)(w[u] >> 16), (uint8_t)(w[u] >> 24) };
 
-    // Get the value
-    result = _hal.Receive8();
+          CmdStage(buf, 4);
+        }
 
-    DBG_TRAFFIC("Reg %lX = %X\n", address22, result);
+        return;
+      }
+#endif
 
-    return result;
-  }
+      CmdStage(data, len);
 
-public:
-  //-------------------------------------------------------------------------
-  // Read a 2-byte register from FT81X memory
-  //
-  // Referred to as "rd16" in the documentation
-  uint16_t                              // Returns data at given address
-  RegRead16(
-    uint32_t address22)                 // Address (22 bits; not checked)
-  {
-    uint16_t result;
+      return;
+    }
 
-    // Send the 22-bit address and operation flag.
-    BeginMemoryTransaction(address22, false);
+    while (len)
+    {
+      if (!_cmd_space)
+      {
+        if (!CmdWaitSpace((len < RAM_CMD_SIZE / 4) ? (uint16_t)len : (uint16_t)(RAM_CMD_SIZE / 4)))
+        {
+          // The co-processor is stuck; the data can't be stored
+          return;
+        }
+      }
 
-    // Get the value
-    result = _hal.Receive16();
+      uint16_t chunk = _cmd_space;
 
-    DBG_TRAFFIC("Reg %lX = %X\n", address22, result);
+      if (chunk > len)
+      {
+        chunk = (uint16_t)len;
+      }
 
-    return result;
+      if ((!_cmd_bulk) && (chunk > RAM_CMD_SIZE - _cmd_index.index()))
+      {
+        chunk = (uint16_t)(RAM_CMD_SIZE - _cmd_index.index());
+
+        STEVE_STAT(_stats._wrap_splits++);
+      }
+
+      CmdStreamBegin();
+
+      if (progmem)
+      {
+        _hal.SendBufferProgmem(data, chunk);
+      }
+      else if (words)
+      {
+        // The free space and the end of RAM_CMD are always aligned
+        _hal.SendWords((const uint32_t *)data, chunk / 4);
+      }
+      else if (async)
+      {
+        _hal.SendBufferAsync(data, chunk);
+      }
+      else
+      {
+        _hal.SendBuffer(data, chunk);
+      }
+
+      CmdStreamAdvance(chunk);
+
+      data += chunk;
+      len -= chunk;
+    }
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // Read a 4-byte register from FT81X memory
+  // Send the staged commands to the EVE
   //
-  // Referred to as "rd32" in the documentation
-  uint32_t                            // Returns data at given address
-  RegRead32(
-    uint32_t address22)               // Address (22 bits; not checked)
+  // The staging buffer is written to RAM_CMD at the location where the
+  // first staged byte belongs, with one memory transaction. If the data
+  // crosses the end of RAM_CMD, it's split into two transactions. In bulk
+  // mode, the data is written to REG_CMDB_WRITE in one transaction.
+  // If the data doesn't fit in the free space of the command queue, it's
+  // sent in smaller chunks as space becomes available.
+  //
+  // This doesn't update REG_CMD_WRITE; the co-processor doesn't start
+  // executing the commands until CmdExecute is called (unless more space
+  // was needed).
+  //
+  // The data is sent asynchronously if the HAL supports it, so in bulk
+  // mode the host can go on with other things (such as calculating the
+  // next frame) while the commands are sent. The staging buffer isn't
+  // reused until the transfer is done.
+  void CmdFlushStaging()
   {
-    uint32_t result;
+    if ((!_staging) || (!_staging->_length))
+    {
+      return;
+    }
 
-    // Send the 22-bit address and operation flag.
-    BeginMemoryTransaction(address22, false);
+    CmdStaging *staging = _staging;
 
-    // Get the value
-    result = _hal.Receive32();
+    DBG_TRAFFIC("Flushing %u staged bytes\n", staging->_length);
 
-    DBG_TRAFFIC("Reg %lX = %lX\n", address22, result);
+    // Write the data directly, starting at the first staged location.
+    // This brings the command index back to where it was.
+    _staging = NULL;
+    _cmd_index = _staging_index;
 
-    return result;
+    CmdWrite(staging->_buffer, staging->_length, true);
+
+    _staging = staging;
+    _staging_index = _cmd_index;
+    _staging->_length = 0;
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // Repeat reading a register until it matches the given value
+  // Store data in the staging buffer
   //
-  // The function returns 0 if the register didn't contain the expected
-  // value after the given number of retries. In other words, the result
-  // is successful if the function returns nonzero.
-  uint8_t                             // Returns num retries remaining
-  RegWait8(
-    uint32_t address22,               // Address (22 bits; not checked)
-    uint8_t value,                    // Expected value
-    uint8_t maxtries,                 // Maximum number of tries
-    uint32_t delay_between_tries)     // Delay between tries in ms
+  // The command index is updated as if the data was sent to the EVE.
+  // If the buffer fills up, it's sent to the EVE.
+  uint32_t                              // Returns number of bytes stored
+  CmdStage(
+    const uint8_t *data,                // Data to store
+    uint32_t len)                       // Number of bytes
   {
-    uint8_t result = maxtries;
-    uint8_t read_value = 0;
+    uint32_t result = 0;
 
-    while (result)
+    while (result < len)
     {
-      read_value = RegRead8(address22);
-      --result;
+      // Make sure the previous contents have been sent
+      if (!_staging->_length)
+      {
+        _hal.Wait();
+      }
 
-      if (read_value == value)
+      uint32_t blocksize = _staging->_size - _staging->_length;
+
+      if (blocksize > len - result)
       {
-        DBG_TRAFFIC("Match after %u read(s)\n", maxtries - result);
-        return result;
+        blocksize = len - result;
       }
 
-      _hal.Delay(delay_between_tries);
+      memcpy(_staging->_buffer + _staging->_length, data + result, blocksize);
+      _staging->_length += (uint16_t)blocksize;
+      _cmd_index += (int16_t)blocksize;
+      result += blocksize;
+
+      if (_staging->_length == _staging->_size)
+      {
+        CmdFlushStaging();
+      }
     }
 
-    DBG_GEEK("Timeout waiting for %lX to become %X, last read value was %X\n", address22, value, read_value);
     return result;
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // Read a block of memory
-  uint32_t                              // Returns next address to read from
-  RegReadBuffer(
-    uint32_t address22,                 // Address (22 bits; not checked)
-    uint32_t length,                    // Number of bytes to read
-    uint8_t *destination)               // Destination buffer
+  // Check if a value can be sent to the command stream without splitting
+  //
+  // This is the fast path for command codes and parameters: if the value
+  // fits in the known free space and doesn't cross the end of RAM_CMD, it
+  // can be sent to the HAL directly.
+  bool                                  // Returns true=value fits
+  CmdFits(
+    uint16_t num)                       // Number of bytes to send
   {
-    DBG_TRAFFIC("Reading %lX length %lX (%lu dec)\n", address22, length, length);
-
-    BeginMemoryTransaction(address22, false);
+    return (!_staging) && (_cmd_space >= num) && ((_cmd_bulk) || (RAM_CMD_SIZE - _cmd_index.index() >= num));
+  }
 
-    address22 += _hal.ReceiveBuffer(destination, length);
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 16 bit value to the command stream or staging buffer
+  void CmdSend16(
+    uint16_t value)                     // Value to send
+  {
+    if (CmdFits(2))
+    {
+      CmdStreamBegin();
+      _hal.Send16(value);
+      CmdStreamAdvance(2);
+    }
+    else
+    {
+      uint8_t buf[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
 
-    return address22;
+      CmdWrite(buf, sizeof(buf));
+    }
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // Write an 8 bit register
-  //
-  // Referred to as "wr8" in the documentation
-  void RegWrite8(
-    uint32_t address22,                 // Address (22 bits; not checked)
-    uint8_t value)                      // Value to store
+  // Send a 32 bit value to the command stream or staging buffer
+  void CmdSend32(
+    uint32_t value)                     // Value to send
   {
-    DBG_TRAFFIC("Writing %lX = %02X\n", address22, value);
-
-    BeginMemoryTransaction(address22, true);
+    if (CmdFits(4))
+    {
+      CmdStreamBegin();
+      _hal.Send32(value);
+      CmdStreamAdvance(4);
+    }
+    else
+    {
+      uint8_t buf[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
 
-    _hal.Send8(value);
+      CmdWrite(buf, sizeof(buf));
+    }
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // Write a 16 bit register
-  //
-  // Referred to as "wr16" in the documentation
-  void RegWrite16(
-    uint32_t address22,                 // Address (22 bits; not checked)
-    uint16_t value)                     // Value to store
+  // Send a buffer to the command stream or staging buffer
+  uint32_t                              // Returns number of bytes sent
+  CmdSendBuffer(
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len)                       // Number of bytes to send
   {
-    DBG_TRAFFIC("Writing %lX = %04X\n", address22, value);
-
-    BeginMemoryTransaction(address22, true);
+    CmdWrite(buffer, len);
 
-    _hal.Send16(value);
+    return len;
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // Write a 32 bit register
+  // Send a string to the command stream or staging buffer
   //
-  // Referred to as "wr32" in the documentation
-  void RegWrite32(
-    uint32_t address22,             // Address (22 bits; not checked)
-    uint32_t value)                 // Value to store
+  // See SteveHAL::SendString for the meaning of the parameters.
+  uint16_t                              // Returns number of bytes sent
+  CmdSendString(
+    const char *message,                // Characters to send, '\0' is end
+    uint16_t maxlen)                    // Max input length including \0
   {
-    DBG_TRAFFIC("Writing %lX = %08lX\n", address22, value);
+    uint16_t result = 0;
 
-    BeginMemoryTransaction(address22, true);
+    if (maxlen)
+    {
+      const char *s = message ? message : "";
+      const uint8_t nul = 0;
 
-    _hal.Send32(value);
+      result = (uint16_t)strnlen(s, (size_t)(maxlen - 1));
+
+      CmdWrite((const uint8_t *)s, result);
+      CmdWrite(&nul, 1);
+
+      result++;
+    }
+
+    return result;
   }
 
-public:
+protected:
   //-------------------------------------------------------------------------
-  // Write a block of memory
+  // Send a string, its nul-terminator and alignment bytes
   //
-  // NOTE: It may be necessary to send alignment bytes if the length
-  // is not a multiple of 4.
-  uint32_t                            // Returns next address to write to
-  RegWriteBuffer(
-    uint32_t address22,               // Address (22 bits; not checked)
-    uint32_t length,                  // Number of bytes to read
-    const uint8_t *source)            // Source buffer
+  // This is the same as CmdSendString followed by CmdSendAlignmentBytes,
+  // but if the padded string fits in the command queue without waiting
+  // (and without wrapping around the end of RAM_CMD in non-bulk mode),
+  // it's sent with a single call to SteveHAL::SendStringPadded.
+  //
+  // The maximum length includes the nul-terminator. Unlike CmdSendString,
+  // a maximum length of 0 means there is no limit, so that the CMD
+  // functions for commands with a string can use 0 as default.
+  uint16_t                              // Returns number of bytes sent
+  CmdSendStringPadded(
+    const char *message,                // Characters to send, '\0' is end
+    uint16_t maxlen)                    // Max input length including \0
   {
-    DBG_TRAFFIC("Writing %lX length %lX (%lu dec)\n", address22, length, length);
+    const char *s = message ? message : "";
+    uint16_t len = (uint16_t)(maxlen ? strnlen(s, (size_t)(maxlen - 1)) : strlen(s));
+    uint16_t total = (uint16_t)(len + 4 - ((_cmd_index.index() + len) % 4));
 
-    BeginMemoryTransaction(address22, true);
+    if ((!_staging) && (total <= _cmd_space) && (_cmd_bulk || (total <= RAM_CMD_SIZE - _cmd_index.index())))
+    {
+      CmdStreamBegin();
 
-    address22 += _hal.SendBuffer(source, length);
+      _hal.SendStringPadded(s, len, total);
 
-    return address22;
-  }
+      CmdStreamAdvance(total);
+    }
+    else
+    {
+      const uint8_t zeroes[4] = { 0, 0, 0, 0 };
 
-  //=========================================================================
-  // DISPLAY LIST FUNCTIONS
-  //=========================================================================
-  // NOTE: The display list is used internally. It only supports
-  // the "simple" commands that are encoded with the ENC_* functions.
-  // In most cases it's easiest to use the co-processor, so this section
-  // is safe to ignore when you're trying to understand the EVE.
-  //
-  // See ProgGuide 5.4 p.154 about how to synchronize the display list
-  // with the co-processor command queue.
+      CmdWrite((const uint8_t *)s, len);
+      CmdWrite(zeroes, (uint32_t)(total - len));
+    }
 
-public:
+    return total;
+  }
+
+protected:
   //-------------------------------------------------------------------------
-  // Reset the display list index
+  // Send alignment bytes to the command stream or staging buffer
   //
-  // NOTE: It shouldn't be necessary to get the display list index
-  // without storing a command first, so there is no function to get the
-  // current index without storing anything.
-  void DLResetIndex(
-    uint16_t index = 0)                 // New index
+  // This sends zero bytes until the command index is aligned to a 32 bit
+  // boundary, as required after a string or a block of data.
+  void CmdSendAlignmentBytes()
   {
-    DBG_TRAFFIC("DL reset %u\n", index);
+    const uint8_t zeroes[3] = { 0, 0, 0 };
 
-    _dl_index = index;
+    CmdWrite(zeroes, (4 - (_cmd_index.index() % 4)) % 4);
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Store a 32 bit display list command
+  // Use a staging buffer for co-processor commands, or stop using one
   //
-  // The class keeps track of the current location and updates it to the
-  // next location. Normally it's not necessary to do anything with the
-  // return value.
+  // While a staging buffer is in use, the cmd_* functions store the
+  // commands in host memory instead of sending them to the EVE. They are
+  // sent in a single burst (or two, if the data crosses the end of RAM_CMD)
+  // by CmdExecute (which is also called by CmdDlFinish), or when the
+  // buffer is full.
   //
-  // Referred to as "dl" in the documentation.
-  DLIndex                               // Returns updated DL index
-  DLAdd(
-    uint32_t value)                     // Value to write
+  // Use NULL to stop using the staging buffer; any staged commands are
+  // sent to the EVE first.
+  void CmdSetStaging(
+    CmdStaging *staging)                // Staging buffer, NULL=none
   {
-    DBG_TRAFFIC("dl(%08lX)\n", value);
+    CmdFlushStaging();
+    EndTransaction();
 
-    RegWrite32(RAM_DL + _dl_index.index(), value);
+    // The caller may reuse the old staging buffer after this
+    _hal.Wait();
 
-    _dl_index += 4;
+    _staging = staging;
+    _staging_index = _cmd_index;
 
-    return _dl_index;
+    if (_staging)
+    {
+      _staging->_length = 0;
+    }
   }
 
-  //=========================================================================
-  // CO-PROCESSOR SUPPORT
-  //=========================================================================
-
 public:
   //-------------------------------------------------------------------------
-  // Read a 32 bit value from the given Cmd index
+  // Check if there are commands in the staging buffer
   //
-  // This can be used to retrieve a value that gets stored by the
-  // co-processor into the output parameters of a command.
-  uint32_t                              // Returns value
-  CmdRead32(
-    CmdIndex cmdindex)                  // Command index to read from
+  // CmdIsBusy only knows about commands that were sent to the EVE, so it
+  // returns false while commands are still waiting in the staging buffer.
+  bool                                  // Returns true=commands staged
+  CmdIsStaged() const
   {
-    return RegRead32(RAM_CMD + cmdindex.index());
+    return _staging && _staging->_length;
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Synchronize the local command write index
+  // Store a precompiled array of co-processor commands
   //
-  // The co-processor executes commands from, and updates the command
-  // read index, until it reaches the command write index. So when we
-  // want to start to write a sequence of commands for the co-processor,
-  // we should synchronize our own write index to the write index of the
-  // co-processor. When we're done writing commands, we will set the
-  // write index to the end of the list.
+  // The array is sent to the command queue as a block of data, so that it
+  // goes out in one burst per contiguous block of RAM_CMD, instead of one
+  // function call per command. Any staged commands are sent first, and
+  // the array bypasses the staging buffer.
   //
-  // This function basically cancels all commands that were already queued
-  // for the co-processor (if any), and restarts the building of the queue.
+  // The array can contain display list commands built with the constexpr
+  // ENC_ functions, and co-processor commands with their parameters
+  // (ENC_CMD_ values followed by the parameter words). If progmem is true,
+  // the array is in program memory (e.g. declared with PROGMEM on AVR),
+  // see SteveHAL::SendBufferProgmem.
+  //
+  // Arrays in RAM are sent with SteveHAL::SendWords. Arrays in program
+  // memory are sent as bytes, so they only work on little-endian hosts.
   CmdIndex                              // Returns updated Cmd index
-  CmdInitWriteIndex()
+  CmdSendStatic(
+    const uint32_t *words,              // Commands to store
+    uint32_t count,                     // Number of words
+    bool progmem = false)               // True=array is in program memory
   {
-    DBG_TRAFFIC("Reading REG_CMD_WRITE\n");
+    DBG_TRAFFIC("cmd static %lu words\n", count);
 
-    _cmd_index = CmdIndex(RegRead16(REG_CMD_WRITE));
+    // The array can change any graphics state
+    ShadowReset();
+
+    CmdStaging *staging = _staging;
+
+    if (staging)
+    {
+      // Send the staged data first; keep the buffer for the commands after
+      // this, like CmdFlushStaging does.
+      CmdFlushStaging();
+      _staging = NULL;
+    }
+
+    CmdWrite((const uint8_t *)words, count * 4, false, progmem, true);
+
+    if (staging)
+    {
+      _staging = staging;
+      _staging_index = _cmd_index;
+    }
 
     return _cmd_index;
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Get amount of free space in the command queue
-  //
-  // The number is based on the location where the chip is reading
-  // (not writing). So this can be called repeatedly to check if there's
-  // enough space for a certain command, e.g. when sending large amounts
-  // of data such as a bitmap.
+  // Send commands that are already encoded as little-endian bytes
   //
-  // See also App Note 240 p.21
-  uint16_t                              // Returns number of bytes free
-  CmdGetFreeCmdSpace()
+  // This is for command streams that were built in memory byte by byte
+  // (e.g. SteveCmdList), so it works regardless of the endianness of the
+  // host. The data is padded to a multiple of 4 bytes.
+  CmdIndex                              // Returns updated Cmd index
+  CmdSendBytes(
+    const uint8_t *data,                // Encoded commands
+    uint32_t len)                       // Number of bytes
   {
-    // Calculate the used space by subtracting the read index from
-    // our write index. This value is wrapped around the maximum value.
-    uint16_t used_space = (_cmd_index - RegRead16(REG_CMD_READ)).index();
+    DBG_TRAFFIC("cmd bytes %lu\n", len);
 
-    // Subtract the used space from the total space but reduce the
-    // total space by 4 to avoid wrapping the maximum value to zero.
-    uint16_t result = (RAM_CMD_SIZE - 4) - used_space;
+    // The data can change any graphics state
+    ShadowReset();
 
-    DBG_TRAFFIC("Free command space is %u", result);
+    CmdSendBuffer(data, len);
+    CmdSendAlignmentBytes();
 
-    return result;
+    return _cmd_index;
   }
 
 public:
@@ -1657,31 +5545,54 @@ public:
   {
     DBG_GEEK("cmd(%08lX)\n", command);
 
-    BeginMemoryTransaction(RAM_CMD + _cmd_index.index(), true);
+    if ((_shadow_enabled) && (!ShadowUpdate(command)))
+    {
+      DBG_GEEK("Redundant command dropped\n");
+
+      return _cmd_index;
+    }
+
+    if ((command == ENC_CMD_DLSTART) && (_dedup_enabled))
+    {
+      _dedup_armed = (_staging != NULL);
+      _dedup_start = _cmd_index;
+      _dedup_excludes = 0;
+    }
 
     // Send the command
-    _hal.Send32(command);
+    CmdSend32(command);
 
-    return _cmd_index += 4;
+    return _cmd_index;
   }
 
 public:
   //-------------------------------------------------------------------------
   // Check if the co-processor is busy
+  //
+  // The last known read index is cached, so once the co-processor is known
+  // to have caught up, this doesn't access the EVE until more commands are
+  // sent.
   bool                                  // Returns true=busy, false=ready
   CmdIsBusy(
     bool *pError = NULL)                // Optional output true=error
   {
-    uint16_t readindex = RegRead16(REG_CMD_READ);
+    uint16_t sent = CmdSentIndex().index();
 
-    bool error = (readindex == READ_INDEX_ERROR);
-
-    if (pError)
+    // If the co-processor was already known to have caught up, and
+    // nothing was sent since then, there is no need to ask the EVE.
+    if (_cmd_read == sent)
     {
-      *pError = error;
+      if (pError)
+      {
+        *pError = false;
+      }
+
+      return false;
     }
 
-    return (!error) && (readindex != _cmd_index.index());
+    uint16_t readindex = CmdReadIndex(pError);
+
+    return (readindex != READ_INDEX_ERROR) && (readindex != sent);
   }
 
 public:
@@ -1689,7 +5600,8 @@ public:
   // Wait until the co-processor has caught up.
   //
   // If the co-processor has nothing to do, the function will return
-  // immediately.
+  // immediately. Otherwise, the co-processor is polled with an increasing
+  // delay between polls (see CmdPollWait).
   //
   // NOTE: Simply adding commands doesn't start the co-processor. You must
   // call the CmdExecute() function below.
@@ -1703,9 +5615,33 @@ public:
   {
     DBG_TRAFFIC("Waiting for coprocessor\n");
 
-    while (CmdIsBusy(pError))
+    uint8_t attempt = 0;
+
+    if (_int_mask & INT_CMDEMPTY)
     {
-      // Nothing
+      // Wait for the !INT line between polls. The interrupt flags are
+      // cleared by reading them, which releases the !INT line. If the
+      // command FIFO became empty before the flags were read, the
+      // next poll finds out; if it happens after that, the !INT line
+      // becomes active again.
+      while (CmdIsBusy(pError))
+      {
+        CmdYield();
+
+        if (_hal.WaitForInterrupt(INT_WAIT_TIMEOUT_MS))
+        {
+          IntReadFlags();
+        }
+      }
+
+      _int_flags &= ~INT_CMDEMPTY;
+    }
+    else
+    {
+      while (CmdIsBusy(pError))
+      {
+        CmdPollWait(attempt);
+      }
     }
 
     return _cmd_index;
@@ -1718,6 +5654,10 @@ public:
   // This updates the write pointer on the engine to the current write
   // location so that the co-processor starts executing commands in the
   // command queue.
+  //
+  // In bulk mode, the chip updates the write pointer by itself, so it's
+  // only necessary to end the transaction to make sure that the HAL has
+  // sent all the data.
   CmdIndex                              // Returns updated Cmd index
   CmdExecute(
     bool waituntilcomplete = false,     // True = wait until done
@@ -1725,7 +5665,17 @@ public:
   {
     DBG_TRAFFIC("Executing command queue\n");
 
-    RegWrite16(REG_CMD_WRITE, _cmd_index.index());
+    // Send the staged commands, if any
+    CmdFlushStaging();
+
+    if (_cmd_bulk)
+    {
+      EndTransaction();
+    }
+    else
+    {
+      RegWrite16(REG_CMD_WRITE, _cmd_index.index());
+    }
 
     if (waituntilcomplete)
     {
@@ -1735,6 +5685,155 @@ public:
     return _cmd_index;
   }
 
+public:
+  //-------------------------------------------------------------------------
+  // Enable or disable writing commands through REG_CMDB_WRITE
+  //
+  // In bulk mode, commands are written to the REG_CMDB_WRITE register
+  // instead of directly into RAM_CMD. The chip stores the data at its own
+  // write index and handles the wraparound at the end of RAM_CMD, and
+  // REG_CMDB_SPACE is used to determine the free space.
+  //
+  // Begin enables this automatically for EVE3/EVE4 chips. The registers
+  // are also documented for EVE2, so it's possible to enable this
+  // manually on those chips.
+  //
+  // NOTE: In bulk mode, the co-processor starts executing commands as soon
+  // as they arrive; it doesn't wait for CmdExecute.
+  void CmdSetBulkMode(
+    bool enable)                        // True=use REG_CMDB_WRITE
+  {
+    // Make sure all commands that were stored so far are executed so that
+    // the write index on both sides are synchronized.
+    CmdExecute(true);
+
+    _cmd_bulk = enable;
+    _cmd_space = 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check if bulk mode is enabled
+  bool                                  // Returns true=REG_CMDB_WRITE used
+  CmdIsBulkMode() const
+  {
+    return _cmd_bulk;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Set the command list that restores the state after a co-processor reset
+  //
+  // The list is recorded with RecordList, and it's called by CmdRestore
+  // when CmdRecover has reset the co-processor. It should contain the
+  // commands that set the co-processor state that's lost, such as
+  // CMD_FLASHFAST, CMD_SETFONT2 or CMD_SETSCRATCH. RAM_G isn't cleared by
+  // the reset, so the list stays valid.
+  void CmdSetRestoreList(
+    uint8_t id = INVALID_LIST)          // Index in list cache, INVALID=none
+  {
+    _restore_list = id;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Virtual function that restores the co-processor state after a reset
+  //
+  // This gets called by CmdRecover after the co-processor was reset and
+  // the command queue is empty again.
+  // The implementation here calls the list from CmdSetRestoreList, if it's
+  // valid. Subclasses can override this, e.g. for chips that don't support
+  // command lists.
+  virtual void CmdRestore()
+  {
+    if (_restore_list != INVALID_LIST)
+    {
+      CallList(_restore_list);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Recover from a co-processor fault
+  //
+  // When the co-processor encounters an error, it stops and REG_CMD_READ
+  // reads as READ_INDEX_ERROR (see CmdIsBusy). This resets only the
+  // co-processor, as described in the Programmer's Guide, instead of
+  // restarting the chip with Begin: the display timing, the bitmap
+  // handles and the contents of RAM_G remain the same, and the screen
+  // keeps showing the last display list.
+  //
+  // Commands that weren't executed yet are lost, and so is the co-processor
+  // state such as the media FIFO. The local command index is synchronized
+  // and CmdRestore is called to restore the state.
+  //
+  // On EVE4, the fault report from RAM_ERR_REPORT can be retrieved in a
+  // buffer. On other chips (or if there was no fault) an empty string is
+  // stored.
+  bool                                  // Returns true=co-processor running
+  CmdRecover(
+    char *report = NULL,                // Buffer for fault report or NULL
+    uint16_t reportsize = 0)            // Buffer size including '\0'
+  {
+    DBG_GEEK("Recovering co-processor\n");
+
+    // Forget about the transaction that was in progress
+    EndTransaction();
+
+    if ((report) && (reportsize))
+    {
+      uint16_t len = 0;
+
+      if (_chipid >= SteveDisplay::CHIPID_BT817)
+      {
+        len = reportsize - 1;
+        if (len > RAM_ERR_REPORT_SIZE)
+        {
+          len = RAM_ERR_REPORT_SIZE;
+        }
+
+        MemoryRead(RAM_ERR_REPORT, len, (uint8_t *)report);
+      }
+
+      report[len] = '\0';
+
+      DBG_STAT("Co-processor fault: %s\n", report);
+    }
+
+    // On EVE3/EVE4, the patch pointer must survive the reset, otherwise
+    // the co-processor doesn't run the patched ROM functions anymore.
+    bool patched = (_chipid >= SteveDisplay::CHIPID_BT815);
+    uint16_t patch = patched ? RegRead16(REG_COPRO_PATCH_PTR) : 0;
+
+    RegWrite8(REG_CPURESET, 1);
+    RegWrite16(REG_CMD_READ, 0);
+    RegWrite16(REG_CMD_WRITE, 0);
+    RegWrite16(REG_CMD_DL, 0);
+    if (patched)
+    {
+      RegWrite16(REG_COPRO_PATCH_PTR, patch);
+    }
+    RegWrite8(REG_CPURESET, 0);
+
+    // Start with an empty queue and forget the state of the co-processor
+    CmdInitWriteIndex();
+    _fifo_size = 0;
+    InvalidateFrameHash();
+    ShadowReset();
+
+    bool error = false;
+
+    CmdRestore();
+    CmdExecute(true, &error);
+
+    if (error)
+    {
+      DBG_STAT("Co-processor didn't recover\n");
+    }
+
+    return !error;
+  }
+
   //=========================================================================
   // COMMAND ENCODING
   //=========================================================================
@@ -1797,12 +5896,19 @@ public:
   // * A function (starting with cmd_...) to add an encoded command to the
   //   command list for the co-processor.
   //
+  // The ENC_ functions are static and constexpr (if the compiler supports
+  // it), so they can be used without an instance, and commands with
+  // constant parameters are encoded at compile time. That makes it
+  // possible to store display list fragments in constant tables, e.g.:
+  //
+  //   const uint32_t fragment[] = { Steve::ENC_BEGIN(Steve::BEGIN_RECTS), ... };
+  //
   // Note: The names of the non-enum parameters include the actual number
   // of bits that are used, as a reminder. Keep in mind that some
   // parameters are encoded as unsigned or signed fixed-point value
   // and that negative fixed-point does not use 2's complement.
   #define ENC(name, declaration, parameters, value) \
-    uint32_t ENC_##name declaration { return ENC_CMD_##name | value; } \
+    static STEVE_CONSTEXPR uint32_t ENC_##name declaration { return ENC_CMD_##name | value; } \
     DLIndex   dl_##name declaration { DBG_GEEK("dl_%s\n",  name); return DLAdd(ENC_##name parameters); } \
     CmdIndex cmd_##name declaration { DBG_GEEK("cmd_%s\n", name); return Cmd(ENC_##name parameters); }
 
@@ -1871,19 +5977,21 @@ public:
   // cmd_ and send the given command and parameters to the co-processor.
   //
   // 2 byte input value
-  #define V2(value) (_hal.Send16((uint16_t)(value)), result += 2)
+  #define V2(value) CmdSend16((uint16_t)(value))
   // 4 byte input value
-  #define V4(value) (_hal.Send32((uint32_t)(value)), result += 4)
+  #define V4(value) CmdSend32((uint32_t)(value))
   // String value
-  #define SS(value, maxlen) (result += _hal.SendAlignmentBytes(_hal.SendString(value, maxlen)))
+  #define SS(value, maxlen) CmdSendStringPadded(value, maxlen)
   // Transfer from host RAM
-  #define MM(value, len) (result += _hal.SendAlignmentBytes(_hal.SendBuffer(value, len)))
+  #define MM(value, len) (CmdSendBuffer(value, len), CmdSendAlignmentBytes())
   // 4 byte output value: Store Cmd index to parameter and bump cmd index
   // Use NULL as parameter to ignore the output
-  #define Q4(name) ((name ? (*name = _cmd_index + result) : 0), V4(0))
+  #define Q4(name) ((name ? (*name = _cmd_index) : 0), V4(0))
   // Send command and data
+  // The command index is updated as the command and the parameters are
+  // stored, so it's always the location of the next byte.
   #define CMD(name, declaration, value) \
-      CmdIndex cmd_##name declaration { Cmd(ENC_CMD_##name); int16_t result = 0; (void)(value); return _cmd_index += result; }
+      CmdIndex cmd_##name declaration { Cmd(ENC_CMD_##name); (void)(value); return _cmd_index; }
   // Send command that has outputs (May possibly be changed later)
   // (The caller should start the co-processor and wait until it executes
   // the commands, then retrieve the output data using CmdRead with the
@@ -1893,9 +6001,15 @@ public:
   #define CMDOUT4 CMD4
   // Send command that only works for some types of EVE chips
   // (May possibly be changed later)
+  // The EVE4 commands can be left out with STEVE_CMD_EVE4; the ones that
+  // Steve uses itself are declared with CMD instead.
   #define CMD2 CMD
   #define CMD34 CMD
+#if STEVE_CMD_EVE4
   #define CMD4 CMD
+#else
+  #define CMD4(name, declaration, value)
+#endif
 
   CMD4(APILEVEL,          (APILEVEL level32),                                                                                                             (V4(level32)                                                                        )) //           [PG34 p112] (EVE4)
   CMD(DLSTART,            (),                                                                                                                             (0                                                                                  )) // ProgGuide 5.11 p.162
@@ -1916,6 +6030,7 @@ public:
   CMD(MEMZERO,            (uint32_t ptr32, uint32_t num32),                                                                                               (V4(ptr32),V4(num32)                                                                )) // ProgGuide 5.25 p.174
   CMD(MEMSET,             (uint32_t ptr32, uint32_t value8, uint32_t num32),                                                                              (V4(ptr32),V4(value8),V4(num32)                                                     )) // ProgGuide 5.26 p.175
   CMD(MEMCPY,             (uint32_t dest32, uint32_t src32, uint32_t num32),                                                                              (V4(dest32),V4(src32),V4(num32)                                                     )) // ProgGuide 5.27 p.176
+#if STEVE_CMD_WIDGETS
   CMD(BUTTON,             (int16_t x16, int16_t y16, int16_t w16, int16_t h16, int16_t font5, OPT options, const char *message, uint16_t len = 0),        (V2(x16),V2(y16),V2(w16),V2(h16),V2(font5),V2(options),SS(message, len)             )) // ProgGuide 5.28 p.176
   CMD(CLOCK,              (int16_t x16, int16_t y16, int16_t r16, OPT options, uint16_t h16, uint16_t m16, uint16_t s16, uint16_t ms16),                  (V2(x16),V2(y16),V2(r16),V2(options),V2(h16),V2(m16),V2(s16),V2(ms16)               )) // ProgGuide 5.29 p.179
   CMD(FGCOLOR,            (uint32_t c24),                                                                                                                 (V4(c24)                                                                            )) // ProgGuide 5.30 p.183
@@ -1930,6 +6045,7 @@ public:
   CMD(SLIDER,             (int16_t x16, int16_t y16, int16_t w16, int16_t h16, OPT options, uint16_t val16, uint16_t range16),                            (V2(x16),V2(y16),V2(w16),V2(h16),V2(options),V2(val16),V2(range16),V2(0)            )) // ProgGuide 5.38 p.205
   CMD(DIAL,               (int16_t x16, int16_t y16, int16_t r16, OPT options, uint16_t val16),                                                           (V2(x16),V2(y16),V2(r16),V2(options),V2(val16),V2(0)                                )) // ProgGuide 5.39 p.207
   CMD(TOGGLE,             (int16_t x16, int16_t y16, int16_t w16, uint16_t font5, OPT options, uint16_t state16, const char *message, uint16_t len = 0),  (V2(x16),V2(y16),V2(w16),V2(font5),V2(options),V2(state16),SS(message, len)         )) // ProgGuide 5.40 p.210
+#endif
   CMD34(FILLWIDTH,        (uint32_t s),                                                                                                                   (V4(s)                                                                              )) //           [PG34 p147] (EVE3/EVE4)
   CMD(TEXT,               (int16_t x16, int16_t y16, int16_t font5, OPT options, const char *message, uint16_t len = 0),                                  (V2(x16),V2(y16),V2(font5),V2(options),SS(message, len)                             )) // ProgGuide 5.41 p.213
   CMD(SETBASE,            (uint32_t b6),                                                                                                                  (V4(b6)                                                                             )) // ProgGuide 5.42 p.216
@@ -1961,6 +6077,7 @@ public:
   CMD(SETBITMAP,          (uint32_t addr32, FORMAT format, uint16_t width16, uint16_t height16),                                                          (V4(addr32),V2(format),V2(width16),V2(height16),V2(0)                               )) // ProgGuide 5.65 p.247
   CMD(LOGO,               (),                                                                                                                             (0                                                                                  )) // ProgGuide 5.66 p.249
   CMD2(CSKETCH,           (int16_t x16, int16_t y16, uint16_t w16, uint16_t h16, uint32_t ptr32, FORMAT format, uint16_t freq16),                         (V2(x16),V2(y16),V2(w16),V2(h16),V4(ptr32),V2(format),V2(freq16)                    )) // ProgGuide 5.67 p.249 (EVE2)
+#if STEVE_CMD_FLASH
   CMD34(FLASHERASE,       (),                                                                                                                             (0                                                                                  )) //           [PG34 p174] (EVE3/EVE4)
   CMD34(FLASHWRITE,       (uint32_t ptr32, uint32_t num32, const uint8_t *data),                                                                          (V4(ptr32),V4(num32),MM(data,num32)                                                 )) //           [PG34 p174] (EVE3/EVE4)
   CMD34(FLASHPROGRAM,     (uint32_t dst32, uint32_t src32, uint32_t num32),                                                                               (V4(dst32),V4(src32),V4(num32)                                                      )) //           [PG34 p175] (EVE3/EVE4)
@@ -1974,7 +6091,9 @@ public:
   CMD34(FLASHSPIRX,       (uint32_t ptr32, uint32_t num32),                                                                                               (V4(ptr32),V4(num32)                                                                )) //           [PG34 p179] (EVE3/EVE4)
   CMD34(CLEARCACHE,       (),                                                                                                                             (0                                                                                  )) //           [PG34 p180] (EVE3/EVE4)
   CMD34(FLASHSOURCE,      (uint32_t ptr32),                                                                                                               (V4(ptr32)                                                                          )) //           [PG34 p181] (EVE3/EVE4)
+#endif
   CMD34(VIDEOSTARTF,      (),                                                                                                                             (0                                                                                  )) //           [PG34 p181] (EVE3/EVE4)
+#if STEVE_CMD_ANIM
   CMD34(ANIMSTART,        (int32_t ch5, uint32_t aoptr32, ANIM loop),                                                                                     (V4(ch5),V4(aoptr32),V4(loop)                                                       )) //           [PG34 p181] (EVE3/EVE4)
   CMD4(ANIMSTARTRAM,      (int32_t ch5, uint32_t aoptr32, ANIM loop),                                                                                     (V4(ch5),V4(aoptr32),V4(loop)                                                       )) //           [PG34 p182] (EVE4)
   CMD4(RUNANIM,           (uint32_t waitmask32, uint32_t play32),                                                                                         (V4(waitmask32),V4(play32)                                                          )) //           [PG34 p183] (EVE4)
@@ -1983,6 +6102,7 @@ public:
   CMD34(ANIMDRAW,         (int32_t ch5),                                                                                                                  (V4(ch5)                                                                            )) //           [PG34 p185] (EVE3/EVE4)
   CMD34(ANIMFRAME,        (int16_t x16, int16_t y16, uint32_t aoptr32, uint32_t frame32),                                                                 (V2(x16),V2(y16),V4(aoptr32),V4(frame32)                                            )) //           [PG34 p186] (EVE3/EVE4)
   CMD34(ANIMFRAMERAM,     (int16_t x16, int16_t y16, uint32_t aoptr32, uint32_t frame32),                                                                 (V2(x16),V2(y16),V4(aoptr32),V4(frame32)                                            )) //           [PG34 p186] (EVE4)
+#endif
   CMD34(SYNC,             (),                                                                                                                             (0                                                                                  )) //           [PG34 p187] (EVE3/EVE4)
   CMDOUT34(BITMAP_TRANSFORM,
                           (int32_t x032, int32_t y032, int32_t x132, int32_t y132, int32_t x232, int32_t y232, int32_t tx032, int32_t ty032, int32_t tx132, int32_t ty132, int32_t tx232, int32_t ty232, CmdIndex *xresult16),
@@ -1990,9 +6110,9 @@ public:
                                                                                                                                                                                                                                               )) //           [PG34 p188] (EVE3/EVE4)
   CMD4(TESTCARD,          (),                                                                                                                             (0                                                                                  )) //           [PG34 p189] (EVE4)
   CMD4(WAIT,              (uint32_t us32),                                                                                                                (V4(us32)                                                                           )) //           [PG34 p190] (EVE4)
-  CMD4(NEWLIST,           (uint32_t a32),                                                                                                                 (V4(a32)                                                                            )) //           [PG34 p190] (EVE4)
-  CMD4(ENDLIST,           (),                                                                                                                             (0                                                                                  )) //           [PG34 p191] (EVE4)
-  CMD4(CALLLIST,          (uint32_t a32),                                                                                                                 (V4(a32)                                                                            )) //           [PG34 p192] (EVE4)
+  CMD(NEWLIST,            (uint32_t a32),                                                                                                                 (V4(a32)                                                                            )) //           [PG34 p190] (EVE4)
+  CMD(ENDLIST,            (),                                                                                                                             (0                                                                                  )) //           [PG34 p191] (EVE4)
+  CMD(CALLLIST,           (uint32_t a32),                                                                                                                 (V4(a32)                                                                            )) //           [PG34 p192] (EVE4)
   CMD4(RETURNCMD,         (),                                                                                                                             (0                                                                                  )) //           [PG34 p192] (EVE4)
   CMD4(FONTCACHE,         (uint32_t font32, int32_t ptr32, uint32_t num32),                                                                               (V4(font32),V4(ptr32),V4(num32)                                                     )) //           [PG34 p193] (EVE4)
   CMDOUT4(FONTCACHEQUERY, (CmdIndex *xtotal32, CmdIndex *xused32),                                                                                        (Q4(xtotal32),Q4(xused32)                                                           )) //           [PG34 p194] (EVE4)
@@ -2000,56 +6120,576 @@ public:
   CMD4(HSF,               (uint32_t w32),                                                                                                                 (V4(w32)                                                                            )) //           [PG34 p195] (EVE4)
   CMDOUT4(PCLKFREQ,       (uint32_t ftarget32, int32_t rounding32, CmdIndex *xfactual32),                                                                 (V4(ftarget32),V4(rounding32),Q4(xfactual32)                                        )) //           [PG34 p196] (EVE4)
 
-  #undef CMD4
-  #undef CMD34
-  #undef CMDOUT
-  #undef Q4
-  #undef MM
-  #undef SF
-  #undef SS
-  #undef V4
-  #undef V2
+  #undef CMD4
+  #undef CMD34
+  #undef CMDOUT
+  #undef Q4
+  #undef MM
+  #undef SF
+  #undef SS
+  #undef V4
+  #undef V2
+
+  //=========================================================================
+  // CO-PROCESSOR FUNCTIONS FOR SOME DRAWING PRIMITIVES
+  //=========================================================================
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send the arguments of a formatted string
+  void CmdSendFormatArgs()
+  {
+    // Nothing
+  }
+
+  template<typename T, typename... ARGS>
+  void CmdSendFormatArgs(
+    T value,                            // Argument
+    ARGS... args)                       // Remaining arguments
+  {
+    CmdSend32((uint32_t)value);
+    CmdSendFormatArgs(args...);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Draw text that's formatted by the co-processor
+  //
+  // This sends a CMD_TEXT with OPT_FORMAT, followed by the arguments as
+  // 32 bit values, so that the EVE does the formatting instead of the
+  // host (EVE3/EVE4 only). The format string is truncated to
+  // FORMAT_MAXLEN bytes.
+  //
+  // Arguments can be integer values (for %d, %i, %u, %o, %x, %X and %c)
+  // or RAM_G addresses of strings (for %s). Use STEVE_TEXT_FORMAT instead
+  // of calling this directly, to check the number of arguments against
+  // a literal format string at compile time.
+  template<typename... ARGS>
+  CmdIndex                              // Returns index after command
+  CmdTextFormat(
+    int16_t x16,                        // X coordinate
+    int16_t y16,                        // Y coordinate
+    int16_t font5,                      // Font handle
+    OPT options,                        // Options, OPT_FORMAT is added
+    const char *format,                 // Format string
+    ARGS... args)                       // Arguments
+  {
+    if (_chipid < SteveDisplay::CHIPID_BT815)
+    {
+      DBG_STAT("OPT_FORMAT not supported by this chip\n");
+    }
+
+    if (FormatArgCount(format) != sizeof...(args))
+    {
+      DBG_GEEK("Format string \"%s\" needs %u arguments, got %u\n",
+        format ? format : "", FormatArgCount(format), (unsigned)sizeof...(args));
+    }
+
+    Cmd(ENC_CMD_TEXT);
+    CmdSend16((uint16_t)x16);
+    CmdSend16((uint16_t)y16);
+    CmdSend16((uint16_t)font5);
+    CmdSend16((uint16_t)(options | OPT_FORMAT));
+    CmdSendStringPadded(format, FORMAT_MAXLEN);
+    CmdSendFormatArgs(args...);
+
+    return _cmd_index;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get pointer to first available byte in RAM_G
+  uint32_t                              // Returns pointer in RAM_G
+  CmdGetPtr()
+  {
+    uint32_t result;
+
+    CmdWaitComplete();
+
+    CmdIndex p; // Cmd index of output stored here
+    cmd_GETPTR(&p);
+
+    // Execute the command
+    CmdExecute(true);
+
+    // Retrieve the result
+    result = CmdRead32(p);
+
+    DBG_TRAFFIC("RAM_G first free byte is at %08lX\n", result);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Start a streaming CMD_INFLATE
+  //
+  // The staging buffer (if any) is taken out of use, so that the data
+  // goes directly to the command queue.
+  CmdStaging *                          // Returns old staging buffer
+  InflateBegin(
+    uint32_t ptr32)                     // Destination in RAM_G
+  {
+    CmdStaging *result = _staging;
+
+    if (result)
+    {
+      CmdSetStaging(NULL);
+    }
+
+    cmd_INFLATE(ptr32, 0, NULL);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a chunk of compressed data for a streaming CMD_INFLATE
+  //
+  // In non-bulk mode, the co-processor is told about the data that was
+  // sent whenever another INFLATE_KICK_SIZE bytes were sent, so that it
+  // decompresses the data while the next chunk is sent. In bulk mode, the
+  // co-processor sees the data as soon as it arrives.
+  void InflateChunk(
+    const uint8_t *data,                // Compressed data
+    uint32_t len,                       // Number of bytes
+    uint32_t &unkicked)                 // Bytes not announced yet, updated
+  {
+    CmdSendBuffer(data, len);
+
+    unkicked += len;
+
+    if ((!_cmd_bulk) && (unkicked >= INFLATE_KICK_SIZE))
+    {
+      RegWrite16(REG_CMD_WRITE, _cmd_index.index() & ~3);
+
+      unkicked = 0;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Finish a streaming CMD_INFLATE
+  uint32_t                              // Returns end pointer, 0=error
+  InflateEnd(
+    CmdStaging *staging)                // Staging buffer to restore
+  {
+    bool error;
+
+    CmdSendAlignmentBytes();
+    CmdExecute(true, &error);
+
+    if (staging)
+    {
+      CmdSetStaging(staging);
+    }
+
+    if (error)
+    {
+      DBG_STAT("Co-processor error during streaming inflate\n");
+
+      return 0;
+    }
+
+    return CmdGetPtr();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Decompress data into RAM_G while it's being sent
+  //
+  // This works the same as cmd_INFLATE, but the co-processor is started
+  // early and kept running while the rest of the compressed data is sent,
+  // instead of only when the command queue is full. The function waits
+  // until the data is decompressed, and returns the end of the
+  // decompressed data (see CmdGetPtr).
+  uint32_t                              // Returns end pointer, 0=error
+  InflateStream(
+    uint32_t ptr32,                     // Destination in RAM_G
+    const uint8_t *data,                // Compressed data
+    uint32_t len)                       // Number of bytes
+  {
+    CmdStaging *staging = InflateBegin(ptr32);
+    uint32_t unkicked = 0;
+
+    while (len)
+    {
+      uint32_t chunk = (len < INFLATE_KICK_SIZE) ? len : INFLATE_KICK_SIZE;
+
+      InflateChunk(data, chunk, unkicked);
+
+      data += chunk;
+      len -= chunk;
+    }
+
+    return InflateEnd(staging);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Decompress data from a reader function into RAM_G
+  //
+  // This works the same as the function above, but the compressed data
+  // is retrieved in small chunks by calling the reader, so it doesn't
+  // have to be in host memory all at once; e.g. it can be read from a
+  // file or from a serial flash chip. The reader is called as:
+  //
+  //   uint32_t reader(uint8_t *buffer, uint32_t maxlen)
+  //
+  // It should return the number of bytes that it stored in the buffer.
+  // If it returns 0 before all the data was read, the co-processor is
+  // probably stuck waiting for more data, so the function fails without
+  // waiting for it.
+  template<typename READER> uint32_t    // Returns end pointer, 0=error
+  InflateStream(
+    uint32_t ptr32,                     // Destination in RAM_G
+    uint32_t len,                       // Number of bytes of input
+    READER reader)                      // Function that reads input
+  {
+    uint8_t buffer[INFLATE_READ_SIZE];
+    CmdStaging *staging = InflateBegin(ptr32);
+    uint32_t unkicked = 0;
+
+    while (len)
+    {
+      uint32_t chunk = reader(buffer, (len < sizeof(buffer)) ? len : (uint32_t)sizeof(buffer));
+
+      if ((!chunk) || (chunk > len))
+      {
+        DBG_STAT("Reader failed during streaming inflate\n");
+
+        CmdSendAlignmentBytes();
+        CmdExecute();
+
+        if (staging)
+        {
+          CmdSetStaging(staging);
+        }
+
+        return 0;
+      }
+
+      InflateChunk(buffer, chunk, unkicked);
+
+      len -= chunk;
+    }
+
+    return InflateEnd(staging);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Finish the current display list and swap and execute
+  CmdIndex                              // Returns updated Cmd index
+  CmdDlFinish(
+    bool waituntilcomplete = false)     // True = wait until done
+  {
+    cmd_DISPLAY();
+
+    cmd_SWAP();
+
+    // If the frame is the same as the previous one, it's discarded, and
+    // only the commands that were staged before it (if any) are sent.
+    FrameIsDuplicate();
+
+    CmdIndex result = CmdExecute(waituntilcomplete);
+
+#if STEVE_STATS
+    // A skipped frame isn't counted; anything that was staged before it
+    // counts towards the next frame that's sent.
+    if (!_dedup_skipped)
+    {
+      _stats._frames++;
+      _stats._frame_bytes = _stats._bytes_sent - _stats_frame_start;
+      if (_stats._frame_bytes > _stats._max_frame_bytes)
+      {
+        _stats._max_frame_bytes = _stats._frame_bytes;
+      }
+      _stats_frame_start = _stats._bytes_sent;
+    }
+#endif
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Check if the frame that was just finished is the same as the last one
+  //
+  // This only works if the entire frame, from CMD_DLSTART up to CMD_SWAP,
+  // is still in the staging buffer. The frame is hashed, and if the hash is
+  // the same as for the previous frame, the frame is removed from the
+  // staging buffer.
+  bool                                  // Returns true=frame discarded
+  FrameIsDuplicate()
+  {
+    _dedup_skipped = false;
+
+    if ((!_dedup_armed) || (!_staging))
+    {
+      return false;
+    }
 
-  //=========================================================================
-  // CO-PROCESSOR FUNCTIONS FOR SOME DRAWING PRIMITIVES
-  //=========================================================================
+    _dedup_armed = false;
+
+    // If the staging buffer was flushed during the frame, the offset is
+    // beyond the staged data.
+    uint16_t offset = (_dedup_start - (int16_t)_staging_index.index()).index();
+
+    if (offset > _staging->_length)
+    {
+      return false;
+    }
+
+    // FNV-1a hash, leaving out the excluded ranges
+    uint32_t hash = 2166136261UL;
+    uint8_t x = 0;
+
+    for (uint16_t u = offset; u < _staging->_length; u++)
+    {
+      if ((x < _dedup_excludes) && (u == (_dedup_exclude[x][0] - (int16_t)_staging_index.index()).index()))
+      {
+        u = (uint16_t)((_dedup_exclude[x][1] - (int16_t)_staging_index.index()).index() - 1);
+        x++;
+        continue;
+      }
+
+      hash = (hash ^ _staging->_buffer[u]) * 16777619UL;
+    }
+
+    if (hash != _dedup_hash)
+    {
+      _dedup_hash = hash;
+
+      return false;
+    }
+
+    DBG_TRAFFIC("Frame unchanged, skipped\n");
+
+    _staging->_length = offset;
+    _cmd_index = _dedup_start;
+    _dedup_skipped = true;
+
+    return true;
+  }
 
 public:
   //-------------------------------------------------------------------------
-  // Get pointer to first available byte in RAM_G
-  uint32_t                              // Returns pointer in RAM_G
-  CmdGetPtr()
+  // Enable or disable skipping of unchanged frames
+  //
+  // When enabled, CmdDlFinish compares each frame with the previous one,
+  // and if they're the same, the frame is discarded instead of sent, so
+  // the EVE keeps showing the previous display list. The display still
+  // reflects any changes to RAM_G (e.g. bitmaps), because the display list
+  // refers to it.
+  //
+  // The frame must be built in a staging buffer that's big enough for the
+  // entire frame (see CmdSetStaging); frames that don't fit are always
+  // sent.
+  void CmdSetFrameDedup(
+    bool enable)                        // True=skip unchanged frames
   {
-    uint32_t result;
+    _dedup_enabled = enable;
+    _dedup_armed = false;
+    _dedup_skipped = false;
 
-    CmdWaitComplete();
+    InvalidateFrameHash();
+  }
 
-    CmdIndex p; // Cmd index of output stored here
-    cmd_GETPTR(&p);
+public:
+  //-------------------------------------------------------------------------
+  // Leave commands out of the comparison of frames
+  //
+  // The commands that are generated between FrameHashExcludeBegin and
+  // FrameHashExcludeEnd don't count when a frame is compared with the
+  // previous one (see CmdSetFrameDedup). This is for commands that are
+  // different in every frame without changing what's on the screen, such
+  // as the CMD_MEMCPY commands of SteveProfiler. If the frame is skipped,
+  // these commands are skipped with it.
+  //
+  // A frame can have up to DEDUP_EXCLUDES ranges; after that, the commands
+  // are compared normally.
+  void FrameHashExcludeBegin()
+  {
+    if ((_dedup_armed) && (_dedup_excludes < DEDUP_EXCLUDES))
+    {
+      _dedup_exclude[_dedup_excludes][0] = _cmd_index;
+    }
+  }
 
-    // Execute the command
-    CmdExecute(true);
+  void FrameHashExcludeEnd()
+  {
+    if ((_dedup_armed) && (_dedup_excludes < DEDUP_EXCLUDES))
+    {
+      _dedup_exclude[_dedup_excludes][1] = _cmd_index;
+      _dedup_excludes++;
+    }
+  }
 
-    // Retrieve the result
-    result = CmdRead32(p);
+public:
+  //-------------------------------------------------------------------------
+  // Make sure the next frame is sent, even if it's unchanged
+  //
+  // Call this when the previous frame may not be on the screen anymore,
+  // e.g. after writing a display list with the dl_ functions.
+  void InvalidateFrameHash()
+  {
+    // The hash of a frame is never 0 in practice, because a frame always
+    // contains at least CMD_DLSTART, DISPLAY and CMD_SWAP.
+    _dedup_hash = 0;
+  }
 
-    DBG_TRAFFIC("RAM_G first free byte is at %08lX\n", result);
+public:
+  //-------------------------------------------------------------------------
+  // Check if the last frame was skipped because it was unchanged
+  bool                                  // Returns true=skipped
+  FrameWasSkipped() const
+  {
+    return _dedup_skipped;
+  }
 
-    return result;
+public:
+  //-------------------------------------------------------------------------
+  // Retire the frames that the co-processor has finished
+  //
+  // This reads the co-processor read index (unless all frames are already
+  // known to be finished), and forgets about the submitted frames that the
+  // co-processor has read completely. It never waits.
+  //
+  // If the co-processor encountered an error, all frames are forgotten.
+  uint8_t                               // Returns num frames still pending
+  TryCompleteFrame()
+  {
+    if (_frames_pending)
+    {
+      bool error;
+
+      CmdReadIndex(&error);
+
+      if (error)
+      {
+        DBG_STAT("Co-processor error, frames discarded\n");
+
+        _frames_pending = 0;
+      }
+
+      // The totals wrap around, so compare the difference
+      uint8_t done = 0;
+
+      while ((done < _frames_pending) && ((int32_t)(_cmd_done_total - _frame_end[done]) >= 0))
+      {
+        done++;
+      }
+
+      if (done)
+      {
+        for (uint8_t u = done; u < _frames_pending; u++)
+        {
+          _frame_end[u - done] = _frame_end[u];
+        }
+
+        _frames_pending -= done;
+      }
+    }
+
+    return _frames_pending;
   }
 
 public:
   //-------------------------------------------------------------------------
-  // Finish the current display list and swap and execute
+  // Get the number of frames that the co-processor hasn't finished yet
+  //
+  // The value isn't updated from the EVE; use TryCompleteFrame for that.
+  uint8_t                               // Returns number of frames pending
+  FramesPending() const
+  {
+    return _frames_pending;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start a new frame
+  //
+  // This starts a co-processor display list for a new frame, without
+  // waiting for the co-processor to finish the previous frame: the new
+  // frame is stored in the free part of the command queue (or in the
+  // staging buffer) while the co-processor is still working on the
+  // previous one. The co-processor doesn't start writing the new display
+  // list until the previous one was swapped in.
+  //
+  // Up to FRAMES_IN_FLIGHT frames can be submitted; if that many frames
+  // are still pending, the function waits until the oldest one is done, or
+  // returns false immediately if the caller doesn't want to wait. While
+  // waiting, the !INT line is used if INT_CMDEMPTY or INT_SWAP interrupts
+  // are enabled (see EnableInterrupts); otherwise the co-processor is
+  // polled (see CmdPollWait).
+  //
+  // A frame that's started with BeginFrame should be ended with
+  // SubmitFrame.
+  bool                                  // Returns true=frame started
+  BeginFrame(
+    bool wait = true)                   // False=return false if busy
+  {
+    uint8_t attempt = 0;
+
+    while (TryCompleteFrame() >= FRAMES_IN_FLIGHT)
+    {
+      if (!wait)
+      {
+        return false;
+      }
+
+      CmdYield();
+
+      if (_int_mask & (INT_CMDEMPTY | INT_SWAP))
+      {
+        if (_hal.WaitForInterrupt(INT_WAIT_TIMEOUT_MS))
+        {
+          IntReadFlags();
+        }
+      }
+      else
+      {
+        CmdPollWait(attempt);
+      }
+    }
+
+    cmd_DLSTART();
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Submit a frame that was started with BeginFrame
+  //
+  // This ends the display list, tells the co-processor to swap it in, and
+  // starts the co-processor. It doesn't wait; the frame is tracked so that
+  // BeginFrame and TryCompleteFrame know when it's done.
   CmdIndex                              // Returns updated Cmd index
-  CmdDlFinish(
-    bool waituntilcomplete = false)     // True = wait until done
+  SubmitFrame()
   {
-    cmd_DISPLAY();
+    CmdDlFinish(false);
 
-    cmd_SWAP();
+    // A skipped frame doesn't keep the co-processor busy
+    if (_dedup_skipped)
+    {
+      return _cmd_index;
+    }
+
+    // CmdDlFinish flushed the staging buffer, so the total includes the
+    // entire frame.
+    if (_frames_pending < FRAMES_IN_FLIGHT)
+    {
+      _frame_end[_frames_pending++] = _cmd_sent_total;
+    }
+    else
+    {
+      // The caller didn't use BeginFrame; track the newest frame only
+      _frame_end[FRAMES_IN_FLIGHT - 1] = _cmd_sent_total;
+    }
 
-    return CmdExecute(waituntilcomplete);
+    return _cmd_index;
   }
 
 public:
@@ -2107,6 +6747,257 @@ public:
     return cmd_COLOR_A(alpha);
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // End a primitive that was drawn by one of the functions below
+  //
+  // If the shadow state is enabled (see CmdSetShadowState), the END is left
+  // out: the primitive stays open, so when the next primitive is of the
+  // same type, its BEGIN is dropped too, and their vertices are merged
+  // into one BEGIN/END group. A primitive of a different type, or any
+  // co-processor command, ends it implicitly.
+  //
+  // Strips are always ended: their vertices are connected, so merging two
+  // of them would draw a line or an edge from one to the other.
+  void PrimitiveEnd()
+  {
+    uint32_t begin = _shadow[SHADOW_BEGIN];
+
+    if ((!_shadow_enabled)
+      || ((begin >= ENC_BEGIN(BEGIN_LINE_STRIP)) && (begin <= ENC_BEGIN(BEGIN_EDGE_STRIP_B))))
+    {
+      cmd_END();
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Builder for a batch of vertices of the same primitive type
+  //
+  // Use BeginBatch to create one, and call End when done, e.g.:
+  //
+  //   Steve::Batch b = eve.BeginBatch(Steve::BEGIN_POINTS);
+  //   for (...) b.Vertex(x, y);
+  //   b.End();
+  //
+  // All vertices share one BEGIN/END pair. Vertex takes coordinates in
+  // whole pixels, and uses the smallest encoding (see CmdVertex).
+  class Batch
+  {
+  protected:
+    SteveT           &_steve;           // EVE to draw on
+
+  public:
+    //-----------------------------------------------------------------------
+    // Constructor
+    Batch(
+      SteveT &steve,                    // EVE to draw on
+      BEGIN prim)                       // Primitive type
+      : _steve(steve)
+    {
+      steve.cmd_BEGIN(prim);
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Add a vertex in whole pixels
+    CmdIndex                            // Returns updated Cmd index
+    Vertex(
+      int16_t x,                        // X coordinate in pixels
+      int16_t y)                        // Y coordinate in pixels
+    {
+      return _steve.CmdVertex((int32_t)x * 16, (int32_t)y * 16);
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // Add a vertex in the current VERTEX2F precision
+    CmdIndex                            // Returns updated Cmd index
+    VertexF(
+      int16_t x,                        // X coordinate, current precision
+      int16_t y)                        // Y coordinate, current precision
+    {
+      return _steve.cmd_VERTEX2F(x, y);
+    }
+
+  public:
+    //-----------------------------------------------------------------------
+    // End the batch
+    //
+    // With the shadow state enabled, the END is postponed so that a
+    // following batch or primitive of the same type is merged with this
+    // one, unless it's a strip (see PrimitiveEnd).
+    CmdIndex                            // Returns updated Cmd index
+    End()
+    {
+      _steve.PrimitiveEnd();
+
+      return _steve._cmd_index;
+    }
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the current vertex translation for one axis
+  //
+  // If it's unknown, it's set to 0.
+  int32_t                               // Returns translation, 1/16 pixel
+  VertexTranslation(
+    SHADOW slot)                        // SHADOW_VERTEX_TRANSLATE_X or _Y
+  {
+    uint32_t value = _shadow[slot];
+
+    if (value == SHADOW_UNKNOWN)
+    {
+      value = (slot == SHADOW_VERTEX_TRANSLATE_X) ? ENC_VERTEX_TRANSLATE_X(0) : ENC_VERTEX_TRANSLATE_Y(0);
+      Cmd(value);
+    }
+
+    // Sign-extend the 17 bit field
+    return ((int32_t)((value & 0x1FFFFUL) << 15)) >> 15;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Translate a coordinate so that it fits in the vertex range
+  //
+  // If the coordinate doesn't fit in the range (relative to the current
+  // translation), the translation is moved to the whole pixel at or
+  // below the coordinate.
+  //
+  // The caller restores the translation after the vertex (see CmdVertex).
+  int32_t                               // Returns relative coordinate
+  VertexFit(
+    SHADOW slot,                        // SHADOW_VERTEX_TRANSLATE_X or _Y
+    int32_t v16,                        // Coordinate in 1/16 pixel
+    int32_t min16,                      // Minimum relative coordinate
+    int32_t max16)                      // Maximum relative coordinate
+  {
+    int32_t t16 = VertexTranslation(slot);
+    int32_t rel = v16 - t16;
+
+    if ((rel < min16) || (rel > max16))
+    {
+      t16 = v16 & ~(int32_t)15;
+
+      Cmd((slot == SHADOW_VERTEX_TRANSLATE_X) ? ENC_VERTEX_TRANSLATE_X((uint32_t)t16) : ENC_VERTEX_TRANSLATE_Y((uint32_t)t16));
+
+      rel = v16 - t16;
+    }
+
+    return rel;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a vertex with the smallest possible encoding
+  //
+  // The coordinates are in 1/16 pixel, regardless of the VERTEX_FORMAT.
+  // The shadow state is used to find the vertex format, the translation
+  // and (for bitmaps) the handle and cell:
+  // * If the coordinates are whole pixels within 0-511 of the current
+  //   translation, VERTEX2II is used. This is only done if the primitive
+  //   is known not to be BITMAPS, or if the bitmap handle and cell are
+  //   known, so they can be repeated.
+  // * Otherwise, VERTEX2F is used. If the format isn't known, it's set
+  //   to 1/16 pixel. If a coordinate is out of range, VERTEX_TRANSLATE_X
+  //   or VERTEX_TRANSLATE_Y is used to move the origin, and moved back
+  //   after the vertex.
+  //
+  // Without the shadow state (see CmdSetShadowState), nothing is known,
+  // so a VERTEX2F is sent that assumes the default format and no
+  // translation.
+  //
+  // This should only be used between BEGIN and END.
+  CmdIndex                              // Returns updated Cmd index
+  CmdVertex(
+    int32_t x16,                        // X coordinate in 1/16 pixel
+    int32_t y16)                        // Y coordinate in 1/16 pixel
+  {
+    if (!_shadow_enabled)
+    {
+      return cmd_VERTEX2F((int16_t)x16, (int16_t)y16);
+    }
+
+    int32_t rx = x16 - VertexTranslation(SHADOW_VERTEX_TRANSLATE_X);
+    int32_t ry = y16 - VertexTranslation(SHADOW_VERTEX_TRANSLATE_Y);
+
+    if ((!((rx | ry) & 15)) && (rx >= 0) && (rx < 512 * 16) && (ry >= 0) && (ry < 512 * 16))
+    {
+      uint32_t begin = _shadow[SHADOW_BEGIN];
+      uint32_t handle = _shadow[SHADOW_BITMAP_HANDLE];
+      uint32_t cell = _shadow[SHADOW_CELL];
+
+      if ((begin != SHADOW_UNKNOWN) && (begin != ENC_BEGIN(BEGIN_BITMAPS)))
+      {
+        // Handle and cell are ignored
+        return cmd_VERTEX2II((uint16_t)(rx >> 4), (uint16_t)(ry >> 4), 0, 0);
+      }
+      else if ((handle != SHADOW_UNKNOWN) && (cell != SHADOW_UNKNOWN))
+      {
+        // The encoded handle and cell fit the VERTEX2II fields
+        return cmd_VERTEX2II((uint16_t)(rx >> 4), (uint16_t)(ry >> 4), (uint8_t)(handle & 31), (uint8_t)(cell & 127));
+      }
+    }
+
+    if (_shadow[SHADOW_VERTEX_FORMAT] == SHADOW_UNKNOWN)
+    {
+      cmd_VERTEX_FORMAT(4);
+    }
+
+    // VERTEX2F has 15 bit signed coordinates in units of 1/2^frac pixel
+    uint8_t shift = 4 - (uint8_t)(_shadow[SHADOW_VERTEX_FORMAT] & 7);
+
+    if (shift > 4)
+    {
+      // Formats with more than 4 fraction bits aren't supported
+      shift = 0;
+    }
+
+    int32_t lim = 16384L << shift;
+    uint32_t tx = _shadow[SHADOW_VERTEX_TRANSLATE_X];
+    uint32_t ty = _shadow[SHADOW_VERTEX_TRANSLATE_Y];
+
+    rx = VertexFit(SHADOW_VERTEX_TRANSLATE_X, x16, -lim, lim - 1);
+    ry = VertexFit(SHADOW_VERTEX_TRANSLATE_Y, y16, -lim, lim - 1);
+
+    cmd_VERTEX2F((int16_t)(rx >> shift), (int16_t)(ry >> shift));
+
+    // Restore the translation for the display list commands that follow
+    if (_shadow[SHADOW_VERTEX_TRANSLATE_X] != tx)
+    {
+      Cmd(tx);
+    }
+
+    if (_shadow[SHADOW_VERTEX_TRANSLATE_Y] != ty)
+    {
+      Cmd(ty);
+    }
+
+    return _cmd_index;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a vertex in whole pixels with the smallest possible encoding
+  CmdIndex                              // Returns updated Cmd index
+  CmdVertexPixel(
+    int16_t x,                          // X coordinate in pixels
+    int16_t y)                          // Y coordinate in pixels
+  {
+    return CmdVertex((int32_t)x * 16, (int32_t)y * 16);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start a batch of vertices
+  Batch                                 // Returns batch builder
+  BeginBatch(
+    BEGIN prim)                         // Primitive type
+  {
+    return Batch(*this, prim);
+  }
+
 public:
   //-------------------------------------------------------------------------
   // Draw a point at the given location
@@ -2126,7 +7017,7 @@ public:
     cmd_VERTEX2F(point_x, point_y);
 
     // End the point
-    cmd_END();
+    PrimitiveEnd();
 
     return _cmd_index;
   }
@@ -2155,7 +7046,7 @@ public:
     cmd_VERTEX2F(x1, y1);
 
     // End the line
-    cmd_END();
+    PrimitiveEnd();
 
     return _cmd_index;
   }
@@ -2183,7 +7074,7 @@ public:
     cmd_VERTEX2F(x1, y1);
 
     // End the rectangle
-    cmd_END();
+    PrimitiveEnd();
 
     return _cmd_index;
   }
@@ -2222,7 +7113,7 @@ public:
     cmd_VERTEX2F(x0, y0);
 
     // End the line set
-    cmd_END();
+    PrimitiveEnd();
 
     return _cmd_index;
   }
@@ -2310,6 +7201,12 @@ public:
   }
 };
 
+//---------------------------------------------------------------------------
+// EVE chip control class that works with any HAL
+//
+// This is the type that all helper classes take (see SteveT above).
+typedef SteveT<SteveHAL> Steve;
+
 /////////////////////////////////////////////////////////////////////////////
 // END
 /////////////////////////////////////////////////////////////////////////////
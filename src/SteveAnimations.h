@@ -0,0 +1,320 @@
+/****************************************************************************
+SteveAnimations.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a scheduler for the animation channels of EVE3/EVE4.
+****************************************************************************/
+
+#ifndef _STEVEANIMATIONS_H
+#define _STEVEANIMATIONS_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+#if !STEVE_CMD_ANIM
+#error SteveAnimations needs the animation commands (STEVE_CMD_ANIM)
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// ANIMATION SCHEDULER
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Scheduler for animation channels
+//
+// The co-processor of the BT815 and later plays animations by itself: an
+// animation is started on one of 32 channels, and every frame, a single
+// CMD_ANIMDRAW draws the current frame of each active channel and moves
+// the channel to the next frame. The host doesn't have to keep track of
+// frame numbers, as it would with CMD_ANIMFRAME.
+//
+// The scheduler keeps track of which channels are in use: Start takes a
+// free channel and Stop releases it. Draw adds the animations to the
+// display list that's being built; normally this is one command for all
+// channels. On the BT817/BT818, Update releases the channels of
+// animations that have finished playing, by reading REG_ANIM_ACTIVE. On
+// the BT815/BT816, that register doesn't exist and animations that play
+// once must be stopped by the application.
+//
+// On the BT817/BT818, Run uses CMD_RUNANIM to let the co-processor play
+// animations without any host involvement, until they finish or until the
+// host clears a control byte in RAM_G.
+class SteveAnimations
+{
+public:
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint8_t  CHANNELS = 32;
+  const static uint8_t  INVALID_CHANNEL = 0xFF;
+  const static int32_t  ALL_CHANNELS = -1;      // For ANIMSTOP/ANIMDRAW
+  const static uint32_t NO_PLAY_CONTROL = 0xFFFFFFFFUL; // For RUNANIM
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  uint32_t          _used;              // Channels in use
+  uint32_t          _hidden;            // Channels not drawn
+  uint32_t          _pending;           // Started, maybe not running yet
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveAnimations(
+    Steve &eve)                         // Display
+    : _eve(eve)
+    , _used(0)
+    , _hidden(0)
+    , _pending(0)
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Stop all animations and release all channels
+  //
+  // This should also be called after Steve::Begin, because a reset stops
+  // all animations.
+  void Reset()
+  {
+    if (_used)
+    {
+      _eve.cmd_ANIMSTOP(ALL_CHANNELS);
+    }
+
+    _used = 0;
+    _hidden = 0;
+    _pending = 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a free channel
+  uint8_t                               // Returns channel, INVALID=none
+  Alloc()
+  {
+    for (uint8_t u = 0; u < CHANNELS; u++)
+    {
+      if (!(_used & (1UL << u)))
+      {
+        _used |= 1UL << u;
+        _pending |= 1UL << u;
+        _hidden &= ~(1UL << u);
+
+        return u;
+      }
+    }
+
+    DBG_STAT("No free animation channel\n");
+
+    return INVALID_CHANNEL;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start an animation
+  //
+  // The animation object can be in flash (BT815 and later) or in RAM_G
+  // (BT817/BT818 only).
+  uint8_t                               // Returns channel, INVALID=none
+  Start(
+    uint32_t aoptr32,                   // Animation object in flash/RAM_G
+    int16_t x16,                        // X coordinate of the center
+    int16_t y16,                        // Y coordinate of the center
+    Steve::ANIM loop = Steve::ANIM_LOOP,// Playback mode
+    bool ram = false)                   // True=object in RAM_G
+  {
+#if !STEVE_CMD_EVE4
+    if (ram)
+    {
+      DBG_STAT("Animations in RAM_G need STEVE_CMD_EVE4\n");
+      return INVALID_CHANNEL;
+    }
+#endif
+
+    uint8_t result = Alloc();
+
+    if (result != INVALID_CHANNEL)
+    {
+      if (ram)
+      {
+#if STEVE_CMD_EVE4
+        _eve.cmd_ANIMSTARTRAM(result, aoptr32, loop);
+#endif
+      }
+      else
+      {
+        _eve.cmd_ANIMSTART(result, aoptr32, loop);
+      }
+
+      _eve.cmd_ANIMXY(result, x16, y16);
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Stop an animation and release its channel
+  void Stop(
+    uint8_t channel)                    // Channel from Start
+  {
+    if ((channel < CHANNELS) && (_used & (1UL << channel)))
+    {
+      _eve.cmd_ANIMSTOP(channel);
+
+      _used &= ~(1UL << channel);
+      _pending &= ~(1UL << channel);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Move an animation
+  void Move(
+    uint8_t channel,                    // Channel from Start
+    int16_t x16,                        // X coordinate of the center
+    int16_t y16)                        // Y coordinate of the center
+  {
+    if ((channel < CHANNELS) && (_used & (1UL << channel)))
+    {
+      _eve.cmd_ANIMXY(channel, x16, y16);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Show or hide an animation
+  //
+  // A hidden animation isn't drawn by Draw, but its channel stays in use.
+  void Show(
+    uint8_t channel,                    // Channel from Start
+    bool show)                          // True=show, false=hide
+  {
+    if (channel < CHANNELS)
+    {
+      if (show)
+      {
+        _hidden &= ~(1UL << channel);
+      }
+      else
+      {
+        _hidden |= 1UL << channel;
+      }
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Draw the animations in the display list that's being built
+  //
+  // If no animations are hidden, all active channels are drawn with a
+  // single CMD_ANIMDRAW; otherwise one is sent per visible channel.
+  void Draw()
+  {
+    uint32_t visible = _used & ~_hidden;
+
+    if (!visible)
+    {
+      return;
+    }
+
+    if (visible == _used)
+    {
+      _eve.cmd_ANIMDRAW(ALL_CHANNELS);
+      return;
+    }
+
+    for (uint8_t u = 0; u < CHANNELS; u++)
+    {
+      if (visible & (1UL << u))
+      {
+        _eve.cmd_ANIMDRAW(u);
+      }
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Release the channels of animations that have finished
+  //
+  // This only works on the BT817/BT818; on other chips it does nothing.
+  // Channels that were started while the co-processor is still busy, or
+  // while their commands are still in the staging buffer, are left alone,
+  // because their animations may not be running yet.
+  uint32_t                              // Returns mask of released channels
+  Update()
+  {
+    if ((!_used) || (_eve.ChipId() < SteveDisplay::CHIPID_BT817))
+    {
+      return 0;
+    }
+
+    if ((!_eve.CmdIsStaged()) && (!_eve.CmdIsBusy()))
+    {
+      _pending = 0;
+    }
+
+    uint32_t done = _used & ~_pending & ~_eve.RegRead32(Steve::REG_ANIM_ACTIVE);
+
+    _used &= ~done;
+
+    return done;
+  }
+
+#if STEVE_CMD_EVE4
+public:
+  //-------------------------------------------------------------------------
+  // Let the co-processor play animations by itself
+  //
+  // This sends CMD_RUNANIM, which keeps the co-processor busy drawing
+  // frames until all animations in the mask have finished, or until the
+  // control byte at the given address in RAM_G is set to 0 by the host
+  // (if the address is NO_PLAY_CONTROL, there's no control byte, and
+  // the mask should only contain animations that play once). The host
+  // should not send other commands until the co-processor is done (see
+  // Steve::CmdIsBusy). The channels stay in use until Update sees that
+  // they finished, or until they're stopped.
+  void Run(
+    uint32_t waitmask32,                // Channels to wait for
+    uint32_t play32 = NO_PLAY_CONTROL)  // Address of control byte
+  {
+    if (play32 != NO_PLAY_CONTROL)
+    {
+      _eve.RegWrite8(play32, 1);
+    }
+
+    _eve.cmd_RUNANIM(waitmask32, play32);
+    _eve.CmdExecute();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Stop the animations that were started with Run
+  void StopRun(
+    uint32_t play32)                    // Address of control byte
+  {
+    _eve.RegWrite8(play32, 0);
+  }
+#endif
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the channels that are in use
+  uint32_t                              // Returns mask of channels
+  Active() const
+  {
+    return _used;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
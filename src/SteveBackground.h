@@ -0,0 +1,263 @@
+/****************************************************************************
+SteveBackground.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a background layer that's rendered once and then
+drawn as a bitmap.
+****************************************************************************/
+
+#ifndef _STEVEBACKGROUND_H
+#define _STEVEBACKGROUND_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+#include "SteveRamG.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// CACHED BACKGROUND
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Static background that's captured into a bitmap
+//
+// Screens with a complicated background (gradients, many widgets) and a
+// few small parts that change, take a lot of co-processor time and a long
+// display list to draw every frame. This renders the background once, and
+// captures it with CMD_SNAPSHOT2 into a bitmap in RAM_G, allocated from a
+// SteveRamG allocator. After that, each frame only draws the bitmap, plus
+// the dynamic parts, which can be limited to regions of the screen with
+// BeginRegion and EndRegion.
+//
+// The application provides a function that draws the background, and a
+// hash of everything that the background depends on (see Hash). Update
+// renders the background again whenever the hash changes.
+//
+// Rendering the background shows it on the screen for one frame, because
+// CMD_SNAPSHOT2 takes its snapshot from the screen. Update must not be
+// called while a frame is being built.
+class SteveBackground
+{
+public:
+  //-------------------------------------------------------------------------
+  // Function that draws the background
+  //
+  // This is called between CMD_DLSTART and DISPLAY, and should only add
+  // commands to the display list.
+  typedef void (*DRAW_FUNC)(
+    Steve &eve,                         // Display
+    void *context);                     // Context from Update
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  SteveRamG        &_ramg;              // Allocator for the bitmap
+  Steve::FORMAT     _format;            // Bitmap format
+  int16_t           _x;                 // Left of area in pixels
+  int16_t           _y;                 // Top of area in pixels
+  uint16_t          _width;             // Width of area in pixels
+  uint16_t          _height;            // Height of area in pixels
+  SteveRamG::HANDLE _block;             // Bitmap memory
+  uint32_t          _hash;              // Hash of captured background
+  bool              _valid;             // True=bitmap is up to date
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // The area that's captured can be a part of the screen; if the width
+  // or height is 0, the whole screen is used. The format must be
+  // FORMAT_RGB565 or FORMAT_ARGB4; both use 2 bytes per pixel.
+  SteveBackground(
+    Steve &eve,                         // Display
+    SteveRamG &ramg,                    // Allocator for the bitmap
+    Steve::FORMAT format = Steve::FORMAT_RGB565, // Bitmap format
+    int16_t x = 0,                      // Left of area in pixels
+    int16_t y = 0,                      // Top of area in pixels
+    uint16_t width = 0,                 // Width in pixels, 0=screen
+    uint16_t height = 0)                // Height in pixels, 0=screen
+    : _eve(eve)
+    , _ramg(ramg)
+    , _format(format)
+    , _x(x)
+    , _y(y)
+    , _width(width ? width : eve.Profile()->_hsize)
+    , _height(height ? height : eve.Profile()->_vsize)
+    , _block(SteveRamG::INVALID_HANDLE)
+    , _hash(0)
+    , _valid(false)
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Calculate a hash of some data
+  //
+  // This can be used to combine the state that the background depends
+  // on: pass the result of each call as the seed of the next one.
+  static uint32_t                       // Returns FNV-1a hash
+  Hash(
+    const void *data,                   // Data to hash
+    uint32_t len,                       // Number of bytes
+    uint32_t seed = 2166136261UL)       // Previous hash
+  {
+    const uint8_t *p = (const uint8_t *)data;
+
+    for (uint32_t u = 0; u < len; u++)
+    {
+      seed = (seed ^ p[u]) * 16777619UL;
+    }
+
+    return seed;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Make sure the bitmap matches the background
+  //
+  // If the background was never captured or the hash is different from
+  // the last time, the background is drawn and captured. The function
+  // waits until the snapshot is done.
+  bool                                  // Returns false=error
+  Update(
+    uint32_t hash,                      // Hash of the background state
+    DRAW_FUNC draw,                     // Function that draws background
+    void *context = NULL)               // Context for draw function
+  {
+    if ((_valid) && (hash == _hash))
+    {
+      return true;
+    }
+
+    _valid = false;
+
+    if (_block == SteveRamG::INVALID_HANDLE)
+    {
+      _block = _ramg.Alloc((uint32_t)_width * _height * 2);
+
+      if (_block == SteveRamG::INVALID_HANDLE)
+      {
+        return false;
+      }
+    }
+
+    bool error;
+
+    _eve.cmd_DLSTART();
+    draw(_eve, context);
+    _eve.cmd_DISPLAY();
+    _eve.cmd_SWAP();
+    _eve.CmdExecute(true, &error);
+
+    if (!error)
+    {
+      _eve.cmd_SNAPSHOT2(_format, _ramg.Address(_block), _x, _y, (int16_t)_width, (int16_t)_height);
+      _eve.CmdExecute(true, &error);
+    }
+
+    if (error)
+    {
+      DBG_STAT("Capturing the background failed\n");
+      return false;
+    }
+
+    DBG_GEEK("Background captured, hash %08lX\n", hash);
+
+    _hash = hash;
+    _valid = true;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Force the background to be captured again at the next Update
+  void Invalidate()
+  {
+    _valid = false;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Release the bitmap memory
+  void Free()
+  {
+    if (_block != SteveRamG::INVALID_HANDLE)
+    {
+      _ramg.Free(_block);
+      _block = SteveRamG::INVALID_HANDLE;
+    }
+
+    _valid = false;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Draw the captured background
+  //
+  // This adds the commands to the display list that's being built. The
+  // current bitmap handle is used. Nothing is drawn if the background was
+  // not captured.
+  bool                                  // Returns false=not captured
+  Draw()
+  {
+    if (!_valid)
+    {
+      return false;
+    }
+
+    _eve.cmd_SETBITMAP(_ramg.Address(_block), _format, _width, _height);
+    _eve.cmd_BEGIN(Steve::BEGIN_BITMAPS);
+    _eve.CmdVertexPixel(_x, _y);
+    _eve.cmd_END();
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Limit drawing to a region of the screen
+  //
+  // The graphics state is saved, and restored by EndRegion, so regions
+  // can't be nested. Everything that's drawn in between only changes the
+  // pixels in the region, so it's not necessary to redraw what's around
+  // it.
+  void BeginRegion(
+    int16_t x,                          // Left of region in pixels
+    int16_t y,                          // Top of region in pixels
+    uint16_t width,                     // Width in pixels
+    uint16_t height)                    // Height in pixels
+  {
+    _eve.cmd_SAVE_CONTEXT();
+    _eve.cmd_SCISSOR_XY((uint16_t)x, (uint16_t)y);
+    _eve.cmd_SCISSOR_SIZE(width, height);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // End a region
+  void EndRegion()
+  {
+    _eve.cmd_RESTORE_CONTEXT();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check if the bitmap is up to date
+  bool                                  // Returns true=captured
+  IsValid() const
+  {
+    return _valid;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
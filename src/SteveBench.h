@@ -0,0 +1,413 @@
+/****************************************************************************
+SteveBench.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a benchmark harness for Steve.
+****************************************************************************/
+
+#ifndef _STEVEBENCH_H
+#define _STEVEBENCH_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+// Number of timing samples that are kept for the percentiles; each sample
+// takes 4 bytes of RAM. This is also the default number of iterations per
+// scenario. If a scenario runs more iterations, the percentiles are
+// calculated from the last STEVEBENCH_SAMPLES iterations only.
+#ifndef STEVEBENCH_SAMPLES
+#define STEVEBENCH_SAMPLES 64
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// BENCHMARK HARNESS
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Benchmark scenarios
+//
+// Each scenario runs a number of iterations (frames or operations) and
+// reports the result through a function that's provided by the
+// application, so that it can be printed in a way that works on the
+// platform. The sizes of the screens are based on the display profile.
+//
+// The times are measured on the host with SteveHAL::Micros, so the HAL
+// must implement that function. To compare HALs and clock settings, run
+// the same scenarios with each of them.
+class SteveBench
+{
+public:
+  //-------------------------------------------------------------------------
+  // Result of a scenario
+  struct Result
+  {
+    const char       *_name;            // Name of the scenario
+    uint32_t          _elapsed_us;      // Total time
+    uint32_t          _iterations;      // Number of frames or operations
+    uint32_t          _bytes;           // Bytes transferred, 0=n/a
+    uint32_t          _commands;        // Commands sent, 0=n/a
+    uint32_t          _p50_us;          // Median per iteration, see STEVEBENCH_SAMPLES
+    uint32_t          _p99_us;          // 99th percentile, see STEVEBENCH_SAMPLES
+  };
+
+  //-------------------------------------------------------------------------
+  // Function that reports a result
+  typedef void (*REPORT_FUNC)(
+    const Result &result,               // Result to report
+    void *context);                     // Context from constructor
+
+  //-------------------------------------------------------------------------
+  // Scenario parameters
+  const static uint16_t SMALL_COMMANDS = 500; // Commands per frame
+  const static uint16_t UPLOAD_CHUNK = 256;   // Bytes per RegWriteBuffer
+  const static uint32_t UPLOAD_SIZE = 65536;  // Bytes per upload
+  const static uint8_t  TEXT_FONT = 26;       // Font for text scenario
+  const static uint8_t  TEXT_LINE = 16;       // Line height for font
+  const static uint8_t  BALLS = 16;           // Balls in animation
+
+protected:
+  //-------------------------------------------------------------------------
+  // State of one ball in the animation scenario
+  struct Ball
+  {
+    int16_t           _x;               // X position in pixels
+    int16_t           _y;               // Y position in pixels
+    int16_t           _dx;              // X velocity
+    int16_t           _dy;              // Y velocity
+  };
+
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  REPORT_FUNC       _report;            // Function to report results
+  void             *_context;           // Context for report function
+  uint16_t          _iterations;        // Iterations per scenario
+  uint32_t          _samples[STEVEBENCH_SAMPLES];
+                                        // Time per iteration
+  uint16_t          _count;             // Number of samples
+  uint32_t          _start_us;          // Start time of scenario
+  uint8_t           _upload[UPLOAD_CHUNK];
+                                        // Data for upload scenario
+  Ball              _balls[BALLS];      // Animation state
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveBench(
+    Steve &eve,                         // Display, already initialized
+    REPORT_FUNC report,                 // Function to report results
+    void *context = NULL,               // Context for report function
+    uint16_t iterations = STEVEBENCH_SAMPLES) // Iterations per scenario
+    : _eve(eve)
+    , _report(report)
+    , _context(context)
+    , _iterations(iterations)
+    , _count(0)
+    , _start_us(0)
+  {
+    for (uint16_t u = 0; u < UPLOAD_CHUNK; u++)
+    {
+      _upload[u] = (uint8_t)u;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Calculate a rate
+  static uint32_t                       // Returns count per second
+  PerSecond(
+    uint32_t count,                     // Number of items
+    uint32_t us)                        // Time in microseconds
+  {
+    return us ? (uint32_t)((uint64_t)count * 1000000 / us) : 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Start measuring a scenario
+  void Start()
+  {
+    _count = 0;
+    _start_us = _eve.HostMicros();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Store the time of one iteration
+  //
+  // If there are more iterations than samples, the oldest ones are
+  // overwritten.
+  void Sample(
+    uint32_t us)                        // Time of the iteration
+  {
+    _samples[_count % STEVEBENCH_SAMPLES] = us;
+    _count++;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Stop measuring and report the result
+  void Finish(
+    const char *name,                   // Name of the scenario
+    uint32_t iterations,                // Number of iterations
+    uint32_t bytes,                     // Number of bytes, 0=n/a
+    uint32_t commands)                  // Number of commands, 0=n/a
+  {
+    Result result;
+
+    result._name = name;
+    result._elapsed_us = _eve.HostMicros() - _start_us;
+    result._iterations = iterations;
+    result._bytes = bytes;
+    result._commands = commands;
+    result._p50_us = 0;
+    result._p99_us = 0;
+
+    // Sort the samples to find the percentiles
+    uint16_t n = (_count < STEVEBENCH_SAMPLES) ? _count : STEVEBENCH_SAMPLES;
+
+    for (uint16_t u = 1; u < n; u++)
+    {
+      uint32_t value = _samples[u];
+      uint16_t v = u;
+
+      while ((v > 0) && (_samples[v - 1] > value))
+      {
+        _samples[v] = _samples[v - 1];
+        v--;
+      }
+
+      _samples[v] = value;
+    }
+
+    if (n)
+    {
+      result._p50_us = _samples[(n - 1) * 50 / 100];
+      result._p99_us = _samples[(n - 1) * 99 / 100];
+    }
+
+    _report(result, _context);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Frames with many small commands
+  //
+  // Each frame draws SMALL_COMMANDS points.
+  void SmallCommands()
+  {
+    uint16_t width = _eve.Width();
+    uint16_t height = _eve.Height();
+
+    Start();
+
+    for (uint16_t f = 0; f < _iterations; f++)
+    {
+      uint32_t t = _eve.HostMicros();
+
+      _eve.BeginFrame();
+      _eve.CmdClear(0, 0, 0);
+      _eve.cmd_POINT_SIZE(16);
+      _eve.cmd_BEGIN(Steve::BEGIN_POINTS);
+
+      for (uint16_t u = 0; u < SMALL_COMMANDS; u++)
+      {
+        _eve.cmd_VERTEX2II((uint16_t)((u * 7 + f) % width % 512), (uint16_t)((u * 3) % height % 512), 0, 0);
+      }
+
+      _eve.cmd_END();
+      _eve.SubmitFrame();
+
+      Sample(_eve.HostMicros() - t);
+    }
+
+    _eve.CmdWaitComplete();
+
+    Finish("Small commands", _iterations, 0, (uint32_t)_iterations * (SMALL_COMMANDS + 4));
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Large upload to RAM_G
+  //
+  // UPLOAD_SIZE bytes are written with RegWriteBuffer, in chunks of
+  // UPLOAD_CHUNK bytes. One iteration is one chunk.
+  void Upload(
+    uint32_t address = Steve::RAM_G)    // Address of UPLOAD_SIZE bytes
+  {
+    Start();
+
+    for (uint32_t offset = 0; offset < UPLOAD_SIZE; offset += UPLOAD_CHUNK)
+    {
+      uint32_t t = _eve.HostMicros();
+
+      _eve.RegWriteBuffer(address + offset, UPLOAD_CHUNK, _upload);
+
+      Sample(_eve.HostMicros() - t);
+    }
+
+    // Reading a register makes sure that the HAL sent everything
+    _eve.RegRead32(Steve::REG_ID);
+
+    Finish("Upload", UPLOAD_SIZE / UPLOAD_CHUNK, UPLOAD_SIZE, 0);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Frames full of text
+  void Text()
+  {
+    static const char line[] = "The quick brown fox jumps over the lazy dog 0123456789";
+    uint16_t lines = _eve.Height() / TEXT_LINE;
+
+    Start();
+
+    for (uint16_t f = 0; f < _iterations; f++)
+    {
+      uint32_t t = _eve.HostMicros();
+
+      _eve.BeginFrame();
+      _eve.CmdClear(0, 0, 0);
+
+      for (uint16_t u = 0; u < lines; u++)
+      {
+        _eve.cmd_TEXT((int16_t)(f % 16), (int16_t)(u * TEXT_LINE), TEXT_FONT, Steve::OPT_NONE, line);
+      }
+
+      _eve.SubmitFrame();
+
+      Sample(_eve.HostMicros() - t);
+    }
+
+    _eve.CmdWaitComplete();
+
+    Finish("Text", _iterations, 0, (uint32_t)_iterations * (lines + 4));
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Animation with bouncing balls
+  void Animation()
+  {
+    int16_t width = (int16_t)_eve.Width();
+    int16_t height = (int16_t)_eve.Height();
+
+    for (uint8_t u = 0; u < BALLS; u++)
+    {
+      _balls[u]._x = (int16_t)((u * 37) % width);
+      _balls[u]._y = (int16_t)((u * 23) % height);
+      _balls[u]._dx = (int16_t)(1 + u % 4);
+      _balls[u]._dy = (int16_t)(1 + u % 3);
+    }
+
+    Start();
+
+    for (uint16_t f = 0; f < _iterations; f++)
+    {
+      uint32_t t = _eve.HostMicros();
+
+      _eve.BeginFrame();
+      _eve.CmdClear(0, 0, 0);
+
+      for (uint8_t u = 0; u < BALLS; u++)
+      {
+        Ball &b = _balls[u];
+
+        b._x += b._dx;
+        b._y += b._dy;
+
+        if ((b._x < 0) || (b._x >= width))
+        {
+          b._dx = -b._dx;
+          b._x += 2 * b._dx;
+        }
+
+        if ((b._y < 0) || (b._y >= height))
+        {
+          b._dy = -b._dy;
+          b._y += 2 * b._dy;
+        }
+
+        _eve.CmdColor((uint8_t)(u * 16), (uint8_t)(255 - u * 16), 128);
+        _eve.CmdAlpha(192);
+        _eve.Point((uint16_t)(b._x * 16), (uint16_t)(b._y * 16), 20 * 16);
+      }
+
+      _eve.SubmitFrame();
+
+      Sample(_eve.HostMicros() - t);
+    }
+
+    _eve.CmdWaitComplete();
+
+    Finish("Animation", _iterations, 0, 0);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Register read latency
+  void RegisterRead()
+  {
+    Start();
+
+    for (uint16_t u = 0; u < _iterations; u++)
+    {
+      uint32_t t = _eve.HostMicros();
+
+      _eve.RegRead32(Steve::REG_FRAMES);
+
+      Sample(_eve.HostMicros() - t);
+    }
+
+    Finish("Register read", _iterations, (uint32_t)_iterations * 4, 0);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Co-processor round trip: send a command and wait until it's done
+  void RoundTrip()
+  {
+    Start();
+
+    for (uint16_t u = 0; u < _iterations; u++)
+    {
+      uint32_t t = _eve.HostMicros();
+
+      _eve.cmd_NOP();
+      _eve.CmdExecute();
+      _eve.CmdWaitComplete();
+
+      Sample(_eve.HostMicros() - t);
+    }
+
+    Finish("Round trip", _iterations, 0, _iterations);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Run all scenarios
+  void Run(
+    uint32_t address = Steve::RAM_G)    // RAM_G area for upload scenario
+  {
+    SmallCommands();
+    Upload(address);
+    Text();
+    Animation();
+    RegisterRead();
+    RoundTrip();
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
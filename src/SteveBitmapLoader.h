@@ -0,0 +1,466 @@
+/****************************************************************************
+SteveBitmapLoader.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a bitmap loader that picks the fastest way to get a
+bitmap into RAM_G, based on measured transfer and decoding speeds.
+****************************************************************************/
+
+#ifndef _STEVEBITMAPLOADER_H
+#define _STEVEBITMAPLOADER_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+// Maximum number of bytes that are written to RAM_G in one transaction
+// when uncompressed data is uploaded.
+#ifndef STEVEBITMAPLOADER_CHUNK_SIZE
+#define STEVEBITMAPLOADER_CHUNK_SIZE 0x10000UL
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// ADAPTIVE BITMAP LOADER
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Bitmap loader that chooses between raw, compressed and image data
+//
+// The same bitmap can be stored on the host in up to three forms:
+// * Raw: the bitmap data as it should appear in RAM_G; this is written
+//   to RAM_G directly, in large transactions;
+// * Deflated: the raw data compressed with zlib; this is decompressed by
+//   CMD_INFLATE, while it's being sent (see Steve::InflateStream);
+// * Image: a JPEG or PNG file; this is decoded by CMD_LOADIMAGE.
+//
+// Which one is fastest depends on the speed of the bus compared to the
+// speed of the co-processor: on a fast bus, sending the raw data is
+// usually best; on a slow bus, it's usually better to send fewer bytes
+// and let the co-processor do more work. LoadBitmap estimates the time
+// for each form that's available, and uses the fastest one.
+//
+// The estimates are based on the bus speed in bytes per millisecond, and
+// on the decoding speed of the co-processor, in bytes of output per
+// millisecond. The decoding speeds start at rough values for the chip
+// generation (see Reset), and the bus speed starts unknown. Each load is
+// timed with Steve::HostMicros, and the number of bytes on the bus is
+// taken from the transport statistics (see Steve::GetStats), so the rates
+// are adjusted to the actual hardware as bitmaps are loaded. Until the bus
+// speed is known, raw data is preferred, so that it can be measured; it
+// can also be measured in advance with Calibrate. If the HAL doesn't
+// support Micros or the statistics are compiled out, the rates stay at
+// their starting values (see SetRate).
+class SteveBitmapLoader
+{
+public:
+  //-------------------------------------------------------------------------
+  // Ways to get a bitmap into RAM_G
+  enum METHOD
+  {
+    METHOD_NONE,                        // Not loaded
+    METHOD_RAW,                         // Written directly
+    METHOD_INFLATE,                     // Decompressed by CMD_INFLATE
+    METHOD_LOADIMAGE,                   // Decoded by CMD_LOADIMAGE
+  };
+
+  //-------------------------------------------------------------------------
+  // Rates that are used for the estimates
+  enum RATE
+  {
+    RATE_BUS,                           // Bytes sent per ms
+    RATE_INFLATE,                       // Bytes decompressed per ms
+    RATE_JPEG,                          // Bytes decoded from JPEG per ms
+    RATE_PNG,                           // Bytes decoded from PNG per ms
+
+    RATE_NUM
+  };
+
+  //-------------------------------------------------------------------------
+  // Bitmap in one or more forms
+  //
+  // Forms that aren't available should be NULL. The raw size is also the
+  // size of the bitmap in RAM_G, so it must be set even if there's no raw
+  // data.
+  struct Asset
+  {
+    const uint8_t    *_raw;             // Raw bitmap data, NULL=none
+    uint32_t          _raw_size;        // Size of bitmap in RAM_G
+    const uint8_t    *_deflated;        // Compressed data, NULL=none
+    uint32_t          _deflated_size;   // Size of compressed data
+    const uint8_t    *_image;           // JPEG or PNG data, NULL=none
+    uint32_t          _image_size;      // Size of image data
+    Steve::FORMAT     _format;          // Bitmap format
+    uint16_t          _width;           // Width in pixels
+    uint16_t          _height;          // Height in pixels
+  };
+
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint16_t CALIBRATE_CHUNK = 256; // Bytes per write
+  const static uint8_t  CALIBRATE_COUNT = 16;  // Writes in Calibrate
+
+protected:
+  //-------------------------------------------------------------------------
+  // Starting decoding rates in bytes per ms, by chip generation
+  //
+  // These are rough values; they're replaced by measurements.
+  static uint32_t DefaultRate(          // Returns bytes per ms
+    SteveDisplay::CHIPID chipid,        // Chip ID
+    RATE rate)                          // Rate to get
+  {
+    const static uint32_t table[3][RATE_NUM] =
+    {
+      //  BUS  INFLATE  JPEG  PNG
+      {     0,    1500,  600,  250 },   // FT81x (EVE2)
+      {     0,    1500,  600,  250 },   // BT815/BT816 (EVE3)
+      {     0,    1800,  720,  300 },   // BT817/BT818 (EVE4)
+    };
+
+    uint8_t generation;
+
+    if (chipid >= SteveDisplay::CHIPID_BT817)
+    {
+      generation = 2;
+    }
+    else if (chipid >= SteveDisplay::CHIPID_BT815)
+    {
+      generation = 1;
+    }
+    else
+    {
+      generation = 0;
+    }
+
+    return table[generation][rate];
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  uint32_t          _rate[RATE_NUM];    // Current rates, 0=unknown
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveBitmapLoader(
+    Steve &eve)                         // Display
+    : _eve(eve)
+  {
+    Reset();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Reset the rates to their starting values
+  //
+  // The starting decoding rates depend on the chip, so this should be
+  // called again after Steve::Begin if the loader was constructed before.
+  void Reset()
+  {
+    for (uint8_t u = 0; u < RATE_NUM; u++)
+    {
+      _rate[u] = DefaultRate(_eve.ChipId(), (RATE)u);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get a rate
+  uint32_t                              // Returns bytes per ms, 0=unknown
+  GetRate(
+    RATE rate) const                    // Rate to get
+  {
+    return _rate[rate];
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Set a rate
+  //
+  // This can be used to set the rates for a board ahead of time, e.g. if
+  // the HAL can't measure time.
+  void SetRate(
+    RATE rate,                          // Rate to set
+    uint32_t bytes_per_ms)              // New value
+  {
+    _rate[rate] = bytes_per_ms;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Update a rate with a measurement
+  //
+  // The new measurement is averaged with the old value, so a single slow
+  // load (e.g. because of an interrupt on the host) doesn't throw off the
+  // estimates too much.
+  void Measure(
+    RATE rate,                          // Rate to update
+    uint32_t bytes,                     // Number of bytes processed
+    uint32_t elapsed_us)                // Time it took
+  {
+    if ((!bytes) || (!elapsed_us))
+    {
+      return;
+    }
+
+    uint32_t measured = (uint32_t)((uint64_t)bytes * 1000 / elapsed_us);
+
+    if (!measured)
+    {
+      measured = 1;
+    }
+
+    _rate[rate] = _rate[rate] ? (_rate[rate] + measured) / 2 : measured;
+
+    DBG_GEEK("Rate %u is now %lu bytes/ms\n", rate, _rate[rate]);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Calculate the time to process a number of bytes
+  uint32_t                              // Returns microseconds
+  Estimate(
+    RATE rate,                          // Rate to use
+    uint32_t bytes) const               // Number of bytes
+  {
+    return (uint32_t)((uint64_t)bytes * 1000 / _rate[rate]);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Check if image data is a PNG file
+  static bool                           // Returns true=PNG, false=JPEG
+  IsPng(
+    const Asset &asset)                 // Asset to check
+  {
+    return (asset._image_size >= 4)
+      && (asset._image[0] == 0x89) && (asset._image[1] == 'P')
+      && (asset._image[2] == 'N') && (asset._image[3] == 'G');
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Choose the fastest way to load a bitmap
+  //
+  // The co-processor decodes the data while it's being sent, so the time
+  // for a compressed form is whichever is longer: sending the input, or
+  // producing the output.
+  METHOD                                // Returns method, NONE=no data
+  Choose(
+    const Asset &asset) const           // Bitmap to load
+  {
+    METHOD result = METHOD_NONE;
+    uint32_t best = 0xFFFFFFFFUL;
+
+    if (asset._raw)
+    {
+      // Until the bus speed is known, raw data is always preferred, so
+      // that the bus speed can be measured
+      if (!_rate[RATE_BUS])
+      {
+        return METHOD_RAW;
+      }
+
+      best = Estimate(RATE_BUS, asset._raw_size);
+      result = METHOD_RAW;
+    }
+
+    if (!_rate[RATE_BUS])
+    {
+      // Without raw data, the form with the fewest bytes is probably best
+      if ((asset._deflated) && ((!asset._image) || (asset._deflated_size <= asset._image_size)))
+      {
+        return METHOD_INFLATE;
+      }
+
+      return asset._image ? METHOD_LOADIMAGE : METHOD_NONE;
+    }
+
+    if ((asset._deflated) && (_rate[RATE_INFLATE]))
+    {
+      uint32_t send = Estimate(RATE_BUS, asset._deflated_size);
+      uint32_t decode = Estimate(RATE_INFLATE, asset._raw_size);
+      uint32_t t = (send > decode) ? send : decode;
+
+      if (t < best)
+      {
+        best = t;
+        result = METHOD_INFLATE;
+      }
+    }
+
+    if (asset._image)
+    {
+      RATE rate = IsPng(asset) ? RATE_PNG : RATE_JPEG;
+
+      if (_rate[rate])
+      {
+        uint32_t send = Estimate(RATE_BUS, asset._image_size);
+        uint32_t decode = Estimate(rate, asset._raw_size);
+        uint32_t t = (send > decode) ? send : decode;
+
+        if (t < best)
+        {
+          best = t;
+          result = METHOD_LOADIMAGE;
+        }
+      }
+    }
+
+    DBG_GEEK("Chose method %u, estimated %lu us\n", result, best);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write raw data to RAM_G
+  //
+  // The data is written in transactions of up to
+  // STEVEBITMAPLOADER_CHUNK_SIZE bytes.
+  void WriteRaw(
+    uint32_t address,                   // Destination in RAM_G
+    const uint8_t *data,                // Data to write
+    uint32_t len)                       // Number of bytes
+  {
+    while (len)
+    {
+      uint32_t chunk = (len < STEVEBITMAPLOADER_CHUNK_SIZE) ? len : STEVEBITMAPLOADER_CHUNK_SIZE;
+
+      address = _eve.RegWriteBuffer(address, chunk, data);
+
+      data += chunk;
+      len -= chunk;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Measure the bus speed
+  //
+  // This writes CALIBRATE_COUNT * CALIBRATE_CHUNK bytes of zeroes to the
+  // given location in RAM_G, which must not be in use.
+  bool                                  // Returns true=measured
+  Calibrate(
+    uint32_t address)                   // Scratch area in RAM_G
+  {
+    uint8_t zeroes[CALIBRATE_CHUNK];
+
+    memset(zeroes, 0, sizeof(zeroes));
+
+    uint32_t bytes = _eve.GetStats()._bytes_sent;
+    uint32_t start = _eve.HostMicros();
+
+    for (uint8_t u = 0; u < CALIBRATE_COUNT; u++)
+    {
+      _eve.RegWriteBuffer(address + u * CALIBRATE_CHUNK, CALIBRATE_CHUNK, zeroes);
+    }
+
+    // Make sure the data is really sent, in case the HAL caches it
+    _eve.RegRead32(Steve::REG_ID);
+
+    uint32_t elapsed = _eve.HostMicros() - start;
+
+    bytes = _eve.GetStats()._bytes_sent - bytes;
+
+    if ((!elapsed) || (!bytes))
+    {
+      return false;
+    }
+
+    _rate[RATE_BUS] = 0;
+    Measure(RATE_BUS, bytes, elapsed);
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Load a bitmap into RAM_G
+  //
+  // The fastest available form is used (see Choose). The function waits
+  // until the bitmap is completely in RAM_G, and then updates the rates
+  // with the time that it took. CMD_LOADIMAGE is used with OPT_NODL, so
+  // the display list isn't changed; use Steve::cmd_SETBITMAP with the
+  // format and size of the asset to draw the bitmap.
+  METHOD                                // Returns method used, NONE=error
+  LoadBitmap(
+    uint32_t address,                   // Destination in RAM_G
+    const Asset &asset)                 // Bitmap to load
+  {
+    METHOD result = Choose(asset);
+    bool ok = true;
+
+    uint32_t bytes = _eve.GetStats()._bytes_sent;
+    uint32_t start = _eve.HostMicros();
+
+    switch (result)
+    {
+    case METHOD_RAW:
+      WriteRaw(address, asset._raw, asset._raw_size);
+
+      // Make sure the data is really sent, in case the HAL caches it
+      _eve.RegRead32(Steve::REG_ID);
+      break;
+
+    case METHOD_INFLATE:
+      ok = (_eve.InflateStream(address, asset._deflated, asset._deflated_size) != 0);
+      break;
+
+    case METHOD_LOADIMAGE:
+      {
+        bool error;
+
+        _eve.cmd_LOADIMAGE(address,
+          (Steve::OPT)(Steve::OPT_NODL | ((asset._format == Steve::FORMAT_L8) ? Steve::OPT_MONO : Steve::OPT_RGB565)),
+          asset._image_size, asset._image);
+        _eve.CmdExecute(true, &error);
+
+        ok = !error;
+      }
+      break;
+
+    default:
+      DBG_STAT("No data to load bitmap\n");
+      return METHOD_NONE;
+    }
+
+    uint32_t elapsed = _eve.HostMicros() - start;
+
+    bytes = _eve.GetStats()._bytes_sent - bytes;
+
+    if (!ok)
+    {
+      DBG_STAT("Loading bitmap failed\n");
+      return METHOD_NONE;
+    }
+
+    if (result == METHOD_RAW)
+    {
+      Measure(RATE_BUS, bytes, elapsed);
+    }
+    else if ((_rate[RATE_BUS]) && (elapsed > Estimate(RATE_BUS, bytes)))
+    {
+      // The co-processor was slower than the bus, so the time was spent
+      // decoding
+      Measure((result == METHOD_INFLATE) ? RATE_INFLATE : (IsPng(asset) ? RATE_PNG : RATE_JPEG),
+        asset._raw_size, elapsed);
+    }
+
+    return result;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
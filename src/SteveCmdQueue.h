@@ -0,0 +1,301 @@
+/****************************************************************************
+SteveCmdQueue.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a lock-free queue that lets multiple threads submit
+co-processor commands for one display.
+****************************************************************************/
+
+#ifndef _STEVECMDQUEUE_H
+#define _STEVECMDQUEUE_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// COMMAND LIST IN HOST MEMORY
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Co-processor command list in host memory
+//
+// This stores commands in a buffer, without accessing a Steve instance, so
+// it can be used by a thread that doesn't own the bus. The commands are
+// encoded the same way as by the cmd_ functions:
+//
+//   list.Cmd(Steve::ENC_COLOR_RGB(255, 0, 0));
+//   list.Cmd(Steve::ENC_CMD_TEXT).V2(x).V2(y).V2(26).V2(0).String("Alarm");
+//
+// Each Cmd pads the previous command to a multiple of 4 bytes. If the
+// buffer overflows, the list is marked as such, and it won't be sent.
+class SteveCmdList
+{
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  uint8_t          *_buffer;           // Storage
+  uint16_t          _size;             // Size of storage in bytes
+  uint16_t          _length;           // Number of bytes used
+  bool              _overflow;         // True=data didn't fit
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveCmdList(
+    uint32_t *buffer = NULL,           // Storage (32-bit aligned)
+    uint16_t size = 0)                 // Size of storage in bytes
+    : _buffer((uint8_t *)buffer)
+    , _size(size & ~3)
+    , _length(0)
+    , _overflow(false)
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Remove all commands
+  SteveCmdList &                        // Returns this
+  Clear()
+  {
+    _length = 0;
+    _overflow = false;
+
+    return *this;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Store bytes
+  SteveCmdList &                        // Returns this
+  Buffer(
+    const void *data,                   // Data to store
+    uint32_t len)                       // Number of bytes
+  {
+    if (len > (uint32_t)(_size - _length))
+    {
+      _overflow = true;
+    }
+    else
+    {
+      memcpy(_buffer + _length, data, len);
+      _length += (uint16_t)len;
+    }
+
+    return *this;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Pad the data to a multiple of 4 bytes
+  SteveCmdList &                        // Returns this
+  Align()
+  {
+    const uint8_t zeroes[3] = { 0, 0, 0 };
+
+    return Buffer(zeroes, (4 - (_length % 4)) % 4);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Store a 16 bit parameter
+  SteveCmdList &                        // Returns this
+  V2(
+    uint16_t value)                     // Value to store
+  {
+    uint8_t buf[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+
+    return Buffer(buf, sizeof(buf));
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Store a 32 bit parameter
+  SteveCmdList &                        // Returns this
+  V4(
+    uint32_t value)                     // Value to store
+  {
+    uint8_t buf[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+
+    return Buffer(buf, sizeof(buf));
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Store a command
+  //
+  // This can be a display list command (encoded with an ENC_ function) or
+  // a co-processor command code (ENC_CMD_ value), followed by parameters.
+  SteveCmdList &                        // Returns this
+  Cmd(
+    uint32_t command)                   // Command to store
+  {
+    return Align().V4(command);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Store a nul-terminated string parameter
+  SteveCmdList &                        // Returns this
+  String(
+    const char *s)                      // String to store
+  {
+    return Buffer(s, (uint32_t)strlen(s) + 1).Align();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the data
+  const uint32_t *                      // Returns data
+  Data() const
+  {
+    return (const uint32_t *)_buffer;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of bytes in the list
+  uint16_t                              // Returns number of bytes
+  Length() const
+  {
+    return _length;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check if the list overflowed
+  bool                                  // Returns true=data was lost
+  Overflow() const
+  {
+    return _overflow;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// MULTI-PRODUCER COMMAND QUEUE
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Queue of command lists from multiple threads
+//
+// Each producer thread has its own slot, and builds its commands in a
+// SteveCmdList from Edit, then calls Publish. The thread that owns the bus
+// calls Drain between BeginFrame and SubmitFrame, which sends the latest
+// published list of every slot, in slot order (so higher slots are drawn
+// on top of lower slots).
+//
+// A slot keeps its last published list until a new one is published, so
+// a thread only has to publish when its part of the screen changes.
+//
+// Each slot is a triple buffer: the producer edits one buffer, one buffer
+// holds the latest published list, and the bus owner sends from the
+// third, so nobody ever waits for a lock. Only one thread may use a
+// slot, and only one thread may call Drain.
+template<const uint8_t producers, const uint16_t size> class SteveCmdQueue
+{
+protected:
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint8_t FRESH = 0x04;    // Flag: published but not taken
+
+  //-------------------------------------------------------------------------
+  // Slot for one producer
+  struct Slot
+  {
+    uint32_t          _storage[3][(size + 3) / 4];
+                                        // Buffers
+    SteveCmdList      _lists[3];        // Lists in the buffers
+    uint8_t           _edit;            // Buffer that the producer edits
+    uint8_t           _send;            // Buffer that the bus owner sends
+    std::atomic<uint8_t>
+                      _ready;           // Latest published buffer | FRESH
+  };
+
+  Slot              _slots[producers];  // Slots
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveCmdQueue()
+  {
+    for (uint8_t u = 0; u < producers; u++)
+    {
+      Slot &slot = _slots[u];
+
+      for (uint8_t b = 0; b < 3; b++)
+      {
+        slot._lists[b] = SteveCmdList(slot._storage[b], (uint16_t)sizeof(slot._storage[b]));
+      }
+
+      slot._edit = 0;
+      slot._send = 1;
+      slot._ready.store(2);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get an empty list to build commands in (producer side)
+  SteveCmdList &                        // Returns list
+  Edit(
+    uint8_t index)                      // Slot of the calling thread
+  {
+    Slot &slot = _slots[index];
+
+    return slot._lists[slot._edit].Clear();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Publish the list from Edit (producer side)
+  void Publish(
+    uint8_t index)                      // Slot of the calling thread
+  {
+    Slot &slot = _slots[index];
+
+    slot._edit = slot._ready.exchange(slot._edit | FRESH) & 3;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Send the latest list of every slot (bus owner side)
+  //
+  // Lists that overflowed aren't sent.
+  void Drain(
+    Steve &eve)                         // Display to send the commands to
+  {
+    for (uint8_t u = 0; u < producers; u++)
+    {
+      Slot &slot = _slots[u];
+
+      if (slot._ready.load() & FRESH)
+      {
+        slot._send = slot._ready.exchange(slot._send) & 3;
+      }
+
+      const SteveCmdList &list = slot._lists[slot._send];
+
+      if (list.Overflow())
+      {
+        DBG_STAT("Command list of slot %u overflowed\n", u);
+      }
+      else if (list.Length())
+      {
+        // The list is stored as little-endian bytes
+        eve.CmdSendBytes((const uint8_t *)list.Data(), list.Length());
+      }
+    }
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
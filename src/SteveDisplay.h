@@ -9,6 +9,20 @@ This file declares a struct for storing display parameters.
 #ifndef _STEVEDISPLAY_H
 #define _STEVEDISPLAY_H
 
+/////////////////////////////////////////////////////////////////////////////
+// CONFIGURATION
+/////////////////////////////////////////////////////////////////////////////
+
+// Functions that can be evaluated at compile time are declared with this
+// macro. It's empty for compilers that don't support constexpr.
+#ifndef STEVE_CONSTEXPR
+#if (__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1900))
+#define STEVE_CONSTEXPR constexpr
+#else
+#define STEVE_CONSTEXPR
+#endif
+#endif
+
 /////////////////////////////////////////////////////////////////////////////
 // STRUCT FOR DISPLAY PARAMETERS
 /////////////////////////////////////////////////////////////////////////////
@@ -16,6 +30,10 @@ This file declares a struct for storing display parameters.
 //---------------------------------------------------------------------------
 // This struct is used to describe the hardware parameters for a 
 // particular LCD display panel.
+//
+// The constructor can be evaluated at compile time, so a profile can be
+// declared as a constant (see the examples). Begin writes the display
+// registers from the register image of the profile (see RegisterImage).
 struct SteveDisplay
 {
 public:
@@ -114,6 +132,43 @@ public:
     CHIPID_BT818                      = 0x00011808
   };
 
+public:
+  //-------------------------------------------------------------------------
+  // Index of each register in the register image
+  //
+  // The image covers the contiguous registers from REG_HCYCLE to
+  // REG_PCLK_POL, so that Begin can write them in one burst. That includes
+  // REG_DLSWAP and REG_ROTATE, which are 0 after a reset.
+  enum IMAGE
+  {
+    IMAGE_HCYCLE,
+    IMAGE_HOFFSET,
+    IMAGE_HSIZE,
+    IMAGE_HSYNC0,
+    IMAGE_HSYNC1,
+    IMAGE_VCYCLE,
+    IMAGE_VOFFSET,
+    IMAGE_VSIZE,
+    IMAGE_VSYNC0,
+    IMAGE_VSYNC1,
+    IMAGE_DLSWAP,
+    IMAGE_ROTATE,
+    IMAGE_OUTBITS,
+    IMAGE_DITHER,
+    IMAGE_SWIZZLE,
+    IMAGE_CSPREAD,
+    IMAGE_PCLK_POL,
+
+    IMAGE_COUNT
+  };
+
+  //-------------------------------------------------------------------------
+  // Register image
+  struct Image
+  {
+    uint32_t        _regs[IMAGE_COUNT]; // Register values
+  };
+
 public:
   //-------------------------------------------------------------------------
   // Data
@@ -151,7 +206,12 @@ public:
   // constructor.
   #define STEVE_USE_PINDRIVE_TABLE_BEGIN const static uint8_t Steve__pindrive_table[] = {
   #define STEVE_USE_PINDRIVE_TABLE_END 0xFF }; _pindrivetable = Steve__pindrive_table;
-  #define STEVE_PINDRIVE(pins, level) ((SteveDisplay::PINS_##pins << 2) | (PINDRIVE_STRENGTH_##level)),
+  #define STEVE_PINDRIVE(pins, level) ((SteveDisplay::PINS_##pins << 2) | (SteveDisplay::PINDRIVE_STRENGTH_##level)),
+
+  // Macros to generate a named pin drive table outside a constructor, so
+  // it can be passed to the constructor of a profile that's a constant.
+  #define STEVE_PINDRIVE_TABLE_BEGIN(name) const static uint8_t name[] = {
+  #define STEVE_PINDRIVE_TABLE_END 0xFF };
 
 public:
   //-------------------------------------------------------------------------
@@ -159,7 +219,7 @@ public:
   //
   // This generates some of the timing values based on the given
   // parameters. 
-  SteveDisplay(
+  STEVE_CONSTEXPR SteveDisplay(
     uint16_t width,                   // Horizontal number of pixels
     uint16_t hfrontporch,             // Num clocks from display to sync
     uint16_t hsyncwidth,              // Number of clocks in hsync
@@ -172,11 +232,15 @@ public:
     uint16_t vpadding,                // Num additional lines per frame
     uint8_t pclk,                     // Clock divisor
     uint8_t pclkpol = 1,              // Clock policy
-    uint8_t swizzle = 0)              // Pin order
+    uint8_t swizzle = 0,              // Pin order
+    CHIPID chipid = CHIPID_ANY,       // Expected chip ID
+    CLKSEL clksel = CLKSEL_DEFAULT,   // Clock multiplier
+    uint32_t frequency = 0,           // ClockFreq to store; 0 = don't store
+    const uint8_t *pindrivetable = NULL) // Pin drive table (NULL=none)
     : _clkext(false)
-    , _clksel(CLKSEL_DEFAULT)
-    , _chipid(CHIPID_ANY)
-    , _frequency(0)
+    , _clksel(clksel)
+    , _chipid(chipid)
+    , _frequency(frequency)
     , _lcd10ma(false)
     , _cspread(false)
     , _dither(false)
@@ -194,10 +258,42 @@ public:
     , _swizzle(swizzle)
     , _pclkpol(pclkpol)
     , _pclk(pclk)
-    , _pindrivetable(NULL)
+    , _pindrivetable(pindrivetable)
   {
     // Nothing
   }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the register image
+  //
+  // For a profile that's a constant, this can be evaluated at compile time.
+  STEVE_CONSTEXPR Image                 // Returns register image
+  RegisterImage() const
+  {
+    return Image
+    {
+      {
+        _hcycle,                      // REG_HCYCLE
+        _hoffset,                     // REG_HOFFSET
+        _hsize,                       // REG_HSIZE
+        _hsync0,                      // REG_HSYNC0
+        _hsync1,                      // REG_HSYNC1
+        _vcycle,                      // REG_VCYCLE
+        _voffset,                     // REG_VOFFSET
+        _vsize,                       // REG_VSIZE
+        _vsync0,                      // REG_VSYNC0
+        _vsync1,                      // REG_VSYNC1
+        0,                            // REG_DLSWAP
+        0,                            // REG_ROTATE
+        _outbits,                     // REG_OUTBITS
+        _dither ? 1U : 0U,            // REG_DITHER
+        _swizzle,                     // REG_SWIZZLE
+        _cspread ? 1U : 0U,           // REG_CSPREAD
+        _pclkpol,                     // REG_PCLK_POL
+      }
+    };
+  }
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,464 @@
+/****************************************************************************
+SteveFlashAssets.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a table of bitmap assets in the external flash of an
+EVE3/EVE4 chip.
+****************************************************************************/
+
+#ifndef _STEVEFLASHASSETS_H
+#define _STEVEFLASHASSETS_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+#include "SteveRamG.h"
+
+#if !STEVE_CMD_FLASH
+#error SteveFlashAssets needs the flash commands (STEVE_CMD_FLASH)
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// FLASH ASSET TABLE
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Table of assets in the flash memory of an EVE3/EVE4
+//
+// The assets are described by an index in flash, which is generated by the
+// tool that builds the flash image. All values are little-endian. The
+// index starts with a 16-byte header:
+//
+//   uint32_t magic;         // INDEX_MAGIC
+//   uint32_t count;         // Number of entries
+//   uint32_t reserved[2];
+//
+// The header is followed by 32-byte entries:
+//
+//   char     name[16];      // Name, padded with zeroes
+//   uint32_t offset;        // Location in flash; multiple of 64
+//   uint32_t size;          // Size in bytes
+//   uint16_t format;        // Steve::FORMAT value
+//   uint16_t width;         // Width in pixels
+//   uint16_t height;        // Height in pixels
+//   uint16_t reserved;
+//
+// Load reads the index into host memory (only a hash and the length of
+// each name are kept). An asset isn't copied to RAM_G until Bitmap or Source is called
+// for it; the copy is made by CMD_FLASHREAD in the command queue, so
+// the host doesn't have to wait for it, and the data doesn't go through
+// the SPI bus of the host.
+//
+// ASTC assets can be rendered directly from flash when the flash is in
+// full-speed mode (see Steve::cmd_FLASHFAST); those aren't copied to
+// RAM_G at all.
+//
+// Use the SteveFlashAssetTable template to declare a table with a given
+// maximum number of assets.
+class SteveFlashAssets
+{
+public:
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint32_t INDEX_MAGIC = 0x54534153UL; // "SAST"
+  const static uint8_t  INVALID_INDEX = 0xFF;
+  const static uint16_t FLASH_STATUS_FULL = 3; // REG_FLASH_STATUS value
+  const static uint32_t FLASH_BLOCK = 64; // Alignment for CMD_FLASHREAD
+
+  //-------------------------------------------------------------------------
+  // Asset entry
+  struct Asset
+  {
+    uint32_t          _hash;          // Hash of the name
+    uint8_t           _namelen;       // Length of the name
+    uint32_t          _offset;        // Location in flash
+    uint32_t          _size;          // Size in bytes
+    Steve::FORMAT     _format;        // Bitmap format
+    uint16_t          _width;         // Width in pixels
+    uint16_t          _height;        // Height in pixels
+    SteveRamG::HANDLE _handle;        // RAM_G block, INVALID_HANDLE=none
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_steve;           // EVE to load assets for
+  SteveRamG        &_ramg;            // Allocator for RAM_G copies
+  Asset *const      _assets;          // Storage for assets
+  const uint8_t     _max;             // Maximum number of assets
+  uint8_t           _count;           // Number of assets loaded
+  bool              _flash_full;      // Flash was in full-speed mode
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // This is protected; use SteveFlashAssetTable.
+  SteveFlashAssets(
+    Steve &steve,                     // EVE to load assets for
+    SteveRamG &ramg,                  // Allocator for RAM_G copies
+    Asset *assets,                    // Storage for assets
+    uint8_t max)                      // Maximum number of assets
+    : _steve(steve)
+    , _ramg(ramg)
+    , _assets(assets)
+    , _max(max)
+    , _count(0)
+    , _flash_full(false)
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Calculate the hash of an asset name
+  //
+  // This is the 32 bit FNV-1a hash of the name, up to 16 characters.
+  static uint32_t                       // Returns hash
+  Hash(
+    const char *name)                   // Name of the asset
+  {
+    uint32_t result = 2166136261UL;
+
+    for (uint8_t u = 0; (u < 16) && (name[u]); u++)
+    {
+      result = (result ^ (uint8_t)name[u]) * 16777619UL;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the length of an asset name, up to 16 characters
+  static uint8_t                        // Returns length
+  NameLength(
+    const char *name)                   // Name of the asset
+  {
+    uint8_t result = 0;
+
+    while ((result < 16) && (name[result]))
+    {
+      result++;
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a little-endian value from a buffer
+  static uint32_t                       // Returns value
+  Get32(
+    const uint8_t *p)                   // Location of the value
+  {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  static uint16_t                       // Returns value
+  Get16(
+    const uint8_t *p)                   // Location of the value
+  {
+    return (uint16_t)(p[0] | (p[1] << 8));
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Load the asset index from flash
+  //
+  // The index is copied to a temporary block in RAM_G with CMD_FLASHREAD,
+  // and read from there. The flash must be attached (see
+  // Steve::cmd_FLASHATTACH). Any previously loaded assets are unloaded.
+  bool                                  // Returns true=success
+  Load(
+    uint32_t offset)                    // Location of the index in flash
+  {
+    Unload();
+    _count = 0;
+    _flash_full = false;
+
+    if ((_steve.ChipId() < SteveDisplay::CHIPID_BT815) || (offset % FLASH_BLOCK))
+    {
+      DBG_STAT("Flash assets not supported or index not aligned\n");
+      return false;
+    }
+
+    // Read the header, then the entire index
+    uint8_t buf[32];
+    uint32_t size = FLASH_BLOCK;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+      SteveRamG::HANDLE scratch = _ramg.Alloc(size);
+      uint32_t address = _ramg.Address(scratch);
+
+      if (scratch == SteveRamG::INVALID_HANDLE)
+      {
+        _count = 0;
+        return false;
+      }
+
+      bool error;
+
+      _steve.cmd_FLASHREAD(address, offset, size);
+      _steve.CmdExecute(true, &error);
+
+      if (error)
+      {
+        _ramg.Free(scratch);
+        _count = 0;
+        return false;
+      }
+
+      if (!pass)
+      {
+        _steve.RegReadBuffer(address, 16, buf);
+
+        uint32_t count = Get32(buf + 4);
+
+        if ((Get32(buf) != INDEX_MAGIC) || (count > _max))
+        {
+          DBG_STAT("Flash asset index not found or too big\n");
+          _ramg.Free(scratch);
+          return false;
+        }
+
+        _count = (uint8_t)count;
+        size = (16 + 32 * count + FLASH_BLOCK - 1) & ~(FLASH_BLOCK - 1);
+      }
+      else
+      {
+        for (uint8_t u = 0; u < _count; u++)
+        {
+          _steve.RegReadBuffer(address + 16 + 32 * u, sizeof(buf), buf);
+
+          Asset &a = _assets[u];
+          char name[17];
+
+          memcpy(name, buf, 16);
+          name[16] = 0;
+
+          a._hash = Hash(name);
+          a._namelen = NameLength(name);
+          a._offset = Get32(buf + 16);
+          a._size = Get32(buf + 20);
+          a._format = (Steve::FORMAT)Get16(buf + 24);
+          a._width = Get16(buf + 26);
+          a._height = Get16(buf + 28);
+          a._handle = SteveRamG::INVALID_HANDLE;
+        }
+      }
+
+      _ramg.Free(scratch);
+    }
+
+    _flash_full = (_steve.RegRead16(Steve::REG_FLASH_STATUS) == FLASH_STATUS_FULL);
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of assets in the index
+  uint8_t                               // Returns number of assets
+  Count() const
+  {
+    return _count;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Find an asset by name
+  //
+  // The names themselves aren't kept, so the hash and the length of the
+  // name are compared.
+  uint8_t                               // Returns index, INVALID_INDEX=none
+  Find(
+    const char *name) const             // Name of the asset
+  {
+    uint32_t hash = Hash(name);
+    uint8_t namelen = NameLength(name);
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      if ((_assets[u]._hash == hash) && (_assets[u]._namelen == namelen))
+      {
+        return u;
+      }
+    }
+
+    return INVALID_INDEX;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get an asset entry
+  const Asset *                         // Returns asset, NULL=bad index
+  GetAsset(
+    uint8_t index) const                // Index of the asset
+  {
+    return (index < _count) ? &_assets[index] : NULL;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check if an asset can be rendered directly from flash
+  //
+  // This is only possible for ASTC bitmaps, while the flash is in
+  // full-speed mode. The flash mode is checked by Load, so if the flash
+  // is switched to full-speed mode later, Load should be called again.
+  bool                                  // Returns true=asset stays in flash
+  IsDirect(
+    uint8_t index) const                // Index of the asset
+  {
+    return (index < _count)
+      && (_assets[index]._format >= Steve::COMPRESSED_RGBA_ASTC_4x4_KHR)
+      && (_assets[index]._format <= Steve::COMPRESSED_RGBA_ASTC_12x12_KHR)
+      && (!(_assets[index]._offset % 32))
+      && (_flash_full);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the bitmap source address of an asset, loading it if necessary
+  //
+  // The first time this is called for an asset that can't be rendered
+  // from flash, a block of RAM_G is allocated for it and a CMD_FLASHREAD
+  // is queued to copy it. Commands that are queued after this will see
+  // the data in RAM_G.
+  //
+  // For assets that are rendered from flash, the result is the address
+  // in the format that BITMAP_SOURCE uses for flash.
+  uint32_t                              // Returns address, INVALID_ADDRESS=fail
+  Source(
+    uint8_t index)                      // Index of the asset
+  {
+    if (index >= _count)
+    {
+      return SteveRamG::INVALID_ADDRESS;
+    }
+
+    Asset &a = _assets[index];
+
+    if (a._handle != SteveRamG::INVALID_HANDLE)
+    {
+      return _ramg.Address(a._handle);
+    }
+
+    if (IsDirect(index))
+    {
+      return Steve::FLASH | (a._offset / 32);
+    }
+
+    if (a._offset % FLASH_BLOCK)
+    {
+      DBG_STAT("Flash asset %u not aligned\n", index);
+      return SteveRamG::INVALID_ADDRESS;
+    }
+
+    uint32_t size = (a._size + 3) & ~3UL;
+
+    a._handle = _ramg.Alloc(size);
+
+    if (a._handle == SteveRamG::INVALID_HANDLE)
+    {
+      return SteveRamG::INVALID_ADDRESS;
+    }
+
+    uint32_t result = _ramg.Address(a._handle);
+
+    _steve.cmd_FLASHREAD(result, a._offset, size);
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Set up a bitmap for an asset, loading it if necessary
+  //
+  // This queues CMD_SETBITMAP for the asset, for the current bitmap
+  // handle.
+  bool                                  // Returns true=success
+  Bitmap(
+    uint8_t index)                      // Index of the asset
+  {
+    uint32_t source = Source(index);
+
+    if (source == SteveRamG::INVALID_ADDRESS)
+    {
+      return false;
+    }
+
+    _steve.cmd_SETBITMAP(source, _assets[index]._format, _assets[index]._width, _assets[index]._height);
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Remove the RAM_G copy of an asset
+  //
+  // The caller must make sure that the co-processor doesn't use the
+  // asset anymore.
+  void Unload(
+    uint8_t index)                      // Index of the asset
+  {
+    if ((index < _count) && (_assets[index]._handle != SteveRamG::INVALID_HANDLE))
+    {
+      _ramg.Free(_assets[index]._handle);
+      _assets[index]._handle = SteveRamG::INVALID_HANDLE;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Remove the RAM_G copies of all assets
+  void Unload()
+  {
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      Unload(u);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Forget all RAM_G copies without freeing them
+  //
+  // Call this after a reset of the EVE, together with SteveRamG::Reset.
+  void Reset()
+  {
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      _assets[u]._handle = SteveRamG::INVALID_HANDLE;
+    }
+  }
+};
+
+//---------------------------------------------------------------------------
+// Flash asset table with a given maximum number of assets
+template<const uint8_t count> class SteveFlashAssetTable : public SteveFlashAssets
+{
+private:
+  Asset             _storage[count];  // Storage
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveFlashAssetTable(
+    Steve &steve,                     // EVE to load assets for
+    SteveRamG &ramg)                  // Allocator for RAM_G copies
+    : SteveFlashAssets(steve, ramg, _storage, count)
+  {
+    // Nothing
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,344 @@
+/****************************************************************************
+SteveFontCache.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a manager for the font cache of the BT817/BT818, with
+prefetching of glyphs for text that's about to be shown.
+****************************************************************************/
+
+#ifndef _STEVEFONTCACHE_H
+#define _STEVEFONTCACHE_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+#include "SteveRamG.h"
+
+#if !STEVE_CMD_EVE4
+#error SteveFontCache needs the EVE4 commands (STEVE_CMD_EVE4)
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// FONT CACHE MANAGER
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Font cache for an extended font in flash
+//
+// On the BT817/BT818, the glyphs of an extended font that's stored in
+// flash can be copied to a cache in RAM_G by CMD_FONTCACHE. A glyph is
+// copied when it's first used, which takes time while the co-processor
+// is building a frame; with large fonts (e.g. CJK fonts), the first frame
+// that shows a lot of new text can be late.
+//
+// This manager allocates the cache from a SteveRamG allocator, and can
+// prefetch the glyphs for strings that will be shown soon: the strings
+// are queued with Prefetch, and Idle draws some of them, invisibly, in the
+// frame that's being built. The application should call Idle in frames
+// that have time to spare, e.g. while the current screen doesn't change.
+//
+// The co-processor only reports the capacity and the use of the cache
+// (CMD_FONTCACHEQUERY). The statistics count the glyphs that were added
+// to the cache between queries as misses; once the cache is full, glyphs
+// are replaced, and the number of misses can't be determined anymore.
+//
+// Use the SteveFontCacheTable template to declare a manager with a given
+// number of queued strings.
+class SteveFontCache
+{
+public:
+  //-------------------------------------------------------------------------
+  // Statistics
+  struct Stats
+  {
+    uint32_t          _capacity;        // Glyphs that fit in the cache
+    uint32_t          _used;            // Glyphs in the cache
+    uint32_t          _misses;          // Glyphs loaded since Begin
+    uint32_t          _prefetched;      // Strings drawn by Idle
+    bool              _full;            // True=glyphs were replaced
+  };
+
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint32_t MIN_SIZE = 16384; // Minimum size of the cache
+  const static uint32_t ALIGNMENT = 64;   // Alignment of the cache
+  const static uint16_t PREFETCH_CHARS = 64; // Default characters per Idle
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  SteveRamG        &_ramg;              // Allocator for the cache
+  const char      **const _queue;       // Storage for queued strings
+  const uint8_t     _size;              // Number of strings in storage
+  uint8_t           _head;              // Index of oldest string
+  uint8_t           _count;             // Number of queued strings
+  bool              _active;            // True=cache in use
+  uint8_t           _font;              // Font handle
+  uint32_t          _address;           // Cache address in RAM_G
+  uint32_t          _cache_size;        // Cache size in bytes
+  Stats             _stats;             // Statistics
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // This is protected; use SteveFontCacheTable.
+  SteveFontCache(
+    Steve &eve,                         // Display
+    SteveRamG &ramg,                    // Allocator for the cache
+    const char **queue,                 // Storage for queued strings
+    uint8_t size)                       // Number of strings in storage
+    : _eve(eve)
+    , _ramg(ramg)
+    , _queue(queue)
+    , _size(size)
+    , _head(0)
+    , _count(0)
+    , _active(false)
+    , _font(0)
+    , _address(0)
+    , _cache_size(0)
+  {
+    memset(&_stats, 0, sizeof(_stats));
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveFontCache()
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Set up the cache for a font
+  //
+  // The font must already be an extended font in flash (e.g. set up with
+  // Steve::cmd_SETFONT2 from a flash image). The cache is a static
+  // allocation, so it stays in RAM_G until the allocator is reset.
+  virtual bool                          // Returns true=success
+  Begin(
+    uint8_t font,                       // Font handle
+    uint32_t size)                      // Cache size in bytes
+  {
+    if ((_eve.ChipId() < SteveDisplay::CHIPID_BT817) || (size < MIN_SIZE))
+    {
+      DBG_STAT("Font cache needs a BT817/818 and at least %lu bytes\n", MIN_SIZE);
+      return false;
+    }
+
+    size &= ~3UL;
+
+    // Allocate extra space so the cache can be aligned
+    uint32_t address = _ramg.AllocStatic(size + ALIGNMENT - SteveRamG::ALIGNMENT);
+
+    if (address == SteveRamG::INVALID_ADDRESS)
+    {
+      return false;
+    }
+
+    _address = (address + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    _cache_size = size;
+    _font = font;
+    _active = true;
+    _head = 0;
+    _count = 0;
+
+    memset(&_stats, 0, sizeof(_stats));
+
+    bool error;
+
+    _eve.cmd_FONTCACHE(font, (int32_t)_address, size);
+    _eve.CmdExecute(true, &error);
+
+    if (error)
+    {
+      DBG_STAT("CMD_FONTCACHE failed\n");
+      _active = false;
+      return false;
+    }
+
+    Query();
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Stop using the cache
+  //
+  // The memory of the cache stays allocated until the allocator is reset.
+  virtual void End()
+  {
+    if (_active)
+    {
+      _eve.cmd_FONTCACHE(_font, 0, 0);
+      _eve.CmdExecute(true);
+
+      _active = false;
+    }
+
+    _count = 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Update the statistics from the co-processor
+  //
+  // This waits until the co-processor is idle, so it shouldn't be called
+  // while a frame is being built.
+  const Stats &                         // Returns statistics
+  Query()
+  {
+    if (!_active)
+    {
+      return _stats;
+    }
+
+    Steve::CmdIndex total;
+    Steve::CmdIndex used;
+
+    _eve.CmdWaitComplete();
+    _eve.cmd_FONTCACHEQUERY(&total, &used);
+    _eve.CmdExecute(true);
+
+    uint32_t capacity = _eve.CmdRead32(total);
+    uint32_t now = _eve.CmdRead32(used);
+
+    if (now > _stats._used)
+    {
+      _stats._misses += now - _stats._used;
+    }
+
+    if ((capacity) && (now >= capacity))
+    {
+      _stats._full = true;
+    }
+
+    _stats._capacity = capacity;
+    _stats._used = now;
+
+    DBG_GEEK("Font cache: %lu of %lu glyphs used\n", now, capacity);
+
+    return _stats;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Queue a string for prefetching
+  //
+  // The string must stay valid until Idle has drawn it (see Pending).
+  bool                                  // Returns false=queue full
+  Prefetch(
+    const char *s)                      // String to prefetch
+  {
+    if ((!_active) || (_count >= _size))
+    {
+      return false;
+    }
+
+    _queue[(_head + _count) % _size] = s;
+    _count++;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Prefetch glyphs in the frame that's being built
+  //
+  // Call this between the start and the end of a display list. Queued
+  // strings are drawn with all color channels and the tag buffer masked
+  // off, so they're not visible and can't be touched, but the
+  // co-processor loads their glyphs into the cache. At
+  // least one string is drawn; more are drawn until the given number of
+  // characters is reached. The graphics state is saved and restored.
+  uint8_t                               // Returns number of strings left
+  Idle(
+    uint16_t maxchars = PREFETCH_CHARS) // Characters per call
+  {
+    if ((!_active) || (!_count))
+    {
+      return _count;
+    }
+
+    uint16_t chars = 0;
+
+    _eve.cmd_SAVE_CONTEXT();
+    _eve.cmd_COLOR_MASK(0, 0, 0, 0);
+    _eve.cmd_TAG_MASK(0);
+
+    while ((_count) && (chars < maxchars))
+    {
+      const char *s = _queue[_head];
+
+      _eve.cmd_TEXT(0, 0, _font, Steve::OPT_NONE, s);
+
+      chars = (uint16_t)(chars + strlen(s));
+      _head = (uint8_t)((_head + 1) % _size);
+      _count--;
+      _stats._prefetched++;
+    }
+
+    _eve.cmd_RESTORE_CONTEXT();
+
+    return _count;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of strings that are waiting to be prefetched
+  uint8_t                               // Returns number of strings
+  Pending() const
+  {
+    return _count;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the statistics of the last query
+  const Stats &                         // Returns statistics
+  GetStats() const
+  {
+    return _stats;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the location of the cache in RAM_G
+  uint32_t                              // Returns address, 0=no cache
+  Address() const
+  {
+    return _active ? _address : 0;
+  }
+};
+
+//---------------------------------------------------------------------------
+// Font cache manager with a given number of queued strings
+template<const uint8_t count> class SteveFontCacheTable : public SteveFontCache
+{
+private:
+  const char       *_storage[count];    // Storage
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveFontCacheTable(
+    Steve &eve,                         // Display
+    SteveRamG &ramg)                    // Allocator for the cache
+    : SteveFontCache(eve, ramg, _storage, count)
+  {
+    // Nothing
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -9,6 +9,24 @@ This file declares a Hardware Abstraction Layer for Steve.
 #ifndef _STEVEHAL_H
 #define _STEVEHAL_H
 
+/////////////////////////////////////////////////////////////////////////////
+// MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+// STEVE_LITTLE_ENDIAN is 1 if the host stores 32 bit values in the same
+// byte order as the EVE, so that arrays of 32 bit values can be sent as
+// they are. If the byte order can't be determined, it's 0 and the values
+// are sent one by one.
+#ifndef STEVE_LITTLE_ENDIAN
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+#define STEVE_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#elif defined(_WIN32)
+#define STEVE_LITTLE_ENDIAN 1
+#else
+#define STEVE_LITTLE_ENDIAN 0
+#endif
+#endif
+
 /////////////////////////////////////////////////////////////////////////////
 // HARDWARE ABSTRACTION LAYER
 /////////////////////////////////////////////////////////////////////////////
@@ -30,7 +48,31 @@ This file declares a Hardware Abstraction Layer for Steve.
 // bytes at a time, its subclass can override the Send32 function.
 class SteveHAL
 {
-  friend class Steve;
+  template<class> friend class SteveT;
+  friend class SteveHAL_Recorder;       // Passes calls to another HAL
+  friend class SteveReplay;             // Sends recorded traffic
+
+public:
+  //-------------------------------------------------------------------------
+  // SPI bus widths
+  //
+  // The values are the number of data lines, and they are also used as
+  // flags in the return value of GetBusWidths.
+  enum BUSWIDTH
+  {
+    BUSWIDTH_SINGLE = 1,                // Standard SPI (MOSI and MISO)
+    BUSWIDTH_DUAL = 2,                  // Dual SPI (MOSI/MISO bidirectional)
+    BUSWIDTH_QUAD = 4,                  // Quad SPI (4 bidirectional lines)
+  };
+
+public:
+  //-------------------------------------------------------------------------
+  // Callback function type for asynchronous transfers
+  //
+  // The callback may be called from an interrupt handler, so it should
+  // be short.
+  typedef void (*ASYNC_CALLBACK)(
+    void *context);                     // Context passed to SendBufferAsync
 
 protected:
   //-------------------------------------------------------------------------
@@ -76,6 +118,62 @@ protected:
   virtual void Init(
     bool slow = false) = 0;             // True=use slow speed for early init
 
+protected:
+  //-------------------------------------------------------------------------
+  // Change the fast SPI clock
+  //
+  // This is called by Steve to change the clock that's used after early
+  // initialization (see Init). If the fast clock is in use, the HAL should
+  // switch immediately; otherwise the new clock is used when Init is called
+  // again. Subclasses that can't change the clock don't need to override
+  // this.
+  virtual bool SetClock(                // Returns true=success
+    uint32_t hz)                        // New fast clock in Hz
+  {
+    (void)hz;
+
+    return false;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the fast SPI clock
+  //
+  // This may return the requested frequency, not the actual frequency
+  // that the hardware uses.
+  virtual uint32_t GetClock()           // Returns fast clock in Hz, 0=unknown
+  {
+    return 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the supported bus widths
+  //
+  // Subclasses for hardware that can communicate with the EVE chip over
+  // dual or quad SPI should override this and SetBusWidth.
+  virtual uint8_t GetBusWidths()        // Returns combination of BUSWIDTHs
+  {
+    return BUSWIDTH_SINGLE;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the bus width
+  //
+  // This is called by Steve after the EVE chip was switched to the given
+  // bus width. It's also called when the EVE chip is reset, to switch
+  // back to single SPI.
+  //
+  // The HAL only needs to change the way it clocks bits in and out of the
+  // chip; Steve takes care of the extra dummy byte that's needed for reads
+  // in quad mode.
+  virtual bool SetBusWidth(             // Returns true=success
+    BUSWIDTH width)                     // New bus width
+  {
+    return (width == BUSWIDTH_SINGLE);
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Pause or resume communication
@@ -170,6 +268,28 @@ protected:
     Transfer((uint8_t)(value >> 24));
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Send an array of 32-bit values in little-endian format
+  //
+  // On little-endian hosts, the array is sent as a block of data with
+  // SendBuffer; otherwise each value is sent with Send32. Subclasses that
+  // collect data in a buffer, or that can send it by DMA, can override
+  // this to copy the whole array at once.
+  virtual void SendWords(
+    const uint32_t *words,              // Values to send
+    uint32_t count)                     // Number of values
+  {
+#if STEVE_LITTLE_ENDIAN
+    SendBuffer((const uint8_t *)words, count * 4);
+#else
+    for (uint32_t u = 0; u < count; u++)
+    {
+      Send32(words[u]);
+    }
+#endif
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Send data from a RAM buffer to the chip
@@ -190,6 +310,69 @@ protected:
     return result;
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from program memory to the chip
+  //
+  // This is used for constant tables that are stored in program memory
+  // on MCUs with a separate address space for it, such as AVR (PROGMEM).
+  // The implementation here assumes that program memory can be read
+  // like RAM, which is true on most other platforms.
+  virtual uint32_t SendBufferProgmem(   // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len)                       // Number of bytes to send
+  {
+    return SendBuffer(buffer, len);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Start sending data from a RAM buffer to the chip
+  //
+  // The function may return before all the data has been sent, e.g. if the
+  // hardware uses DMA. The buffer must stay valid and unchanged until the
+  // transfer is complete; use IsBusy or Wait to find out when that is.
+  // If a callback function is given, it's called when the transfer is
+  // complete.
+  //
+  // Subclasses that implement this asynchronously must make sure that any
+  // other access to the bus, including changing the !CS line, waits until
+  // the transfer is done. De-selecting the chip may be postponed until the
+  // transfer completes, so that Steve can end the transaction without
+  // waiting.
+  //
+  // The implementation here sends the data synchronously, and calls the
+  // callback before returning.
+  virtual void SendBufferAsync(
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len,                       // Number of bytes to send
+    ASYNC_CALLBACK callback = NULL,     // Callback function, NULL=none
+    void *context = NULL)               // Context for callback
+  {
+    SendBuffer(buffer, len);
+
+    if (callback)
+    {
+      callback(context);
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Check if an asynchronous transfer is in progress
+  virtual bool IsBusy()                 // Returns true=transfer in progress
+  {
+    return false;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait until an asynchronous transfer is complete
+  virtual void Wait()
+  {
+    // Nothing
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Receive an 8-bit value
@@ -248,6 +431,32 @@ protected:
     return result;
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Perform a complete read transaction
+  //
+  // This selects the chip, sends the header (the read command with the
+  // address and the dummy byte(s)), receives the data and de-selects the
+  // chip.
+  //
+  // Subclasses for hardware with a high latency per transfer (e.g. USB
+  // adapters) can override this to do everything in a single round trip.
+  virtual uint32_t ReadTransaction(     // Returns number of bytes received
+    const uint8_t *header,              // Header to send
+    uint32_t headerlen,                 // Number of header bytes to send
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len)                       // Number of bytes to receive
+  {
+    uint32_t result;
+
+    Select(true);
+    SendBuffer(header, headerlen);
+    result = ReceiveBuffer(buffer, len);
+    Select(false);
+
+    return result;
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Send zero-bytes for alignment
@@ -257,15 +466,15 @@ protected:
   virtual uint32_t SendAlignmentBytes(  // Returns updated number bytes sent
     uint32_t num)                       // Previous number of bytes sent
   {
-    uint32_t result = num;
+    const uint8_t zeroes[3] = { 0, 0, 0 };
+    uint32_t pad = (4 - (num % 4)) % 4;
 
-    while (result % 4)
+    if (pad)
     {
-      Send8(0);
-      result++;
+      SendBuffer(zeroes, pad);
     }
 
-    return result;
+    return num + pad;
   }
 
 protected:
@@ -298,18 +507,113 @@ protected:
 
       size_t len = strnlen(s, (size_t)(maxlen - 1));
 
-      result = SendBuffer((uint8_t *)message, len) + 1;
+      result = SendBuffer((const uint8_t *)s, len) + 1;
       Send8(0);
     }
 
     return result;
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Send a string with its nul-terminator and alignment bytes
+  //
+  // This sends the given number of characters, followed by zero bytes up
+  // to the total number of bytes. The caller has already determined the
+  // length of the string, and has calculated the total so that the data
+  // ends on a 32 bit boundary; there are always 1 to 4 zero bytes.
+  //
+  // The default implementation sends the characters and the zero bytes
+  // with two calls to SendBuffer. Subclasses that collect data in a buffer
+  // can override this to copy the string and fill the zero bytes with
+  // a single check for space in the buffer.
+  virtual uint32_t SendStringPadded(    // Returns number of bytes sent
+    const char *s,                      // Characters to send, not NULL
+    uint16_t len,                       // Number of characters
+    uint16_t total)                     // Total including zero bytes
+  {
+    const uint8_t zeroes[4] = { 0, 0, 0, 0 };
+
+    SendBuffer((const uint8_t *)s, len);
+    SendBuffer(zeroes, (uint32_t)(total - len));
+
+    return total;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for the !INT line to become active
+  //
+  // This is called by Steve when it waits for an interrupt that was enabled
+  // with Steve::EnableInterrupts. Subclasses for hardware that has access
+  // to the !INT line of the EVE chip should override this, and wait until
+  // the line is LOW or until the timeout expires. If possible, the host
+  // should sleep or do other work in the mean time instead of polling.
+  //
+  // A timeout of 0 checks the line without waiting.
+  //
+  // The default implementation can't see the !INT line: it waits for a
+  // millisecond (unless the timeout is 0) and returns true, so that Steve
+  // keeps polling the registers over SPI.
+  virtual bool WaitForInterrupt(        // Returns true=!INT active or unknown
+    uint32_t timeout_ms)                // Maximum time to wait (ms)
+  {
+    if (timeout_ms)
+    {
+      Delay(1);
+    }
+
+    return true;
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Wait for at least the requested time
   virtual void Delay(
     uint32_t ms) = 0;                   // Number of milliseconds to wait
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  //
+  // This is used for profiling (see SteveProfiler). The value may wrap
+  // around. The default implementation returns 0, which means the host
+  // timings aren't known.
+  virtual uint32_t Micros()             // Returns timestamp in us
+  {
+    return 0;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Convert a count of a timer with the given frequency to microseconds
+  //
+  // The count is split so that multiplying by a million can't overflow,
+  // even for a count of a high resolution timer after a long time.
+  static uint32_t                       // Returns time in us
+  TicksToMicros(
+    uint64_t count,                     // Timer count
+    uint64_t frequency)                 // Timer ticks per second
+  {
+    return (uint32_t)((count / frequency) * 1000000 + (count % frequency) * 1000000 / frequency);
+  }
+};
+
+//---------------------------------------------------------------------------
+// Final version of a HAL class
+//
+// Use this to declare the HAL for a SteveT instance that calls the HAL
+// without going through the virtual function table (see SteveT in
+// Steve.h). The constructors of the HAL class are inherited.
+//
+// A SteveT that uses a final HAL is not a Steve, so the helper classes
+// (SteveTouch, SteveRamG etc.) can't be used with it.
+template<class BASE> class SteveHAL_Final final : public BASE
+{
+  template<class> friend class SteveT;
+
+public:
+  using BASE::BASE;
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -35,6 +35,44 @@ This file declares an Arduino-specific Hardware Abstraction Layer for Steve.
 #define DBG_STAT(...)
 #endif
 
+// Size of the buffer on the stack that's used to send data from a const
+// buffer with the SPI.transfer(buf, count) function, which overwrites the
+// buffer with the received data. This can be redefined to a smaller value
+// for MCUs with very little RAM.
+#ifndef STEVEHAL_ARDUINO_CHUNK_SIZE
+#define STEVEHAL_ARDUINO_CHUNK_SIZE 64
+#endif
+
+// Define this if the SPI library for the target has a writeBytes function
+// that sends data from a const buffer without receiving anything. This is
+// enabled automatically for ESP32 and ESP8266.
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+#ifndef STEVEHAL_ARDUINO_WRITEBYTES
+#define STEVEHAL_ARDUINO_WRITEBYTES
+#endif
+#endif
+
+// Define this if the SPI library for the target can send data with DMA
+// in the background, with the following functions (e.g. the Adafruit
+// SAMD core):
+// * transfer(const void *txbuf, void *rxbuf, size_t count, bool block)
+// * isBusy()
+// * waitForTransfer()
+// Without this, SendBufferAsync sends the data synchronously.
+//#define STEVEHAL_ARDUINO_DMA
+
+// Maximum SPI clock speed during early initialization
+#ifndef STEVEHAL_ARDUINO_MAX_SLOW_CLOCK
+#define STEVEHAL_ARDUINO_MAX_SLOW_CLOCK 11000000UL
+#endif
+
+// Statement that's executed repeatedly while waiting for the !INT line.
+// This can be redefined to put the MCU to sleep until the next interrupt,
+// e.g. with __WFI() on ARM Cortex-M.
+#ifndef STEVEHAL_ARDUINO_IDLE
+#define STEVEHAL_ARDUINO_IDLE() yield()
+#endif
+
 /////////////////////////////////////////////////////////////////////////////
 // HARDWARE ABSTRACTION LAYER SPECIFIC TO ARDUINO
 /////////////////////////////////////////////////////////////////////////////
@@ -44,36 +82,56 @@ This file declares an Arduino-specific Hardware Abstraction Layer for Steve.
 //
 // This should be compatible with basically all variations of Arduino:
 // * It uses a single SPI port (not dual SPI or quad SPI).
-// * There are no optimizations for sending and receiving multiple successive
-//   bytes.
-// * No interrupts or DMA are used.
-// * Only a single SPI clock speed is used (up to 8 MHz). The speed is not
-//   switched to a higher frequency once the EVE is ready for it.
+// * Multiple successive bytes are sent and received with the block transfer
+//   functions of the SPI library (transfer16 and transfer(buf, count)) which
+//   are available on all Arduino cores. On cores that have a writeBytes
+//   function, that's used to send buffers without copying them.
+// * The !INT pin is optional. If it's connected, an interrupt handler is
+//   attached to it, so the MCU can idle (see STEVEHAL_ARDUINO_IDLE) while
+//   Steve waits for an interrupt from the EVE. DMA is only used for
+//   SendBufferAsync, and only if STEVEHAL_ARDUINO_DMA is defined.
+// * Two SPI clock speeds can be used: a slow one (up to 11 MHz) for the
+//   early initialization, and a fast one (up to 30 MHz) once the EVE is
+//   ready for it. If only one clock speed is given, it's used for both, but
+//   it's limited to 11 MHz during early initialization.
 class SteveHAL_Arduino : public SteveHAL
 {
   // This shouldn't be necessary (Steve is already a friend of our parent
   // class and the code compiles fine) but Visual Studio's IntelliSense pops
   // up a lot of errors if we don't put this here.
-  friend class Steve;
+  template<class> friend class SteveT;
 
 private:
   //-------------------------------------------------------------------------
   // Constants and initialization parameters
 
   SPIClass         &_spi;               // SPI instance
-  const SPISettings _spi_settings;      // SPI settings
+  const SPISettings _spi_settings_slow; // SPI settings for early init
+  SPISettings       _spi_settings_fast; // SPI settings after early init
+  uint32_t          _spi_clock_fast;    // SPI clock after early init
   const int         _pin_cs;            // Chip Select Not Pin
   const int         _pin_pd;            // Power Down Not Pin
+  const int         _pin_int;           // Interrupt Not Pin, -1=none
 
 private:
   //-------------------------------------------------------------------------
   // State data
 
   bool              _selected;          // True if chip currently selected
+  bool              _slow;              // True if using slow clock
+  bool              _in_transaction;    // True if SPI transaction active
+#ifdef STEVEHAL_ARDUINO_DMA
+  bool              _async;             // True if DMA transfer started
+  bool              _deselect;          // True=de-select after DMA done
+  ASYNC_CALLBACK    _callback;          // Callback for DMA transfer
+  void             *_context;           // Context for callback
+#endif
 
 public:
   //-------------------------------------------------------------------------
-  // Constructor
+  // Constructor with a single clock speed
+  //
+  // The clock speed is limited to 11 MHz during early initialization.
   SteveHAL_Arduino(
     SPIClass &spi,                      // SPI port
     uint32_t spi_clock,                 // SPI clock speed
@@ -81,10 +139,56 @@ public:
     int pin_pd)                         // !PD pin
     : SteveHAL()
     , _spi(spi)
-    , _spi_settings(spi_clock, MSBFIRST, SPI_MODE0)
+    , _spi_settings_slow(
+      (spi_clock < STEVEHAL_ARDUINO_MAX_SLOW_CLOCK) ? spi_clock : STEVEHAL_ARDUINO_MAX_SLOW_CLOCK,
+      MSBFIRST, SPI_MODE0)
+    , _spi_settings_fast(spi_clock, MSBFIRST, SPI_MODE0)
+    , _spi_clock_fast(spi_clock)
+    , _pin_cs(pin_cs)
+    , _pin_pd(pin_pd)
+    , _pin_int(-1)
+  {
+    Setup();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor with separate clock speeds for early init and normal use
+  //
+  // The !INT pin is optional; it must be a pin that supports interrupts.
+  SteveHAL_Arduino(
+    SPIClass &spi,                      // SPI port
+    uint32_t spi_clock_slow,            // SPI clock for early init (<=11MHz)
+    uint32_t spi_clock_fast,            // SPI clock after init (<= 30MHz)
+    int pin_cs,                         // !CS pin
+    int pin_pd,                         // !PD pin
+    int pin_int = -1)                   // !INT pin, -1=not connected
+    : SteveHAL()
+    , _spi(spi)
+    , _spi_settings_slow(spi_clock_slow, MSBFIRST, SPI_MODE0)
+    , _spi_settings_fast(spi_clock_fast, MSBFIRST, SPI_MODE0)
+    , _spi_clock_fast(spi_clock_fast)
     , _pin_cs(pin_cs)
     , _pin_pd(pin_pd)
+    , _pin_int(pin_int)
+  {
+    Setup();
+  }
+
+private:
+  //-------------------------------------------------------------------------
+  // Initialize the state and the pins; called from the constructors
+  void Setup()
   {
+    _slow = true;
+    _in_transaction = false;
+#ifdef STEVEHAL_ARDUINO_DMA
+    _async = false;
+    _deselect = false;
+    _callback = NULL;
+    _context = NULL;
+#endif
+
     // Set the output pins before switching the pins to output, to
     // avoid glitches
     _selected = true; // Make sure the CS pin is changed next
@@ -105,16 +209,106 @@ public:
     }
   }
 
+private:
+  //-------------------------------------------------------------------------
+  // Flag that's set by the interrupt handler
+  //
+  // This is shared by all instances; it only serves to end the idle loop
+  // in WaitForInterrupt, which checks the pin of its own instance.
+  static volatile bool &InterruptFlag()
+  {
+    static volatile bool flag = false;
+
+    return flag;
+  }
+
+private:
+  //-------------------------------------------------------------------------
+  // Interrupt handler for the !INT pin
+  static void InterruptHandler()
+  {
+    InterruptFlag() = true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the hardware
+  //
+  // The interrupt handler is attached here instead of in the constructor,
+  // because the constructor may run before the Arduino core is
+  // initialized.
+  bool Begin() override                 // Returns true if successful
+  {
+    if (_pin_int >= 0)
+    {
+      pinMode(_pin_int, INPUT_PULLUP);
+      attachInterrupt(digitalPinToInterrupt(_pin_int), InterruptHandler, FALLING);
+    }
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Shut down the hardware
+  void End() override
+  {
+    if (_pin_int >= 0)
+    {
+      detachInterrupt(digitalPinToInterrupt(_pin_int));
+    }
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Initialize the communication
+  //
+  // The SPI transaction is restarted with the settings for the requested
+  // speed.
   void Init(
     bool slow = false) override         // True=use slow speed for early init
   {
-    (void)slow; // Ignored
+    SteveHAL_Arduino::Wait();
+
+    if (_in_transaction)
+    {
+      DBG_TRAFFIC("endTransaction\n");
+      _spi.endTransaction();
+    }
+
+    _slow = slow;
+
+    DBG_TRAFFIC("beginTransaction %s\n", slow ? "slow" : "fast");
+    _spi.beginTransaction(slow ? _spi_settings_slow : _spi_settings_fast);
+    _in_transaction = true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the fast clock
+  //
+  // If the fast clock is in use, the SPI transaction is restarted with the
+  // new settings.
+  bool SetClock(                        // Returns true=success
+    uint32_t hz) override               // New fast clock in Hz
+  {
+    _spi_settings_fast = SPISettings(hz, MSBFIRST, SPI_MODE0);
+    _spi_clock_fast = hz;
 
-    DBG_TRAFFIC("beginTransaction\n");
-    _spi.beginTransaction(_spi_settings);
+    if ((_in_transaction) && (!_slow))
+    {
+      Init(false);
+    }
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the fast clock
+  uint32_t GetClock() override          // Returns fast clock in Hz
+  {
+    return _spi_clock_fast;
   }
 
 protected:
@@ -125,12 +319,19 @@ protected:
   {
     if (pause)
     {
-      DBG_TRAFFIC("endTransaction\n");
-      _spi.endTransaction();
+      SteveHAL_Arduino::Wait();
+
+      if (_in_transaction)
+      {
+        DBG_TRAFFIC("endTransaction\n");
+        _spi.endTransaction();
+
+        _in_transaction = false;
+      }
     }
     else
     {
-      Init();
+      Init(_slow);
     }
   }
 
@@ -150,6 +351,22 @@ protected:
   bool Select(                          // Returns true if !CS line changed
     bool enable) override               // True=select (!CS low) false=de-sel
   {
+#ifdef STEVEHAL_ARDUINO_DMA
+    // While a DMA transfer is running, postpone de-selecting the chip
+    // until the transfer is done. Anything else waits for the transfer.
+    if (_async)
+    {
+      if ((!enable) && (_selected))
+      {
+        _deselect = true;
+
+        return true;
+      }
+
+      Wait();
+    }
+#endif
+
     bool result = (enable != _selected);
 
     if (result)
@@ -171,9 +388,274 @@ protected:
   virtual uint8_t Transfer(             // Returns received byte
     uint8_t value) override             // Byte to send
   {
+    SteveHAL_Arduino::Wait();
+
     return _spi.transfer(value);
   }
 
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 16-bit value in little-endian format
+  //
+  // transfer16 sends the most significant byte first, so the bytes are
+  // swapped.
+  virtual void Send16(
+    uint16_t value) override            // Value to send
+  {
+    SteveHAL_Arduino::Wait();
+
+    _spi.transfer16((uint16_t)((value << 8) | (value >> 8)));
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 24 bit value in BIG ENDIAN format
+  virtual void Send24BE(
+    uint32_t value) override            // Value to send (MSB ignored)
+  {
+    SteveHAL_Arduino::Wait();
+
+    _spi.transfer16((uint16_t)(value >> 8));
+    _spi.transfer((uint8_t)value);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 32-bit value in little-endian format
+  virtual void Send32(
+    uint32_t value) override            // Value to send
+  {
+    SteveHAL_Arduino::Wait();
+
+    uint8_t buf[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+
+    _spi.transfer(buf, sizeof(buf));
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from a RAM buffer to the chip
+  //
+  // The SPI.transfer(buf, count) function overwrites the buffer with the
+  // received data, so the data is copied to a buffer on the stack in
+  // chunks, unless the SPI library has a function to send from a const
+  // buffer.
+  virtual uint32_t SendBuffer(          // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len) override              // Number of bytes to send
+  {
+    SteveHAL_Arduino::Wait();
+
+#ifdef STEVEHAL_ARDUINO_WRITEBYTES
+    _spi.writeBytes(buffer, len);
+#else
+    uint8_t chunk[STEVEHAL_ARDUINO_CHUNK_SIZE];
+
+    for (uint32_t done = 0; done < len; )
+    {
+      uint32_t n = len - done;
+
+      if (n > sizeof(chunk))
+      {
+        n = sizeof(chunk);
+      }
+
+      memcpy(chunk, buffer + done, n);
+      _spi.transfer(chunk, n);
+
+      done += n;
+    }
+#endif
+
+    return len;
+  }
+
+#ifdef __AVR__
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from program memory to the chip
+  //
+  // On AVR, program memory has its own address space, so the data is
+  // copied to a buffer on the stack in chunks with memcpy_P.
+  virtual uint32_t SendBufferProgmem(   // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len) override              // Number of bytes to send
+  {
+    SteveHAL_Arduino::Wait();
+
+    uint8_t chunk[STEVEHAL_ARDUINO_CHUNK_SIZE];
+
+    for (uint32_t done = 0; done < len; )
+    {
+      uint32_t n = len - done;
+
+      if (n > sizeof(chunk))
+      {
+        n = sizeof(chunk);
+      }
+
+      memcpy_P(chunk, buffer + done, n);
+      _spi.transfer(chunk, n);
+
+      done += n;
+    }
+
+    return len;
+  }
+#endif
+
+protected:
+  //-------------------------------------------------------------------------
+  // Start sending data from a RAM buffer to the chip
+  //
+  // With STEVEHAL_ARDUINO_DMA, the data is sent by DMA and the function
+  // returns immediately. The callback is called from IsBusy or Wait when
+  // the SPI library reports that the transfer is done.
+  virtual void SendBufferAsync(
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len,                       // Number of bytes to send
+    ASYNC_CALLBACK callback = NULL,     // Callback function, NULL=none
+    void *context = NULL) override      // Context for callback
+  {
+#ifdef STEVEHAL_ARDUINO_DMA
+    SteveHAL_Arduino::Wait();
+
+    _callback = callback;
+    _context = context;
+    _async = true;
+
+    _spi.transfer(buffer, NULL, len, false);
+#else
+    SteveHAL::SendBufferAsync(buffer, len, callback, context);
+#endif
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Check if an asynchronous transfer is in progress
+  virtual bool IsBusy() override        // Returns true=transfer in progress
+  {
+#ifdef STEVEHAL_ARDUINO_DMA
+    if ((_async) && (!_spi.isBusy()))
+    {
+      SteveHAL_Arduino::Wait();
+    }
+
+    return _async;
+#else
+    return false;
+#endif
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait until an asynchronous transfer is complete
+  //
+  // If the chip was de-selected while the transfer was in progress, it's
+  // de-selected now.
+  virtual void Wait() override
+  {
+#ifdef STEVEHAL_ARDUINO_DMA
+    if (_async)
+    {
+      _spi.waitForTransfer();
+
+      _async = false;
+
+      if (_deselect)
+      {
+        _deselect = false;
+
+        Select(false);
+      }
+
+      if (_callback)
+      {
+        ASYNC_CALLBACK callback = _callback;
+
+        _callback = NULL;
+        callback(_context);
+      }
+    }
+#endif
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a 16-bit value in little-endian format
+  virtual uint16_t Receive16() override // Returns incoming value
+  {
+    SteveHAL_Arduino::Wait();
+
+    uint16_t value = _spi.transfer16(0);
+
+    return (uint16_t)((value << 8) | (value >> 8));
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a 32-bit value in little-endian format
+  virtual uint32_t Receive32() override // Returns incoming value
+  {
+    SteveHAL_Arduino::Wait();
+
+    uint8_t buf[4] = { 0, 0, 0, 0 };
+
+    _spi.transfer(buf, sizeof(buf));
+
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a buffer
+  //
+  // The buffer is cleared first, so that zeroes are sent while the data
+  // is received into the same buffer.
+  virtual uint32_t ReceiveBuffer(       // Returns number of bytes received
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len) override              // Number of bytes to receive
+  {
+    SteveHAL_Arduino::Wait();
+
+    memset(buffer, 0, len);
+    _spi.transfer(buffer, len);
+
+    return len;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for the !INT line to become active
+  //
+  // The line stays LOW until the EVE interrupt flags are read, so the pin
+  // is checked too, in case the interrupt happened before the flag was
+  // reset.
+  virtual bool WaitForInterrupt(        // Returns true=!INT active or unknown
+    uint32_t timeout_ms) override       // Maximum time to wait (ms)
+  {
+    if (_pin_int < 0)
+    {
+      return SteveHAL::WaitForInterrupt(timeout_ms);
+    }
+
+    uint32_t start = millis();
+
+    InterruptFlag() = false;
+
+    while ((!InterruptFlag()) && (digitalRead(_pin_int) != LOW))
+    {
+      if (millis() - start >= timeout_ms)
+      {
+        return false;
+      }
+
+      STEVEHAL_ARDUINO_IDLE();
+    }
+
+    return true;
+  }
+
 protected:
   //-------------------------------------------------------------------------
   // Wait for at least the requested time
@@ -182,6 +664,14 @@ protected:
   {
     delay(ms);
   }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  virtual uint32_t Micros() override    // Returns timestamp in us
+  {
+    return micros();
+  }
 };
 
 #endif // ARDUINO
@@ -0,0 +1,373 @@
+/****************************************************************************
+SteveHAL_Null.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a Hardware Abstraction Layer for Steve that emulates
+an EVE chip without any hardware.
+****************************************************************************/
+
+#ifndef _STEVEHAL_NULL_H
+#define _STEVEHAL_NULL_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARDUINO
+#include <chrono>
+#endif
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// HARDWARE ABSTRACTION LAYER WITHOUT HARDWARE
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Hardware Abstraction Layer that doesn't talk to any hardware
+//
+// This decodes the transactions that Steve sends, and emulates just enough
+// of the registers of an EVE chip to make Steve work:
+// * REG_ID is 0x7C and REG_CPURESET is 0, so Begin succeeds;
+// * REG_CHIP_ID returns the chip ID from the constructor;
+// * The co-processor executes commands instantly: REG_CMD_READ follows
+//   REG_CMD_WRITE, and REG_CMDB_SPACE always reports an empty queue;
+// * Other registers read back what was written to them.
+// Everything that's written outside the registers is discarded, and all
+// other memory reads as zero. Delays return immediately.
+//
+// This makes it possible to measure the time that Steve spends on the
+// host to encode commands, e.g. with SteveBench in automated builds, or
+// to capture the bus traffic with SteveHAL_Recorder without a display.
+class SteveHAL_Null : public SteveHAL
+{
+protected:
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint32_t REG_BASE = Steve::RAM_REG;
+  const static uint32_t REG_SIZE = 4096;
+
+  //-------------------------------------------------------------------------
+  // State of the current transaction
+  enum PHASE
+  {
+    PHASE_IDLE,                         // Chip not selected
+    PHASE_HEADER,                       // Receiving the header
+    PHASE_WRITE,                        // Memory write
+    PHASE_READ,                         // Memory read
+    PHASE_HOSTCMD,                      // Host command
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  SteveDisplay::CHIPID _chipid;         // Chip ID to report
+  uint8_t           _regs[REG_SIZE];    // Register image
+  PHASE             _phase;             // Transaction phase
+  uint8_t           _header[3];         // Header of current transaction
+  uint8_t           _headerlen;         // Number of header bytes received
+  uint32_t          _address;           // Current memory address
+  uint32_t          _clock;             // Fast clock set by Steve
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveHAL_Null(
+    SteveDisplay::CHIPID chipid = SteveDisplay::CHIPID_BT817)
+                                        // Chip ID to report
+    : SteveHAL()
+    , _chipid(chipid)
+    , _phase(PHASE_IDLE)
+    , _headerlen(0)
+    , _address(0)
+    , _clock(0)
+  {
+    Reset();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Reset the emulated registers
+  void Reset()
+  {
+    memset(_regs, 0, sizeof(_regs));
+
+    Store32(Steve::REG_ID, 0x7C);
+    Store32(Steve::REG_CMDB_SPACE, Steve::RAM_CMD_SIZE - 4);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a register from the image
+  uint32_t                              // Returns value
+  Load32(
+    uint32_t address)                   // Register address
+  {
+    const uint8_t *p = _regs + (address - REG_BASE);
+
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Store a register in the image
+  void Store32(
+    uint32_t address,                   // Register address
+    uint32_t value)                     // Value to store
+  {
+    uint8_t *p = _regs + (address - REG_BASE);
+
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Let the co-processor execute everything up to the write index
+  void Execute()
+  {
+    Store32(Steve::REG_CMD_READ, Load32(Steve::REG_CMD_WRITE) & (Steve::RAM_CMD_SIZE - 1));
+    Store32(Steve::REG_CMDB_SPACE, Steve::RAM_CMD_SIZE - 4);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Process a byte from the host
+  void Write(
+    uint8_t value)                      // Byte sent by the host
+  {
+    switch (_phase)
+    {
+    case PHASE_HEADER:
+      _header[_headerlen++] = value;
+      if (_headerlen == 3)
+      {
+        _address = (((uint32_t)_header[0] << 16) | ((uint32_t)_header[1] << 8) | _header[2]) & 0x3FFFFF;
+
+        switch (_header[0] & 0xC0)
+        {
+        case 0x80: _phase = PHASE_WRITE;   break;
+        case 0x00: _phase = PHASE_READ;    break;
+        default:   _phase = PHASE_HOSTCMD; break;
+        }
+      }
+      break;
+
+    case PHASE_WRITE:
+      if (_address == Steve::REG_CMDB_WRITE)
+      {
+        // Bulk writes all go to the same address; each byte is added to
+        // the command queue
+        Store32(Steve::REG_CMD_WRITE, (Load32(Steve::REG_CMD_WRITE) + 1) & (Steve::RAM_CMD_SIZE - 1));
+        Execute();
+      }
+      else
+      {
+        if ((_address >= REG_BASE) && (_address < REG_BASE + REG_SIZE))
+        {
+          _regs[_address - REG_BASE] = value;
+        }
+
+        _address++;
+      }
+      break;
+
+    default:
+      // Dummy bytes of reads and host command parameters are ignored
+      break;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Produce a byte for the host
+  uint8_t                               // Returns byte at current address
+  Read()
+  {
+    uint8_t result = 0;
+
+    if (_phase == PHASE_READ)
+    {
+      if ((_address >= REG_BASE) && (_address < REG_BASE + REG_SIZE))
+      {
+        result = _regs[_address - REG_BASE];
+      }
+      else if ((_address >= Steve::REG_CHIP_ID) && (_address < Steve::REG_CHIP_ID + 4))
+      {
+        result = (uint8_t)((uint32_t)_chipid >> (8 * (_address - Steve::REG_CHIP_ID)));
+      }
+
+      _address++;
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the hardware
+  void Init(
+    bool slow = false) override         // True=use slow speed for early init
+  {
+    (void)slow;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the fast clock
+  //
+  // The clock is only stored, so that GetClock can report it.
+  bool SetClock(                        // Returns true=success
+    uint32_t hz) override               // New fast clock in Hz
+  {
+    _clock = hz;
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the fast clock
+  uint32_t GetClock() override          // Returns fast clock in Hz
+  {
+    return _clock;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Pause or resume communication
+  void Pause(
+    bool pause) override                // True=pause, false=resume
+  {
+    (void)pause;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Turn the power on or off
+  //
+  // Turning the power off resets the registers.
+  void Power(
+    bool enable) override               // True=on (!PD high) false=off/reset
+  {
+    if (!enable)
+    {
+      Reset();
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Select or de-select the chip
+  bool Select(                          // Returns true if !CS line changed
+    bool enable) override               // True=select (!CS low) false=de-sel
+  {
+    bool result = (enable != (_phase != PHASE_IDLE));
+
+    if (result)
+    {
+      // Writes to REG_CMD_WRITE take effect at the end of the transaction
+      if (_phase == PHASE_WRITE)
+      {
+        Execute();
+      }
+
+      _phase = enable ? PHASE_HEADER : PHASE_IDLE;
+      _headerlen = 0;
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Transfer data to and from the emulated chip
+  uint8_t Transfer(                     // Returns received byte
+    uint8_t value) override             // Byte to send
+  {
+    uint8_t result = Read();
+
+    Write(value);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send an 8-bit value
+  void Send8(
+    uint8_t value) override             // Value to send
+  {
+    Write(value);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from a RAM buffer
+  uint32_t SendBuffer(                  // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len) override              // Number of bytes to send
+  {
+    for (uint32_t u = 0; u < len; u++)
+    {
+      Write(buffer[u]);
+    }
+
+    return len;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive an 8-bit value
+  uint8_t Receive8() override           // Returns incoming value
+  {
+    return Read();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for the !INT line to become active
+  //
+  // There are no interrupts, so Steve keeps polling the registers.
+  bool WaitForInterrupt(                // Returns true=!INT active or unknown
+    uint32_t timeout_ms) override       // Maximum time to wait (ms)
+  {
+    (void)timeout_ms;
+
+    return true;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for at least the requested time
+  //
+  // This returns immediately, so that the delays of the initialization
+  // don't count in benchmarks.
+  void Delay(
+    uint32_t ms) override               // Number of milliseconds to wait
+  {
+    (void)ms;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  uint32_t Micros() override            // Returns timestamp in us
+  {
+#ifdef ARDUINO
+    return micros();
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
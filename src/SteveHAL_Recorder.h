@@ -0,0 +1,633 @@
+/****************************************************************************
+SteveHAL_Recorder.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a Hardware Abstraction Layer for Steve that records
+the traffic of another HAL.
+****************************************************************************/
+
+#ifndef _STEVEHAL_RECORDER_H
+#define _STEVEHAL_RECORDER_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "SteveHAL.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+// Maximum number of bytes that are collected into one send or receive
+// record.
+#ifndef STEVEHAL_RECORDER_CHUNK_SIZE
+#define STEVEHAL_RECORDER_CHUNK_SIZE 256
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// RECORDING HARDWARE ABSTRACTION LAYER
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Hardware Abstraction Layer that records the traffic of another HAL
+//
+// All calls are passed to the HAL from the constructor, and are written to
+// a binary stream through a function that's provided by the application
+// (e.g. to write the data to a file). Use SteveHAL_Null as the other HAL
+// to record the traffic without hardware.
+//
+// The stream starts with the four characters "STVR" and a version byte.
+// After that, each record starts with a RECORD byte and the time since
+// the previous record in microseconds, followed by the parameters of the
+// record type. Numbers are stored as unsigned LEB128 (7 bits per byte,
+// least significant first, bit 7 set if more bytes follow) so that most of
+// them only take one byte.
+//
+// The host command or memory address of each transaction is in the first
+// three bytes that are sent after a REC_SELECT record; consecutive send or
+// receive calls are combined into one record.
+class SteveHAL_Recorder : public SteveHAL
+{
+public:
+  //-------------------------------------------------------------------------
+  // Function that writes data to the stream
+  typedef void (*WRITE_FUNC)(
+    const uint8_t *data,                // Data to write
+    uint32_t len,                       // Number of bytes
+    void *context);                     // Context from constructor
+
+  //-------------------------------------------------------------------------
+  // Stream format version
+  const static uint8_t VERSION = 1;
+
+  //-------------------------------------------------------------------------
+  // Record types
+  enum RECORD
+  {
+    REC_SELECT = 1,                     // !CS went low
+    REC_DESELECT,                       // !CS went high
+    REC_SEND,                           // Length, data sent to the chip
+    REC_RECEIVE,                        // Length, data received from chip
+    REC_INIT,                           // 1 byte: 1=slow, 0=fast
+    REC_POWER,                          // 1 byte: 1=on, 0=off
+    REC_PAUSE,                          // 1 byte: 1=pause, 0=resume
+    REC_BUSWIDTH,                       // 1 byte: new bus width
+    REC_DELAY,                          // Milliseconds
+    REC_INTERRUPT,                      // Timeout, 1 byte result
+    REC_BEGIN,                          // 1 byte result
+    REC_END,                            // No parameters
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Parameters of a record, see Record
+  const static uint8_t PARAM_NUMBER = 0x01;
+  const static uint8_t PARAM_BYTE = 0x02;
+
+  //-------------------------------------------------------------------------
+  // Data
+  SteveHAL         &_hal;               // HAL that does the work
+  WRITE_FUNC        _write;             // Function to write the stream
+  void             *_context;           // Context for write function
+  uint32_t          _time;              // Time of the previous record
+  uint8_t           _pending;           // REC_SEND/REC_RECEIVE or 0=none
+  uint32_t          _pending_time;      // Time of the pending record
+  uint16_t          _pending_len;       // Bytes in pending record
+  uint8_t           _chunk[STEVEHAL_RECORDER_CHUNK_SIZE];
+                                        // Data of pending record
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveHAL_Recorder(
+    SteveHAL &hal,                      // HAL that does the work
+    WRITE_FUNC write,                   // Function to write the stream
+    void *context = NULL)               // Context for write function
+    : SteveHAL()
+    , _hal(hal)
+    , _write(write)
+    , _context(context)
+    , _time(hal.Micros())
+    , _pending(0)
+    , _pending_time(0)
+    , _pending_len(0)
+  {
+    const uint8_t header[] = { 'S', 'T', 'V', 'R', VERSION };
+
+    _write(header, sizeof(header), _context);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Write the pending send or receive record to the stream
+  //
+  // This is done automatically before any other record, so it's only
+  // necessary to call this before the stream is closed.
+  void Flush()
+  {
+    if (_pending)
+    {
+      uint8_t buf[12];
+      uint8_t len = 0;
+
+      buf[len++] = _pending;
+      len += Encode(buf + len, _pending_time - _time);
+      len += Encode(buf + len, _pending_len);
+
+      _write(buf, len, _context);
+      _write(_chunk, _pending_len, _context);
+
+      _time = _pending_time;
+      _pending = 0;
+      _pending_len = 0;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Encode a number in LEB128 format
+  static uint8_t                        // Returns number of bytes stored
+  Encode(
+    uint8_t *buf,                       // Output buffer, 5 bytes
+    uint32_t value)                     // Value to encode
+  {
+    uint8_t result = 0;
+
+    while (value >= 0x80)
+    {
+      buf[result++] = (uint8_t)(value | 0x80);
+      value >>= 7;
+    }
+
+    buf[result++] = (uint8_t)value;
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write a record with optional parameters to the stream
+  //
+  // The number is stored first (if any), followed by the byte (if any).
+  void Record(
+    RECORD type,                        // Record type
+    uint8_t params = 0,                 // Combination of PARAM_ flags
+    uint32_t value = 0,                 // Number parameter
+    uint8_t byte = 0)                   // Byte parameter
+  {
+    Flush();
+
+    uint32_t now = _hal.Micros();
+    uint8_t buf[12];
+    uint8_t len = 0;
+
+    buf[len++] = (uint8_t)type;
+    len += Encode(buf + len, now - _time);
+
+    if (params & PARAM_NUMBER)
+    {
+      len += Encode(buf + len, value);
+    }
+
+    if (params & PARAM_BYTE)
+    {
+      buf[len++] = byte;
+    }
+
+    _write(buf, len, _context);
+
+    _time = now;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Add data to a send or receive record
+  void RecordData(
+    RECORD type,                        // REC_SEND or REC_RECEIVE
+    const uint8_t *data,                // Data to add
+    uint32_t len)                       // Number of bytes
+  {
+    while (len)
+    {
+      if ((_pending != type) || (_pending_len == sizeof(_chunk)))
+      {
+        Flush();
+
+        _pending = (uint8_t)type;
+        _pending_time = _hal.Micros();
+      }
+
+      uint32_t n = sizeof(_chunk) - _pending_len;
+      if (n > len)
+      {
+        n = len;
+      }
+
+      memcpy(_chunk + _pending_len, data, n);
+      _pending_len += (uint16_t)n;
+      data += n;
+      len -= n;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Add a number to a send or receive record
+  void RecordValue(
+    RECORD type,                        // REC_SEND or REC_RECEIVE
+    uint32_t value,                     // Value to add
+    uint8_t len)                        // Number of bytes, LSB first
+  {
+    uint8_t buf[4];
+
+    for (uint8_t u = 0; u < len; u++)
+    {
+      buf[u] = (uint8_t)(value >> (8 * u));
+    }
+
+    RecordData(type, buf, len);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Initialize the hardware
+  bool Begin() override                 // Returns true if successful
+  {
+    bool result = _hal.Begin();
+
+    Record(REC_BEGIN, PARAM_BYTE, 0, result);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Shut down the hardware
+  void End() override
+  {
+    Record(REC_END);
+
+    _hal.End();
+
+    Flush();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Set the speed to slow or fast
+  void Init(
+    bool slow = false) override         // True=use slow speed for early init
+  {
+    Record(REC_INIT, PARAM_BYTE, 0, slow);
+
+    _hal.Init(slow);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the supported bus widths
+  uint8_t GetBusWidths() override       // Returns combination of BUSWIDTHs
+  {
+    return _hal.GetBusWidths();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the bus width
+  bool SetBusWidth(                     // Returns true=success
+    BUSWIDTH width) override            // New bus width
+  {
+    Record(REC_BUSWIDTH, PARAM_BYTE, 0, (uint8_t)width);
+
+    return _hal.SetBusWidth(width);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Change the fast clock
+  //
+  // This isn't recorded: the clock doesn't change the traffic.
+  bool SetClock(                        // Returns true=success
+    uint32_t hz) override               // New fast clock in Hz
+  {
+    return _hal.SetClock(hz);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the fast clock
+  uint32_t GetClock() override          // Returns fast clock in Hz, 0=unknown
+  {
+    return _hal.GetClock();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Pause or resume communication
+  void Pause(
+    bool pause) override                // True=pause, false=resume
+  {
+    Record(REC_PAUSE, PARAM_BYTE, 0, pause);
+
+    _hal.Pause(pause);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Turn the power on or off
+  void Power(
+    bool enable) override               // True=on (!PD high) false=off/reset
+  {
+    Record(REC_POWER, PARAM_BYTE, 0, enable);
+
+    _hal.Power(enable);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Select or de-select the chip
+  //
+  // Only calls that change the !CS line are recorded.
+  bool Select(                          // Returns true if !CS line changed
+    bool enable) override               // True=select (!CS low) false=de-sel
+  {
+    bool result = _hal.Select(enable);
+
+    if (result)
+    {
+      Record(enable ? REC_SELECT : REC_DESELECT);
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Transfer data to and from the EVE chip
+  uint8_t Transfer(                     // Returns received byte
+    uint8_t value) override             // Byte to send
+  {
+    RecordValue(REC_SEND, value, 1);
+
+    uint8_t result = _hal.Transfer(value);
+
+    RecordValue(REC_RECEIVE, result, 1);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send an 8-bit value
+  void Send8(
+    uint8_t value) override             // Value to send
+  {
+    RecordValue(REC_SEND, value, 1);
+
+    _hal.Send8(value);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 16-bit value in little-endian format
+  void Send16(
+    uint16_t value) override            // Value to send
+  {
+    RecordValue(REC_SEND, value, 2);
+
+    _hal.Send16(value);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 24 bit value in BIG ENDIAN format
+  void Send24BE(
+    uint32_t value) override            // Value to send (MSB ignored)
+  {
+    uint8_t buf[3] = { (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+
+    RecordData(REC_SEND, buf, sizeof(buf));
+
+    _hal.Send24BE(value);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a 32-bit value in little-endian format
+  void Send32(
+    uint32_t value) override            // Value to send
+  {
+    RecordValue(REC_SEND, value, 4);
+
+    _hal.Send32(value);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from a RAM buffer to the chip
+  uint32_t SendBuffer(                  // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len) override              // Number of bytes to send
+  {
+    RecordData(REC_SEND, buffer, len);
+
+    return _hal.SendBuffer(buffer, len);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send an array of 32-bit values in little-endian format
+  void SendWords(
+    const uint32_t *words,              // Values to send
+    uint32_t count) override            // Number of values
+  {
+#if STEVE_LITTLE_ENDIAN
+    RecordData(REC_SEND, (const uint8_t *)words, count * 4);
+#else
+    for (uint32_t u = 0; u < count; u++)
+    {
+      RecordValue(REC_SEND, words[u], 4);
+    }
+#endif
+
+    _hal.SendWords(words, count);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send a string with its nul-terminator and alignment bytes
+  uint32_t SendStringPadded(            // Returns number of bytes sent
+    const char *s,                      // Characters to send, not NULL
+    uint16_t len,                       // Number of characters
+    uint16_t total) override            // Total including zero bytes
+  {
+    const uint8_t zeroes[4] = { 0, 0, 0, 0 };
+
+    RecordData(REC_SEND, (const uint8_t *)s, len);
+    RecordData(REC_SEND, zeroes, (uint32_t)(total - len));
+
+    return _hal.SendStringPadded(s, len, total);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send data from program memory to the chip
+  //
+  // On platforms with a separate address space for program memory (AVR),
+  // the recorded data is wrong, because it's read as if it were in RAM.
+  uint32_t SendBufferProgmem(           // Returns number of bytes sent
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len) override              // Number of bytes to send
+  {
+    RecordData(REC_SEND, buffer, len);
+
+    return _hal.SendBufferProgmem(buffer, len);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Start sending data from a RAM buffer to the chip
+  //
+  // The data is recorded immediately; the time of the record is the time
+  // when the transfer was started.
+  void SendBufferAsync(
+    const uint8_t *buffer,              // Buffer to send
+    uint32_t len,                       // Number of bytes to send
+    ASYNC_CALLBACK callback = NULL,     // Callback function, NULL=none
+    void *context = NULL) override      // Context for callback
+  {
+    RecordData(REC_SEND, buffer, len);
+
+    _hal.SendBufferAsync(buffer, len, callback, context);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Check if an asynchronous transfer is in progress
+  bool IsBusy() override                // Returns true=transfer in progress
+  {
+    return _hal.IsBusy();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait until an asynchronous transfer is complete
+  void Wait() override
+  {
+    _hal.Wait();
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive an 8-bit value
+  uint8_t Receive8() override           // Returns incoming value
+  {
+    uint8_t result = _hal.Receive8();
+
+    RecordValue(REC_RECEIVE, result, 1);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a 16-bit value in little-endian format
+  uint16_t Receive16() override         // Returns incoming value
+  {
+    uint16_t result = _hal.Receive16();
+
+    RecordValue(REC_RECEIVE, result, 2);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a 32-bit value in little-endian format
+  uint32_t Receive32() override         // Returns incoming value
+  {
+    uint32_t result = _hal.Receive32();
+
+    RecordValue(REC_RECEIVE, result, 4);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Receive a buffer
+  uint32_t ReceiveBuffer(               // Returns number of bytes received
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len) override              // Number of bytes to receive
+  {
+    uint32_t result = _hal.ReceiveBuffer(buffer, len);
+
+    RecordData(REC_RECEIVE, buffer, result);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Perform a complete read transaction
+  //
+  // The transaction is passed to the other HAL as a whole, so that it
+  // still takes a single round trip; it's recorded as if the separate
+  // functions were called.
+  uint32_t ReadTransaction(             // Returns number of bytes received
+    const uint8_t *header,              // Header to send
+    uint32_t headerlen,                 // Number of header bytes to send
+    uint8_t *buffer,                    // Buffer to receive to
+    uint32_t len) override              // Number of bytes to receive
+  {
+    Record(REC_SELECT);
+    RecordData(REC_SEND, header, headerlen);
+
+    uint32_t result = _hal.ReadTransaction(header, headerlen, buffer, len);
+
+    RecordData(REC_RECEIVE, buffer, result);
+    Record(REC_DESELECT);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for the !INT line to become active
+  bool WaitForInterrupt(                // Returns true=!INT active or unknown
+    uint32_t timeout_ms) override       // Maximum time to wait (ms)
+  {
+    bool result = _hal.WaitForInterrupt(timeout_ms);
+
+    Record(REC_INTERRUPT, PARAM_NUMBER | PARAM_BYTE, timeout_ms, result);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Wait for at least the requested time
+  void Delay(
+    uint32_t ms) override               // Number of milliseconds to wait
+  {
+    Record(REC_DELAY, PARAM_NUMBER, ms);
+
+    _hal.Delay(ms);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a host timestamp in microseconds
+  uint32_t Micros() override            // Returns timestamp in us
+  {
+    return _hal.Micros();
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,328 @@
+/****************************************************************************
+SteveMultiDisplay.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a scheduler that drives multiple displays.
+****************************************************************************/
+
+#ifndef _STEVEMULTIDISPLAY_H
+#define _STEVEMULTIDISPLAY_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MULTIPLE DISPLAY SCHEDULER
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Scheduler for multiple displays
+//
+// Each display has its own Steve instance with its own HAL (e.g. one
+// MPSSE channel per display). Frames are built by a function that's
+// registered for each display.
+//
+// Instead of waiting for each display in turn, the scheduler polls all
+// displays and builds a frame for every display that can accept one (see
+// Steve::BeginFrame). So while the co-processor of one display is busy
+// rendering, the frames for the other displays are sent.
+//
+// Use the SteveMultiDisplayTable template to declare a scheduler with a
+// given maximum number of displays.
+class SteveMultiDisplay
+{
+public:
+  //-------------------------------------------------------------------------
+  // Function that builds a frame
+  //
+  // The function is called between BeginFrame and SubmitFrame, so it
+  // should only add the commands for the frame.
+  typedef void (*FRAME_FUNC)(
+    Steve &eve,                         // Display to build the frame for
+    void *context);                     // Context from Add
+
+  const static uint8_t INVALID_PANEL = 0xFF;
+
+  //-------------------------------------------------------------------------
+  // Display with its frame function
+  struct Panel
+  {
+    Steve            *_eve;           // Display
+    FRAME_FUNC        _func;          // Function that builds frames
+    void             *_context;       // Context for the function
+    volatile uint32_t _frames;        // Number of frames submitted
+                                      //   (may be updated by a thread)
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Panel *const      _panels;          // Storage for panels
+  const uint8_t     _max;             // Maximum number of panels
+  uint8_t           _count;           // Number of panels
+  uint8_t           _next;            // Panel to poll first
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // This is protected; use SteveMultiDisplayTable.
+  SteveMultiDisplay(
+    Panel *panels,                    // Storage for panels
+    uint8_t max)                      // Maximum number of panels
+    : _panels(panels)
+    , _max(max)
+    , _count(0)
+    , _next(0)
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveMultiDisplay()
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a display
+  uint8_t                               // Returns index, INVALID_PANEL=full
+  Add(
+    Steve &eve,                         // Display
+    FRAME_FUNC func,                    // Function that builds frames
+    void *context = NULL)               // Context for the function
+  {
+    if (_count >= _max)
+    {
+      return INVALID_PANEL;
+    }
+
+    Panel &p = _panels[_count];
+
+    p._eve = &eve;
+    p._func = func;
+    p._context = context;
+    p._frames = 0;
+
+    return _count++;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of displays
+  uint8_t                               // Returns number of displays
+  Count() const
+  {
+    return _count;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of frames that were submitted to a display
+  uint32_t                              // Returns number of frames
+  Frames(
+    uint8_t index) const                // Index of the display
+  {
+    return (index < _count) ? _panels[index]._frames : 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Initialize all displays
+  //
+  // The displays are initialized at the same time with Steve::BeginStep,
+  // so the time it takes is about the same as for a single display. While
+  // all of the displays are waiting, the host sleeps until the first one
+  // needs to be called again.
+  virtual bool                          // Returns true=all successful
+  Begin()
+  {
+    bool result = true;
+    bool pending;
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      _panels[u]._eve->BeginRestart();
+    }
+
+    do
+    {
+      uint8_t first = 0;                // Display that wakes up first
+      uint32_t sleep = 0xFFFFFFFFUL;    // Time until then in us
+
+      pending = false;
+
+      for (uint8_t u = 0; u < _count; u++)
+      {
+        uint32_t wakeup;
+
+        if (_panels[u]._eve->BeginStep(&wakeup) == Steve::BEGINSTEP_PENDING)
+        {
+          // Each HAL may have its own time base
+          int32_t left = (int32_t)(wakeup - _panels[u]._eve->HostMicros());
+
+          if (left < 0)
+          {
+            left = 0;
+          }
+
+          if ((uint32_t)left < sleep)
+          {
+            sleep = (uint32_t)left;
+            first = u;
+          }
+
+          pending = true;
+        }
+      }
+
+      if ((pending) && (sleep))
+      {
+        _panels[first]._eve->HostDelay((sleep + 999) / 1000);
+      }
+    } while (pending);
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      if (_panels[u]._eve->BeginStep() != Steve::BEGINSTEP_DONE)
+      {
+        DBG_STAT("Display %u failed to initialize\n", u);
+        result = false;
+      }
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Shut down all displays
+  virtual void End()
+  {
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      _panels[u]._eve->End();
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Build and submit a frame for one display if it can accept one
+  bool                                  // Returns true=frame submitted
+  PollPanel(
+    Panel &p)                           // Panel to poll
+  {
+    if (!p._eve->BeginFrame(false))
+    {
+      return false;
+    }
+
+    p._func(*p._eve, p._context);
+    p._eve->SubmitFrame();
+    p._frames = p._frames + 1;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Submit frames to all displays that can accept one
+  //
+  // This never waits for a display. The displays are polled in turn,
+  // starting at a different one each time, so that they get an equal
+  // share of the host's time.
+  virtual uint8_t                       // Returns number of frames submitted
+  Poll()
+  {
+    uint8_t result = 0;
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      uint8_t index = (uint8_t)((_next + u) % _count);
+
+      if (PollPanel(_panels[index]))
+      {
+        result++;
+      }
+    }
+
+    if (_count)
+    {
+      _next = (uint8_t)((_next + 1) % _count);
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Virtual function that gets called when no display could accept a frame
+  //
+  // The implementation here does nothing. Subclasses can override this to
+  // sleep for a short time or to do something useful in the mean time.
+  virtual void Idle()
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Submit frames until every display has received at least a number of
+  // frames
+  void Run(
+    uint32_t frames)                    // Number of frames per display
+  {
+    for (;;)
+    {
+      bool done = true;
+
+      for (uint8_t u = 0; u < _count; u++)
+      {
+        if (_panels[u]._frames < frames)
+        {
+          done = false;
+        }
+      }
+
+      if (done)
+      {
+        break;
+      }
+
+      if (!Poll())
+      {
+        Idle();
+      }
+    }
+  }
+};
+
+//---------------------------------------------------------------------------
+// Scheduler with a given maximum number of displays
+template<const uint8_t count> class SteveMultiDisplayTable : public SteveMultiDisplay
+{
+private:
+  Panel             _storage[count];  // Storage
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveMultiDisplayTable()
+    : SteveMultiDisplay(_storage, count)
+  {
+    // Nothing
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
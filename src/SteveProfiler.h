@@ -0,0 +1,436 @@
+/****************************************************************************
+SteveProfiler.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a frame profiler for Steve.
+****************************************************************************/
+
+#ifndef _STEVEPROFILER_H
+#define _STEVEPROFILER_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// FRAME PROFILER
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Frame profiler
+//
+// Use the BeginFrame and SubmitFrame functions of the profiler instead of
+// the ones in Steve. For each frame, the profiler measures:
+// - The build time: host time between BeginFrame and SubmitFrame.
+// - The transmit time: host time spent in SubmitFrame, i.e. sending the
+//   staged commands (see Steve::CmdSetStaging). Without a staging buffer,
+//   the commands are sent while the frame is built, so the bus time is
+//   part of the build time.
+// - The execution time: co-processor time from CMD_DLSTART to the end of
+//   the frame, measured with REG_CLOCK.
+// - The number of display list bytes used (REG_CMD_DL).
+// - The number of missed vsyncs, from REG_FRAMES.
+//
+// The EVE values are copied to a scratch area in RAM_G by cmd_MEMCPY
+// commands at the start and end of each frame, so measuring doesn't make
+// the host wait for the co-processor. The values are collected when the
+// frame is done. The host times are only known if the HAL implements
+// SteveHAL::Micros.
+//
+// The samples of the most recent frames are kept, to calculate averages,
+// maximums and histograms. Use the SteveProfilerTable template to declare
+// a profiler with a given number of samples.
+class SteveProfiler
+{
+public:
+  //-------------------------------------------------------------------------
+  // Measurements of one frame
+  struct Sample
+  {
+    uint32_t          _build_us;        // Time to build the frame (host)
+    uint32_t          _transmit_us;     // Time to submit the frame (host)
+    uint32_t          _execute_us;      // Co-processor execution time
+    uint16_t          _dl_bytes;        // Display list bytes used
+    uint16_t          _missed_vsyncs;   // Frames displayed in between
+                                        //   minus one
+  };
+
+  //-------------------------------------------------------------------------
+  // Measurement selector for the statistics functions
+  enum METRIC
+  {
+    METRIC_BUILD,                       // Build time in us
+    METRIC_TRANSMIT,                    // Transmit time in us
+    METRIC_EXECUTE,                     // Execution time in us
+    METRIC_DL_BYTES,                    // Display list bytes
+    METRIC_MISSED_VSYNCS,               // Missed vsyncs
+  };
+
+  //-------------------------------------------------------------------------
+  // What limits the frame rate the most
+  enum BOUND
+  {
+    BOUND_UNKNOWN,                      // No samples
+    BOUND_HOST,                         // Building frames on the host
+    BOUND_BUS,                          // Sending frames to the EVE
+    BOUND_EVE,                          // Executing frames on the EVE
+  };
+
+  //-------------------------------------------------------------------------
+  // Scratch area layout
+  //
+  // Each frame that can be in flight has its own slot.
+  const static uint8_t  SLOTS = Steve::FRAMES_IN_FLIGHT + 1;
+  const static uint32_t SLOT_CLOCK_START = 0;
+  const static uint32_t SLOT_FRAMES = 4;
+  const static uint32_t SLOT_CMD_DL = 8;
+  const static uint32_t SLOT_CLOCK_END = 12;
+  const static uint32_t SLOT_SIZE = 16;
+  const static uint32_t SCRATCH_SIZE = SLOTS * SLOT_SIZE;
+
+protected:
+  //-------------------------------------------------------------------------
+  // Host times of a frame that hasn't been collected
+  struct Pending
+  {
+    uint32_t          _build_us;        // Time to build the frame
+    uint32_t          _transmit_us;     // Time to submit the frame
+  };
+
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  const uint32_t    _scratch;           // Scratch area in RAM_G
+  Sample *const     _samples;           // Storage for samples
+  const uint16_t    _max;               // Maximum number of samples
+  uint16_t          _count;             // Number of samples
+  uint16_t          _next;              // Index of next sample to store
+  uint32_t          _mhz;               // EVE clock in MHz, 0=unknown
+  Pending           _pending[SLOTS];    // Host times of slots
+  uint8_t           _slot;              // Slot for next frame
+  uint8_t           _inflight;          // Frames not collected
+  uint32_t          _begin_us;          // Host time at BeginFrame
+  uint32_t          _last_frames;       // REG_FRAMES of last frame
+  bool              _have_frames;       // True=_last_frames is valid
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // This is protected; use SteveProfilerTable.
+  SteveProfiler(
+    Steve &eve,                         // Display
+    uint32_t scratch,                   // RAM_G area of SCRATCH_SIZE bytes
+    Sample *samples,                    // Storage for samples
+    uint16_t max)                       // Maximum number of samples
+    : _eve(eve)
+    , _scratch(scratch)
+    , _samples(samples)
+    , _max(max)
+  {
+    Reset();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Forget all samples
+  //
+  // Frames that are in flight are forgotten too.
+  void Reset()
+  {
+    _count = 0;
+    _next = 0;
+    _mhz = 0;
+    _slot = 0;
+    _inflight = 0;
+    _begin_us = 0;
+    _last_frames = 0;
+    _have_frames = false;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Store a sample, replacing the oldest one if the storage is full
+  void AddSample(
+    const Sample &sample)               // Sample to store
+  {
+    _samples[_next] = sample;
+    _next = (uint16_t)((_next + 1) % _max);
+
+    if (_count < _max)
+    {
+      _count++;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Collect the measurements of the frames that the co-processor finished
+  void Collect()
+  {
+    while (_inflight > _eve.FramesPending())
+    {
+      uint8_t slot = (uint8_t)((_slot + SLOTS - _inflight) % SLOTS);
+      uint8_t buf[SLOT_SIZE];
+      uint32_t values[SLOT_SIZE / 4];
+
+      _eve.RegReadBuffer(_scratch + slot * SLOT_SIZE, sizeof(buf), buf);
+
+      for (uint8_t u = 0; u < SLOT_SIZE / 4; u++)
+      {
+        values[u] = (uint32_t)buf[u * 4] | ((uint32_t)buf[u * 4 + 1] << 8) | ((uint32_t)buf[u * 4 + 2] << 16) | ((uint32_t)buf[u * 4 + 3] << 24);
+      }
+
+      Sample sample;
+      uint32_t frames = values[SLOT_FRAMES / 4];
+
+      sample._build_us = _pending[slot]._build_us;
+      sample._transmit_us = _pending[slot]._transmit_us;
+      sample._execute_us = _mhz ? (values[SLOT_CLOCK_END / 4] - values[SLOT_CLOCK_START / 4]) / _mhz : 0;
+      sample._dl_bytes = (uint16_t)values[SLOT_CMD_DL / 4];
+      sample._missed_vsyncs = ((_have_frames) && (frames - _last_frames > 1)) ? (uint16_t)(frames - _last_frames - 1) : 0;
+
+      _last_frames = frames;
+      _have_frames = true;
+
+      AddSample(sample);
+
+      _inflight--;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start a new frame
+  //
+  // See Steve::BeginFrame.
+  bool                                  // Returns true=frame started
+  BeginFrame(
+    bool wait = true)                   // False=return false if busy
+  {
+    if (!_eve.BeginFrame(wait))
+    {
+      return false;
+    }
+
+    Collect();
+
+    if (!_mhz)
+    {
+      _mhz = _eve.RegRead32(Steve::REG_FREQUENCY) / 1000000UL;
+    }
+
+    // If the caller didn't use the profiler for all frames, the oldest
+    // slot may still be in use; forget about it.
+    if (_inflight == SLOTS)
+    {
+      _inflight--;
+    }
+
+    uint32_t base = _scratch + _slot * SLOT_SIZE;
+
+    _begin_us = _eve.HostMicros();
+
+    // The slot is different in every frame, so the copies aren't
+    // compared by the frame deduplication
+    _eve.FrameHashExcludeBegin();
+    _eve.cmd_MEMCPY(base + SLOT_CLOCK_START, Steve::REG_CLOCK, 4);
+    _eve.cmd_MEMCPY(base + SLOT_FRAMES, Steve::REG_FRAMES, 4);
+    _eve.FrameHashExcludeEnd();
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Submit a frame that was started with BeginFrame
+  //
+  // See Steve::SubmitFrame. Frames that are skipped because they didn't
+  // change (see Steve::CmdSetFrameDedup) aren't measured.
+  Steve::CmdIndex                       // Returns updated Cmd index
+  SubmitFrame()
+  {
+    uint32_t base = _scratch + _slot * SLOT_SIZE;
+
+    _eve.FrameHashExcludeBegin();
+    _eve.cmd_MEMCPY(base + SLOT_CMD_DL, Steve::REG_CMD_DL, 4);
+    _eve.cmd_MEMCPY(base + SLOT_CLOCK_END, Steve::REG_CLOCK, 4);
+    _eve.FrameHashExcludeEnd();
+
+    uint32_t submit_us = _eve.HostMicros();
+    Steve::CmdIndex result = _eve.SubmitFrame();
+
+    if (!_eve.FrameWasSkipped())
+    {
+      _pending[_slot]._build_us = submit_us - _begin_us;
+      _pending[_slot]._transmit_us = _eve.HostMicros() - submit_us;
+
+      _slot = (uint8_t)((_slot + 1) % SLOTS);
+      _inflight++;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of samples
+  uint16_t                              // Returns number of samples
+  Count() const
+  {
+    return _count;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get a sample
+  const Sample &                        // Returns sample
+  GetSample(
+    uint16_t index) const               // Index, 0=oldest (not checked)
+  {
+    return _samples[(_next + _max - _count + index) % _max];
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get one measurement from a sample
+  static uint32_t                       // Returns measurement
+  Value(
+    const Sample &sample,               // Sample
+    METRIC metric)                      // Measurement to get
+  {
+    switch (metric)
+    {
+    case METRIC_BUILD:          return sample._build_us;
+    case METRIC_TRANSMIT:       return sample._transmit_us;
+    case METRIC_EXECUTE:        return sample._execute_us;
+    case METRIC_DL_BYTES:       return sample._dl_bytes;
+    case METRIC_MISSED_VSYNCS:  return sample._missed_vsyncs;
+    }
+
+    return 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the average of a measurement over all samples
+  uint32_t                              // Returns average, 0=no samples
+  Average(
+    METRIC metric) const                // Measurement to calculate
+  {
+    uint32_t total = 0;
+
+    for (uint16_t u = 0; u < _count; u++)
+    {
+      total += Value(GetSample(u), metric);
+    }
+
+    return _count ? total / _count : 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the maximum of a measurement over all samples
+  uint32_t                              // Returns maximum, 0=no samples
+  Maximum(
+    METRIC metric) const                // Measurement to calculate
+  {
+    uint32_t result = 0;
+
+    for (uint16_t u = 0; u < _count; u++)
+    {
+      uint32_t value = Value(GetSample(u), metric);
+
+      if (value > result)
+      {
+        result = value;
+      }
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Build a histogram of a measurement over all samples
+  //
+  // Bucket n counts the samples with a value from n * width up to (but not
+  // including) (n + 1) * width. The last bucket also counts all samples
+  // with higher values.
+  uint16_t                              // Returns number of samples
+  Histogram(
+    METRIC metric,                      // Measurement to count
+    uint16_t *buckets,                  // Output buckets
+    uint8_t numbuckets,                 // Number of buckets (at least 1)
+    uint32_t width) const               // Width of each bucket (at least 1)
+  {
+    memset(buckets, 0, numbuckets * sizeof(buckets[0]));
+
+    for (uint16_t u = 0; u < _count; u++)
+    {
+      uint32_t bucket = Value(GetSample(u), metric) / width;
+
+      if (bucket >= numbuckets)
+      {
+        bucket = numbuckets - 1;
+      }
+
+      buckets[bucket]++;
+    }
+
+    return _count;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Find out what limits the frame rate the most
+  //
+  // This compares the average build, transmit and execution times.
+  BOUND                                 // Returns limiting factor
+  Bound() const
+  {
+    if (!_count)
+    {
+      return BOUND_UNKNOWN;
+    }
+
+    uint32_t build = Average(METRIC_BUILD);
+    uint32_t transmit = Average(METRIC_TRANSMIT);
+    uint32_t execute = Average(METRIC_EXECUTE);
+
+    if ((execute >= build) && (execute >= transmit))
+    {
+      return BOUND_EVE;
+    }
+
+    return (transmit > build) ? BOUND_BUS : BOUND_HOST;
+  }
+};
+
+//---------------------------------------------------------------------------
+// Frame profiler with a given number of samples
+template<const uint16_t count> class SteveProfilerTable : public SteveProfiler
+{
+private:
+  Sample            _storage[count];    // Storage
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveProfilerTable(
+    Steve &eve,                         // Display
+    uint32_t scratch)                   // RAM_G area of SCRATCH_SIZE bytes
+    : SteveProfiler(eve, scratch, _storage, count)
+  {
+    // Nothing
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
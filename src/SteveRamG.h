@@ -0,0 +1,573 @@
+/****************************************************************************
+SteveRamG.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares an allocator for the general purpose RAM of the EVE.
+****************************************************************************/
+
+#ifndef _STEVERAMG_H
+#define _STEVERAMG_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// RAM_G ALLOCATOR
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Allocator for RAM_G
+//
+// The allocator manages an area of RAM_G (by default all of it) in two
+// parts:
+// * Static allocations are for assets that stay in memory until the next
+//   reset, e.g. fonts and bitmaps that are loaded at boot time. They are
+//   allocated from the bottom of the area upwards, and can't be freed
+//   individually.
+// * Dynamic allocations are for assets that change at runtime, e.g. the
+//   bitmaps for the current screen. They are allocated from the top of the
+//   area downwards, in the smallest free gap that fits, and are referred to
+//   by a handle. They can be freed in any order. Blocks that are shrunk
+//   after loading go at the bottom of their gap instead.
+//
+// The allocator only keeps track of addresses; it doesn't access the
+// EVE, except in the functions that load data into an allocated block and
+// use CmdGetPtr to find out how much memory was actually used.
+//
+// Use the SteveRamGTable template to declare an allocator with a given
+// number of handles.
+class SteveRamG
+{
+public:
+  //-------------------------------------------------------------------------
+  // Types and constants
+  typedef uint8_t HANDLE;
+
+  const static HANDLE   INVALID_HANDLE = 0xFF;
+  const static uint32_t INVALID_ADDRESS = 0xFFFFFFFFUL;
+  const static uint32_t ALIGNMENT = 4;
+
+  //-------------------------------------------------------------------------
+  // Dynamically allocated block
+  struct Block
+  {
+    uint32_t          _address;       // Address in RAM_G
+    uint32_t          _size;          // Size in bytes (aligned)
+    bool              _used;          // True=handle in use
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_steve;           // EVE to allocate memory for
+  Block *const      _blocks;          // Storage for handles
+  const uint8_t     _count;           // Number of handles
+  uint32_t          _base;            // First address of the area
+  uint32_t          _end;             // Address after the area
+  uint32_t          _static_end;      // End of static allocations
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // This is protected; use SteveRamGTable, which calls Reset when the
+  // storage for the handles exists.
+  SteveRamG(
+    Steve &steve,                     // EVE to allocate memory for
+    Block *blocks,                    // Storage for handles
+    uint8_t count)                    // Number of handles
+    : _steve(steve)
+    , _blocks(blocks)
+    , _count(count)
+    , _base(0)
+    , _end(Steve::RAM_G_SIZE)
+    , _static_end(0)
+  {
+    // Nothing
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Round a size up to the alignment
+  static uint32_t Align(                // Returns aligned size
+    uint32_t size)                      // Size in bytes
+  {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Set the area of RAM_G to manage
+  //
+  // This frees all allocations. The area should not overlap with anything
+  // else in RAM_G that the application uses, e.g. a list cache (see
+  // Steve::CmdSetListCache).
+  void SetArea(
+    uint32_t address,                   // First address of the area
+    uint32_t size)                      // Size of the area in bytes
+  {
+    _base = Align(address);
+    _end = (address + size) & ~(ALIGNMENT - 1);
+
+    Reset();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Free all allocations
+  //
+  // This should be called after Steve::Begin, because a reset clears
+  // RAM_G.
+  void Reset()
+  {
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      _blocks[u]._address = 0;
+      _blocks[u]._size = 0;
+      _blocks[u]._used = false;
+    }
+
+    _static_end = _base;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the lowest address of all dynamic allocations
+  uint32_t                              // Returns address, _end=none
+  DynamicStart() const
+  {
+    uint32_t result = _end;
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      if ((_blocks[u]._used) && (_blocks[u]._address < result))
+      {
+        result = _blocks[u]._address;
+      }
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Find the end of the free gap that starts at the given address
+  uint32_t                              // Returns address after the gap
+  GapEnd(
+    uint32_t start) const               // Start of the gap
+  {
+    uint32_t result = _end;
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      if ((_blocks[u]._used) && (_blocks[u]._address >= start) && (_blocks[u]._address < result))
+      {
+        result = _blocks[u]._address;
+      }
+    }
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Iterate the free gaps
+  //
+  // The gaps start at the end of the static allocations and at the end of
+  // each dynamic block. Pass -1 to get the first gap; the function returns
+  // false when there are no more gaps. Gaps may be empty.
+  bool                                  // Returns true=gap found
+  NextGap(
+    int &iterator,                      // -1=first, updated
+    uint32_t &start,                    // Output start of the gap
+    uint32_t &end) const                // Output address after the gap
+  {
+    for (;;)
+    {
+      if (iterator < 0)
+      {
+        start = _static_end;
+      }
+      else if (iterator >= _count)
+      {
+        return false;
+      }
+      else if (_blocks[iterator]._used)
+      {
+        start = _blocks[iterator]._address + _blocks[iterator]._size;
+      }
+      else
+      {
+        iterator++;
+        continue;
+      }
+
+      iterator++;
+      end = GapEnd(start);
+
+      return true;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Allocate static memory
+  //
+  // The memory is allocated from the bottom of the area, and stays
+  // allocated until Reset is called.
+  uint32_t                              // Returns address, INVALID_ADDRESS=fail
+  AllocStatic(
+    uint32_t size)                      // Number of bytes
+  {
+    size = Align(size);
+
+    if (size > DynamicStart() - _static_end)
+    {
+      DBG_STAT("RAM_G: No space for static allocation of %lu bytes\n", size);
+      return INVALID_ADDRESS;
+    }
+
+    uint32_t result = _static_end;
+
+    _static_end += size;
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the end of the static allocations
+  //
+  // This can be used with commands that use all memory from a given
+  // address, to find out where they can store data.
+  uint32_t                              // Returns first unused address
+  StaticEnd() const
+  {
+    return _static_end;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Allocate dynamic memory
+  //
+  // The smallest free gap that fits is used, and the block is normally
+  // placed at the top of the gap, so that the bottom of the area stays
+  // available for static allocations.
+  //
+  // A block that will be shrunk after it's filled (see Shrink) should be
+  // placed at the bottom of the gap instead, so that the space that's
+  // given back stays connected to the rest of the gap.
+  HANDLE                                // Returns handle, INVALID_HANDLE=fail
+  Alloc(
+    uint32_t size,                      // Number of bytes
+    bool bottom = false)                // True=bottom of gap, false=top
+  {
+    size = Align(size);
+
+    HANDLE result = INVALID_HANDLE;
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      if (!_blocks[u]._used)
+      {
+        result = u;
+        break;
+      }
+    }
+
+    if (result == INVALID_HANDLE)
+    {
+      DBG_STAT("RAM_G: No free handles\n");
+      return INVALID_HANDLE;
+    }
+
+    int iterator = -1;
+    uint32_t start;
+    uint32_t end;
+    uint32_t beststart = 0;
+    uint32_t bestend = 0;
+    uint32_t bestsize = INVALID_ADDRESS;
+
+    while (NextGap(iterator, start, end))
+    {
+      uint32_t gap = end - start;
+
+      if ((gap >= size) && (gap < bestsize))
+      {
+        bestsize = gap;
+        beststart = start;
+        bestend = end;
+      }
+    }
+
+    if (bestsize == INVALID_ADDRESS)
+    {
+      DBG_STAT("RAM_G: No space for %lu bytes\n", size);
+      return INVALID_HANDLE;
+    }
+
+    _blocks[result]._address = bottom ? beststart : bestend - size;
+    _blocks[result]._size = size;
+    _blocks[result]._used = true;
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Free dynamic memory
+  void Free(
+    HANDLE handle)                      // Handle to free
+  {
+    if (handle < _count)
+    {
+      _blocks[handle]._used = false;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the address of a dynamic block
+  uint32_t                              // Returns address, INVALID_ADDRESS=bad
+  Address(
+    HANDLE handle) const                // Handle of the block
+  {
+    return ((handle < _count) && (_blocks[handle]._used)) ? _blocks[handle]._address : INVALID_ADDRESS;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the size of a dynamic block
+  uint32_t                              // Returns size, 0=bad handle
+  Size(
+    HANDLE handle) const                // Handle of the block
+  {
+    return ((handle < _count) && (_blocks[handle]._used)) ? _blocks[handle]._size : 0;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Reduce the size of a dynamic block
+  //
+  // The end of the block is freed; the address doesn't change. Blocks
+  // that are shrunk should be allocated at the bottom of a gap (see
+  // Alloc).
+  bool                                  // Returns true=success
+  Shrink(
+    HANDLE handle,                      // Handle of the block
+    uint32_t size)                      // New size in bytes
+  {
+    size = Align(size);
+
+    if ((handle >= _count) || (!_blocks[handle]._used) || (size > _blocks[handle]._size))
+    {
+      return false;
+    }
+
+    _blocks[handle]._size = size;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Reduce a dynamic block to the data that was stored in it
+  //
+  // This uses CMD_GETPTR (see Steve::CmdGetPtr) to find the end of the
+  // data that was stored by the last CMD_INFLATE or CMD_LOADIMAGE, and
+  // shrinks the block to fit. If the data turned out to be bigger than
+  // the block, memory after the block was overwritten; the block is freed
+  // and the function returns false.
+  bool                                  // Returns true=success
+  ShrinkToPtr(
+    HANDLE handle)                      // Handle of the block
+  {
+    uint32_t address = Address(handle);
+
+    if (address == INVALID_ADDRESS)
+    {
+      return false;
+    }
+
+    uint32_t ptr = _steve.CmdGetPtr();
+
+    if ((ptr < address) || (ptr - address > _blocks[handle]._size))
+    {
+      DBG_STAT("RAM_G: Data at %lX ends at %lX, outside block of %lu bytes\n", address, ptr, _blocks[handle]._size);
+      Free(handle);
+      return false;
+    }
+
+    return Shrink(handle, ptr - address);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Execute a command that fills a dynamic block, and shrink the block
+  //
+  // The command is only queued by the caller, so it's executed here before
+  // CMD_GETPTR is used. If the co-processor reports an error, the block is
+  // freed.
+  bool                                  // Returns true=success
+  Complete(
+    HANDLE handle)                      // Handle of the block
+  {
+    bool error;
+
+    _steve.CmdExecute(true, &error);
+
+    if (error)
+    {
+      DBG_STAT("RAM_G: Co-processor error while loading block\n");
+      Free(handle);
+      return false;
+    }
+
+    return ShrinkToPtr(handle);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Decompress data into a new dynamic block
+  //
+  // The maximum size is allocated for the decompressed data, and the block
+  // is shrunk to what's actually used after decompression.
+  HANDLE                                // Returns handle, INVALID_HANDLE=fail
+  Inflate(
+    uint32_t maxsize,                   // Maximum decompressed size
+    uint32_t num,                       // Size of compressed data
+    const uint8_t *data)                // Compressed data
+  {
+    HANDLE result = Alloc(maxsize, true);
+
+    if (result != INVALID_HANDLE)
+    {
+      _steve.cmd_INFLATE(_blocks[result]._address, num, data);
+
+      if (!Complete(result))
+      {
+        result = INVALID_HANDLE;
+      }
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Load a JPEG or PNG image into a new dynamic block
+  //
+  // The maximum size is allocated for the decoded image, and the block is
+  // shrunk to what's actually used after decoding.
+  HANDLE                                // Returns handle, INVALID_HANDLE=fail
+  LoadImage(
+    uint32_t maxsize,                   // Maximum decoded size
+    Steve::OPT options,                 // Options for CMD_LOADIMAGE
+    uint32_t num,                       // Size of image data
+    const uint8_t *data)                // Image data
+  {
+    HANDLE result = Alloc(maxsize, true);
+
+    if (result != INVALID_HANDLE)
+    {
+      _steve.cmd_LOADIMAGE(_blocks[result]._address, options, num, data);
+
+      if (!Complete(result))
+      {
+        result = INVALID_HANDLE;
+      }
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the total number of free bytes
+  uint32_t                              // Returns number of bytes free
+  FreeBytes() const
+  {
+    int iterator = -1;
+    uint32_t start;
+    uint32_t end;
+    uint32_t result = 0;
+
+    while (NextGap(iterator, start, end))
+    {
+      result += end - start;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the size of the largest free gap
+  //
+  // This is the biggest block that can currently be allocated.
+  uint32_t                              // Returns number of bytes
+  LargestFree() const
+  {
+    int iterator = -1;
+    uint32_t start;
+    uint32_t end;
+    uint32_t result = 0;
+
+    while (NextGap(iterator, start, end))
+    {
+      if (end - start > result)
+      {
+        result = end - start;
+      }
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the fragmentation of the free memory
+  //
+  // This is the percentage of free memory that's not in the largest gap:
+  // 0 means all free memory can be allocated in one block.
+  uint8_t                               // Returns percentage 0-100
+  Fragmentation() const
+  {
+    uint32_t total = FreeBytes();
+
+    if (!total)
+    {
+      return 0;
+    }
+
+    return (uint8_t)(100 - (uint32_t)(((uint64_t)LargestFree() * 100) / total));
+  }
+};
+
+//---------------------------------------------------------------------------
+// RAM_G allocator with a given number of handles
+template<const uint8_t count> class SteveRamGTable : public SteveRamG
+{
+private:
+  Block             _storage[count];  // Storage
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveRamGTable(
+    Steve &steve)                     // EVE to allocate memory for
+    : SteveRamG(steve, _storage, count)
+  {
+    Reset();
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
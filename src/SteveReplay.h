@@ -0,0 +1,547 @@
+/****************************************************************************
+SteveReplay.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a player for traffic that was recorded with
+SteveHAL_Recorder.
+****************************************************************************/
+
+#ifndef _STEVEREPLAY_H
+#define _STEVEREPLAY_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+#include "SteveHAL_Recorder.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// TRAFFIC REPLAY
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Player for recorded traffic
+//
+// This sends the transactions from a SteveHAL_Recorder stream to an EVE
+// chip through a HAL, as fast as possible, so that the performance of the
+// transport can be measured without the application that generated the
+// traffic:
+// * Consecutive write transactions to adjacent addresses (or to
+//   REG_CMDB_WRITE) are merged into one burst;
+// * Delays, power changes, bus width changes and host commands are
+//   skipped, so the chip must already be initialized (e.g. with
+//   Steve::Begin, using the same display profile as the recording);
+// * Recorded polls of REG_CMD_READ and REG_CMDB_SPACE are skipped; the
+//   player does its own flow control, so the co-processor queue never
+//   overflows even if the chip is slower than during the recording;
+// * The command queue is relocated: the player follows the value that
+//   Steve read from REG_CMD_WRITE during the recording, and moves writes
+//   to RAM_CMD and REG_CMD_WRITE by the difference with the actual chip.
+// All other reads are performed as recorded; the data is discarded.
+class SteveReplay
+{
+public:
+  //-------------------------------------------------------------------------
+  // Result of a replay
+  struct Result
+  {
+    uint32_t          _recorded_us;     // Duration of the recording
+    uint32_t          _delay_ms;        // Delays skipped (included above)
+    uint32_t          _replay_us;       // Duration of the replay
+    uint32_t          _transactions;    // Transactions in the recording
+    uint32_t          _bursts;          // Write bursts sent by the player
+    uint32_t          _reads;           // Reads sent by the player
+    uint32_t          _skipped;         // Recorded polls that were skipped
+    uint32_t          _bytes;           // Bytes written by the player
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint16_t CHUNK_SIZE = 64; // Buffer size for reads
+  const static uint16_t CMD_MASK = Steve::RAM_CMD_SIZE - 1;
+
+  //-------------------------------------------------------------------------
+  // Data
+  SteveHAL         &_hal;               // HAL to send the traffic to
+  uint8_t           _dummies;           // Dummy bytes for reads
+  Result            _result;            // Statistics
+
+  // Recorded transaction
+  bool              _selected;          // True=in transaction
+  uint8_t           _header[3];         // Header of transaction
+  uint8_t           _headerlen;         // Header bytes received
+  uint32_t          _address;           // Current recorded address
+  uint32_t          _received;          // Bytes received in transaction
+  uint8_t           _value[4];          // First bytes received or written
+  uint8_t           _valuelen;          // Bytes written to REG_CMD_WRITE
+
+  // State of the chip
+  bool              _open;              // True=write burst in progress
+  uint32_t          _next;              // Address for next byte of burst
+  uint16_t          _delta;             // Offset in RAM_CMD
+  uint16_t          _cmd_read;          // Last known REG_CMD_READ
+  uint16_t          _cmd_space;         // Last known REG_CMDB_SPACE
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveReplay(
+    SteveHAL &hal,                      // HAL, chip already initialized
+    uint8_t dummies = 1)                // Dummy bytes for reads
+    : _hal(hal)
+    , _dummies(dummies)
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the result of the last replay
+  const Result &                        // Returns statistics
+  GetResult() const
+  {
+    return _result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // End the write burst if there is one
+  void Close()
+  {
+    if (_open)
+    {
+      _hal.Select(false);
+      _open = false;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Read from the chip
+  //
+  // Longer reads are split into one read transaction per chunk, so that
+  // only SteveHAL::ReadTransaction is needed. Only the first chunk is kept.
+  void Read(
+    uint32_t address,                   // Address to read
+    uint8_t *buffer,                    // Buffer of CHUNK_SIZE bytes
+    uint32_t len)                       // Number of bytes
+  {
+    uint8_t scratch[CHUNK_SIZE];
+
+    Close();
+
+    for (uint32_t n = 0; n < len; n += CHUNK_SIZE)
+    {
+      uint32_t a = address + n;
+      uint8_t header[3 + 4];
+      uint8_t headerlen = 0;
+
+      header[headerlen++] = (uint8_t)(a >> 16);
+      header[headerlen++] = (uint8_t)(a >> 8);
+      header[headerlen++] = (uint8_t)(a);
+      for (uint8_t u = 0; (u < _dummies) && (u < 4); u++)
+      {
+        header[headerlen++] = 0;
+      }
+
+      _hal.ReadTransaction(header, headerlen, n ? scratch : buffer, (len - n < CHUNK_SIZE) ? len - n : CHUNK_SIZE);
+    }
+
+    _result._reads++;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Read a 16 bit register
+  uint16_t                              // Returns value
+  Read16(
+    uint32_t address)                   // Address to read
+  {
+    uint8_t buf[CHUNK_SIZE];
+
+    Read(address, buf, 2);
+
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write data, merged with the previous burst if possible
+  void Burst(
+    uint32_t address,                   // Address to write
+    const uint8_t *data,                // Data to write
+    uint32_t len)                       // Number of bytes
+  {
+    if ((!_open) || (address != _next))
+    {
+      Close();
+
+      _hal.Select(true);
+      _hal.Send24BE(Steve::HOSTCMD_WRITE | address);
+      _open = true;
+      _result._bursts++;
+    }
+
+    _hal.SendBuffer(data, len);
+    _result._bytes += len;
+
+    // REG_CMDB_WRITE doesn't auto-increment
+    _next = (address == Steve::REG_CMDB_WRITE) ? address : address + len;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write commands through REG_CMDB_WRITE
+  void WriteBulk(
+    const uint8_t *data,                // Data to write
+    uint32_t len)                       // Number of bytes
+  {
+    while (len)
+    {
+      if (!_cmd_space)
+      {
+        _cmd_space = Read16(Steve::REG_CMDB_SPACE) & (CMD_MASK & ~3);
+        continue;
+      }
+
+      uint32_t n = (len < _cmd_space) ? len : _cmd_space;
+
+      Burst(Steve::REG_CMDB_WRITE, data, n);
+
+      _cmd_space -= (uint16_t)n;
+      data += n;
+      len -= n;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write commands to RAM_CMD, at the relocated address
+  void WriteRing(
+    uint32_t address,                   // Recorded address in RAM_CMD
+    const uint8_t *data,                // Data to write
+    uint32_t len)                       // Number of bytes
+  {
+    uint16_t offset = (uint16_t)((address - Steve::RAM_CMD + _delta) & CMD_MASK);
+
+    while (len)
+    {
+      // Don't overwrite commands that the co-processor hasn't read yet
+      uint16_t space = (uint16_t)((_cmd_read - offset - 4) & CMD_MASK);
+      if (!space)
+      {
+        _cmd_read = Read16(Steve::REG_CMD_READ);
+        if (_cmd_read == Steve::READ_INDEX_ERROR)
+        {
+          DBG_STAT("Co-processor fault during replay\n");
+          return;
+        }
+        continue;
+      }
+
+      uint32_t n = Steve::RAM_CMD_SIZE - offset;
+      n = (len < n) ? len : n;
+      n = (space < n) ? space : n;
+
+      Burst(Steve::RAM_CMD + offset, data, n);
+
+      offset = (uint16_t)((offset + n) & CMD_MASK);
+      data += n;
+      len -= n;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Process data that was sent in the recording
+  void Sent(
+    const uint8_t *data,                // Data that was sent
+    uint32_t len)                       // Number of bytes
+  {
+    if (!_selected)
+    {
+      return;
+    }
+
+    while ((len) && (_headerlen < 3))
+    {
+      _header[_headerlen++] = *data++;
+      len--;
+
+      if (_headerlen == 3)
+      {
+        _address = (((uint32_t)_header[0] << 16) | ((uint32_t)_header[1] << 8) | _header[2]) & 0x3FFFFF;
+      }
+    }
+
+    // Only the data of writes is used
+    if ((!len) || ((_header[0] & 0xC0) != 0x80))
+    {
+      return;
+    }
+
+    if (_address == Steve::REG_CMDB_WRITE)
+    {
+      WriteBulk(data, len);
+    }
+    else if ((_address >= Steve::REG_CMD_WRITE) && (_address < Steve::REG_CMD_WRITE + 4))
+    {
+      // Relocated at the end of the transaction
+      while ((len) && (_valuelen < 4))
+      {
+        _value[_valuelen++] = *data++;
+        len--;
+      }
+    }
+    else if ((_address >= Steve::RAM_CMD) && (_address < Steve::RAM_CMD + Steve::RAM_CMD_SIZE))
+    {
+      WriteRing(_address, data, len);
+      _address += len;
+    }
+    else
+    {
+      Burst(_address, data, len);
+      _address += len;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Process data that was received in the recording
+  void Received(
+    const uint8_t *data,                // Data that was received
+    uint32_t len)                       // Number of bytes
+  {
+    for (uint32_t u = 0; u < len; u++)
+    {
+      if (_received < 4)
+      {
+        _value[_received] = data[u];
+      }
+
+      _received++;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Process the end of a recorded transaction
+  void Deselected()
+  {
+    if ((!_selected) || (_headerlen < 3))
+    {
+      _selected = false;
+      return;
+    }
+
+    _selected = false;
+    _result._transactions++;
+
+    switch (_header[0] & 0xC0)
+    {
+    case 0x80:
+      if (_valuelen)
+      {
+        // Relocate the write index
+        uint16_t index = (uint16_t)((_value[0] | (_value[1] << 8)) + _delta) & CMD_MASK;
+        uint8_t buf[4] = { (uint8_t)index, (uint8_t)(index >> 8), 0, 0 };
+
+        Close();
+        Burst(Steve::REG_CMD_WRITE, buf, _valuelen);
+        Close();
+      }
+      break;
+
+    case 0x00:
+      if (!_received)
+      {
+        // Probably HOSTCMD_ACTIVE
+        break;
+      }
+
+      if ((_address == Steve::REG_CMD_READ) || (_address == Steve::REG_CMDB_SPACE))
+      {
+        _result._skipped++;
+      }
+      else
+      {
+        uint8_t buf[CHUNK_SIZE];
+
+        Read(_address, buf, _received);
+
+        if ((_address == Steve::REG_CMD_WRITE) && (_received >= 2))
+        {
+          // Steve synchronized its command index: follow the difference
+          _delta = (uint16_t)((buf[0] | (buf[1] << 8)) - (_value[0] | (_value[1] << 8))) & CMD_MASK;
+          _cmd_read = (uint16_t)(buf[0] | (buf[1] << 8));
+        }
+      }
+      break;
+
+    default:
+      // Host commands would interfere with the initialization
+      break;
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Decode a number from the stream
+  static bool                           // Returns false=end of stream
+  Decode(
+    const uint8_t *data,                // Stream
+    uint32_t len,                       // Length of stream
+    uint32_t &pos,                      // Position, updated
+    uint32_t &value)                    // Output value
+  {
+    value = 0;
+
+    for (uint8_t shift = 0; pos < len; shift += 7)
+    {
+      uint8_t b = data[pos++];
+
+      value |= (uint32_t)(b & 0x7F) << shift;
+
+      if (!(b & 0x80))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Replay a recorded stream
+  bool                                  // Returns false=invalid stream
+  Play(
+    const uint8_t *data,                // Stream from SteveHAL_Recorder
+    uint32_t len)                       // Length of stream
+  {
+    memset(&_result, 0, sizeof(_result));
+
+    if ((len < 5) || (memcmp(data, "STVR", 4)) || (data[4] != SteveHAL_Recorder::VERSION))
+    {
+      DBG_STAT("Not a recording\n");
+      return false;
+    }
+
+    _selected = false;
+    _open = false;
+    _valuelen = 0;
+
+    uint32_t start = _hal.Micros();
+
+    // Until the recording shows otherwise, assume that the recording
+    // started with an empty command queue at index 0
+    _cmd_read = Read16(Steve::REG_CMD_READ);
+    _cmd_space = 0;
+    _delta = Read16(Steve::REG_CMD_WRITE);
+    _result._reads = 0;
+
+    bool result = true;
+    uint32_t pos = 5;
+
+    while ((result) && (pos < len))
+    {
+      uint8_t type = data[pos++];
+      uint32_t delta;
+      uint32_t value = 0;
+
+      if (!Decode(data, len, pos, delta))
+      {
+        result = false;
+        break;
+      }
+
+      _result._recorded_us += delta;
+
+      switch (type)
+      {
+      case SteveHAL_Recorder::REC_SELECT:
+        _selected = true;
+        _headerlen = 0;
+        _received = 0;
+        _valuelen = 0;
+        break;
+
+      case SteveHAL_Recorder::REC_DESELECT:
+        Deselected();
+        break;
+
+      case SteveHAL_Recorder::REC_SEND:
+      case SteveHAL_Recorder::REC_RECEIVE:
+        if ((!Decode(data, len, pos, value)) || (value > len - pos))
+        {
+          result = false;
+          break;
+        }
+
+        if (type == SteveHAL_Recorder::REC_SEND)
+        {
+          Sent(data + pos, value);
+        }
+        else
+        {
+          Received(data + pos, value);
+        }
+
+        pos += value;
+        break;
+
+      case SteveHAL_Recorder::REC_INIT:
+      case SteveHAL_Recorder::REC_POWER:
+      case SteveHAL_Recorder::REC_PAUSE:
+      case SteveHAL_Recorder::REC_BUSWIDTH:
+      case SteveHAL_Recorder::REC_BEGIN:
+        pos++;
+        break;
+
+      case SteveHAL_Recorder::REC_DELAY:
+        result = Decode(data, len, pos, value);
+        _result._delay_ms += value;
+        break;
+
+      case SteveHAL_Recorder::REC_INTERRUPT:
+        result = Decode(data, len, pos, value);
+        pos++;
+        break;
+
+      case SteveHAL_Recorder::REC_END:
+        break;
+
+      default:
+        result = false;
+        break;
+      }
+    }
+
+    if ((!result) || (pos > len))
+    {
+      DBG_STAT("Recording is damaged at offset %lu\n", (unsigned long)pos);
+      result = false;
+    }
+
+    Close();
+
+    // Wait until the co-processor has caught up
+    while ((_cmd_read != Steve::READ_INDEX_ERROR) && (_cmd_read != Read16(Steve::REG_CMD_WRITE)))
+    {
+      _cmd_read = Read16(Steve::REG_CMD_READ);
+    }
+
+    _result._replay_us = _hal.Micros() - start;
+
+    return result;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
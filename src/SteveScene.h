@@ -0,0 +1,777 @@
+/****************************************************************************
+SteveScene.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a retained-mode scene of widgets, that only encodes
+the widgets that changed.
+****************************************************************************/
+
+#ifndef _STEVESCENE_H
+#define _STEVESCENE_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+#if !STEVE_CMD_WIDGETS
+#error SteveScene needs the widget commands (STEVE_CMD_WIDGETS)
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// WIDGET SCENE
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Retained-mode scene of widgets
+//
+// Normally, an application sends the commands for all of its widgets for
+// every frame. A scene instead stores the widgets as nodes with their
+// properties, and only encodes the widgets again when they change.
+//
+// The nodes are organized in groups. The first time a group is drawn,
+// and after one of its nodes changed, its commands are encoded and stored
+// in the list cache of Steve (see Steve::CmdSetListCache): on EVE4 chips
+// as a command list (see Steve::RecordList), on other chips as a display
+// list snippet (see Steve::RecordSnippet). In other frames, the group is
+// drawn with a single CMD_CALLLIST or CMD_APPEND. Nodes that change in
+// almost every frame can be left out of any group; those are encoded
+// every time they're drawn, but they don't cause a group to be encoded
+// again. So the work per frame depends on what changed, not on the number
+// of widgets.
+//
+// Each encoded node sets its own colors and tag, so that the cached
+// lists don't depend on the graphics state around them. Nodes that are
+// added as touchable get a unique tag, which can be mapped back to the
+// node with FindTag.
+//
+// Strings aren't copied; they must stay valid while they're in the
+// scene. If the contents of a string change, call SetText again to mark
+// the node as changed.
+//
+// Use the SteveSceneTable template to declare a scene with a given
+// number of nodes.
+class SteveScene
+{
+public:
+  //-------------------------------------------------------------------------
+  // Types and constants
+  typedef uint8_t NODE;
+
+  const static NODE     INVALID_NODE = 0xFF;
+  const static uint8_t  NO_TAG = 0;
+  const static uint32_t DEFAULT_COLOR = 0xFFFFFFUL;   // Co-processor
+  const static uint32_t DEFAULT_FGCOLOR = 0x003870UL; //   defaults
+
+  //-------------------------------------------------------------------------
+  // Node types
+  enum TYPE
+  {
+    TYPE_GROUP,                         // Group of nodes
+    TYPE_TEXT,                          // CMD_TEXT
+    TYPE_NUMBER,                        // CMD_NUMBER
+    TYPE_BUTTON,                        // CMD_BUTTON
+    TYPE_TOGGLE,                        // CMD_TOGGLE
+    TYPE_SLIDER,                        // CMD_SLIDER
+    TYPE_PROGRESS,                      // CMD_PROGRESS
+    TYPE_GAUGE,                         // CMD_GAUGE
+    TYPE_DIAL,                          // CMD_DIAL
+  };
+
+  //-------------------------------------------------------------------------
+  // Node
+  struct Node
+  {
+    uint8_t           _type;            // TYPE value
+    NODE              _group;           // Group, INVALID_NODE=none
+    uint8_t           _tag;             // Touch tag, NO_TAG=none
+    bool              _visible;         // True=drawn
+    bool              _dirty;           // True=group must be encoded
+    uint8_t           _list;            // List cache index (groups)
+    uint16_t          _maxsize;         // Maximum list size (groups)
+    int16_t           _x;               // X coordinate
+    int16_t           _y;               // Y coordinate
+    int16_t           _w;               // Width or radius
+    int16_t           _h;               // Height
+    int16_t           _font;            // Font
+    uint16_t          _options;         // OPT values
+    uint8_t           _major;           // Major divisions (gauge)
+    uint8_t           _minor;           // Minor divisions (gauge)
+    uint16_t          _range;           // Range of value
+    int32_t           _value;           // Value, state or number
+    uint32_t          _color;           // Color (COLOR_RGB)
+    uint32_t          _fgcolor;         // Foreground color (CMD_FGCOLOR)
+    const char       *_text;            // Text, NULL=none
+  };
+
+  //-------------------------------------------------------------------------
+  // Statistics of the last Draw
+  struct Stats
+  {
+    uint8_t           _encoded;         // Nodes that were encoded
+    uint8_t           _recorded;        // Groups that were recorded
+    uint8_t           _cached;          // Groups drawn from the cache
+  };
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  Node *const       _nodes;             // Storage for nodes
+  const uint8_t     _size;              // Number of nodes in storage
+  uint8_t           _count;             // Number of nodes in use
+  uint8_t           _next_tag;          // Next tag to assign
+  const uint8_t     _first_list;        // First list cache index
+  uint8_t           _next_list;         // Next list cache index
+  Stats             _stats;             // Statistics
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // This is protected; use SteveSceneTable.
+  SteveScene(
+    Steve &eve,                         // Display
+    Node *nodes,                        // Storage for nodes
+    uint8_t size,                       // Number of nodes in storage
+    uint8_t first_list)                 // First list cache index to use
+    : _eve(eve)
+    , _nodes(nodes)
+    , _size(size)
+    , _count(0)
+    , _next_tag(1)
+    , _first_list(first_list)
+    , _next_list(first_list)
+  {
+    memset(&_stats, 0, sizeof(_stats));
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveScene()
+  {
+    // Nothing
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Add a node
+  NODE                                  // Returns node, INVALID_NODE=full
+  Add(
+    TYPE type,                          // Type of node
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate
+    int16_t y,                          // Y coordinate
+    bool touch)                         // True=assign a tag
+  {
+    if (_count >= _size)
+    {
+      DBG_STAT("Scene is full\n");
+      return INVALID_NODE;
+    }
+
+    if ((group != INVALID_NODE) && ((group >= _count) || (_nodes[group]._type != TYPE_GROUP)))
+    {
+      DBG_STAT("Invalid group %u\n", group);
+      return INVALID_NODE;
+    }
+
+    NODE result = _count++;
+    Node &n = _nodes[result];
+
+    memset(&n, 0, sizeof(n));
+
+    n._type = (uint8_t)type;
+    n._group = group;
+    n._visible = true;
+    n._x = x;
+    n._y = y;
+    n._color = DEFAULT_COLOR;
+    n._fgcolor = DEFAULT_FGCOLOR;
+
+    if (touch)
+    {
+      if (_next_tag)
+      {
+        n._tag = _next_tag++;
+      }
+      else
+      {
+        DBG_STAT("No more tags\n");
+      }
+    }
+
+    Changed(result);
+
+    return result;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Mark the group of a node as changed
+  void Changed(
+    NODE node)                          // Node that changed
+  {
+    NODE group = (_nodes[node]._type == TYPE_GROUP) ? node : _nodes[node]._group;
+
+    if (group != INVALID_NODE)
+    {
+      _nodes[group]._dirty = true;
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Remove all nodes
+  //
+  // The list cache entries that were used by groups are invalidated.
+  void Clear()
+  {
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      if (_nodes[u]._type == TYPE_GROUP)
+      {
+        _eve.InvalidateList(_nodes[u]._list);
+      }
+    }
+
+    _next_list = _first_list;
+    _count = 0;
+    _next_tag = 1;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a group
+  //
+  // Each group uses the next entry of the list cache. The maximum size
+  // is the space that's reserved in the cache for the group; if the
+  // encoded group doesn't fit, the group is drawn without the cache.
+  // Snippets on older chips need more space than command lists, because
+  // they contain the display list commands that the widgets produce.
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddGroup(
+    uint16_t maxsize)                   // Maximum size of the list
+  {
+    NODE result = Add(TYPE_GROUP, INVALID_NODE, 0, 0, false);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._list = _next_list++;
+      _nodes[result]._maxsize = maxsize;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a text
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddText(
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate
+    int16_t y,                          // Y coordinate
+    int16_t font,                       // Font
+    Steve::OPT options,                 // Options
+    const char *text,                   // Text
+    bool touch = false)                 // True=assign a tag
+  {
+    NODE result = Add(TYPE_TEXT, group, x, y, touch);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._font = font;
+      _nodes[result]._options = (uint16_t)options;
+      _nodes[result]._text = text;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a number
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddNumber(
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate
+    int16_t y,                          // Y coordinate
+    int16_t font,                       // Font
+    Steve::OPT options,                 // Options
+    int32_t value)                      // Number
+  {
+    NODE result = Add(TYPE_NUMBER, group, x, y, false);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._font = font;
+      _nodes[result]._options = (uint16_t)options;
+      _nodes[result]._value = value;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a button
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddButton(
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate
+    int16_t y,                          // Y coordinate
+    int16_t w,                          // Width
+    int16_t h,                          // Height
+    int16_t font,                       // Font
+    Steve::OPT options,                 // Options
+    const char *text,                   // Label
+    bool touch = true)                  // True=assign a tag
+  {
+    NODE result = Add(TYPE_BUTTON, group, x, y, touch);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._w = w;
+      _nodes[result]._h = h;
+      _nodes[result]._font = font;
+      _nodes[result]._options = (uint16_t)options;
+      _nodes[result]._text = text;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a toggle
+  //
+  // The text contains the labels for both states, separated by \xFF.
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddToggle(
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate
+    int16_t y,                          // Y coordinate
+    int16_t w,                          // Width
+    int16_t font,                       // Font
+    Steve::OPT options,                 // Options
+    uint16_t state,                     // State, 0=off, 65535=on
+    const char *text,                   // Labels
+    bool touch = true)                  // True=assign a tag
+  {
+    NODE result = Add(TYPE_TOGGLE, group, x, y, touch);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._w = w;
+      _nodes[result]._font = font;
+      _nodes[result]._options = (uint16_t)options;
+      _nodes[result]._value = state;
+      _nodes[result]._text = text;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a slider or a progress bar
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddSlider(
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate
+    int16_t y,                          // Y coordinate
+    int16_t w,                          // Width
+    int16_t h,                          // Height
+    Steve::OPT options,                 // Options
+    uint16_t value,                     // Value
+    uint16_t range,                     // Range
+    bool progress = false,              // True=progress bar (no knob)
+    bool touch = true)                  // True=assign a tag
+  {
+    NODE result = Add(progress ? TYPE_PROGRESS : TYPE_SLIDER, group, x, y, touch);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._w = w;
+      _nodes[result]._h = h;
+      _nodes[result]._options = (uint16_t)options;
+      _nodes[result]._value = value;
+      _nodes[result]._range = range;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a gauge
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddGauge(
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate of center
+    int16_t y,                          // Y coordinate of center
+    int16_t r,                          // Radius
+    Steve::OPT options,                 // Options
+    uint8_t major,                      // Major divisions
+    uint8_t minor,                      // Minor divisions
+    uint16_t value,                     // Value
+    uint16_t range)                     // Range
+  {
+    NODE result = Add(TYPE_GAUGE, group, x, y, false);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._w = r;
+      _nodes[result]._options = (uint16_t)options;
+      _nodes[result]._major = major;
+      _nodes[result]._minor = minor;
+      _nodes[result]._value = value;
+      _nodes[result]._range = range;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Add a dial
+  NODE                                  // Returns node, INVALID_NODE=full
+  AddDial(
+    NODE group,                         // Group, INVALID_NODE=none
+    int16_t x,                          // X coordinate of center
+    int16_t y,                          // Y coordinate of center
+    int16_t r,                          // Radius
+    Steve::OPT options,                 // Options
+    uint16_t value,                     // Value, 0-65535 is full circle
+    bool touch = true)                  // True=assign a tag
+  {
+    NODE result = Add(TYPE_DIAL, group, x, y, touch);
+
+    if (result != INVALID_NODE)
+    {
+      _nodes[result]._w = r;
+      _nodes[result]._options = (uint16_t)options;
+      _nodes[result]._value = value;
+    }
+
+    return result;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Change the value, state or number of a node
+  //
+  // Nothing is marked as changed if the value is the same.
+  void SetValue(
+    NODE node,                          // Node to change
+    int32_t value)                      // New value
+  {
+    if ((node < _count) && (_nodes[node]._value != value))
+    {
+      _nodes[node]._value = value;
+      Changed(node);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Change the text of a node
+  //
+  // The node is always marked as changed, because the contents of the
+  // string may have changed even if the pointer is the same.
+  void SetText(
+    NODE node,                          // Node to change
+    const char *text)                   // New text
+  {
+    if (node < _count)
+    {
+      _nodes[node]._text = text;
+      Changed(node);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Change the colors of a node
+  //
+  // The color is used for text; the foreground color is used for the
+  // widgets that use CMD_FGCOLOR.
+  void SetColor(
+    NODE node,                          // Node to change
+    uint32_t color,                     // Color
+    uint32_t fgcolor = DEFAULT_FGCOLOR) // Foreground color
+  {
+    if ((node < _count) && ((_nodes[node]._color != color) || (_nodes[node]._fgcolor != fgcolor)))
+    {
+      _nodes[node]._color = color;
+      _nodes[node]._fgcolor = fgcolor;
+      Changed(node);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Move a node
+  void SetPosition(
+    NODE node,                          // Node to change
+    int16_t x,                          // X coordinate
+    int16_t y)                          // Y coordinate
+  {
+    if ((node < _count) && ((_nodes[node]._x != x) || (_nodes[node]._y != y)))
+    {
+      _nodes[node]._x = x;
+      _nodes[node]._y = y;
+      Changed(node);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Show or hide a node or a group
+  void SetVisible(
+    NODE node,                          // Node to change
+    bool visible)                       // True=show, false=hide
+  {
+    if ((node < _count) && (_nodes[node]._visible != visible))
+    {
+      _nodes[node]._visible = visible;
+
+      // Hiding a group doesn't change what's in it
+      if (_nodes[node]._type != TYPE_GROUP)
+      {
+        Changed(node);
+      }
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get a node
+  const Node *                          // Returns node, NULL=invalid
+  GetNode(
+    NODE node) const                    // Node to get
+  {
+    return (node < _count) ? &_nodes[node] : NULL;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Find the node that has a tag
+  //
+  // Use this with the tag that the touch screen reports (e.g. see
+  // SteveTouch).
+  NODE                                  // Returns node, INVALID_NODE=none
+  FindTag(
+    uint8_t tag) const                  // Tag to find
+  {
+    if (tag != NO_TAG)
+    {
+      for (uint8_t u = 0; u < _count; u++)
+      {
+        if (_nodes[u]._tag == tag)
+        {
+          return u;
+        }
+      }
+    }
+
+    return INVALID_NODE;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send the commands for a node
+  virtual void Encode(
+    const Node &n)                      // Node to encode
+  {
+    Steve::OPT options = (Steve::OPT)n._options;
+
+    _eve.cmd_TAG(n._tag);
+    _eve.cmd_COLOR_RGB((uint8_t)(n._color >> 16), (uint8_t)(n._color >> 8), (uint8_t)n._color);
+
+    if ((n._type != TYPE_TEXT) && (n._type != TYPE_NUMBER))
+    {
+      _eve.cmd_FGCOLOR(n._fgcolor);
+    }
+
+    switch (n._type)
+    {
+    case TYPE_TEXT:
+      _eve.cmd_TEXT(n._x, n._y, n._font, options, n._text ? n._text : "");
+      break;
+
+    case TYPE_NUMBER:
+      _eve.cmd_NUMBER(n._x, (uint16_t)n._y, n._font, options, n._value);
+      break;
+
+    case TYPE_BUTTON:
+      _eve.cmd_BUTTON(n._x, n._y, n._w, n._h, n._font, options, n._text ? n._text : "");
+      break;
+
+    case TYPE_TOGGLE:
+      _eve.cmd_TOGGLE(n._x, n._y, n._w, (uint16_t)n._font, options, (uint16_t)n._value, n._text ? n._text : "");
+      break;
+
+    case TYPE_SLIDER:
+      _eve.cmd_SLIDER(n._x, n._y, n._w, n._h, options, (uint16_t)n._value, n._range);
+      break;
+
+    case TYPE_PROGRESS:
+      _eve.cmd_PROGRESS(n._x, n._y, n._w, n._h, options, (uint16_t)n._value, n._range);
+      break;
+
+    case TYPE_GAUGE:
+      _eve.cmd_GAUGE(n._x, n._y, n._w, options, n._major, n._minor, (uint16_t)n._value, n._range);
+      break;
+
+    case TYPE_DIAL:
+      _eve.cmd_DIAL(n._x, n._y, n._w, options, (uint16_t)n._value);
+      break;
+
+    default:
+      break;
+    }
+
+    _stats._encoded++;
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Send the commands for all visible nodes in a group
+  void EncodeGroup(
+    NODE group)                         // Group to encode
+  {
+    // The encoded commands must not depend on the state before them
+    _eve.ShadowReset();
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      if ((_nodes[u]._group == group) && (_nodes[u]._visible))
+      {
+        Encode(_nodes[u]);
+      }
+    }
+
+    _eve.cmd_TAG(NO_TAG);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Draw a group
+  void DrawGroup(
+    NODE group)                         // Group to draw
+  {
+    Node &g = _nodes[group];
+    bool lists = (_eve.ChipId() >= SteveDisplay::CHIPID_BT817);
+
+    if (!g._dirty)
+    {
+      if (lists ? _eve.CallList(g._list) : _eve.AppendSnippet(g._list))
+      {
+        _stats._cached++;
+        return;
+      }
+    }
+
+    bool recorded;
+    uint8_t encoded = _stats._encoded;
+
+    if (lists)
+    {
+      recorded = _eve.RecordList(g._list, g._maxsize, [&]() { EncodeGroup(group); });
+
+      if (recorded)
+      {
+        _eve.CallList(g._list);
+      }
+    }
+    else
+    {
+      // Recording a snippet also draws it
+      recorded = _eve.RecordSnippet(g._list, g._maxsize, [&]() { EncodeGroup(group); });
+    }
+
+    if (recorded)
+    {
+      g._dirty = false;
+      _stats._recorded++;
+    }
+    else if ((lists) || (_stats._encoded == encoded))
+    {
+      // Without space in the cache, the group is drawn directly, and is
+      // recorded again next time. A snippet that was too big was already
+      // drawn while it was recorded.
+      EncodeGroup(group);
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Draw the scene in the display list that's being built
+  //
+  // Groups and nodes that aren't in a group are drawn in the order in
+  // which they were added. Nodes in a group are drawn with their group.
+  // The tag is reset to NO_TAG afterwards.
+  void Draw()
+  {
+    memset(&_stats, 0, sizeof(_stats));
+
+    for (uint8_t u = 0; u < _count; u++)
+    {
+      const Node &n = _nodes[u];
+
+      if (!n._visible)
+      {
+        continue;
+      }
+
+      if (n._type == TYPE_GROUP)
+      {
+        DrawGroup(u);
+      }
+      else if (n._group == INVALID_NODE)
+      {
+        Encode(n);
+        _eve.cmd_TAG(NO_TAG);
+      }
+    }
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the statistics of the last Draw
+  const Stats &                         // Returns statistics
+  GetStats() const
+  {
+    return _stats;
+  }
+};
+
+//---------------------------------------------------------------------------
+// Scene with a given number of nodes
+template<const uint8_t count> class SteveSceneTable : public SteveScene
+{
+private:
+  Node              _storage[count];    // Storage
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveSceneTable(
+    Steve &eve,                         // Display
+    uint8_t first_list = 0)             // First list cache index to use
+    : SteveScene(eve, _storage, count, first_list)
+  {
+    // Nothing
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
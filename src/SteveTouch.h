@@ -0,0 +1,314 @@
+/****************************************************************************
+SteveTouch.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares an interrupt-driven touch event queue for Steve.
+****************************************************************************/
+
+#ifndef _STEVETOUCH_H
+#define _STEVETOUCH_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// TOUCH EVENT QUEUE
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Touch screen events
+//
+// This enables the touch screen and the touch interrupts of the EVE, and
+// turns the touch registers into a queue of events that the application
+// can get at its own pace.
+//
+// Poll should be called regularly, e.g. once per main loop. If the HAL
+// can see the !INT line, Poll doesn't use the SPI bus at all until the
+// EVE reports a change. When it does, the interrupt flags are read, and
+// the touch registers are read in one transaction (see RegReadSnapshot).
+// The conversion-complete interrupt, which fires for every sample, is
+// only enabled while the screen is touched, to track movement.
+//
+// The application must not disable the touch interrupts with
+// Steve::EnableInterrupts while this is in use; other interrupts can be
+// enabled in addition to the ones that are used here.
+//
+// Use the SteveTouchTable template to declare a queue with a given number
+// of events.
+class SteveTouch
+{
+public:
+  //-------------------------------------------------------------------------
+  // Event types
+  enum EVENT
+  {
+    EVENT_DOWN,                         // Screen is touched
+    EVENT_MOVE,                         // Touch moved
+    EVENT_UP,                           // Screen is released
+    EVENT_TAG,                          // Tag under the touch changed
+  };
+
+  //-------------------------------------------------------------------------
+  // Event
+  struct Event
+  {
+    uint32_t          _time_us;         // Host time (SteveHAL::Micros)
+    int16_t           _x;               // X coordinate in pixels
+    int16_t           _y;               // Y coordinate in pixels
+    uint8_t           _type;            // EVENT value
+    uint8_t           _tag;             // Tag under touch, 0=none
+  };
+
+  //-------------------------------------------------------------------------
+  // Interrupts that are used
+  const static uint16_t INT_EDGES = Steve::INT_TOUCH | Steve::INT_TAG;
+  const static uint16_t INT_ALL = INT_EDGES | Steve::INT_CONVCOMPLETE;
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  Event *const      _events;            // Storage for events
+  const uint8_t     _size;              // Number of events in storage
+  uint8_t           _head;              // Index of oldest event
+  uint8_t           _count;             // Number of queued events
+  uint16_t          _lost;              // Events lost because queue full
+  Steve::RegSnapshotTable<2> _snapshot; // Touch registers
+  bool              _down;              // True=screen is touched
+  int16_t           _x;                 // Last X coordinate
+  int16_t           _y;                 // Last Y coordinate
+  uint8_t           _tag;               // Last tag
+
+protected:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // This is protected; use SteveTouchTable.
+  SteveTouch(
+    Steve &eve,                         // Display
+    Event *events,                      // Storage for events
+    uint8_t size)                       // Number of events in storage
+    : _eve(eve)
+    , _events(events)
+    , _size(size)
+    , _head(0)
+    , _count(0)
+    , _lost(0)
+    , _down(false)
+    , _x(0)
+    , _y(0)
+    , _tag(0)
+  {
+    _snapshot.Add(Steve::REG_TOUCH_SCREEN_XY);
+    _snapshot.Add(Steve::REG_TOUCH_TAG);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Destructor
+  virtual ~SteveTouch()
+  {
+    // Nothing
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Enable the touch screen and the interrupts
+  //
+  // This must be called after Steve::Begin, which disables the touch
+  // screen (see Steve::TouchInit).
+  virtual void Begin(
+    Steve::TOUCHMODE mode = Steve::TOUCHMODE_CONTINUOUS)
+                                        // Sample mode
+  {
+    _head = 0;
+    _count = 0;
+    _lost = 0;
+    _down = false;
+    _tag = 0;
+
+    _eve.RegWrite8(Steve::REG_TOUCH_MODE, (uint8_t)mode);
+    _eve.EnableInterrupts((_eve.Interrupts() & ~INT_ALL) | INT_EDGES, false);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Disable the touch screen and the interrupts
+  virtual void End()
+  {
+    _eve.EnableInterrupts(_eve.Interrupts() & ~INT_ALL, false);
+    _eve.IntClearFlags(INT_ALL);
+    _eve.RegWrite8(Steve::REG_TOUCH_MODE, Steve::TOUCHMODE_OFF);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Store an event in the queue
+  //
+  // If the queue is full, the event is lost.
+  void Queue(
+    EVENT type,                         // Type of event
+    uint32_t time_us)                   // Time of event
+  {
+    if (_count >= _size)
+    {
+      _lost++;
+      return;
+    }
+
+    Event &e = _events[(_head + _count) % _size];
+
+    e._time_us = time_us;
+    e._x = _x;
+    e._y = _y;
+    e._type = (uint8_t)type;
+    e._tag = _tag;
+
+    _count++;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check for changes and queue events
+  uint8_t                               // Returns number of new events
+  Poll()
+  {
+    if (!_eve.IntPending())
+    {
+      return 0;
+    }
+
+    uint16_t flags = _eve.IntReadFlags() & INT_ALL;
+
+    if (!flags)
+    {
+      return 0;
+    }
+
+    _eve.IntClearFlags(flags);
+
+    uint8_t before = _count;
+    uint32_t now = _eve.HostMicros();
+
+    _eve.RegReadSnapshot(_snapshot);
+
+    bool down = _snapshot.Touched();
+    bool tagged = (_snapshot.Tag() != _tag);
+
+    _tag = _snapshot.Tag();
+
+    if (down)
+    {
+      int16_t x = _snapshot.TouchX();
+      int16_t y = _snapshot.TouchY();
+      bool moved = (x != _x) || (y != _y);
+
+      _x = x;
+      _y = y;
+
+      if (!_down)
+      {
+        Queue(EVENT_DOWN, now);
+
+        // Track movement until the screen is released
+        _eve.EnableInterrupts(_eve.Interrupts() | Steve::INT_CONVCOMPLETE, false);
+      }
+      else if (moved)
+      {
+        Queue(EVENT_MOVE, now);
+      }
+    }
+    else if (_down)
+    {
+      // The coordinates of the release are the last known ones
+      Queue(EVENT_UP, now);
+
+      _eve.EnableInterrupts(_eve.Interrupts() & ~Steve::INT_CONVCOMPLETE, false);
+    }
+
+    _down = down;
+
+    if (tagged)
+    {
+      Queue(EVENT_TAG, now);
+    }
+
+    return (uint8_t)(_count - before);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the oldest event from the queue
+  bool                                  // Returns false=queue empty
+  Get(
+    Event &event)                       // Output event
+  {
+    if (!_count)
+    {
+      return false;
+    }
+
+    event = _events[_head];
+    _head = (uint8_t)((_head + 1) % _size);
+    _count--;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of events in the queue
+  uint8_t                               // Returns number of events
+  Count() const
+  {
+    return _count;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the number of events that were lost because the queue was full
+  uint16_t                              // Returns number of lost events
+  Lost() const
+  {
+    return _lost;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Check if the screen is touched
+  //
+  // This returns the state after the last Poll.
+  bool                                  // Returns true=touched
+  IsDown() const
+  {
+    return _down;
+  }
+};
+
+//---------------------------------------------------------------------------
+// Touch event queue with a given number of events
+template<const uint8_t count> class SteveTouchTable : public SteveTouch
+{
+private:
+  Event             _storage[count];    // Storage
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  SteveTouchTable(
+    Steve &eve)                         // Display
+    : SteveTouch(eve, _storage, count)
+  {
+    // Nothing
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif
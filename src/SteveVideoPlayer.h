@@ -0,0 +1,488 @@
+/****************************************************************************
+SteveVideoPlayer.h
+(C) 2023 Jac Goudsmit
+MIT License.
+
+This file declares a video player that streams AVI (motion JPEG) data from
+the host to the EVE through the media FIFO.
+****************************************************************************/
+
+#ifndef _STEVEVIDEOPLAYER_H
+#define _STEVEVIDEOPLAYER_H
+
+/////////////////////////////////////////////////////////////////////////////
+// INCLUDES
+/////////////////////////////////////////////////////////////////////////////
+
+#include "Steve.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// MACROS
+/////////////////////////////////////////////////////////////////////////////
+
+// Number of bytes that are read from a stream at a time. This must be a
+// multiple of 4.
+#ifndef STEVEVIDEOPLAYER_CHUNK_SIZE
+#define STEVEVIDEOPLAYER_CHUNK_SIZE 512
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// VIDEO PLAYER
+/////////////////////////////////////////////////////////////////////////////
+
+//---------------------------------------------------------------------------
+// Frame-paced video player
+//
+// The video data is written to the media FIFO, and each frame is decoded
+// with CMD_VIDEOFRAME into a bitmap in RAM_G, when it's time to show it
+// according to the frame rate in the AVI header. Update must be called
+// regularly (e.g. once per main loop): it tops up the media FIFO with as
+// much data as fits, without waiting, and starts decoding the next frame
+// when it's due. The application draws the current frame into its own
+// display lists with Draw.
+//
+// The data can come from memory, or from a function that's provided by
+// the application. On Windows, a file can be mapped into memory (e.g.
+// with MapViewOfFile) and played from memory without copying. On Arduino,
+// the read function can read from a file on an SD card.
+//
+// The co-processor stops to wait if a frame isn't completely in the
+// FIFO. To avoid that, a frame is only started if the FIFO is at least
+// half full (or the end of the stream was reached); otherwise the frame
+// is postponed and counted as an underrun. Frames that are decoded too
+// late to be shown at their time are counted as dropped.
+//
+// With two frame buffers, each frame is decoded into the buffer that's
+// not on the screen, so the decoding isn't visible.
+class SteveVideoPlayer
+{
+public:
+  //-------------------------------------------------------------------------
+  // Function that reads data from a stream
+  //
+  // The function should return a multiple of 4 bytes, except at the end
+  // of the stream. It should return 0 at the end of the stream.
+  typedef uint32_t (*READ_FUNC)(        // Returns num bytes read, 0=end
+    uint8_t *buffer,                    // Buffer to fill
+    uint32_t len,                       // Size of buffer
+    void *context);                     // Context from Begin
+
+  //-------------------------------------------------------------------------
+  // State of the player
+  enum STATE
+  {
+    STATE_IDLE,                         // Not playing
+    STATE_PLAYING,                      // Playing
+    STATE_DONE,                         // Last frame was decoded
+    STATE_ERROR,                        // Co-processor error
+  };
+
+  //-------------------------------------------------------------------------
+  // Playback statistics
+  struct Stats
+  {
+    uint32_t          _frames;          // Frames decoded
+    uint32_t          _dropped;         // Frame times that were missed
+    uint32_t          _underruns;       // Frames postponed for lack of data
+    uint32_t          _bytes;           // Bytes written to the media FIFO
+  };
+
+  //-------------------------------------------------------------------------
+  // Constants
+  const static uint32_t DEFAULT_US_PER_FRAME = 33333; // If not in header
+  const static uint32_t DONE_BUSY = 0xFFFFFFFFUL;     // Frame not decoded
+
+protected:
+  //-------------------------------------------------------------------------
+  // Data
+  Steve            &_eve;               // Display
+  uint32_t          _fifo_address;      // Media FIFO in RAM_G
+  uint32_t          _fifo_size;         // Size of media FIFO
+  uint32_t          _frame_address;     // First frame buffer in RAM_G
+  uint32_t          _done_address;      // Completion pointer in RAM_G
+  uint8_t           _buffers;           // Number of frame buffers (1/2)
+  STATE             _state;             // Current state
+  READ_FUNC         _read;              // Read function, NULL=memory
+  void             *_context;           // Context for read function
+  const uint8_t    *_data;              // Data in memory
+  uint32_t          _len;               // Length of data in memory
+  uint32_t          _pos;               // Bytes of data written so far
+  bool              _eof;               // True=all data is in the FIFO
+  uint8_t           _chunk[STEVEVIDEOPLAYER_CHUNK_SIZE];
+                                        // Data read from stream
+  uint32_t          _chunk_len;         // Bytes in _chunk
+  uint32_t          _chunk_pos;         // Bytes of _chunk written
+  uint16_t          _width;             // Width in pixels
+  uint16_t          _height;            // Height in pixels
+  uint32_t          _us_per_frame;      // Time per frame
+  uint32_t          _next_us;           // Time when next frame is due
+  bool              _decoding;          // True=frame being decoded
+  uint8_t           _shown;             // Buffer with the current frame
+  bool              _has_frame;         // True=a frame was decoded
+  Stats             _stats;             // Statistics
+
+public:
+  //-------------------------------------------------------------------------
+  // Constructor
+  //
+  // The frame buffers need width * height * 2 bytes each (RGB565). The
+  // completion pointer needs 4 bytes. All addresses must be multiples of
+  // 4, and the areas must not overlap.
+  SteveVideoPlayer(
+    Steve &eve,                         // Display
+    uint32_t fifo_address,              // Media FIFO address in RAM_G
+    uint32_t fifo_size,                 // Media FIFO size
+    uint32_t frame_address,             // Frame buffer(s) in RAM_G
+    uint32_t done_address,              // Completion pointer in RAM_G
+    uint8_t buffers = 1)                // Number of frame buffers (1/2)
+    : _eve(eve)
+    , _fifo_address(fifo_address)
+    , _fifo_size(fifo_size)
+    , _frame_address(frame_address)
+    , _done_address(done_address)
+    , _buffers((buffers > 1) ? 2 : 1)
+    , _state(STATE_IDLE)
+    , _read(NULL)
+    , _context(NULL)
+    , _data(NULL)
+    , _len(0)
+    , _pos(0)
+    , _eof(false)
+    , _chunk_len(0)
+    , _chunk_pos(0)
+    , _width(0)
+    , _height(0)
+    , _us_per_frame(DEFAULT_US_PER_FRAME)
+    , _next_us(0)
+    , _decoding(false)
+    , _shown(0)
+    , _has_frame(false)
+  {
+    memset(&_stats, 0, sizeof(_stats));
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get a little-endian value from the AVI header
+  static uint32_t                       // Returns value
+  Get32(
+    const uint8_t *p)                   // Location of value
+  {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Get the frame time and the size from the main AVI header
+  //
+  // The "avih" chunk is near the start of the file; if it can't be found
+  // in the given data, the defaults are used.
+  void ParseHeader(
+    const uint8_t *data,                // Start of the file
+    uint32_t len)                       // Number of bytes available
+  {
+    for (uint32_t u = 0; u + 8 + 40 <= len; u++)
+    {
+      if ((data[u] == 'a') && (data[u + 1] == 'v') && (data[u + 2] == 'i') && (data[u + 3] == 'h'))
+      {
+        const uint8_t *avih = data + u + 8;
+
+        if (Get32(avih))
+        {
+          _us_per_frame = Get32(avih);
+        }
+
+        _width = (uint16_t)Get32(avih + 32);
+        _height = (uint16_t)Get32(avih + 36);
+
+        DBG_GEEK("Video %ux%u, %lu us per frame\n", _width, _height, _us_per_frame);
+        return;
+      }
+    }
+
+    DBG_STAT("No AVI header found\n");
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Write as much data to the media FIFO as fits, without waiting
+  void Feed()
+  {
+    while (!_eof)
+    {
+      uint32_t written;
+
+      if (!_read)
+      {
+        written = _eve.MediaFifoWrite(_data + _pos, _len - _pos, false);
+
+        _pos += written;
+        _eof = (_pos >= _len);
+      }
+      else
+      {
+        if (_chunk_pos >= _chunk_len)
+        {
+          _chunk_len = _read(_chunk, sizeof(_chunk), _context);
+          _chunk_pos = 0;
+
+          if (!_chunk_len)
+          {
+            _eof = true;
+            break;
+          }
+        }
+
+        written = _eve.MediaFifoWrite(_chunk + _chunk_pos, _chunk_len - _chunk_pos, false);
+
+        _chunk_pos += written;
+        _pos += written;
+      }
+
+      _stats._bytes += written;
+
+      if (!written)
+      {
+        // The FIFO is full
+        break;
+      }
+    }
+  }
+
+protected:
+  //-------------------------------------------------------------------------
+  // Start playing
+  //
+  // For a stream, the chunk buffer may already hold the start of the file.
+  bool                                  // Returns true=success
+  Start()
+  {
+    memset(&_stats, 0, sizeof(_stats));
+
+    _pos = 0;
+    _eof = false;
+    _decoding = false;
+    _shown = 0;
+    _has_frame = false;
+    _state = STATE_IDLE;
+
+    if (!_eve.MediaFifoBegin(_fifo_address, _fifo_size))
+    {
+      _state = STATE_ERROR;
+      return false;
+    }
+
+    Feed();
+
+    // CMD_VIDEOSTART reads the AVI header from the FIFO
+    _eve.cmd_VIDEOSTART();
+    _eve.CmdExecute();
+
+    _next_us = _eve.HostMicros();
+    _state = STATE_PLAYING;
+
+    return true;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start playing a video from memory
+  //
+  // The data must stay valid until the video was played.
+  bool                                  // Returns true=success
+  Begin(
+    const uint8_t *data,                // AVI data
+    uint32_t len)                       // Length of data
+  {
+    _read = NULL;
+    _context = NULL;
+    _data = data;
+    _len = len;
+    _chunk_len = 0;
+    _chunk_pos = 0;
+
+    ParseHeader(data, len);
+
+    return Start();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Start playing a video from a stream
+  bool                                  // Returns true=success
+  Begin(
+    READ_FUNC read,                     // Function that reads data
+    void *context = NULL)               // Context for read function
+  {
+    _read = read;
+    _context = context;
+    _data = NULL;
+    _len = 0;
+
+    // Read the first chunk to get the header; Feed sends it to the FIFO
+    _chunk_len = read(_chunk, sizeof(_chunk), context);
+    _chunk_pos = 0;
+
+    ParseHeader(_chunk, _chunk_len);
+
+    return Start();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Keep the FIFO filled and decode frames when they're due
+  //
+  // The co-processor isn't waited for; if the previous frame isn't done
+  // yet, the next one is started during a later call.
+  STATE                                 // Returns current state
+  Update()
+  {
+    if (_state != STATE_PLAYING)
+    {
+      return _state;
+    }
+
+    Feed();
+
+    if (_decoding)
+    {
+      uint32_t done = _eve.RegRead32(_done_address);
+
+      if (done == DONE_BUSY)
+      {
+        bool error;
+
+        _eve.CmdIsBusy(&error);
+
+        if (error)
+        {
+          _state = STATE_ERROR;
+        }
+
+        return _state;
+      }
+
+      _decoding = false;
+      _has_frame = true;
+      _shown = (uint8_t)((_shown + 1) % _buffers);
+      _stats._frames++;
+
+      // CMD_VIDEOFRAME writes 0 when it decoded the last frame
+      if (done == 0)
+      {
+        _state = STATE_DONE;
+        return _state;
+      }
+    }
+
+    uint32_t now = _eve.HostMicros();
+
+    if ((int32_t)(now - _next_us) < 0)
+    {
+      return _state;
+    }
+
+    if ((!_eof) && (_eve.MediaFifoSpace() > _fifo_size / 2))
+    {
+      _stats._underruns++;
+      return _state;
+    }
+
+    // Skip the frame times that were missed
+    uint32_t late = (now - _next_us) / _us_per_frame;
+
+    _stats._dropped += late;
+    _next_us += (late + 1) * _us_per_frame;
+
+    // Decode into the buffer that's not on the screen
+    uint8_t target = (uint8_t)((_shown + 1) % _buffers);
+
+    _eve.RegWrite32(_done_address, DONE_BUSY);
+    _eve.cmd_VIDEOFRAME(FrameAddress(target), _done_address);
+    _eve.CmdExecute();
+
+    _decoding = true;
+
+    return _state;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Stop playing
+  void End()
+  {
+    _state = STATE_IDLE;
+    _decoding = false;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the address of a frame buffer
+  uint32_t                              // Returns address in RAM_G
+  FrameAddress(
+    uint8_t buffer) const               // Buffer number
+  {
+    return _frame_address + (buffer ? (uint32_t)_width * _height * 2 : 0);
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Draw the current frame
+  //
+  // This adds the commands to show the frame at the given location to the
+  // display list that's being built. The current bitmap handle is used.
+  // Nothing is drawn until the first frame was decoded.
+  void Draw(
+    int16_t x,                          // X coordinate in pixels
+    int16_t y)                          // Y coordinate in pixels
+  {
+    if (!_has_frame)
+    {
+      return;
+    }
+
+    _eve.cmd_SETBITMAP(FrameAddress(_shown), Steve::FORMAT_RGB565, _width, _height);
+    _eve.cmd_BEGIN(Steve::BEGIN_BITMAPS);
+    _eve.CmdVertexPixel(x, y);
+    _eve.cmd_END();
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the current state
+  STATE                                 // Returns state
+  State() const
+  {
+    return _state;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the size of the video
+  uint16_t                              // Returns width in pixels
+  Width() const
+  {
+    return _width;
+  }
+
+  uint16_t                              // Returns height in pixels
+  Height() const
+  {
+    return _height;
+  }
+
+public:
+  //-------------------------------------------------------------------------
+  // Get the playback statistics
+  const Stats &                         // Returns statistics
+  GetStats() const
+  {
+    return _stats;
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// END
+/////////////////////////////////////////////////////////////////////////////
+
+#endif